@@ -0,0 +1,1034 @@
+// ============================================================================
+// ARQUIVO: bench.c
+//
+// DESCRIÇÃO: Modo de carga sem interface do cliente ("--bench").
+//            Abre N conexões simultâneas com o servidor e envia quadros
+//            CONTROLE/ECO com carimbo de tempo, no ritmo e tamanho
+//            configurados. O servidor devolve cada quadro ao remetente, o
+//            que permite medir o tempo de ida e volta de cada mensagem.
+//
+//            Ao final imprime, em CSV ou JSON, a vazão, os percentis
+//            p50/p99/p999 da latência de ida e volta e o tempo de conexão.
+//            Tudo roda em uma única thread com epoll.
+//
+//            Com --envio escolhe-se o modo do buffer de saída (saida.h):
+//            "interativo" liga o TCP_NODELAY e envia cada quadro na hora;
+//            "vazao" deixa o Nagle ligado e junta os quadros de cada rodada
+//            em um único send() por conexão, com MSG_MORE.
+//
+//            Com --sala, todas as conexões entram na mesma sala e enviam
+//            quadros CHAT com a flag de eco: cada mensagem é entregue a
+//            todos os membros, inclusive ao remetente. A vazão passa a
+//            contar entregas e a latência vai do envio até cada entrega,
+//            o que mede o custo da difusão conforme o número de membros.
+//
+//            No lugar do IP e da porta, --bench aceita uma URI tcp:// ou
+//            unix:// (ver transporte.h).
+//
+//            "--bench-transporte" compara a latência dos transportes: para
+//            cada URI dada (tcp://, unix://, shm://), abre uma conexão e
+//            manda ecos um de cada vez, esperando cada resposta (pingue-
+//            pongue), e imprime os percentis do tempo de ida e volta. Com
+//            uma única mensagem em voo, o que sobra além do servidor é o
+//            custo do transporte: pilha TCP, socket UNIX ou anel na memória.
+//
+//            "--bench-comandos" é um microbenchmark sem rede: mede o custo
+//            por linha de reconhecer os comandos digitados, comparando o
+//            sscanf + strcmp de antes com o módulo common/comandos.
+//
+//            "--bench-federacao" compara a entrega no mesmo nó com a
+//            entrega em outro nó da federação: um emissor e um receptor em
+//            um nó e outro receptor em um segundo nó, na mesma sala, em
+//            pingue-pongue (cada mensagem esperada nos dois receptores).
+//
+// COMO EXECUTAR: ./client --bench [ip|uri] [porta] [opções]
+//                ./client --bench-transporte <uri>... [--mensagens N] [--tamanho B]
+//                ./client --bench-comandos [iteracoes]
+//                ./client --bench-federacao <uri_no_a> <uri_no_b> [--mensagens N]
+//
+// Exemplo: ./client --bench 127.0.0.1 8080 --conexoes 100 --taxa 20000
+//                   --tamanho 128 --duracao 10 --formato json
+//          ./client --bench --sala geral --conexoes 500 --taxa 200
+//          ./client --bench --taxa 0 --envio vazao
+//          ./client --bench-transporte tcp://127.0.0.1:8080 unix:///tmp/chat.sock
+//                   shm:///tmp/chat-shm.sock --mensagens 100000
+//          ./client --bench-federacao tcp://127.0.0.1:8080 tcp://127.0.0.1:8081
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "protocolo.h"
+#include "saida.h"
+#include "transporte.h"
+#include "comandos.h"
+#include "bench.h"
+
+#define BENCH_MAX_EVENTOS 512
+#define BENCH_CABECALHO_ECO (1 + 8 + 4 + 4) // operação, carimbo, conexão, sequência
+#define BENCH_DRENAGEM_NS 2000000000ULL     // Espera pelas últimas respostas
+#define BENCH_AQUECIMENTO 1000              // Ecos de cada transporte fora da medida
+#define BENCH_PRAZO_TRANSPORTE 5            // Segundos para conectar (e por resposta, nos sockets)
+
+// Estado de uma conexão de carga
+typedef struct {
+    int fd;
+    uint32_t indice;
+    int conectada;
+    int na_sala;
+    uint64_t inicio_conexao;
+    uint32_t sequencia;
+    uint32_t em_voo;
+    LeitorQuadros leitor;
+    SaidaQuadros saida;
+} ConexaoBench;
+
+// Configuração do teste
+typedef struct {
+    EnderecoTransporte endereco;
+    int conexoes;
+    double taxa;      // Mensagens por segundo somando todas as conexões (0 = sem limite)
+    int tamanho;      // Bytes de payload por quadro
+    double duracao;   // Segundos de envio
+    int janela;       // Máximo de mensagens em voo por conexão
+    int csv;
+    const char *sala; // NULL = eco direto pelo servidor
+    ModoEnvio envio;
+} ConfigBench;
+
+// Função para ler o relógio monotônico em nanossegundos
+static uint64_t agora_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Função para acrescentar uma amostra
+void amostras_adicionar(Amostras *a, uint64_t valor) {
+    if (a->total == a->capacidade) {
+        size_t nova = a->capacidade ? a->capacidade * 2 : 4096;
+        uint64_t *novo = realloc(a->valores, nova * sizeof(uint64_t));
+        if (novo == NULL) return;
+        a->valores = novo;
+        a->capacidade = nova;
+    }
+    a->valores[a->total++] = valor;
+}
+
+// Função de comparação para qsort
+static int comparar_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Função para ordenar as amostras, antes de consultar os percentis
+void amostras_ordenar(Amostras *a) {
+    qsort(a->valores, a->total, sizeof(uint64_t), comparar_u64);
+}
+
+// Função para obter um percentil (0..1) de amostras já ordenadas
+uint64_t amostras_percentil(const Amostras *a, double p) {
+    if (a->total == 0) return 0;
+    size_t i = (size_t)(p * (double)(a->total - 1) + 0.5);
+    return a->valores[i];
+}
+
+// Função para pedir a entrada da conexão em uma sala
+static int entrar_sala(ConexaoBench *c, const char *sala) {
+    if (saida_enfileirar(&c->saida, QUADRO_SALA, sala, strlen(sala)) < 0) return -1;
+    return saida_descarregar(&c->saida, c->fd, 0) < 0 ? -1 : 0;
+}
+
+// Função para montar um quadro de eco com carimbo de tempo. No modo
+// interativo o quadro é enviado na hora; no modo vazão fica no buffer até
+// o fim da rodada. Em uma sala o mesmo corpo vai dentro de um quadro CHAT
+// com a flag de eco.
+static int enviar_eco(ConexaoBench *c, int tamanho, int em_sala) {
+    size_t total = PROTOCOLO_CABECALHO + (em_sala ? 1 : 0) + (size_t)tamanho;
+    uint8_t *q = saida_reservar(&c->saida, total);
+    if (q == NULL) return -1;
+
+    uint32_t payload = (uint32_t)(total - PROTOCOLO_CABECALHO);
+    uint16_t flags = em_sala ? QUADRO_FLAG_ECO : 0;
+    q[0] = PROTOCOLO_VERSAO;
+    q[1] = em_sala ? QUADRO_CHAT : QUADRO_CONTROLE;
+    q[2] = (uint8_t)(flags >> 8);
+    q[3] = (uint8_t)flags;
+    q[4] = (uint8_t)(payload >> 24);
+    q[5] = (uint8_t)(payload >> 16);
+    q[6] = (uint8_t)(payload >> 8);
+    q[7] = (uint8_t)payload;
+
+    uint8_t *p = q + PROTOCOLO_CABECALHO;
+    if (em_sala) *p++ = 0; // Origem vazia; o servidor preenche
+    uint64_t carimbo = agora_ns();
+    p[0] = CONTROLE_ECO;
+    memcpy(p + 1, &carimbo, 8);
+    memcpy(p + 9, &c->indice, 4);
+    memcpy(p + 13, &c->sequencia, 4);
+    memset(p + BENCH_CABECALHO_ECO, 'x', (size_t)tamanho - BENCH_CABECALHO_ECO);
+
+    saida_avancar(&c->saida, total);
+    c->sequencia++;
+    c->em_voo++;
+    if (c->saida.modo == ENVIO_VAZAO) {
+        // Lote cheio: envia já, avisando o kernel que a rodada continua
+        if (saida_pendente(&c->saida) < SAIDA_LOTE) return 0;
+        return saida_descarregar(&c->saida, c->fd, 1) < 0 ? -1 : 0;
+    }
+    return saida_descarregar(&c->saida, c->fd, 0) < 0 ? -1 : 0;
+}
+
+// Função para ler as respostas de uma conexão e registrar as latências
+static int ler_respostas(ConexaoBench *c, Amostras *rtt, uint64_t *recebidas, uint64_t *bytes) {
+    while (1) {
+        size_t livre;
+        uint8_t *destino = leitor_espaco(&c->leitor, &livre);
+        if (destino == NULL) return -1;
+        ssize_t n = transporte_receber(c->fd, destino, livre, 0);
+        if (n > 0) {
+            leitor_avancar(&c->leitor, (size_t)n);
+            *bytes += (uint64_t)n;
+            Quadro q;
+            int r;
+            uint64_t agora = agora_ns();
+            while ((r = leitor_proximo(&c->leitor, &q)) == QUADRO_PRONTO) {
+                const uint8_t *corpo = q.payload;
+                size_t tamanho_corpo = q.tamanho;
+                if (q.tipo == QUADRO_SALA) {
+                    c->na_sala = 1; // Confirmação da própria entrada (ou de outro membro)
+                    continue;
+                }
+                if (q.tipo == QUADRO_CHAT) {
+                    const char *origem, *texto;
+                    size_t tamanho_origem;
+                    if (protocolo_separar_origem(&q, &origem, &tamanho_origem, &texto,
+                                                 &tamanho_corpo) < 0) {
+                        continue;
+                    }
+                    corpo = (const uint8_t *)texto;
+                } else if (q.tipo != QUADRO_CONTROLE) {
+                    continue;
+                }
+                if (tamanho_corpo < BENCH_CABECALHO_ECO || corpo[0] != CONTROLE_ECO) {
+                    continue; // Mensagens de chat do operador são ignoradas
+                }
+                uint64_t carimbo;
+                uint32_t indice;
+                memcpy(&carimbo, corpo + 1, 8);
+                memcpy(&indice, corpo + 9, 4);
+                amostras_adicionar(rtt, agora - carimbo);
+                (*recebidas)++;
+                // A janela só avança com a volta da própria mensagem
+                if (indice == c->indice && c->em_voo > 0) c->em_voo--;
+            }
+            if (r == QUADRO_ERRO) return -1;
+        } else if (n == 0) {
+            return -1;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+}
+
+// Função para exibir o uso do modo de carga
+static void exibir_uso_bench(const char *programa) {
+    fprintf(stderr,
+        "Uso: %s --bench [ip|uri] [porta] [opções]\n"
+        "  --conexoes N   conexões simultâneas (padrão 10)\n"
+        "  --taxa R       mensagens/s somando todas as conexões, 0 = sem limite (padrão 1000)\n"
+        "  --tamanho B    bytes de payload por mensagem, mínimo %d (padrão 64)\n"
+        "  --duracao S    segundos de envio (padrão 10)\n"
+        "  --janela W     mensagens em voo por conexão (padrão 64)\n"
+        "  --formato F    csv ou json (padrão csv)\n"
+        "  --sala NOME    todas as conexões entram na sala e medem a difusão\n"
+        "  --envio M      interativo ou vazao (padrão interativo)\n",
+        programa, BENCH_CABECALHO_ECO);
+}
+
+// Função para interpretar os argumentos do modo de carga
+static int ler_config(int argc, char *argv[], ConfigBench *cfg) {
+    static struct option opcoes[] = {
+        {"conexoes", required_argument, 0, 'c'},
+        {"taxa", required_argument, 0, 'r'},
+        {"tamanho", required_argument, 0, 's'},
+        {"duracao", required_argument, 0, 'd'},
+        {"janela", required_argument, 0, 'w'},
+        {"formato", required_argument, 0, 'f'},
+        {"sala", required_argument, 0, 'a'},
+        {"envio", required_argument, 0, 'e'},
+        {0, 0, 0, 0}
+    };
+    cfg->conexoes = 10;
+    cfg->taxa = 1000;
+    cfg->tamanho = 64;
+    cfg->duracao = 10;
+    cfg->janela = 64;
+    cfg->csv = 1;
+    cfg->sala = NULL;
+    cfg->envio = ENVIO_INTERATIVO;
+
+    int opcao;
+    optind = 2; // argv[1] é o próprio "--bench"
+    while ((opcao = getopt_long(argc, argv, "c:r:s:d:w:f:a:e:", opcoes, NULL)) != -1) {
+        switch (opcao) {
+            case 'c': cfg->conexoes = atoi(optarg); break;
+            case 'r': cfg->taxa = atof(optarg); break;
+            case 's': cfg->tamanho = atoi(optarg); break;
+            case 'd': cfg->duracao = atof(optarg); break;
+            case 'w': cfg->janela = atoi(optarg); break;
+            case 'f':
+                if (strcmp(optarg, "json") == 0) cfg->csv = 0;
+                else if (strcmp(optarg, "csv") == 0) cfg->csv = 1;
+                else return -1;
+                break;
+            case 'a': cfg->sala = optarg; break;
+            case 'e':
+                if (saida_modo_ler(optarg, &cfg->envio) < 0) return -1;
+                break;
+            default:
+                return -1;
+        }
+    }
+    const char *ip = optind < argc ? argv[optind++] : "127.0.0.1";
+    if (strstr(ip, "://") != NULL) {
+        if (transporte_ler_uri(ip, &cfg->endereco) < 0) return -1;
+    } else if (transporte_ler_host_porta(ip, optind < argc ? argv[optind++] : "8080",
+                                         &cfg->endereco) < 0) {
+        return -1;
+    }
+
+    if (cfg->conexoes <= 0 || cfg->taxa < 0 || cfg->duracao <= 0 || cfg->janela <= 0 ||
+        cfg->tamanho < BENCH_CABECALHO_ECO ||
+        cfg->tamanho > PROTOCOLO_PAYLOAD_MAX - (cfg->sala ? 1 + PROTOCOLO_ORIGEM_MAX : 0) ||
+        (cfg->sala != NULL && cfg->sala[0] == '\0')) {
+        return -1;
+    }
+    return 0;
+}
+
+// Função para abrir as conexões sem bloquear; o tempo de conexão é medido
+// do connect() até o socket ficar gravável
+static int abrir_conexoes(const ConfigBench *cfg, ConexaoBench *conexoes, int epoll_fd) {
+    struct sockaddr_storage endereco;
+    socklen_t tamanho_endereco;
+    if (transporte_resolver(&cfg->endereco, &endereco, &tamanho_endereco) < 0) {
+        char descricao[TRANSPORTE_DESCRICAO_MAX];
+        transporte_descrever(&cfg->endereco, descricao, sizeof(descricao));
+        fprintf(stderr, "[ERRO] Endereço inválido para o modo de carga: %s "
+                        "(shm:// só em --bench-transporte)\n", descricao);
+        return -1;
+    }
+
+    for (int i = 0; i < cfg->conexoes; i++) {
+        ConexaoBench *c = &conexoes[i];
+        c->indice = (uint32_t)i;
+        leitor_iniciar(&c->leitor);
+        saida_iniciar(&c->saida, cfg->envio);
+        c->fd = socket(endereco.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (c->fd < 0) {
+            perror("[ERRO] Não foi possível criar o socket");
+            return -1;
+        }
+        saida_configurar_socket(c->fd, cfg->envio);
+        c->inicio_conexao = agora_ns();
+        if (connect(c->fd, (struct sockaddr *)&endereco, tamanho_endereco) < 0 &&
+            errno != EINPROGRESS) {
+            perror("[ERRO] Conexão falhou");
+            return -1;
+        }
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        ev.data.ptr = c;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->fd, &ev);
+    }
+    return 0;
+}
+
+// Função para imprimir o relatório em CSV ou JSON
+static void imprimir_relatorio(const ConfigBench *cfg, double segundos, uint64_t enviadas,
+                               uint64_t recebidas, uint64_t bytes, uint64_t erros,
+                               int membros, Amostras *rtt, Amostras *conexao) {
+    amostras_ordenar(rtt);
+    amostras_ordenar(conexao);
+
+    double vazao = segundos > 0 ? (double)recebidas / segundos : 0;
+    double mb = segundos > 0 ? (double)bytes / segundos / (1024.0 * 1024.0) : 0;
+
+    if (cfg->csv) {
+        printf("conexoes,tamanho,taxa_alvo,duracao_s,enviadas,recebidas,erros,"
+               "vazao_msgs_s,vazao_mb_s,rtt_p50_us,rtt_p99_us,rtt_p999_us,rtt_max_us,"
+               "conexao_p50_us,conexao_p99_us,conexao_max_us,membros_sala,envio\n");
+        printf("%d,%d,%.0f,%.3f,%llu,%llu,%llu,%.1f,%.3f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%d,%s\n",
+               cfg->conexoes, cfg->tamanho, cfg->taxa, segundos,
+               (unsigned long long)enviadas, (unsigned long long)recebidas,
+               (unsigned long long)erros, vazao, mb,
+               amostras_percentil(rtt, 0.50) / 1e3, amostras_percentil(rtt, 0.99) / 1e3,
+               amostras_percentil(rtt, 0.999) / 1e3, amostras_percentil(rtt, 1.0) / 1e3,
+               amostras_percentil(conexao, 0.50) / 1e3, amostras_percentil(conexao, 0.99) / 1e3,
+               amostras_percentil(conexao, 1.0) / 1e3, membros, saida_modo_nome(cfg->envio));
+    } else {
+        printf("{\"conexoes\": %d, \"tamanho\": %d, \"taxa_alvo\": %.0f, \"duracao_s\": %.3f, "
+               "\"enviadas\": %llu, \"recebidas\": %llu, \"erros\": %llu, "
+               "\"vazao_msgs_s\": %.1f, \"vazao_mb_s\": %.3f, "
+               "\"rtt_us\": {\"p50\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f}, "
+               "\"conexao_us\": {\"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f}, "
+               "\"membros_sala\": %d, \"envio\": \"%s\"}\n",
+               cfg->conexoes, cfg->tamanho, cfg->taxa, segundos,
+               (unsigned long long)enviadas, (unsigned long long)recebidas,
+               (unsigned long long)erros, vazao, mb,
+               amostras_percentil(rtt, 0.50) / 1e3, amostras_percentil(rtt, 0.99) / 1e3,
+               amostras_percentil(rtt, 0.999) / 1e3, amostras_percentil(rtt, 1.0) / 1e3,
+               amostras_percentil(conexao, 0.50) / 1e3, amostras_percentil(conexao, 0.99) / 1e3,
+               amostras_percentil(conexao, 1.0) / 1e3, membros, saida_modo_nome(cfg->envio));
+    }
+}
+
+// Função principal do modo de carga
+int executar_bench(int argc, char *argv[]) {
+    ConfigBench cfg;
+    if (ler_config(argc, argv, &cfg) < 0) {
+        exibir_uso_bench(argv[0]);
+        return 1;
+    }
+
+    // Cada conexão consome um descritor
+    struct rlimit limite;
+    if (getrlimit(RLIMIT_NOFILE, &limite) == 0 && limite.rlim_cur < limite.rlim_max) {
+        limite.rlim_cur = limite.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limite);
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    ConexaoBench *conexoes = calloc((size_t)cfg.conexoes, sizeof(ConexaoBench));
+    if (epoll_fd < 0 || conexoes == NULL) {
+        perror("[ERRO] Não foi possível iniciar o modo de carga");
+        return 1;
+    }
+
+    Amostras rtt = {0}, tempo_conexao = {0};
+    uint64_t enviadas = 0, recebidas = 0, bytes = 0, erros = 0;
+    int conectadas = 0, fechadas = 0;
+    struct epoll_event eventos[BENCH_MAX_EVENTOS];
+
+    if (abrir_conexoes(&cfg, conexoes, epoll_fd) < 0) {
+        return 1;
+    }
+
+    // Espera todas as conexões completarem antes de medir a vazão
+    while (conectadas + fechadas < cfg.conexoes) {
+        int n = epoll_wait(epoll_fd, eventos, BENCH_MAX_EVENTOS, 5000);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            fprintf(stderr, "[ERRO] Tempo esgotado aguardando conexões (%d/%d)\n",
+                    conectadas, cfg.conexoes);
+            return 1;
+        }
+        for (int i = 0; i < n; i++) {
+            ConexaoBench *c = eventos[i].data.ptr;
+            if (c->conectada) continue;
+            int erro = 0;
+            socklen_t tamanho = sizeof(erro);
+            getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &erro, &tamanho);
+            if (erro != 0 || (eventos[i].events & (EPOLLERR | EPOLLHUP))) {
+                close(c->fd);
+                c->fd = -1;
+                c->conectada = -1;
+                fechadas++;
+                erros++;
+                continue;
+            }
+            c->conectada = 1;
+            conectadas++;
+            amostras_adicionar(&tempo_conexao, agora_ns() - c->inicio_conexao);
+        }
+    }
+    if (conectadas == 0) {
+        fprintf(stderr, "[ERRO] Nenhuma conexão foi estabelecida\n");
+        return 1;
+    }
+
+    // No modo sala, cada mensagem é entregue a todos os membros
+    int membros = 0;
+    uint64_t entregas_por_envio = 1;
+    if (cfg.sala != NULL) {
+        for (int i = 0; i < cfg.conexoes; i++) {
+            if (conexoes[i].conectada == 1 && entrar_sala(&conexoes[i], cfg.sala) < 0) {
+                fprintf(stderr, "[ERRO] Falha ao entrar na sala\n");
+                return 1;
+            }
+        }
+        // Cada conexão recebe ao menos o aviso da própria entrada
+        int dentro = 0;
+        while (dentro < conectadas) {
+            int n = epoll_wait(epoll_fd, eventos, BENCH_MAX_EVENTOS, 5000);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                fprintf(stderr, "[ERRO] Tempo esgotado entrando na sala (%d/%d)\n",
+                        dentro, conectadas);
+                return 1;
+            }
+            for (int i = 0; i < n; i++) {
+                ConexaoBench *c = eventos[i].data.ptr;
+                if (c->conectada != 1 || c->na_sala) continue;
+                if (ler_respostas(c, &rtt, &recebidas, &bytes) < 0) {
+                    fprintf(stderr, "[ERRO] Conexão perdida ao entrar na sala\n");
+                    return 1;
+                }
+                if (c->na_sala) dentro++;
+            }
+        }
+        membros = conectadas;
+        entregas_por_envio = (uint64_t)membros;
+        bytes = 0;
+    }
+
+    uint64_t inicio = agora_ns();
+    uint64_t fim_envio = inicio + (uint64_t)(cfg.duracao * 1e9);
+    uint64_t fim_total = fim_envio + BENCH_DRENAGEM_NS;
+    int proxima = 0;
+
+    while (1) {
+        uint64_t agora = agora_ns();
+        if (agora >= fim_total ||
+            (agora >= fim_envio && recebidas + erros >= enviadas * entregas_por_envio)) {
+            break;
+        }
+
+        // Envia o déficit acumulado em relação à taxa alvo, em rodízio
+        if (agora < fim_envio) {
+            uint64_t devidas;
+            if (cfg.taxa > 0) {
+                devidas = (uint64_t)((double)(agora - inicio) * cfg.taxa / 1e9) + 1;
+            } else {
+                devidas = enviadas + (uint64_t)cfg.conexoes * (uint64_t)cfg.janela;
+            }
+            int tentativas = 0;
+            while (enviadas < devidas && tentativas < cfg.conexoes) {
+                ConexaoBench *c = &conexoes[proxima];
+                proxima = (proxima + 1) % cfg.conexoes;
+                if (c->conectada != 1 || c->em_voo >= (uint32_t)cfg.janela) {
+                    tentativas++;
+                    continue;
+                }
+                tentativas = 0;
+                if (enviar_eco(c, cfg.tamanho, cfg.sala != NULL) < 0) {
+                    erros++;
+                    close(c->fd);
+                    c->conectada = -1;
+                    continue;
+                }
+                enviadas++;
+            }
+
+            // Modo vazão: um send() por conexão com tudo o que a rodada gerou
+            if (cfg.envio == ENVIO_VAZAO) {
+                for (int i = 0; i < cfg.conexoes; i++) {
+                    ConexaoBench *c = &conexoes[i];
+                    if (c->conectada != 1 || saida_pendente(&c->saida) == 0) continue;
+                    if (saida_descarregar(&c->saida, c->fd, 0) < 0) {
+                        erros++;
+                        close(c->fd);
+                        c->conectada = -1;
+                    }
+                }
+            }
+        }
+
+        // Dorme até a próxima mensagem devida ou até chegar resposta
+        int espera_ms = 1;
+        if (cfg.taxa > 0 && cfg.taxa < 1000) {
+            espera_ms = (int)(1000.0 / cfg.taxa);
+        }
+        int n = epoll_wait(epoll_fd, eventos, BENCH_MAX_EVENTOS, espera_ms);
+        for (int i = 0; i < n; i++) {
+            ConexaoBench *c = eventos[i].data.ptr;
+            if (c->conectada != 1) continue;
+            if ((eventos[i].events & EPOLLOUT) && saida_descarregar(&c->saida, c->fd, 0) < 0) {
+                erros++;
+                close(c->fd);
+                c->conectada = -1;
+                continue;
+            }
+            if (eventos[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                if (ler_respostas(c, &rtt, &recebidas, &bytes) < 0) {
+                    erros++;
+                    close(c->fd);
+                    c->conectada = -1;
+                }
+            }
+        }
+    }
+
+    double segundos = (double)(agora_ns() - inicio) / 1e9;
+    imprimir_relatorio(&cfg, segundos, enviadas, recebidas, bytes, erros, membros,
+                       &rtt, &tempo_conexao);
+
+    for (int i = 0; i < cfg.conexoes; i++) {
+        if (conexoes[i].conectada == 1) close(conexoes[i].fd);
+        leitor_liberar(&conexoes[i].leitor);
+        saida_liberar(&conexoes[i].saida);
+    }
+    free(conexoes);
+    free(rtt.valores);
+    free(tempo_conexao.valores);
+    close(epoll_fd);
+    return 0;
+}
+
+// Função para esperar, em uma conexão bloqueante, a volta dos ecos em voo;
+// a latência de cada um vai para `rtt` (NULL = aquecimento, não mede)
+// Retorna -1 se a conexão falhou ou o prazo passou
+static int esperar_ecos(ConexaoBench *c, Amostras *rtt) {
+    while (c->em_voo > 0) {
+        size_t livre;
+        uint8_t *destino = leitor_espaco(&c->leitor, &livre);
+        if (destino == NULL) return -1;
+        ssize_t n = transporte_receber(c->fd, destino, livre, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        leitor_avancar(&c->leitor, (size_t)n);
+        uint64_t agora = agora_ns();
+        Quadro q;
+        int r;
+        while ((r = leitor_proximo(&c->leitor, &q)) == QUADRO_PRONTO) {
+            // O CONTROLE_SESSAO do começo e os pings ficam de fora
+            if (q.tipo != QUADRO_CONTROLE || q.tamanho < BENCH_CABECALHO_ECO ||
+                q.payload[0] != CONTROLE_ECO) {
+                continue;
+            }
+            uint64_t carimbo;
+            memcpy(&carimbo, q.payload + 1, 8);
+            if (rtt != NULL) amostras_adicionar(rtt, agora - carimbo);
+            if (c->em_voo > 0) c->em_voo--;
+        }
+        if (r == QUADRO_ERRO) return -1;
+    }
+    return 0;
+}
+
+// Função para medir um transporte: conecta, aquece com BENCH_AQUECIMENTO
+// ecos e manda outros `mensagens`, um de cada vez
+// Retorna -1 se a conexão falhou
+static int medir_transporte(const EnderecoTransporte *endereco, int mensagens, int tamanho,
+                            Amostras *rtt) {
+    ConexaoBench c;
+    memset(&c, 0, sizeof(c));
+    c.fd = transporte_conectar(endereco, BENCH_PRAZO_TRANSPORTE);
+    if (c.fd < 0) return -1;
+    if (endereco->tipo == TRANSPORTE_TCP) saida_configurar_socket(c.fd, ENVIO_INTERATIVO);
+    leitor_iniciar(&c.leitor);
+    saida_iniciar(&c.saida, ENVIO_INTERATIVO);
+
+    int resultado = 0;
+    for (int i = 0; resultado == 0 && i < BENCH_AQUECIMENTO + mensagens; i++) {
+        if (enviar_eco(&c, tamanho, 0) < 0) resultado = -1;
+        // Um eco maior que o espaço livre no kernel (ou no anel) sai aos poucos
+        while (resultado == 0 && saida_pendente(&c.saida) > 0) {
+            struct pollfd evento = { -1, 0, 0 };
+            evento.fd = transporte_fd_envio(c.fd, &evento.events);
+            if (poll(&evento, 1, BENCH_PRAZO_TRANSPORTE * 1000) <= 0 ||
+                saida_descarregar(&c.saida, c.fd, 0) < 0) {
+                resultado = -1;
+            }
+        }
+        if (resultado == 0 && esperar_ecos(&c, i < BENCH_AQUECIMENTO ? NULL : rtt) < 0) {
+            resultado = -1;
+        }
+    }
+    transporte_fechar(c.fd);
+    leitor_liberar(&c.leitor);
+    saida_liberar(&c.saida);
+    return resultado;
+}
+
+// Função para exibir o uso da comparação de transportes
+static void exibir_uso_transporte(const char *programa) {
+    fprintf(stderr,
+        "Uso: %s --bench-transporte <uri>... [opções]\n"
+        "  uri            tcp://host:porta, unix:///caminho ou shm:///caminho\n"
+        "  --mensagens N  ecos medidos por transporte, um de cada vez (padrão 10000)\n"
+        "  --tamanho B    bytes de payload por eco, mínimo %d (padrão 64)\n"
+        "  --formato F    csv ou json (padrão csv)\n",
+        programa, BENCH_CABECALHO_ECO);
+}
+
+// Função principal da comparação de transportes: a mesma carga de
+// pingue-pongue em cada URI, uma linha de resultado por transporte
+int executar_bench_transporte(int argc, char *argv[]) {
+    static struct option opcoes[] = {
+        {"mensagens", required_argument, 0, 'n'},
+        {"tamanho", required_argument, 0, 's'},
+        {"formato", required_argument, 0, 'f'},
+        {0, 0, 0, 0}
+    };
+    int mensagens = 10000;
+    int tamanho = 64;
+    int csv = 1;
+    int opcao;
+    optind = 2; // argv[1] é o próprio "--bench-transporte"
+    while ((opcao = getopt_long(argc, argv, "n:s:f:", opcoes, NULL)) != -1) {
+        switch (opcao) {
+            case 'n': mensagens = atoi(optarg); break;
+            case 's': tamanho = atoi(optarg); break;
+            case 'f':
+                if (strcmp(optarg, "json") == 0) csv = 0;
+                else if (strcmp(optarg, "csv") == 0) csv = 1;
+                else mensagens = -1;
+                break;
+            default:
+                mensagens = -1;
+                break;
+        }
+    }
+    if (optind >= argc || mensagens <= 0 || tamanho < BENCH_CABECALHO_ECO ||
+        tamanho > PROTOCOLO_PAYLOAD_MAX) {
+        exibir_uso_transporte(argv[0]);
+        return 1;
+    }
+
+    if (csv) {
+        printf("transporte,endereco,mensagens,tamanho,rtt_media_us,rtt_p50_us,rtt_p99_us,"
+               "rtt_p999_us,rtt_max_us\n");
+    }
+    int falhas = 0;
+    for (int i = optind; i < argc; i++) {
+        EnderecoTransporte endereco;
+        if (transporte_ler_uri(argv[i], &endereco) < 0) {
+            fprintf(stderr, "[ERRO] URI inválida: %s\n", argv[i]);
+            falhas++;
+            continue;
+        }
+        Amostras rtt = {0};
+        if (medir_transporte(&endereco, mensagens, tamanho, &rtt) < 0) {
+            fprintf(stderr, "[ERRO] Falha ao medir %s: %s\n", argv[i], strerror(errno));
+            free(rtt.valores);
+            falhas++;
+            continue;
+        }
+        double soma = 0;
+        for (size_t k = 0; k < rtt.total; k++) soma += (double)rtt.valores[k];
+        double media = rtt.total > 0 ? soma / (double)rtt.total / 1e3 : 0;
+        amostras_ordenar(&rtt);
+        const char *formato = csv
+            ? "%s,%s,%zu,%d,%.2f,%.2f,%.2f,%.2f,%.2f\n"
+            : "{\"transporte\": \"%s\", \"endereco\": \"%s\", \"mensagens\": %zu, "
+              "\"tamanho\": %d, \"rtt_us\": {\"media\": %.2f, \"p50\": %.2f, "
+              "\"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f}}\n";
+        printf(formato, transporte_nome(endereco.tipo), argv[i], rtt.total, tamanho, media,
+               amostras_percentil(&rtt, 0.50) / 1e3, amostras_percentil(&rtt, 0.99) / 1e3,
+               amostras_percentil(&rtt, 0.999) / 1e3, amostras_percentil(&rtt, 1.0) / 1e3);
+        fflush(stdout);
+        free(rtt.valores);
+    }
+    return falhas > 0 ? 1 : 0;
+}
+
+// Função para receber o que chegou em uma conexão da federação e
+// registrar a latência dos quadros CHAT com o carimbo do emissor; `visto`
+// recebe a maior sequência entregue (-1 = nenhuma)
+// Retorna -1 se a conexão falhou
+static int receber_federacao(ConexaoBench *c, Amostras *amostras, int64_t *visto) {
+    size_t livre;
+    uint8_t *destino = leitor_espaco(&c->leitor, &livre);
+    if (destino == NULL) return -1;
+    ssize_t n = transporte_receber(c->fd, destino, livre, 0);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) return 0;
+    if (n <= 0) return -1;
+    leitor_avancar(&c->leitor, (size_t)n);
+    uint64_t agora = agora_ns();
+    Quadro q;
+    int r;
+    while ((r = leitor_proximo(&c->leitor, &q)) == QUADRO_PRONTO) {
+        const char *origem, *texto;
+        size_t tamanho_origem, tamanho_texto;
+        if (q.tipo != QUADRO_CHAT ||
+            protocolo_separar_origem(&q, &origem, &tamanho_origem, &texto, &tamanho_texto) < 0 ||
+            tamanho_texto < BENCH_CABECALHO_ECO || texto[0] != CONTROLE_ECO) {
+            continue;
+        }
+        uint64_t carimbo;
+        uint32_t sequencia;
+        memcpy(&carimbo, texto + 1, 8);
+        memcpy(&sequencia, texto + 13, 4);
+        if (amostras != NULL) amostras_adicionar(amostras, agora - carimbo);
+        if ((int64_t)sequencia > *visto) *visto = sequencia;
+    }
+    return r == QUADRO_ERRO ? -1 : 0;
+}
+
+// Função para esperar as duas recepções da mensagem `sequencia`, medindo
+// cada uma no momento em que chega (NULL = aquecimento, não mede). O eco
+// do emissor é lido e descartado.
+// Retorna -1 se uma conexão falhou ou o prazo passou
+static int esperar_recepcoes(ConexaoBench *emissor, ConexaoBench *local, ConexaoBench *remota,
+                             uint32_t sequencia, Amostras *mesmo_no, Amostras *outro_no,
+                             int prazo_ms) {
+    int64_t visto_local = -1, visto_remoto = -1, visto_emissor = -1;
+    while (visto_local < (int64_t)sequencia || visto_remoto < (int64_t)sequencia) {
+        struct pollfd eventos[3] = {
+            { visto_local < (int64_t)sequencia ? local->fd : -1, POLLIN, 0 },
+            { visto_remoto < (int64_t)sequencia ? remota->fd : -1, POLLIN, 0 },
+            { emissor->fd, POLLIN, 0 }
+        };
+        int prontos = poll(eventos, 3, prazo_ms);
+        if (prontos < 0 && errno == EINTR) continue;
+        if (prontos <= 0) return -1;
+        if ((eventos[0].revents & (POLLIN | POLLHUP | POLLERR)) &&
+            receber_federacao(local, mesmo_no, &visto_local) < 0) {
+            return -1;
+        }
+        if ((eventos[1].revents & (POLLIN | POLLHUP | POLLERR)) &&
+            receber_federacao(remota, outro_no, &visto_remoto) < 0) {
+            return -1;
+        }
+        if ((eventos[2].revents & (POLLIN | POLLHUP | POLLERR)) &&
+            receber_federacao(emissor, NULL, &visto_emissor) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Função para abrir uma conexão bloqueante da medição da federação e pô-la
+// na sala
+// Retorna -1 se não conseguiu
+static int abrir_federacao(ConexaoBench *c, const EnderecoTransporte *endereco, uint32_t indice,
+                           const char *sala) {
+    memset(c, 0, sizeof(*c));
+    c->indice = indice;
+    c->fd = transporte_conectar(endereco, BENCH_PRAZO_TRANSPORTE);
+    if (c->fd < 0) return -1;
+    if (endereco->tipo == TRANSPORTE_TCP) saida_configurar_socket(c->fd, ENVIO_INTERATIVO);
+    leitor_iniciar(&c->leitor);
+    saida_iniciar(&c->saida, ENVIO_INTERATIVO);
+    return entrar_sala(c, sala);
+}
+
+// Função para fechar uma conexão da medição da federação
+static void fechar_federacao(ConexaoBench *c) {
+    if (c->fd >= 0) transporte_fechar(c->fd);
+    leitor_liberar(&c->leitor);
+    saida_liberar(&c->saida);
+}
+
+// Função para exibir o uso da comparação entre nós da federação
+static void exibir_uso_federacao(const char *programa) {
+    fprintf(stderr,
+        "Uso: %s --bench-federacao <uri_no_a> <uri_no_b> [opções]\n"
+        "  uri            tcp://host:porta ou unix:///caminho de dois nós federados\n"
+        "  --mensagens N  mensagens medidas, uma de cada vez (padrão 10000)\n"
+        "  --tamanho B    bytes de payload por mensagem, mínimo %d (padrão 64)\n"
+        "  --sala NOME    sala usada na medição (padrão bench-federacao)\n"
+        "  --formato F    csv ou json (padrão csv)\n",
+        programa, BENCH_CABECALHO_ECO);
+}
+
+// Função principal da comparação entre nós da federação: um emissor e um
+// receptor no nó A e outro receptor no nó B, todos na mesma sala. Cada
+// mensagem do emissor é esperada nos dois receptores antes da próxima; a
+// diferença entre as duas latências é o custo da ligação entre os nós.
+int executar_bench_federacao(int argc, char *argv[]) {
+    static struct option opcoes[] = {
+        {"mensagens", required_argument, 0, 'n'},
+        {"tamanho", required_argument, 0, 's'},
+        {"sala", required_argument, 0, 'S'},
+        {"formato", required_argument, 0, 'f'},
+        {0, 0, 0, 0}
+    };
+    int mensagens = 10000;
+    int tamanho = 64;
+    const char *sala = "bench-federacao";
+    int csv = 1;
+    int opcao;
+    optind = 2; // argv[1] é o próprio "--bench-federacao"
+    while ((opcao = getopt_long(argc, argv, "n:s:S:f:", opcoes, NULL)) != -1) {
+        switch (opcao) {
+            case 'n': mensagens = atoi(optarg); break;
+            case 's': tamanho = atoi(optarg); break;
+            case 'S': sala = optarg; break;
+            case 'f':
+                if (strcmp(optarg, "json") == 0) csv = 0;
+                else if (strcmp(optarg, "csv") == 0) csv = 1;
+                else mensagens = -1;
+                break;
+            default:
+                mensagens = -1;
+                break;
+        }
+    }
+    EnderecoTransporte enderecos[2];
+    if (argc - optind != 2 || mensagens <= 0 || tamanho < BENCH_CABECALHO_ECO ||
+        tamanho > PROTOCOLO_PAYLOAD_MAX - 1) {
+        exibir_uso_federacao(argv[0]);
+        return 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (transporte_ler_uri(argv[optind + i], &enderecos[i]) < 0 ||
+            enderecos[i].tipo == TRANSPORTE_MEMORIA) {
+            fprintf(stderr, "[ERRO] URI inválida: %s\n", argv[optind + i]);
+            return 1;
+        }
+    }
+
+    ConexaoBench emissor, local, remota;
+    memset(&emissor, 0, sizeof(emissor));
+    memset(&local, 0, sizeof(local));
+    memset(&remota, 0, sizeof(remota));
+    emissor.fd = local.fd = remota.fd = -1;
+    Amostras mesmo_no = {0}, outro_no = {0};
+    int resultado = -1;
+    if (abrir_federacao(&emissor, &enderecos[0], 0, sala) < 0 ||
+        abrir_federacao(&local, &enderecos[0], 1, sala) < 0 ||
+        abrir_federacao(&remota, &enderecos[1], 2, sala) < 0) {
+        fprintf(stderr, "[ERRO] Falha ao conectar aos nós: %s\n", strerror(errno));
+        goto fim;
+    }
+
+    // A entrada do receptor remoto na sala leva um momento para chegar ao
+    // nó A: o aquecimento repete a primeira mensagem até ela dar a volta
+    uint64_t limite = agora_ns() + (uint64_t)BENCH_PRAZO_TRANSPORTE * 1000000000ULL;
+    emissor.sequencia = 0;
+    while (1) {
+        if (enviar_eco(&emissor, tamanho, 1) < 0) goto falha;
+        emissor.sequencia--; // A sequência só avança quando as duas recepções chegam
+        if (esperar_recepcoes(&emissor, &local, &remota, 0, NULL, NULL, 200) == 0) break;
+        if (agora_ns() > limite) {
+            fprintf(stderr, "[ERRO] As mensagens do nó A não chegam ao nó B (federação ligada?)\n");
+            goto fim;
+        }
+    }
+    for (int i = 0; i < BENCH_AQUECIMENTO + mensagens; i++) {
+        emissor.sequencia = (uint32_t)i + 1;
+        if (enviar_eco(&emissor, tamanho, 1) < 0 ||
+            esperar_recepcoes(&emissor, &local, &remota, (uint32_t)i + 1,
+                              i < BENCH_AQUECIMENTO ? NULL : &mesmo_no,
+                              i < BENCH_AQUECIMENTO ? NULL : &outro_no,
+                              BENCH_PRAZO_TRANSPORTE * 1000) < 0) {
+            goto falha;
+        }
+    }
+
+    if (csv) {
+        printf("entrega,mensagens,tamanho,media_us,p50_us,p99_us,p999_us,max_us\n");
+    }
+    Amostras *medidas[2] = { &mesmo_no, &outro_no };
+    const char *nomes[2] = { "mesmo_no", "outro_no" };
+    for (int k = 0; k < 2; k++) {
+        Amostras *a = medidas[k];
+        double soma = 0;
+        for (size_t j = 0; j < a->total; j++) soma += (double)a->valores[j];
+        double media = a->total > 0 ? soma / (double)a->total / 1e3 : 0;
+        amostras_ordenar(a);
+        const char *formato = csv
+            ? "%s,%zu,%d,%.2f,%.2f,%.2f,%.2f,%.2f\n"
+            : "{\"entrega\": \"%s\", \"mensagens\": %zu, \"tamanho\": %d, \"latencia_us\": "
+              "{\"media\": %.2f, \"p50\": %.2f, \"p99\": %.2f, \"p999\": %.2f, \"max\": %.2f}}\n";
+        printf(formato, nomes[k], a->total, tamanho, media,
+               amostras_percentil(a, 0.50) / 1e3, amostras_percentil(a, 0.99) / 1e3,
+               amostras_percentil(a, 0.999) / 1e3, amostras_percentil(a, 1.0) / 1e3);
+    }
+    resultado = 0;
+    goto fim;
+
+falha:
+    fprintf(stderr, "[ERRO] Falha durante a medição: %s\n",
+            errno != 0 ? strerror(errno) : "prazo esgotado");
+fim:
+    fechar_federacao(&emissor);
+    fechar_federacao(&local);
+    fechar_federacao(&remota);
+    free(mesmo_no.valores);
+    free(outro_no.valores);
+    return resultado < 0 ? 1 : 0;
+}
+
+// Linhas típicas do teclado para o microbenchmark de comandos
+static const char *linhas_comandos[] = {
+    "/nick ana",
+    "/join sala-geral",
+    "oi pessoal, tudo bem por aí?",
+    "/history 50",
+    "/send relatorio final.pdf",
+    "/status",
+    "uma mensagem de chat um pouco mais longa, como as que aparecem numa conversa",
+    "/leave"
+};
+#define TOTAL_LINHAS_COMANDOS (sizeof(linhas_comandos) / sizeof(linhas_comandos[0]))
+
+// Função que reproduz a análise antiga: sscanf em dois buffers de 1024
+// bytes e uma cadeia de strcmp
+static int analisar_com_sscanf(const char *linha) {
+    char cmd[1024];
+    char arg1[1024];
+    arg1[0] = '\0';
+    if (linha[0] != '/' || sscanf(linha, "%s %s", cmd, arg1) < 1) return COMANDO_NENHUM;
+    int tem_argumento = arg1[0] != '\0';
+    if (strcmp(cmd, "/nick") == 0) return COMANDO_NICK + tem_argumento;
+    if (strcmp(cmd, "/history") == 0) return COMANDO_HISTORY + tem_argumento;
+    if (strcmp(cmd, "/send") == 0) return COMANDO_SEND + tem_argumento;
+    if (strcmp(cmd, "/join") == 0) return COMANDO_JOIN + tem_argumento;
+    if (strcmp(cmd, "/leave") == 0) return COMANDO_LEAVE + tem_argumento;
+    if (strcmp(cmd, "/quit") == 0) return COMANDO_QUIT + tem_argumento;
+    if (strcmp(cmd, "/help") == 0) return COMANDO_HELP + tem_argumento;
+    if (strcmp(cmd, "/status") == 0) return COMANDO_STATUS + tem_argumento;
+    if (strcmp(cmd, "/stats") == 0) return COMANDO_STATS + tem_argumento;
+    return COMANDO_DESCONHECIDO + tem_argumento;
+}
+
+// Função para analisar uma linha com o módulo de comandos
+static int analisar_com_tabela(const char *linha) {
+    LinhaComando resultado;
+    Comando comando = comando_analisar(linha, strlen(linha), &resultado);
+    return (int)comando + (resultado.argumento.tamanho > 0);
+}
+
+// Função para medir o custo médio, em nanossegundos, de analisar uma linha
+static double medir_analise(int (*analisar)(const char *), long iteracoes, long *checagem) {
+    uint64_t inicio = agora_ns();
+    long soma = 0;
+    for (long i = 0; i < iteracoes; i++) {
+        soma += analisar(linhas_comandos[(size_t)i % TOTAL_LINHAS_COMANDOS]);
+    }
+    *checagem = soma; // Impede o compilador de descartar o laço
+    return (double)(agora_ns() - inicio) / (double)iteracoes;
+}
+
+// Função principal do microbenchmark de comandos ("--bench-comandos [N]"):
+// compara o custo por linha da análise com sscanf com o de comandos.c
+int executar_bench_comandos(int argc, char *argv[]) {
+    long iteracoes = argc > 2 ? atol(argv[2]) : 10000000L;
+    if (iteracoes <= 0) {
+        fprintf(stderr, "Uso: %s --bench-comandos [iteracoes]\n", argv[0]);
+        return 1;
+    }
+    long checagem_sscanf, checagem_tabela;
+    medir_analise(analisar_com_tabela, iteracoes / 10 + 1, &checagem_tabela); // Aquecimento
+    double ns_sscanf = medir_analise(analisar_com_sscanf, iteracoes, &checagem_sscanf);
+    double ns_tabela = medir_analise(analisar_com_tabela, iteracoes, &checagem_tabela);
+    if (checagem_sscanf != checagem_tabela) {
+        fprintf(stderr, "[ERRO] As duas análises discordam (%ld != %ld)\n",
+                checagem_sscanf, checagem_tabela);
+        return 1;
+    }
+    printf("analise,ns_por_linha,linhas\n");
+    printf("sscanf,%.1f,%ld\n", ns_sscanf, iteracoes);
+    printf("tabela,%.1f,%ld\n", ns_tabela, iteracoes);
+    return 0;
+}
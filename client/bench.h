@@ -0,0 +1,31 @@
+// ============================================================================
+// ARQUIVO: bench.h
+//
+// DESCRIÇÃO: Modo de carga sem interface do cliente, comparação de latência
+//            dos transportes e entre nós da federação e microbenchmark dos comandos (bench.c). As
+//            amostras de latência servem também à reprodução de rastros.
+// ============================================================================
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Vetor de amostras (nanossegundos)
+typedef struct {
+    uint64_t *valores;
+    size_t total;
+    size_t capacidade;
+} Amostras;
+
+void amostras_adicionar(Amostras *a, uint64_t valor);
+void amostras_ordenar(Amostras *a);
+uint64_t amostras_percentil(const Amostras *a, double p);
+
+int executar_bench(int argc, char *argv[]);
+int executar_bench_transporte(int argc, char *argv[]);
+int executar_bench_comandos(int argc, char *argv[]);
+int executar_bench_federacao(int argc, char *argv[]);
+
+#endif
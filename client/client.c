@@ -6,11 +6,26 @@
 // DESCRIÇÃO: Este programa atua como o lado "cliente" do chat.
 //            Ele se conecta a um servidor em um IP e porta específicos
 //            e então inicia a troca de mensagens bidirecional usando threads.
+//            No lugar do IP e da porta aceita uma URI (ver transporte.h):
+//            tcp://host:porta, unix:///caminho ou shm:///caminho. Uma
+//            conexão por memória compartilhada não é retomada se cair.
+//            Com --rastro, os quadros enviados e recebidos de cada conexão
+//            vão para um arquivo de rastro (rastro.h). A linha de entrada
+//            tem edição, histórico e colagem de várias linhas (editor.h).
 //
-// COMO COMPILAR: gcc cliente.c -o cliente -pthread
-// COMO EXECUTAR: ./cliente <ip_servidor> <porta>
+// COMO COMPILAR: gcc client.c bench.c transferencia.c tela.c ../common/protocolo.c ../common/fila_spsc.c ../common/saida.c ../common/transporte.c ../common/slab.c ../common/metricas.c ../common/comandos.c ../common/rastro.c ../common/editor.c reproducao.c -I../common -o client -pthread
+// COMO EXECUTAR: ./client <ip_servidor> <porta> [--envio interativo|vazao] [--metricas SOCKET]
+//                         [--rastro ARQUIVO]
+//                ./client <uri> [opções]
+//                ./client --bench [ip_servidor] [porta] [opções]  (modo de carga, ver bench.c)
+//                ./client --bench-transporte <uri>...  (latência de cada transporte)
+//                ./client --bench-comandos [iteracoes]  (custo da análise de comandos)
+//                ./client --bench-federacao <uri_a> <uri_b>  (entrega entre nós federados)
+//                ./client --reproduzir <uri> <rastro>... [opções]  (ver reproducao.c)
 //
-// Exemplo: ./cliente 127.0.0.1 8080
+// Exemplo: ./client 127.0.0.1 8080
+//          ./client shm:///tmp/chat.sock
+//          ./client 127.0.0.1 8080 --rastro cliente.rastro
 // ============================================================================
 
 #include <stdio.h>
@@ -19,87 +34,148 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <sys/socket.h>
-#include <arpa/inet.h>
 #include <termios.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <limits.h>
+#include <stdatomic.h>
+
+#include "protocolo.h"
+#include "fila_spsc.h"
+#include "saida.h"
+#include "transporte.h"
+#include "bench.h"
+#include "transferencia.h"
+#include "tela.h"
+#include "metricas.h"
+#include "comandos.h"
+#include "slab.h"
+#include "rastro.h"
+#include "reproducao.h"
+#include "editor.h"
 
 #define BUFFER_SIZE 1024
+// Uma linha digitada ou colada pode ocupar um quadro inteiro
+#define LINHA_MAX (PROTOCOLO_PAYLOAD_MAX - 1 - PROTOCOLO_ORIGEM_MAX)
 #define PROMPT_LENGTH 25 // Tamanho do prompt "[HH:MM] Você: "
 #define NICKNAME_MAX 50
+#define SALA_NOME_MAX 64
+#define FILA_EXIBICAO_CAPACIDADE 1024
+#define HISTORICO_PADRAO 20 // Mensagens pedidas por /history sem argumento
+#define SAIDA_RETIDO_MAX (1024 * 1024) // Enviado e não confirmado guardado para a retomada
+#define CONFIRMACAO_LIMIAR (16 * 1024) // Bytes recebidos entre uma confirmação e outra
+#define RETOMADA_PRAZO 2               // Segundos para conectar e receber a resposta
+#define RETOMADA_ESPERA_INICIAL 100    // ms entre tentativas, dobrando a cada falha
+#define RETOMADA_ESPERA_MAX 5000
+#define RETOMADA_DESISTIR 30000        // ms sem conseguir reconectar até desistir
+// Marcas da fila de saída: acima da alta o teclado deixa de ser lido até
+// ela descer à baixa (o resto fica no terminal)
+#define SAIDA_MARCA_ALTA (256 * 1024)
+#define SAIDA_MARCA_BAIXA (64 * 1024)
+#define SAIDA_PRAZO_FINAL 1000         // ms para o que falta enviar ao sair
 
 // Variável global para sinalizar o fim da conexão para as threads
 volatile int FIM_CONEXAO = 0;
-volatile int MENSAGEM_RECEBIDA = 0;
 
-// Estrutura para armazenar a mensagem recebida
+// Descritor de uma mensagem entregue pela thread de recebimento.
+// `dados` contém a origem e depois o corpo, ambos terminados em '\0';
+// a thread principal libera `dados` depois de exibir a mensagem.
 typedef struct {
-    char mensagem[BUFFER_SIZE];
-    int tamanho;
+    uint8_t tipo;           // QUADRO_CHAT, QUADRO_NICK, QUADRO_SALA, QUADRO_ARQUIVO,
+                            // QUADRO_PRIVADO ou QUADRO_CONTROLE
+    uint8_t operacao;       // Operação de um QUADRO_CONTROLE (CONTROLE_HISTORICO etc.)
+    uint8_t tamanho_origem;
+    uint32_t tamanho;       // Tamanho do corpo
+    int64_t instante;       // Instante original (histórico) ou 0 = agora
+    uint64_t recebido;      // metricas_agora() na chegada (recepção → exibição)
+    char *dados;
 } MensagemRecebida;
 
-MensagemRecebida ultima_mensagem;
-pthread_mutex_t mutex_mensagem = PTHREAD_MUTEX_INITIALIZER;
+#define MENSAGEM_ORIGEM(m) ((m)->dados)
+#define MENSAGEM_CORPO(m) ((m)->dados + (m)->tamanho_origem + 1)
+
+// Fila sem travas entre a thread de recebimento e a thread principal.
+// Se a tela não acompanhar, as mensagens mais novas são descartadas e contadas.
+FilaSPSC fila_recebidas;
+uint64_t descartes_avisados = 0;
+
+// eventfd que a thread de recebimento sinaliza para acordar a thread principal
+int evento_interface = -1;
+
+// Chegada das mensagens desenhadas nesta volta do laço; a latência
+// recepção → exibição é registrada depois do write() da tela
+uint64_t chegadas_exibidas[FILA_EXIBICAO_CAPACIDADE];
+size_t total_chegadas = 0;
+
+// Enter da última linha digitada e da linha mais antiga ainda não enviada
+// (0 = nenhuma), para a latência entrada → envio
+uint64_t ultimo_enter = 0;
+uint64_t entrada_pendente = 0;
 
-// Variáveis globais para gerenciar o input atual
-char input_atual[BUFFER_SIZE] = "";
-int posicao_atual = 0;
-int input_visivel = 0; // Flag para indicar se há input visível na tela
+// Linha de entrada sendo editada
+Editor editor;
+uint64_t tecla_lida = 0; // Leitura do teclado ainda não desenhada (0 = nenhuma)
+int entrada_encerrada = 0; // stdin chegou ao fim (ex.: redirecionado de arquivo)
+
+// Ping do servidor à espera de resposta. Só a thread principal escreve no
+// socket: a thread de recebimento marca e a principal responde.
+atomic_int ping_recebido = 0;
+
+// Retomada da sessão (ver protocolo.h). A thread de recebimento anota o
+// token, quantos bytes do fluxo do servidor já tratou e a confirmação do
+// servidor para o nosso fluxo; a principal confirma o fluxo recebido e,
+// se a conexão cair, reconecta e pede a retomada.
+_Atomic uint64_t token_sessao = 0;     // 0 = o servidor não mandou (ou a sessão é nova)
+_Atomic uint64_t fluxo_recebido = 0;
+_Atomic uint64_t fluxo_confirmado = 0;
+atomic_int sessao_nova = 0;    // Chegou um token: confirmar logo, para o servidor reter
+atomic_int conexao_caiu = 0;   // A conexão falhou com uma sessão retomável
+uint64_t confirmacao_enviada = 0; // Último fluxo recebido confirmado (thread principal)
+int retomada_ligada = 1; // Uma conexão por memória não pode ser retomada
+
+// Motivo do fim da conexão, escrito pela thread de recebimento
+char aviso_fim[128] = "";
 
 // Variável global para o nickname
 char nickname[NICKNAME_MAX] = "";
 
-// Variável global para armazenar o IP do servidor
-char *server_ip_global = NULL;
+// Variável global para armazenar o endereço do servidor (ip:porta ou URI)
+char server_ip_global[TRANSPORTE_DESCRICAO_MAX] = "";
 
 // Variável global para armazenar o nickname do parceiro
 char nickname_parceiro[NICKNAME_MAX] = "Parceiro";
 
-// Função para obter timestamp atual em horário de Brasília
-char* obter_timestamp() {
-    static char timestamp[20];
-    time_t now = time(NULL);
-    struct tm *t = localtime(&now);
-    strftime(timestamp, sizeof(timestamp), "%H:%M", t);
-    return timestamp;
-}
+// Sala em que o usuário está (vazia = conversa com o operador do servidor)
+char sala_atual[SALA_NOME_MAX] = "";
 
-// Função para limpar linha atual
-void limpar_linha_atual() {
-    printf("\r\033[K"); // Volta ao início da linha e limpa
-    fflush(stdout);
-}
-
-// Função para salvar o input atual
-void salvar_input_atual() {
-    if (posicao_atual > 0) {
-        // Mover cursor para o início da linha e salvar o que está sendo digitado
-        printf("\r");
-        fflush(stdout);
-        input_visivel = 1;
-    }
-}
-
-// Função para restaurar o input atual
-void restaurar_input_atual() {
-    if (input_visivel && posicao_atual > 0) {
-        printf("\033[36m[%s] %s(você): \033[0m%s", obter_timestamp(), nickname, input_atual);
-        fflush(stdout);
-    }
-}
+// Quadros digitados ainda não enviados; vão juntos ao fim de cada rajada
+// de entrada (uma linha digitada ou um bloco colado)
+SaidaQuadros saida;
+uint64_t conexoes_rastro = 0; // Conexões já anotadas no rastro (--rastro)
 
 // Função para configurar entrada não-bloqueante
 void configurar_entrada_nao_bloqueante() {
     struct termios term;
     tcgetattr(STDIN_FILENO, &term);
     term.c_lflag &= ~(ICANON | ECHO);
-    term.c_cc[VMIN] = 0;
+    // Com VMIN=1 e O_NONBLOCK, read() devolve EAGAIN (e não 0) quando não
+    // há teclas; assim 0 passa a significar fim da entrada
+    term.c_cc[VMIN] = 1;
     term.c_cc[VTIME] = 0;
     tcsetattr(STDIN_FILENO, TCSANOW, &term);
     
     int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
     fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
+
+    // Colagens chegam marcadas e viram uma mensagem só (ver editor.h)
+    if (isatty(STDOUT_FILENO)) {
+        fputs(EDITOR_COLAGEM_LIGAR, stdout);
+        fflush(stdout);
+    }
 }
 
 // Função para restaurar configurações do terminal
@@ -111,6 +187,11 @@ void restaurar_terminal() {
     
     int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
     fcntl(STDIN_FILENO, F_SETFL, flags & ~O_NONBLOCK);
+
+    if (isatty(STDOUT_FILENO)) {
+        fputs(EDITOR_COLAGEM_DESLIGAR, stdout);
+        fflush(stdout);
+    }
 }
 
 // Função para exibir o banner do lobby
@@ -136,7 +217,7 @@ void exibir_comandos() {
 }
 
 // Função para exibir status atual
-void exibir_status(const char* ip, int porta) {
+void exibir_status(const char* servidor) {
     printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
     printf("\033[34m                           STATUS                            \033[0m\n");
     printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
@@ -145,47 +226,45 @@ void exibir_status(const char* ip, int porta) {
     } else {
         printf("\033[31m✗ Nickname: Não definido\033[0m\n");
     }
-    printf("\033[32m✓ Servidor: %s:%d\033[0m\n", ip, porta);
+    printf("\033[32m✓ Servidor: %s\033[0m\n", servidor);
     printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n\n");
 }
 
 // Função para processar comandos do lobby
-int processar_comando_lobby(char *comando, const char* ip, int porta) {
-    char cmd[BUFFER_SIZE];
-    char arg1[BUFFER_SIZE];
-    comando[strcspn(comando, "\n")] = 0;
-    if (sscanf(comando, "%s %s", cmd, arg1) >= 1) {
-        if (strcmp(cmd, "/nick") == 0) {
-            if (strlen(arg1) > 0) {
-                strncpy(nickname, arg1, NICKNAME_MAX - 1);
-                nickname[NICKNAME_MAX - 1] = '\0';
+int processar_comando_lobby(char *comando, const char* servidor) {
+    LinhaComando linha;
+    switch (comando_analisar(comando, strlen(comando), &linha)) {
+        case COMANDO_NICK:
+            if (linha.argumento.tamanho > 0) {
+                trecho_copiar(linha.argumento, nickname, NICKNAME_MAX);
                 printf("\033[32m✓ Nickname definido como: %s\033[0m\n", nickname);
             } else {
                 printf("\033[31m✗ Uso: /nick <nome>\033[0m\n");
             }
             return 0;
-        } else if (strcmp(cmd, "/status") == 0) {
-            exibir_status(ip, porta);
+        case COMANDO_STATUS:
+            exibir_status(servidor);
             return 0;
-        } else if (strcmp(cmd, "/quit") == 0) {
+        case COMANDO_QUIT:
             printf("\033[33mSaindo do chat...\033[0m\n");
             return 1;
-        } else {
+        case COMANDO_NENHUM:
+            if (linha.resto.tamanho == 0) return 0; // Só espaços
+            // fall through
+        default:
             printf("\033[31m✗ Comando não reconhecido. Digite /status para ver informações.\033[0m\n");
             return 0;
-        }
     }
-    return 0;
 }
 
 // Função para executar o lobby
-int executar_lobby(const char* ip, int porta) {
+int executar_lobby(const char* servidor) {
     char comando[BUFFER_SIZE];
     printf("\n");
     fflush(stdout);
     exibir_banner_lobby();
     exibir_comandos();
-    exibir_status(ip, porta);
+    exibir_status(servidor);
     printf("\033[36mDigite um comando ou pressione Enter para iniciar o chat: \033[0m");
     fflush(stdout);
     while (1) {
@@ -194,7 +273,7 @@ int executar_lobby(const char* ip, int porta) {
             if (comando[0] == '\n' || comando[0] == '\0') {
                 return 1;
             }
-            int resultado = processar_comando_lobby(comando, ip, porta);
+            int resultado = processar_comando_lobby(comando, servidor);
             if (resultado == 1) {
                 return 0; // Sair do programa
             }
@@ -204,173 +283,860 @@ int executar_lobby(const char* ip, int porta) {
     }
 }
 
+// Função para copiar um campo do quadro para uma string terminada em '\0'
+void copiar_campo(char *destino, size_t capacidade, const char *origem, size_t tamanho) {
+    if (tamanho >= capacidade) tamanho = capacidade - 1;
+    memcpy(destino, origem, tamanho);
+    destino[tamanho] = '\0';
+}
+
+// Função para entregar uma mensagem à thread principal
+void entregar(uint8_t tipo, uint8_t operacao, const char *origem, size_t tamanho_origem,
+              const char *corpo, size_t tamanho_corpo, int64_t instante) {
+    MensagemRecebida m;
+    m.tipo = tipo;
+    m.operacao = operacao;
+    m.instante = instante;
+    m.tamanho_origem = (uint8_t)tamanho_origem;
+    m.tamanho = (uint32_t)tamanho_corpo;
+    m.recebido = metricas_agora();
+    m.dados = slab_alocar(tamanho_origem + 1 + tamanho_corpo + 1);
+    if (m.dados == NULL) return;
+    memcpy(m.dados, origem, tamanho_origem);
+    m.dados[tamanho_origem] = '\0';
+    memcpy(MENSAGEM_CORPO(&m), corpo, tamanho_corpo);
+    MENSAGEM_CORPO(&m)[tamanho_corpo] = '\0';
+    if (fila_spsc_inserir(&fila_recebidas, &m)) {
+        metricas_ajustar(MEDIDOR_FILA_EXIBICAO, 1);
+    } else {
+        slab_liberar(m.dados);
+    }
+}
+
+// Função para entregar um quadro recebido à thread principal
+void entregar_mensagem(uint8_t tipo, const char *origem, size_t tamanho_origem,
+                       const char *corpo, size_t tamanho_corpo, int64_t instante) {
+    entregar(tipo, 0, origem, tamanho_origem, corpo, tamanho_corpo, instante);
+}
+
+// Função para entregar à thread principal a resposta a um pedido de
+// controle (/history, /search, /who, um erro)
+void entregar_controle(uint8_t operacao, const char *origem, size_t tamanho_origem,
+                       const char *corpo, size_t tamanho_corpo) {
+    entregar(QUADRO_CONTROLE, operacao, origem, tamanho_origem, corpo, tamanho_corpo, 0);
+}
+
+// Função para acordar a thread principal, que dorme em poll()
+void acordar_interface() {
+    uint64_t um = 1;
+    if (write(evento_interface, &um, sizeof(um)) < 0 && errno != EAGAIN) {
+        perror("[ERRO] Falha ao sinalizar a interface");
+    }
+}
+
+// Função para tratar um quadro recebido do servidor
+// Retorna 1 se o parceiro encerrou a conversa e -1 se o quadro é inválido
+int processar_quadro(const Quadro *q) {
+    const char *origem, *corpo;
+    size_t tamanho_origem, tamanho_corpo;
+    int64_t instante = 0;
+    Quadro original;
+
+    if (q->flags & QUADRO_FLAG_HISTORICO) {
+        // Mensagem antiga reenviada por /history ou /search: trata o quadro original
+        if (protocolo_separar_historico(q, &instante, &original) < 0) return -1;
+        q = &original;
+    }
+    if (q->tipo == QUADRO_CONTROLE && q->tamanho >= 1 && q->payload[0] == CONTROLE_PING) {
+        atomic_store_explicit(&ping_recebido, 1, memory_order_relaxed);
+        return 0;
+    }
+    if (q->tipo == QUADRO_CONTROLE && q->tamanho >= 1 + PROTOCOLO_FLUXO &&
+        q->payload[0] == CONTROLE_SESSAO) {
+        if (retomada_ligada) {
+            atomic_store(&token_sessao, protocolo_ler_u64(q->payload + 1));
+            atomic_store(&sessao_nova, 1);
+        }
+        return 0;
+    }
+    if (q->tipo == QUADRO_CONTROLE && q->tamanho >= 1 + PROTOCOLO_FLUXO &&
+        q->payload[0] == CONTROLE_CONFIRMA) {
+        atomic_store(&fluxo_confirmado, protocolo_ler_u64(q->payload + 1));
+        return 0;
+    }
+    if (q->tipo == QUADRO_CONTROLE && q->tamanho >= 5 && q->payload[0] == CONTROLE_HISTORICO) {
+        // Fim da resposta a /history; o corpo leva quantas mensagens vieram
+        char total[16];
+        uint32_t n = ((uint32_t)q->payload[1] << 24) | ((uint32_t)q->payload[2] << 16) |
+                     ((uint32_t)q->payload[3] << 8) | q->payload[4];
+        int tamanho = snprintf(total, sizeof(total), "%u", n);
+        entregar_controle(CONTROLE_HISTORICO, "", 0, total, (size_t)tamanho);
+        return 0;
+    }
+    if (q->tipo == QUADRO_CONTROLE && q->tamanho >= 9 && q->payload[0] == CONTROLE_BUSCA) {
+        // Fim da resposta a /search: quantas mensagens vieram (na origem) e
+        // quanto o servidor levou, em microssegundos (no corpo)
+        char total[16], duracao[16];
+        uint32_t n = ((uint32_t)q->payload[1] << 24) | ((uint32_t)q->payload[2] << 16) |
+                     ((uint32_t)q->payload[3] << 8) | q->payload[4];
+        uint32_t us = ((uint32_t)q->payload[5] << 24) | ((uint32_t)q->payload[6] << 16) |
+                      ((uint32_t)q->payload[7] << 8) | q->payload[8];
+        int tamanho_total = snprintf(total, sizeof(total), "%u", n);
+        int tamanho_duracao = snprintf(duracao, sizeof(duracao), "%u", us);
+        entregar_controle(CONTROLE_BUSCA, total, (size_t)tamanho_total, duracao,
+                          (size_t)tamanho_duracao);
+        return 0;
+    }
+    if (q->tipo == QUADRO_CONTROLE && q->tamanho >= 5 && q->payload[0] == CONTROLE_QUEM) {
+        // Resposta a /who: o total vai na origem, a lista no corpo
+        char total[16];
+        uint32_t n = ((uint32_t)q->payload[1] << 24) | ((uint32_t)q->payload[2] << 16) |
+                     ((uint32_t)q->payload[3] << 8) | q->payload[4];
+        int tamanho = snprintf(total, sizeof(total), "%u", n);
+        entregar_controle(CONTROLE_QUEM, total, (size_t)tamanho,
+                          (const char *)q->payload + 5, q->tamanho - 5);
+        return 0;
+    }
+    if (q->tipo == QUADRO_CONTROLE && q->tamanho >= 2 && q->payload[0] == CONTROLE_ERRO &&
+        q->payload[1] != 0) {
+        // O código (nunca 0) fica no primeiro byte do corpo, antes do nickname
+        entregar_controle(CONTROLE_ERRO, "", 0, (const char *)q->payload + 1, q->tamanho - 1);
+        return 0;
+    }
+    if (q->tipo != QUADRO_CHAT && q->tipo != QUADRO_NICK && q->tipo != QUADRO_QUIT &&
+        q->tipo != QUADRO_SALA && q->tipo != QUADRO_ARQUIVO && q->tipo != QUADRO_PRIVADO) {
+        return 0; // Controle e tipos desconhecidos são ignorados
+    }
+    if (protocolo_separar_origem(q, &origem, &tamanho_origem, &corpo, &tamanho_corpo) < 0) {
+        return -1;
+    }
+    if (q->tipo == QUADRO_ARQUIVO) {
+        char aviso[AVISO_TRANSFERENCIA_MAX];
+        if (transferencia_tratar_quadro(origem, tamanho_origem, corpo, tamanho_corpo, aviso) < 0) {
+            return -1;
+        }
+        if (aviso[0] != '\0') {
+            entregar_mensagem(QUADRO_ARQUIVO, origem, tamanho_origem, aviso, strlen(aviso), 0);
+        }
+        return 0;
+    }
+    if (q->tipo == QUADRO_QUIT) {
+        copiar_campo(nickname_parceiro, NICKNAME_MAX, origem, tamanho_origem);
+        return 1;
+    }
+    if (q->tipo == QUADRO_NICK && tamanho_corpo == 0) {
+        return 0;
+    }
+    entregar_mensagem(q->tipo, origem, tamanho_origem, corpo, tamanho_corpo, instante);
+    if (q->tipo == QUADRO_NICK) {
+        copiar_campo(nickname_parceiro, NICKNAME_MAX, corpo, tamanho_corpo);
+    }
+    return 0;
+}
+
+// Função para anotar no rastro uma conexão que acabou de abrir
+// Retorna o número dela no rastro (0 se não há rastro)
+uint64_t rastrear_conexao() {
+    if (!rastro_ligado()) return 0;
+    rastro_conexao(++conexoes_rastro, RASTRO_ABERTA);
+    return conexoes_rastro;
+}
+
+// Função para anotar no rastro que a conexão atual fechou
+void rastrear_fechamento() {
+    if (saida.rastro != 0) rastro_conexao(saida.rastro, RASTRO_FECHADA);
+}
+
+// Função de limpeza da thread de recebimento (pthread_cleanup_push)
+void descarregar_rastro(void *ignorado) {
+    (void)ignorado;
+    rastro_descarregar();
+}
+
 // Função executada pela thread de recebimento de mensagens
 void *receber_mensagens(void *socket_desc) {
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     int sock = *(int*)socket_desc;
-    char server_message[BUFFER_SIZE];
+    uint64_t conexao = saida.rastro; // Fixado antes de a thread ser criada
+    LeitorQuadros leitor;
     int read_size;
+    int resultado = 0;
 
-    while ((read_size = recv(sock, server_message, BUFFER_SIZE, 0)) > 0) {
-        server_message[read_size] = '\0';
-        
-        // Verificar se é um comando /nick do parceiro
-        char cmd[BUFFER_SIZE];
-        char arg1[BUFFER_SIZE];
-        if (sscanf(server_message, "%s %s", cmd, arg1) >= 1) {
-            if (strcmp(cmd, "/nick") == 0 && strlen(arg1) > 0) {
-                strncpy(nickname_parceiro, arg1, NICKNAME_MAX - 1);
-                nickname_parceiro[NICKNAME_MAX - 1] = '\0';
-                pthread_mutex_lock(&mutex_mensagem);
-                strcpy(ultima_mensagem.mensagem, server_message);
-                ultima_mensagem.tamanho = read_size;
-                MENSAGEM_RECEBIDA = 1;
-                pthread_mutex_unlock(&mutex_mensagem);
-                continue;
-            }
+    leitor_iniciar(&leitor);
+    // Encerrada por pthread_cancel() no fim do chat: o bloco do rastro vai
+    // para o arquivo mesmo assim
+    pthread_cleanup_push(descarregar_rastro, NULL);
+    while (resultado == 0) {
+        size_t livre;
+        uint8_t *destino = leitor_espaco(&leitor, &livre);
+        if (destino == NULL) {
+            read_size = -1;
+            break;
         }
-        
-        pthread_mutex_lock(&mutex_mensagem);
-        strcpy(ultima_mensagem.mensagem, server_message);
-        ultima_mensagem.tamanho = read_size;
-        MENSAGEM_RECEBIDA = 1;
-        pthread_mutex_unlock(&mutex_mensagem);
-        if (strncmp(server_message, "/quit", 5) == 0) {
+        read_size = transporte_receber(sock, destino, livre, 0);
+        if (read_size <= 0) {
             break;
         }
+        metricas_somar(METRICA_BYTES_RECEBIDOS, (uint64_t)read_size);
+        metricas_registrar(HISTOGRAMA_TAMANHO_RECV, (uint64_t)read_size);
+        leitor_avancar(&leitor, (size_t)read_size);
+
+        // Um único aviso à interface por leitura, não por quadro
+        Quadro q;
+        int r;
+        while ((r = leitor_proximo(&leitor, &q)) == QUADRO_PRONTO) {
+            metricas_somar(METRICA_QUADROS_RECEBIDOS, 1);
+            rastro_quadro(conexao, RASTRO_RECEBIDO, &q, q.tamanho);
+            resultado = processar_quadro(&q);
+            atomic_fetch_add(&fluxo_recebido, PROTOCOLO_CABECALHO + (uint64_t)q.tamanho);
+            if (resultado != 0) break;
+        }
+        if (r == QUADRO_ERRO) resultado = -1;
+
+        // O restante de um bloco de arquivo pela metade vai do socket
+        // direto para o arquivo
+        char aviso[AVISO_TRANSFERENCIA_MAX] = "";
+        if (resultado == 0 && r == QUADRO_INCOMPLETO) {
+            Quadro parcial;
+            size_t disponivel = 0;
+            if (!rastro_ligado() || !leitor_parcial(&leitor, &parcial, &disponivel)) {
+                disponivel = 0;
+            }
+            ssize_t direto = transferencia_receber_direto(sock, &leitor, aviso);
+            if (direto < 0) {
+                read_size = -1;
+                break;
+            }
+            // O começo do quadro segue no buffer do leitor, só descartado
+            if (direto > 0 && disponivel > 0) {
+                rastro_quadro(conexao, RASTRO_RECEBIDO, &parcial, disponivel);
+            }
+            atomic_fetch_add(&fluxo_recebido, (uint64_t)direto);
+        }
+        if (resultado == 0 && aviso[0] != '\0') {
+            entregar_mensagem(QUADRO_ARQUIVO, "", 0, aviso, strlen(aviso), 0);
+        }
+        acordar_interface();
     }
-    if (read_size == 0) {
-        printf("\n\033[33m[SISTEMA] Parceiro desconectou.\033[0m\n");
+    pthread_cleanup_pop(1);
+    leitor_liberar(&leitor);
+    slab_esvaziar_cache();
+
+    // Com uma sessão retomável, a queda não encerra o chat: a thread
+    // principal reconecta e abre outra thread de recebimento
+    if (resultado == 0 && atomic_load(&token_sessao) != 0) {
+        atomic_store(&conexao_caiu, 1);
+        acordar_interface();
+        return 0;
+    }
+
+    // Só a thread principal desenha: o motivo é exibido por ela ao encerrar
+    if (resultado == 1) {
+        snprintf(aviso_fim, sizeof(aviso_fim), "\033[33m[SISTEMA] %s encerrou o chat.\033[0m\n",
+                 nickname_parceiro);
+    } else if (resultado == -1) {
+        snprintf(aviso_fim, sizeof(aviso_fim),
+                 "\033[31m[ERRO] Quadro inválido recebido do servidor.\033[0m\n");
+    } else if (read_size == 0) {
+        snprintf(aviso_fim, sizeof(aviso_fim), "\033[33m[SISTEMA] Parceiro desconectou.\033[0m\n");
     } else if (read_size == -1) {
         perror("[ERRO] Falha ao receber mensagem");
     }
     FIM_CONEXAO = 1;
+    acordar_interface();
     return 0;
 }
 
-// Função para ler entrada do usuário de forma não-bloqueante
+// Função para desenhar a linha de entrada (prompt e a parte visível do que
+// já foi digitado), se ela ainda não estiver na tela
+void exibir_prompt() {
+    if (tela_entrada_visivel()) return;
+    static char visivel[EDITOR_EXIBICAO_MAX];
+    // "[HH:MM] " + nickname + "(você): "
+    size_t prompt = 16 + editor_colunas(nickname, strlen(nickname));
+    size_t colunas = editor_largura_terminal(STDOUT_FILENO);
+    editor_exibir(&editor, colunas > prompt + 1 ? colunas - prompt - 1 : 0, visivel);
+    tela_desenhar_entrada(nickname, visivel);
+}
+
+// Função para ler entrada do usuário de forma não-bloqueante: cada leitura
+// traz tudo o que o terminal tiver (uma colagem inteira, se couber) e o
+// editor trata os bytes até acabarem ou até um Enter
+// Retorna -1 quando não há mais caracteres disponíveis, 1 quando uma
+// mensagem ficou pronta em `buffer` e 0 quando ela ainda não está completa
 int ler_entrada_usuario(char *buffer, int max_size) {
-    char c;
-    int bytes_read = read(STDIN_FILENO, &c, 1);
-    
-    if (bytes_read <= 0) {
-        return 0; // Nenhum caractere disponível
+    ssize_t bytes_read = editor_ler(&editor, STDIN_FILENO);
+    if (bytes_read == 0) {
+        entrada_encerrada = 1; // Fim da entrada (stdin fechado)
+        return -1;
     }
-    
-    if (c == '\n' || c == '\r') {
-        // Enter pressionado - finalizar mensagem
-        if (posicao_atual > 0) {
-            input_atual[posicao_atual] = '\0';
-            strcpy(buffer, input_atual);
-            posicao_atual = 0;
-            input_atual[0] = '\0';
-            input_visivel = 0;
-            return 1; // Mensagem completa
-        }
-    } else if (c == 127 || c == 8) {
-        // Backspace - só permite apagar se não estiver no início do prompt
-        if (posicao_atual > 0) {
-            posicao_atual--;
-            input_atual[posicao_atual] = '\0';
-            printf("\b \b"); // Apagar caractere na tela
-            fflush(stdout);
-        }
-        // Se tentar apagar além do prompt, não faz nada (protege o prompt)
-    } else if (posicao_atual < max_size - 1) {
-        // Adicionar caractere ao buffer
-        input_atual[posicao_atual] = c;
-        posicao_atual++;
-        input_atual[posicao_atual] = '\0';
-        printf("%c", c); // Mostrar caractere na tela
-        fflush(stdout);
+    if (bytes_read < 0) {
+        return -1; // Nenhum caractere disponível
+    }
+    if (tecla_lida == 0) tecla_lida = metricas_agora();
+
+    int pronta = editor_processar(&editor, buffer, (size_t)max_size);
+    if (editor.alterada) {
+        // Redesenhada uma vez, no próximo exibir_prompt() do laço
+        tela_apagar_entrada();
+        editor.alterada = 0;
+    }
+    if (pronta) {
+        ultimo_enter = metricas_agora();
+        return 1; // Mensagem completa
     }
-    
     return 0; // Mensagem ainda não completa
 }
 
 // Função para processar comandos durante o chat
-int processar_comando_chat(char *mensagem) {
-    // Remover quebra de linha se existir
-    mensagem[strcspn(mensagem, "\n")] = 0;
-
-    if (strcmp(mensagem, "/quit") == 0) {
-        printf("\n\033[33m[SISTEMA] Encerrando o chat...\033[0m\n");
+int processar_comando_chat(Comando comando) {
+    if (comando == COMANDO_QUIT) {
+        tela_apagar_entrada();
+        tela_printf("\033[33m[SISTEMA] Encerrando o chat...\033[0m\n");
         return 1; // Sinalizar para sair
-    } else if (strcmp(mensagem, "/help") == 0) {
-        printf("\n\033[33m══════════════════════════════════════════════════════════════\033[0m\n");
-        printf("\033[33m                           COMANDOS DO CHAT                   \033[0m\n");
-        printf("\033[33m══════════════════════════════════════════════════════════════\033[0m\n");
-        printf("\033[36m• /quit            \033[0m- Sair do chat\n");
-        printf("\033[36m• /help            \033[0m- Mostrar esta ajuda\n");
-        printf("\033[36m• /status          \033[0m- Mostrar seu status\n");
-        printf("\033[36m• /nick <nome>     \033[0m- Trocar seu nickname\n");
-        printf("\033[33m══════════════════════════════════════════════════════════════\033[0m\n\n");
+    } else if (comando == COMANDO_HELP) {
+        tela_apagar_entrada();
+        tela_printf("\033[33m══════════════════════════════════════════════════════════════\033[0m\n");
+        tela_printf("\033[33m                           COMANDOS DO CHAT                   \033[0m\n");
+        tela_printf("\033[33m══════════════════════════════════════════════════════════════\033[0m\n");
+        tela_printf("\033[36m• /quit            \033[0m- Sair do chat\n");
+        tela_printf("\033[36m• /help            \033[0m- Mostrar esta ajuda\n");
+        tela_printf("\033[36m• /status          \033[0m- Mostrar seu status\n");
+        tela_printf("\033[36m• /stats           \033[0m- Mostrar as métricas de rede e latência\n");
+        tela_printf("\033[36m• /nick <nome>     \033[0m- Trocar seu nickname\n");
+        tela_printf("\033[36m• /msg <nick> <msg> \033[0m- Mensagem privada para um usuário\n");
+        tela_printf("\033[36m• /who [prefixo]   \033[0m- Listar os nicknames conectados\n");
+        tela_printf("\033[36m• /join <sala>     \033[0m- Entrar em uma sala\n");
+        tela_printf("\033[36m• /leave           \033[0m- Sair da sala e voltar ao servidor\n");
+        tela_printf("\033[36m• /history [n]     \033[0m- Mostrar as últimas n mensagens (padrão %d)\n",
+               HISTORICO_PADRAO);
+        tela_printf("\033[36m• /search <termos> \033[0m- Buscar mensagens antigas (#sala e @nick filtram)\n");
+        tela_printf("\033[36m• /send <arquivo>  \033[0m- Enviar um arquivo para a sala\n");
+        tela_printf("\033[33m══════════════════════════════════════════════════════════════\033[0m\n\n");
         return 2; // Sinalizar que é comando interno (não enviar)
-    } else if (strcmp(mensagem, "/status") == 0) {
-        printf("\n\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
-        printf("\033[34m                           SEU STATUS                         \033[0m\n");
-        printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
-        printf("\033[32m✓ Nickname: %s\033[0m\n", nickname);
-        printf("\033[32m✓ Conectado a: %s\033[0m\n", server_ip_global);
-        printf("\033[32m✓ Parceiro: %s\033[0m\n", nickname_parceiro);
-        printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n\n");
+    } else if (comando == COMANDO_STATUS) {
+        tela_apagar_entrada();
+        tela_printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
+        tela_printf("\033[34m                           SEU STATUS                         \033[0m\n");
+        tela_printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
+        tela_printf("\033[32m✓ Nickname: %s\033[0m\n", nickname);
+        tela_printf("\033[32m✓ Conectado a: %s\033[0m\n", server_ip_global);
+        if (strlen(sala_atual) > 0) {
+            tela_printf("\033[32m✓ Sala: %s\033[0m\n", sala_atual);
+        } else {
+            tela_printf("\033[32m✓ Parceiro: %s\033[0m\n", nickname_parceiro);
+        }
+        tela_printf("\033[32m✓ Fila de exibição: pico %zu/%zu, %llu descartadas\033[0m\n",
+               fila_spsc_marca_maxima(&fila_recebidas), fila_spsc_capacidade(&fila_recebidas),
+               (unsigned long long)fila_spsc_descartados(&fila_recebidas));
+        tela_printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n\n");
+        return 2; // Sinalizar que é comando interno (não enviar)
+    } else if (comando == COMANDO_STATS) {
+        tela_apagar_entrada();
+        tela_printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
+        tela_printf("\033[34m                           MÉTRICAS                           \033[0m\n");
+        tela_printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
+        char *relatorio = NULL;
+        size_t tamanho = 0;
+        FILE *texto = open_memstream(&relatorio, &tamanho);
+        if (texto != NULL) {
+            metricas_relatorio(texto);
+            fclose(texto);
+            tela_escrever(relatorio, tamanho);
+            free(relatorio);
+        }
+        tela_printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n\n");
         return 2; // Sinalizar que é comando interno (não enviar)
     }
     
     return 0; // Mensagem normal (enviar)
 }
 
-// Função para exibir prompt de entrada
-void exibir_prompt() {
-    printf("\033[36m[%s] %s(você): \033[0m", obter_timestamp(), nickname);
-    fflush(stdout);
+// Função para exibir a resposta a um /who: `total` nicknames conectados e
+// a lista (separada por '\n', talvez cortada)
+void exibir_nicknames(const char *total, const char *lista) {
+    unsigned long esperados = strtoul(total, NULL, 10), listados = 0;
+    tela_printf("\033[34m[SISTEMA] %s conectados:\033[0m\n", total);
+    while (*lista != '\0') {
+        const char *fim = strchr(lista, '\n');
+        int tamanho = fim ? (int)(fim - lista) : (int)strlen(lista);
+        tela_printf("\033[36m  • %.*s\033[0m\n", tamanho, lista);
+        listados++;
+        lista += tamanho + (fim ? 1 : 0);
+    }
+    if (listados < esperados) {
+        tela_printf("\033[36m  ... e mais %lu\033[0m\n", esperados - listados);
+    }
+}
+
+// Função para exibir um CONTROLE_ERRO do servidor. Um /nick recusado volta
+// o nickname local ao que o servidor manteve.
+void exibir_erro(uint8_t codigo, const char *alvo) {
+    if (codigo == ERRO_NICK_EM_USO || codigo == ERRO_NICK_INVALIDO) {
+        tela_printf("\033[31m✗ Nickname %s %s; você continua como %s\033[0m\n", nickname,
+                    codigo == ERRO_NICK_EM_USO ? "já está em uso" : "inválido", alvo);
+        copiar_campo(nickname, NICKNAME_MAX, alvo, strlen(alvo));
+    } else if (codigo == ERRO_DESTINO_AUSENTE) {
+        tela_printf("\033[31m✗ Ninguém está usando o nickname %s\033[0m\n", alvo);
+    } else if (codigo == ERRO_SEM_HISTORICO) {
+        tela_printf("\033[31m✗ O servidor não guarda histórico: /search indisponível\033[0m\n");
+    } else {
+        tela_printf("\033[31m✗ Erro %u do servidor (%s)\033[0m\n", codigo, alvo);
+    }
 }
 
-// Função para exibir mensagem recebida
-void exibir_mensagem_recebida(const char *mensagem) {
+// Função para exibir mensagem recebida; `instante` diferente de 0 indica
+// uma mensagem do histórico, exibida com a data e a hora originais
+void exibir_mensagem_recebida(uint8_t tipo, uint8_t operacao, const char *origem,
+                              const char *mensagem, int64_t instante) {
     // Limpa a linha atual do input
-    limpar_linha_atual();
-
-    // Verificar se é um comando /nick
-    char cmd[BUFFER_SIZE];
-    char arg1[BUFFER_SIZE];
-    if (sscanf(mensagem, "%s %s", cmd, arg1) >= 1) {
-        if (strcmp(cmd, "/nick") == 0 && strlen(arg1) > 0) {
-            // Mostrar mensagem de confirmação do nickname do parceiro
-            printf("\033[33m[SISTEMA] %s alterou o nickname para: %s\033[0m\n", nickname_parceiro, arg1);
+    tela_apagar_entrada();
+
+    if (instante != 0) {
+        char quando[32];
+        time_t t = (time_t)instante;
+        strftime(quando, sizeof(quando), "%d/%m %H:%M", localtime(&t));
+        tela_printf("\033[90m[%s] %s: %s\033[0m\n", quando, origem, mensagem);
+    } else if (tipo == QUADRO_ARQUIVO) {
+        tela_printf("\033[35m[ARQUIVO] %s\033[0m\n", mensagem);
+    } else if (tipo == QUADRO_CONTROLE && operacao == CONTROLE_QUEM) {
+        exibir_nicknames(origem, mensagem);
+    } else if (tipo == QUADRO_CONTROLE && operacao == CONTROLE_ERRO) {
+        exibir_erro((uint8_t)mensagem[0], mensagem + 1);
+    } else if (tipo == QUADRO_CONTROLE && operacao == CONTROLE_BUSCA) {
+        tela_printf("\033[33m[SISTEMA] Fim da busca (%s mensagens, %s µs no servidor)\033[0m\n",
+                    origem, mensagem);
+    } else if (tipo == QUADRO_CONTROLE) {
+        tela_printf("\033[33m[SISTEMA] Fim do histórico (%s mensagens)\033[0m\n", mensagem);
+    } else if (tipo == QUADRO_PRIVADO) {
+        tela_printf("\033[35m[%s] %s → você: %s\033[0m\n", tela_horario(), origem, mensagem);
+    } else if (tipo == QUADRO_NICK) {
+        // Mostrar mensagem de confirmação do nickname do parceiro
+        tela_printf("\033[33m[SISTEMA] %s alterou o nickname para: %s\033[0m\n", origem, mensagem);
+    } else if (tipo == QUADRO_SALA) {
+        // Entrada ou saída de um membro da sala
+        if (strlen(mensagem) > 0) {
+            tela_printf("\033[33m[SISTEMA] %s entrou na sala %s\033[0m\n", origem, mensagem);
         } else {
-            // Exibe a mensagem recebida normal
-            printf("\033[32m[%s] %s: %s\033[0m", obter_timestamp(), nickname_parceiro, mensagem);
-            if (mensagem[strlen(mensagem) - 1] != '\n') {
-                printf("\n");
-            }
+            tela_printf("\033[33m[SISTEMA] %s saiu da sala\033[0m\n", origem);
         }
     } else {
         // Exibe a mensagem recebida normal
-        printf("\033[32m[%s] %s: %s\033[0m", obter_timestamp(), nickname_parceiro, mensagem);
-        if (mensagem[strlen(mensagem) - 1] != '\n') {
-            printf("\n");
+        tela_printf("\033[32m[%s] %s: %s\033[0m\n", tela_horario(), origem, mensagem);
+    }
+    // A linha de entrada volta uma vez só, no fim da volta do laço
+}
+
+// Função para registrar a latência recepção → exibição das mensagens já
+// desenhadas
+void registrar_exibidas() {
+    uint64_t agora = metricas_agora();
+    for (size_t i = 0; i < total_chegadas; i++) {
+        metricas_registrar(HISTOGRAMA_RECEPCAO_EXIBICAO, agora - chegadas_exibidas[i]);
+    }
+    total_chegadas = 0;
+}
+
+// Função para exibir todas as mensagens entregues pela thread de recebimento
+void exibir_mensagens_pendentes() {
+    MensagemRecebida m;
+    while (fila_spsc_remover(&fila_recebidas, &m)) {
+        metricas_ajustar(MEDIDOR_FILA_EXIBICAO, -1);
+        exibir_mensagem_recebida(m.tipo, m.operacao, MENSAGEM_ORIGEM(&m), MENSAGEM_CORPO(&m),
+                                 m.instante);
+        if (total_chegadas == FILA_EXIBICAO_CAPACIDADE) {
+            tela_descarregar(); // Rajada maior que o vetor: desenha o que já tem
+            registrar_exibidas();
         }
+        chegadas_exibidas[total_chegadas++] = m.recebido;
+        slab_liberar(m.dados);
     }
 
-    // Sempre reimprime o prompt e o input atual (se houver)
-    printf("\033[36m[%s] %s(você): \033[0m%s", obter_timestamp(), nickname, input_atual);
-    fflush(stdout);
+    // Avisa se a tela não acompanhou o ritmo e mensagens foram descartadas
+    uint64_t descartadas = fila_spsc_descartados(&fila_recebidas);
+    if (descartadas > descartes_avisados) {
+        tela_apagar_entrada();
+        tela_printf("\033[33m[SISTEMA] %llu mensagens descartadas (fila de exibição cheia).\033[0m\n",
+               (unsigned long long)(descartadas - descartes_avisados));
+        descartes_avisados = descartadas;
+    }
 }
 
 // Função para exibir mensagem enviada
 void exibir_mensagem_enviada(const char *mensagem) {
-    limpar_linha_atual();
-    printf("\033[34m[%s] %s(você): %s\033[0m\n", obter_timestamp(), nickname, mensagem);
-    exibir_prompt();
+    tela_apagar_entrada();
+    tela_printf("\033[34m[%s] %s(você): %s\033[0m\n", tela_horario(), nickname, mensagem);
+}
+
+// Função para exibir o andamento de um envio de arquivo
+void exibir_aviso_transferencia(const char *aviso) {
+    if (aviso[0] == '\0') return;
+    tela_apagar_entrada();
+    tela_printf("\033[35m[ARQUIVO] %s\033[0m\n", aviso);
+}
+
+// Função para tratar uma falha de envio. Com uma sessão retomável a
+// conexão só é dada como caída: o laço principal reconecta e o que estava
+// na fila sai depois.
+// Retorna -1 se a falha encerra o chat
+int falha_envio() {
+    if (atomic_load(&token_sessao) == 0) return -1;
+    atomic_store(&conexao_caiu, 1);
+    return 0;
+}
+
+// Função para enfileirar um quadro para o servidor; o envio acontece ao fim
+// da rajada de entrada. No modo vazão um lote cheio já segue com MSG_MORE.
+// Sem conexão (sock < 0), o quadro espera a retomada.
+// Retorna -1 se falhou
+int enfileirar_quadro(int sock, uint8_t tipo, const char *corpo, size_t tamanho) {
+    if (saida_enfileirar(&saida, tipo, corpo, tamanho) < 0) return -1;
+    if (entrada_pendente == 0) entrada_pendente = ultimo_enter;
+    if (sock >= 0 && saida.modo == ENVIO_VAZAO && saida_pendente(&saida) >= SAIDA_LOTE &&
+        saida_descarregar(&saida, sock, 1) < 0) {
+        return falha_envio();
+    }
+    return 0;
+}
+
+// Função para manter a sessão com o servidor: responde ao ping, se chegou
+// algum (vários seguidos têm uma única resposta: para o servidor, basta um
+// sinal de vida), e confirma o fluxo recebido quando a sessão é nova, a
+// cada ping e a cada CONFIRMACAO_LIMIAR bytes
+// Retorna -1 se o envio falhou
+int manter_sessao(int sock) {
+    int ping = atomic_exchange_explicit(&ping_recebido, 0, memory_order_relaxed);
+    int nova = atomic_exchange(&sessao_nova, 0);
+    uint64_t recebido = atomic_load(&fluxo_recebido);
+    saida_confirmar(&saida, atomic_load(&fluxo_confirmado));
+    int confirmar = atomic_load(&token_sessao) != 0 && recebido != confirmacao_enviada &&
+                    (nova || ping || recebido - confirmacao_enviada >= CONFIRMACAO_LIMIAR);
+    if (!ping && !confirmar) return 0;
+    if (confirmar) {
+        uint8_t fluxo[PROTOCOLO_FLUXO];
+        uint8_t *destino = saida_reservar(&saida, PROTOCOLO_CONTROLE_MINIMO + sizeof(fluxo));
+        if (destino == NULL) return -1;
+        protocolo_escrever_u64(fluxo, recebido);
+        saida_avancar(&saida, protocolo_codificar_controle(destino, CONTROLE_CONFIRMA,
+                                                           fluxo, sizeof(fluxo)));
+        confirmacao_enviada = recebido;
+    }
+    if (ping) {
+        uint8_t *destino = saida_reservar(&saida, PROTOCOLO_CONTROLE_MINIMO);
+        if (destino == NULL) return -1;
+        saida_avancar(&saida, protocolo_codificar_controle(destino, CONTROLE_PONG, NULL, 0));
+    }
+    return saida_descarregar(&saida, sock, 0) < 0 ? -1 : 0;
+}
+
+// Função para enviar o que ainda está na fila antes de fechar a conexão
+// (o /quit, por exemplo), esperando o socket por até SAIDA_PRAZO_FINAL ms
+void esvaziar_saida(int sock) {
+    struct pollfd evento = { -1, 0, 0 };
+    evento.fd = transporte_fd_envio(sock, &evento.events);
+    while (saida_pendente(&saida) > 0 && poll(&evento, 1, SAIDA_PRAZO_FINAL) > 0) {
+        if (saida_descarregar(&saida, sock, 0) < 0) break;
+    }
+}
+
+// Função para esperar a resposta ao CONTROLE_RETOMAR. Lê um quadro por vez,
+// com leituras exatas, para não tirar do socket nada do que vem depois
+// (isso é da thread de recebimento); os quadros anteriores à resposta (o
+// CONTROLE_SESSAO que toda conexão aceita recebe) são descartados.
+// Retorna -1 se a conexão falhou, o prazo passou ou o quadro é inválido
+int ler_resposta_retomada(int sock, uint64_t *token, uint64_t *fluxo) {
+    uint8_t quadro[PROTOCOLO_CABECALHO + 64];
+    for (int i = 0; i < 4; i++) {
+        if (recv(sock, quadro, PROTOCOLO_CABECALHO, MSG_WAITALL) != PROTOCOLO_CABECALHO) {
+            return -1;
+        }
+        size_t tamanho = ((size_t)quadro[4] << 24) | ((size_t)quadro[5] << 16) |
+                         ((size_t)quadro[6] << 8) | quadro[7];
+        if (quadro[0] != PROTOCOLO_VERSAO || tamanho > sizeof(quadro) - PROTOCOLO_CABECALHO) {
+            return -1;
+        }
+        if (tamanho > 0 && recv(sock, quadro + PROTOCOLO_CABECALHO, tamanho, MSG_WAITALL) !=
+                           (ssize_t)tamanho) {
+            return -1;
+        }
+        const uint8_t *payload = quadro + PROTOCOLO_CABECALHO;
+        if (quadro[1] == QUADRO_CONTROLE && tamanho >= 1 + 2 * PROTOCOLO_FLUXO &&
+            payload[0] == CONTROLE_RETOMAR) {
+            *token = protocolo_ler_u64(payload + 1);
+            *fluxo = protocolo_ler_u64(payload + 1 + PROTOCOLO_FLUXO);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Função para recomeçar em uma sessão nova, quando a antiga não existe
+// mais no servidor: esquece os fluxos e as transferências da sessão antiga
+// e apresenta de novo o nickname e a sala, antes do que ficou na fila
+// Retorna -1 se faltou memória
+int recomecar_sessao() {
+    atomic_store(&token_sessao, 0);
+    atomic_store(&fluxo_recebido, 0);
+    atomic_store(&fluxo_confirmado, 0);
+    confirmacao_enviada = 0;
+    transferencia_finalizar();
+
+    SaidaQuadros inicio;
+    saida_iniciar(&inicio, saida.modo);
+    int resultado = 0;
+    if (strlen(nickname) > 0 &&
+        saida_enfileirar(&inicio, QUADRO_NICK, nickname, strlen(nickname)) < 0) {
+        resultado = -1;
+    }
+    if (resultado == 0 && strlen(sala_atual) > 0 &&
+        saida_enfileirar(&inicio, QUADRO_SALA, sala_atual, strlen(sala_atual)) < 0) {
+        resultado = -1;
+    }
+    if (resultado == 0 && saida_reiniciar_fluxo(&saida, inicio.dados, inicio.tamanho) < 0) {
+        resultado = -1;
+    }
+    saida_liberar(&inicio);
+    return resultado;
+}
+
+// Função para reconectar ao servidor e retomar a sessão: pede a retomada,
+// volta a fila de saída ao ponto em que o servidor parou e envia dali em
+// diante. Se a sessão não existe mais, segue em uma sessão nova.
+// Retorna o socket novo ou -1 se esta tentativa falhou
+int retomar_conexao(const EnderecoTransporte *endereco) {
+    // O connect() e as leituras da resposta respeitam o prazo
+    int sock = transporte_conectar(endereco, RETOMADA_PRAZO);
+    if (sock == -1) return -1;
+
+    uint64_t token = atomic_load(&token_sessao);
+    uint8_t dados[2 * PROTOCOLO_FLUXO];
+    uint8_t pedido[PROTOCOLO_CONTROLE_MINIMO + sizeof(dados)];
+    protocolo_escrever_u64(dados, token);
+    protocolo_escrever_u64(dados + PROTOCOLO_FLUXO, atomic_load(&fluxo_recebido));
+    size_t total = protocolo_codificar_controle(pedido, CONTROLE_RETOMAR, dados, sizeof(dados));
+    uint64_t token_resposta, fluxo;
+    if (send(sock, pedido, total, MSG_NOSIGNAL) != (ssize_t)total ||
+        ler_resposta_retomada(sock, &token_resposta, &fluxo) < 0) {
+        close(sock);
+        return -1;
+    }
+    struct timeval sem_prazo = { 0, 0 };
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &sem_prazo, sizeof(sem_prazo));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &sem_prazo, sizeof(sem_prazo));
+    if (endereco->tipo == TRANSPORTE_TCP) saida_configurar_socket(sock, saida.modo);
+    saida.rastro = rastrear_conexao();
+
+    tela_apagar_entrada();
+    if (token != 0 && token_resposta == token) {
+        // Um bloco de arquivo cortado no meio não tem volta: o envio é cancelado
+        if (saida_retomar(&saida, fluxo) && transferencia_enviando()) {
+            transferencia_cancelar_envio(&saida);
+            tela_printf("\033[31m[ARQUIVO] Envio interrompido pela queda da conexão\033[0m\n");
+        }
+        tela_printf("\033[33m[SISTEMA] Sessão retomada.\033[0m\n");
+    } else {
+        if (recomecar_sessao() < 0) {
+            rastrear_fechamento();
+            close(sock);
+            return -1;
+        }
+        tela_printf("\033[33m[SISTEMA] A sessão anterior expirou; conectado em uma sessão nova.\033[0m\n");
+    }
+    if (saida_pendente(&saida) > 0 && saida_descarregar(&saida, sock, 0) < 0) {
+        rastrear_fechamento();
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// Função para tratar uma linha digitada durante o chat
+// Retorna 1 se o usuário pediu para sair
+int processar_entrada(int sock, char *mensagem) {
+    // Remove espaços em branco do início e fim
+    char *msg_trim = mensagem;
+    while (*msg_trim == ' ' || *msg_trim == '\t') msg_trim++;
+    size_t len = strlen(msg_trim);
+    while (len > 0 && (msg_trim[len-1] == ' ' || msg_trim[len-1] == '\t' || msg_trim[len-1] == '\n')) {
+        msg_trim[--len] = '\0';
+    }
+    LinhaComando linha;
+    Comando comando = comando_analisar(msg_trim, len, &linha);
+    if (comando == COMANDO_NICK) {
+        if (linha.argumento.tamanho > 0) {
+            // Atualizar nickname local
+            size_t tamanho = trecho_copiar(linha.argumento, nickname, NICKNAME_MAX);
+            // Enviar para o servidor
+            if (enfileirar_quadro(sock, QUADRO_NICK, nickname, tamanho) < 0) {
+                perror("[ERRO] Falha ao enviar mensagem");
+                FIM_CONEXAO = 1;
+            } else {
+                tela_apagar_entrada();
+                tela_printf("\033[32m✓ Nickname alterado para: %s\033[0m\n", nickname);
+                exibir_prompt();
+            }
+        } else {
+            tela_apagar_entrada();
+            tela_printf("\033[31m✗ Uso: /nick <nome>\033[0m\n");
+            exibir_prompt();
+        }
+        return 0;
+    } else if (comando == COMANDO_HISTORY) {
+        int quantidade = HISTORICO_PADRAO;
+        if (linha.argumento.tamanho > 0 && trecho_numero(linha.argumento, &quantidade) < 0) {
+            quantidade = 0;
+        }
+        if (quantidade <= 0) {
+            tela_apagar_entrada();
+            tela_printf("\033[31m✗ Uso: /history [n]\033[0m\n");
+            exibir_prompt();
+            return 0;
+        }
+        uint8_t pedido[5] = { CONTROLE_HISTORICO, (uint8_t)(quantidade >> 24),
+                              (uint8_t)(quantidade >> 16), (uint8_t)(quantidade >> 8),
+                              (uint8_t)quantidade };
+        // Pedido de controle: sem o byte de origem dos quadros de chat
+        uint8_t *destino = saida_reservar(&saida, PROTOCOLO_CABECALHO + sizeof(pedido));
+        if (destino == NULL) {
+            perror("[ERRO] Falha ao enviar mensagem");
+            FIM_CONEXAO = 1;
+            return 0;
+        }
+        destino[0] = PROTOCOLO_VERSAO;
+        destino[1] = QUADRO_CONTROLE;
+        memset(destino + 2, 0, 5);
+        destino[7] = sizeof(pedido);
+        memcpy(destino + PROTOCOLO_CABECALHO, pedido, sizeof(pedido));
+        saida_avancar(&saida, PROTOCOLO_CABECALHO + sizeof(pedido));
+        return 0;
+    } else if (comando == COMANDO_MSG) {
+        if (linha.argumento.tamanho == 0 || linha.texto.tamanho == 0) {
+            tela_apagar_entrada();
+            tela_printf("\033[31m✗ Uso: /msg <nick> <texto>\033[0m\n");
+            exibir_prompt();
+            return 0;
+        }
+        // Corpo: o destino (com o tamanho na frente) e o texto
+        static char corpo[1 + NICKNAME_MAX + LINHA_MAX];
+        char destino[NICKNAME_MAX];
+        size_t tamanho_destino = trecho_copiar(linha.argumento, destino, sizeof(destino));
+        size_t tamanho = protocolo_codificar_privado(corpo, destino, tamanho_destino,
+                                                     linha.texto.inicio, linha.texto.tamanho);
+        if (enfileirar_quadro(sock, QUADRO_PRIVADO, corpo, tamanho) < 0) {
+            perror("[ERRO] Falha ao enviar mensagem");
+            FIM_CONEXAO = 1;
+        } else {
+            tela_apagar_entrada();
+            tela_printf("\033[35m[%s] você → %s: %.*s\033[0m\n", tela_horario(), destino,
+                        (int)linha.texto.tamanho, linha.texto.inicio);
+        }
+        return 0;
+    } else if (comando == COMANDO_WHO) {
+        // Pedido de controle com o prefixo (vazio = todos)
+        uint8_t *destino = saida_reservar(&saida, PROTOCOLO_CONTROLE_MINIMO +
+                                                  linha.argumento.tamanho);
+        if (destino == NULL) {
+            perror("[ERRO] Falha ao enviar mensagem");
+            FIM_CONEXAO = 1;
+            return 0;
+        }
+        saida_avancar(&saida, protocolo_codificar_controle(destino, CONTROLE_QUEM,
+                                                           (const uint8_t *)linha.argumento.inicio,
+                                                           linha.argumento.tamanho));
+        return 0;
+    } else if (comando == COMANDO_SEARCH) {
+        if (linha.resto.tamanho == 0) {
+            tela_apagar_entrada();
+            tela_printf("\033[31m✗ Uso: /search <termos> [#sala] [@nick]\033[0m\n");
+            exibir_prompt();
+            return 0;
+        }
+        // Pedido de controle com a consulta inteira; o servidor separa os termos
+        uint8_t *destino = saida_reservar(&saida, PROTOCOLO_CONTROLE_MINIMO + linha.resto.tamanho);
+        if (destino == NULL) {
+            perror("[ERRO] Falha ao enviar mensagem");
+            FIM_CONEXAO = 1;
+            return 0;
+        }
+        saida_avancar(&saida, protocolo_codificar_controle(destino, CONTROLE_BUSCA,
+                                                           (const uint8_t *)linha.resto.inicio,
+                                                           linha.resto.tamanho));
+        return 0;
+    } else if (comando == COMANDO_SEND) {
+        // O caminho é o resto da linha (pode ter espaços)
+        char caminho[PATH_MAX];
+        char aviso[AVISO_TRANSFERENCIA_MAX];
+        tela_apagar_entrada();
+        if (linha.resto.tamanho == 0) {
+            tela_printf("\033[31m✗ Uso: /send <arquivo>\033[0m\n");
+        } else if (strlen(sala_atual) == 0) {
+            tela_printf("\033[31m✗ Entre em uma sala (/join) para enviar arquivos\033[0m\n");
+        } else if (linha.resto.tamanho >= sizeof(caminho)) {
+            tela_printf("\033[31m✗ Caminho longo demais\033[0m\n");
+        } else {
+            trecho_copiar(linha.resto, caminho, sizeof(caminho));
+            if (transferencia_iniciar_envio(&saida, caminho, aviso) < 0) {
+                tela_printf("\033[31m✗ %s\033[0m\n", aviso);
+            } else {
+                tela_printf("\033[35m[ARQUIVO] %s\033[0m\n", aviso);
+            }
+        }
+        exibir_prompt();
+        return 0;
+    } else if (comando == COMANDO_JOIN || comando == COMANDO_LEAVE) {
+        char sala[SALA_NOME_MAX] = "";
+        if (comando == COMANDO_JOIN) {
+            if (linha.argumento.tamanho == 0) {
+                tela_apagar_entrada();
+                tela_printf("\033[31m✗ Uso: /join <sala>\033[0m\n");
+                exibir_prompt();
+                return 0;
+            }
+            trecho_copiar(linha.argumento, sala, sizeof(sala));
+        }
+        // A confirmação chega do servidor como um quadro SALA
+        if (enfileirar_quadro(sock, QUADRO_SALA, sala, strlen(sala)) < 0) {
+            perror("[ERRO] Falha ao enviar mensagem");
+            FIM_CONEXAO = 1;
+        } else {
+            strcpy(sala_atual, sala);
+        }
+        return 0;
+    }
+
+    // Se for comando, processa normalmente
+    if (comando != COMANDO_NENHUM) {
+        int resultado_comando = processar_comando_chat(comando);
+        if (resultado_comando == 1) {
+            transferencia_cancelar_envio(&saida);
+            enfileirar_quadro(sock, QUADRO_QUIT, NULL, 0);
+            FIM_CONEXAO = 1;
+            return 1;
+        } else if (resultado_comando == 2) {
+            exibir_prompt();
+        }
+    }
+    // Só envia/exibe se não for vazio
+    else if (len > 0) {
+        if (enfileirar_quadro(sock, QUADRO_CHAT, msg_trim, len) < 0) {
+            perror("[ERRO] Falha ao enviar mensagem");
+            FIM_CONEXAO = 1;
+        } else {
+            exibir_mensagem_enviada(msg_trim);
+        }
+    } else {
+        exibir_prompt();
+    }
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
     int sock;
-    struct sockaddr_in server_addr;
+    EnderecoTransporte endereco;
     pthread_t thread_recebimento;
-    char* ip;
-    int port;
+    ModoEnvio modo_envio = ENVIO_INTERATIVO;
+    const char *socket_metricas = NULL;
+    const char *arquivo_rastro = NULL;
 
     setenv("TZ", "America/Sao_Paulo", 1);
     tzset();
@@ -379,124 +1145,296 @@ int main(int argc, char *argv[]) {
     putenv("TZ=UTC-3");
     tzset();
 
-    if (argc < 3) {
-        fprintf(stderr, "Uso: %s <ip_servidor> <porta>\n", argv[0]);
+    // Modo de carga sem interface: não passa pelo lobby nem pelo terminal
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return executar_bench(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-transporte") == 0) {
+        return executar_bench_transporte(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-comandos") == 0) {
+        return executar_bench_comandos(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-federacao") == 0) {
+        return executar_bench_federacao(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--reproduzir") == 0) {
+        return executar_reproducao(argc, argv);
+    }
+
+    // Uma URI ou o IP e a porta; depois as opções, sempre em pares
+    int posicionais = argc > 1 && strstr(argv[1], "://") != NULL ? 1 : 2;
+    int opcoes_validas = argc > posicionais && (argc - 1 - posicionais) % 2 == 0 &&
+                         (posicionais == 1 ? transporte_ler_uri(argv[1], &endereco)
+                                           : transporte_ler_host_porta(argv[1], argv[2],
+                                                                       &endereco)) == 0;
+    for (int i = 1 + posicionais; opcoes_validas && i < argc; i += 2) {
+        if (strcmp(argv[i], "--envio") == 0) {
+            opcoes_validas = saida_modo_ler(argv[i + 1], &modo_envio) == 0;
+        } else if (strcmp(argv[i], "--metricas") == 0) {
+            socket_metricas = argv[i + 1];
+        } else if (strcmp(argv[i], "--rastro") == 0) {
+            arquivo_rastro = argv[i + 1];
+        } else {
+            opcoes_validas = 0;
+        }
+    }
+    if (!opcoes_validas) {
+        fprintf(stderr, "Uso: %s <ip_servidor> <porta> [--envio interativo|vazao] "
+                        "[--metricas SOCKET] [--rastro ARQUIVO]\n", argv[0]);
+        fprintf(stderr, "     %s <tcp://host:porta|unix:///caminho|shm:///caminho> [opções]\n",
+                argv[0]);
+        fprintf(stderr, "     %s --bench [ip_servidor|uri] [porta] [opções]\n", argv[0]);
+        fprintf(stderr, "     %s --bench-transporte <uri>... [opções]\n", argv[0]);
+        fprintf(stderr, "     %s --bench-comandos [iteracoes]\n", argv[0]);
+        fprintf(stderr, "     %s --bench-federacao <uri_a> <uri_b> [opções]\n", argv[0]);
+        fprintf(stderr, "     %s --reproduzir <uri> <rastro>... [opções]\n", argv[0]);
         return 1;
     }
-    ip = argv[1];
-    port = atoi(argv[2]);
     
-    // Inicializar variável global do IP do servidor
-    server_ip_global = ip;
+    // Inicializar variável global do endereço do servidor
+    transporte_descrever(&endereco, server_ip_global, sizeof(server_ip_global));
+    retomada_ligada = endereco.tipo != TRANSPORTE_MEMORIA;
 
     // Lobby amigável antes de conectar
-    int lobby_result = executar_lobby(ip, port);
+    int lobby_result = executar_lobby(server_ip_global);
     if (lobby_result == 0) {
         printf("\033[33mSaindo do programa...\033[0m\n");
         return 0;
     }
 
+    if (fila_spsc_iniciar(&fila_recebidas, FILA_EXIBICAO_CAPACIDADE,
+                          sizeof(MensagemRecebida), FILA_DESCARTAR_NOVA) < 0) {
+        perror("[ERRO] Não foi possível criar a fila de mensagens");
+        return 1;
+    }
+    evento_interface = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (evento_interface < 0) {
+        perror("[ERRO] Não foi possível criar o eventfd");
+        return 1;
+    }
+    if (editor_iniciar(&editor, LINHA_MAX - 1) < 0) {
+        perror("[ERRO] Não foi possível criar a linha de entrada");
+        return 1;
+    }
+    if (socket_metricas != NULL && metricas_servir(socket_metricas, "chat_cliente_") < 0) {
+        return 1;
+    }
+    if (arquivo_rastro != NULL && rastro_abrir(arquivo_rastro, RASTRO_CLIENTE) < 0) {
+        perror("[ERRO] Não foi possível criar o arquivo de rastro");
+        metricas_parar();
+        return 1;
+    }
+
     configurar_entrada_nao_bloqueante();
-    sock = socket(AF_INET, SOCK_STREAM, 0);
+    sock = transporte_conectar(&endereco, 0);
     if (sock == -1) {
-        perror("[ERRO] Não foi possível criar o socket");
+        perror("[ERRO] Conexão falhou");
+        rastro_fechar();
+        metricas_parar();
         restaurar_terminal();
         return 1;
     }
-    server_addr.sin_addr.s_addr = inet_addr(ip);
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        perror("[ERRO] Conexão falhou");
-        close(sock);
+    if (endereco.tipo == TRANSPORTE_TCP) saida_configurar_socket(sock, modo_envio);
+    saida_iniciar(&saida, modo_envio);
+    saida.rastro = rastrear_conexao();
+    if (retomada_ligada) saida_reter(&saida, SAIDA_RETIDO_MAX);
+    tela_printf("\033[32m══════════════════════════════════════════════════════════════\033[0m\n");
+    tela_printf("\033[32m                    CHAT PRIVADO                              \033[0m\n");
+    tela_printf("\033[32m              Conectado ao servidor %s              \033[0m\n", server_ip_global);
+    tela_printf("\033[32m              Nickname: %s%-*s              \033[0m\n", nickname, (int) (strlen(nickname)), "");
+    tela_printf("\033[32m                                                              \033[0m\n");
+    tela_printf("\033[32m  Digite '/quit' para sair                                    \033[0m\n");
+    tela_printf("\033[32m══════════════════════════════════════════════════════════════\033[0m\n\n");
+    // Apresenta o nickname escolhido no lobby ao servidor
+    if (strlen(nickname) > 0 &&
+        (saida_enfileirar(&saida, QUADRO_NICK, nickname, strlen(nickname)) < 0 ||
+         saida_descarregar(&saida, sock, 0) < 0)) {
+        perror("[ERRO] Falha ao enviar nickname");
+        transporte_fechar(sock);
+        rastro_fechar();
+        metricas_parar();
         restaurar_terminal();
         return 1;
     }
-    printf("\033[32m══════════════════════════════════════════════════════════════\033[0m\n");
-    printf("\033[32m                    CHAT PRIVADO                              \033[0m\n");
-    printf("\033[32m              Conectado ao servidor %s:%d              \033[0m\n", ip, port);
-    printf("\033[32m              Nickname: %s%-*s              \033[0m\n", nickname, (int) (strlen(nickname)), "");
-    printf("\033[32m                                                              \033[0m\n");
-    printf("\033[32m  Digite '/quit' para sair                                    \033[0m\n");
-    printf("\033[32m══════════════════════════════════════════════════════════════\033[0m\n\n");
     if (pthread_create(&thread_recebimento, NULL, receber_mensagens, (void*)&sock) < 0) {
         perror("[ERRO] Não foi possível criar a thread de recebimento");
-        close(sock);
+        transporte_fechar(sock);
+        rastro_fechar();
+        metricas_parar();
         restaurar_terminal();
         return 1;
     }
-    char message[BUFFER_SIZE];
-    exibir_prompt();
+    static char message[LINHA_MAX];
+    struct pollfd eventos[3] = {
+        { STDIN_FILENO, POLLIN, 0 },
+        { evento_interface, POLLIN, 0 },
+        { -1, 0, 0 }
+    };
+    // O socket com POLLOUT, ou o aviso de espaço do anel de memória
+    eventos[2].fd = transporte_fd_envio(sock, &eventos[2].events);
+    // Queda da conexão (0 = conectado) e agenda das tentativas de retomada,
+    // em nanossegundos de metricas_agora()
+    uint64_t queda = 0, proxima_tentativa = 0, espera_tentativa = 0;
+    int entrada_pausada = 0;
     while (!FIM_CONEXAO) {
-        if (MENSAGEM_RECEBIDA) {
-            pthread_mutex_lock(&mutex_mensagem);
-            exibir_mensagem_recebida(ultima_mensagem.mensagem);
-            MENSAGEM_RECEBIDA = 0;
-            pthread_mutex_unlock(&mutex_mensagem);
-        }
-        if (ler_entrada_usuario(message, BUFFER_SIZE)) {
-            // Remove espaços em branco do início e fim
-            char *msg_trim = message;
-            while (*msg_trim == ' ' || *msg_trim == '\t') msg_trim++;
-            size_t len = strlen(msg_trim);
-            while (len > 0 && (msg_trim[len-1] == ' ' || msg_trim[len-1] == '\t' || msg_trim[len-1] == '\n')) {
-                msg_trim[--len] = '\0';
+        if (queda == 0 && atomic_load(&conexao_caiu)) {
+            // A thread de recebimento sai com o shutdown(); o que ela já
+            // entregou é exibido antes do aviso
+            transporte_interromper(sock, SHUT_RDWR);
+            pthread_join(thread_recebimento, NULL);
+            transporte_fechar(sock);
+            rastrear_fechamento();
+            sock = -1;
+            eventos[2].fd = -1;
+            atomic_store(&conexao_caiu, 0);
+            exibir_mensagens_pendentes();
+            tela_apagar_entrada();
+            tela_printf("\033[33m[SISTEMA] Conexão perdida; tentando retomar a sessão...\033[0m\n");
+            queda = proxima_tentativa = metricas_agora();
+            espera_tentativa = 0;
+        }
+
+        // Tudo o que a volta anterior desenhou vai à tela em um único write()
+        exibir_prompt();
+        tela_descarregar();
+        registrar_exibidas();
+        if (tecla_lida != 0) {
+            metricas_registrar(HISTOGRAMA_TECLA_TELA, metricas_agora() - tecla_lida);
+            tecla_lida = 0;
+        }
+
+        // Com a fila de saída acima da marca alta (servidor lento ou
+        // conexão caída), o teclado espera ela descer à marca baixa
+        if (!entrada_pausada && saida_pendente(&saida) >= SAIDA_MARCA_ALTA) {
+            entrada_pausada = 1;
+            metricas_somar(METRICA_LEITURAS_PAUSADAS, 1);
+        } else if (entrada_pausada && saida_pendente(&saida) <= SAIDA_MARCA_BAIXA) {
+            entrada_pausada = 0;
+        }
+        eventos[0].events = entrada_pausada ? 0 : POLLIN;
+
+        // Dorme até chegar entrada do teclado ou aviso da thread de rede; com
+        // um envio de arquivo em andamento ou a fila por enviar, também até
+        // a conexão aceitar mais. Sem conexão, dorme no máximo até a próxima
+        // tentativa de retomada.
+        int total_eventos = queda == 0 &&
+                            (transferencia_enviando() || saida_pendente(&saida) > 0) ? 3 : 2;
+        // Bytes do teclado que ficaram no editor (a fila de saída encheu no
+        // meio de uma rajada) não acordam o poll(): são tratados já
+        int prazo = !entrada_pausada && editor_pendente(&editor) > 0 ? 0 : -1;
+        if (queda != 0 && prazo != 0) {
+            uint64_t agora = metricas_agora();
+            prazo = proxima_tentativa > agora ? (int)((proxima_tentativa - agora) / 1000000) : 0;
+        }
+        eventos[2].revents = 0;
+        if (poll(eventos, total_eventos, prazo) < 0) {
+            if (errno == EINTR) continue;
+            perror("[ERRO] poll falhou");
+            break;
+        }
+        if (eventos[1].revents & POLLIN) {
+            uint64_t contador;
+            while (read(evento_interface, &contador, sizeof(contador)) > 0) {
             }
-            // Se for comando, processa normalmente
-            if (msg_trim[0] == '/' && strlen(msg_trim) > 0) {
-                // Verificar se é comando /nick
-                char cmd[BUFFER_SIZE];
-                char arg1[BUFFER_SIZE];
-                if (sscanf(msg_trim, "%s %s", cmd, arg1) >= 1) {
-                    if (strcmp(cmd, "/nick") == 0) {
-                        if (strlen(arg1) > 0) {
-                            // Atualizar nickname local
-                            strncpy(nickname, arg1, NICKNAME_MAX - 1);
-                            nickname[NICKNAME_MAX - 1] = '\0';
-                            // Enviar para o servidor
-                            if (send(sock, msg_trim, strlen(msg_trim), 0) < 0) {
-                                perror("[ERRO] Falha ao enviar mensagem");
-                                FIM_CONEXAO = 1;
-                            } else {
-                                limpar_linha_atual();
-                                printf("\033[32m✓ Nickname alterado para: %s\033[0m\n", nickname);
-                                exibir_prompt();
-                            }
-                        } else {
-                            limpar_linha_atual();
-                            printf("\033[31m✗ Uso: /nick <nome>\033[0m\n");
-                            exibir_prompt();
-                        }
-                        continue;
-                    }
-                }
-                
-                int resultado_comando = processar_comando_chat(msg_trim);
-                if (resultado_comando == 1) {
-                    FIM_CONEXAO = 1;
+            exibir_mensagens_pendentes();
+            if (queda == 0 && manter_sessao(sock) < 0 && falha_envio() < 0) {
+                perror("[ERRO] Falha ao responder ao ping");
+                FIM_CONEXAO = 1;
+            }
+        }
+        if ((eventos[0].revents & (POLLIN | POLLHUP | POLLERR)) ||
+            (!entrada_pausada && editor_pendente(&editor) > 0)) {
+            int resultado;
+            while (!FIM_CONEXAO && saida_pendente(&saida) < SAIDA_MARCA_ALTA &&
+                   (resultado = ler_entrada_usuario(message, LINHA_MAX)) >= 0) {
+                if (resultado == 1 && processar_entrada(sock, message)) {
                     break;
-                } else if (resultado_comando == 2) {
-                    exibir_prompt();
                 }
             }
-            // Só envia/exibe se não for vazio
-            else if (strlen(msg_trim) > 0) {
-                if (send(sock, msg_trim, strlen(msg_trim), 0) < 0) {
+            // Fim da rajada: tudo o que foi digitado (ou colado) sai junto
+            if (queda != 0) {
+                // Sem conexão: a fila espera a retomada
+            } else if (saida_pendente(&saida) > 0 && saida_descarregar(&saida, sock, 0) < 0) {
+                if (falha_envio() < 0) {
                     perror("[ERRO] Falha ao enviar mensagem");
                     FIM_CONEXAO = 1;
-                } else {
-                    exibir_mensagem_enviada(msg_trim);
                 }
+            } else if (entrada_pendente != 0 && saida_pendente(&saida) == 0) {
+                metricas_registrar(HISTOGRAMA_ENTRADA_ENVIO, metricas_agora() - entrada_pendente);
+                entrada_pendente = 0;
+            }
+            if (entrada_encerrada) {
+                eventos[0].fd = -1; // stdin fechou: continua atendendo só a rede
+            }
+        }
+        if (!FIM_CONEXAO && (eventos[2].revents & (POLLIN | POLLOUT | POLLERR | POLLHUP)) &&
+            !transferencia_enviando()) {
+            // O socket voltou a aceitar: segue o que sobrou da fila
+            if (saida_descarregar(&saida, sock, 0) < 0 && falha_envio() < 0) {
+                perror("[ERRO] Falha ao enviar mensagem");
+                FIM_CONEXAO = 1;
+            }
+        } else if (!FIM_CONEXAO && (eventos[2].revents & (POLLIN | POLLOUT | POLLERR | POLLHUP))) {
+            // Um bloco por volta do laço: o teclado e a rede não esperam o
+            // arquivo inteiro (o bloco sai depois do que estava na fila)
+            char aviso[AVISO_TRANSFERENCIA_MAX];
+            int resultado = transferencia_enviar_bloco(&saida, sock, aviso);
+            if ((resultado < 0 ||
+                 (resultado == 1 && saida_descarregar(&saida, sock, 0) < 0)) &&
+                falha_envio() < 0) {
+                perror("[ERRO] Falha ao enviar arquivo");
+                FIM_CONEXAO = 1;
+            }
+            exibir_aviso_transferencia(aviso);
+        }
+        if (!FIM_CONEXAO && queda != 0 && metricas_agora() >= proxima_tentativa) {
+            int novo = retomar_conexao(&endereco);
+            uint64_t agora = metricas_agora();
+            if (novo >= 0) {
+                sock = novo;
+                eventos[2].fd = transporte_fd_envio(sock, &eventos[2].events);
+                queda = 0;
+                if (pthread_create(&thread_recebimento, NULL, receber_mensagens, (void*)&sock) != 0) {
+                    perror("[ERRO] Não foi possível criar a thread de recebimento");
+                    FIM_CONEXAO = 1;
+                }
+            } else if (agora - queda >= (uint64_t)RETOMADA_DESISTIR * 1000000) {
+                snprintf(aviso_fim, sizeof(aviso_fim),
+                         "\033[33m[SISTEMA] Parceiro desconectou.\033[0m\n");
+                FIM_CONEXAO = 1;
             } else {
-                exibir_prompt();
+                // A primeira nova tentativa é logo; depois a espera dobra
+                espera_tentativa = espera_tentativa == 0 ? RETOMADA_ESPERA_INICIAL
+                                                         : espera_tentativa * 2;
+                if (espera_tentativa > RETOMADA_ESPERA_MAX) espera_tentativa = RETOMADA_ESPERA_MAX;
+                proxima_tentativa = agora + espera_tentativa * 1000000;
             }
         }
-        usleep(10000);
     }
-    pthread_cancel(thread_recebimento);
-    pthread_join(thread_recebimento, NULL);
-    printf("\n\033[33m[SISTEMA] Encerrando a conexão...\033[0m\n");
-    close(sock);
+    // Acorda a thread de recebimento se ela estiver presa em um splice()
+    // (ou no futex do anel de memória)
+    if (sock >= 0) {
+        esvaziar_saida(sock);
+        transporte_interromper(sock, SHUT_RD);
+        pthread_cancel(thread_recebimento);
+        pthread_join(thread_recebimento, NULL);
+    }
+    exibir_mensagens_pendentes();
+    transferencia_finalizar();
+    tela_apagar_entrada();
+    tela_printf("%s", aviso_fim);
+    tela_printf("\033[33m[SISTEMA] Encerrando a conexão...\033[0m\n");
+    tela_descarregar();
+    tela_liberar();
+    if (sock >= 0) {
+        transporte_fechar(sock);
+        rastrear_fechamento();
+    }
+    saida_liberar(&saida);
+    editor_liberar(&editor);
+    rastro_fechar();
+    metricas_parar();
     restaurar_terminal();
     exit(0);
 }
\ No newline at end of file
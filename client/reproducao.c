@@ -0,0 +1,715 @@
+// ============================================================================
+// ARQUIVO: reproducao.c
+//
+// DESCRIÇÃO: Reprodução de rastros de sessão ("--reproduzir"). Lê um ou
+//            mais rastros gravados com --rastro (pelo servidor ou pelo
+//            cliente, ver rastro.h) e refaz contra um servidor o lado dos
+//            clientes: cada conexão do rastro vira uma conexão nova, que
+//            envia os mesmos quadros, na mesma ordem, e fecha quando a
+//            original fechou. Rastros diferentes rodam juntos, todos
+//            começando no mesmo instante.
+//
+//            --ritmo original  cada quadro sai no mesmo instante, contado
+//                              do início, em que saiu na gravação
+//            --ritmo maximo    os quadros saem em ordem, o mais rápido que
+//                              as conexões aceitam
+//
+//            Não são reenviados os quadros que dependem da sessão gravada
+//            (CONFIRMA e RETOMAR) nem os PONG: os pings do servidor são
+//            respondidos na hora. Blocos de arquivo saem com o tamanho
+//            original, completados com zeros.
+//
+//            Ao final imprime, em CSV ou JSON, os quadros e bytes trocados,
+//            a duração e a vazão gravadas e reproduzidas e a latência:
+//            para cada quadro enviado, o tempo até o primeiro quadro que o
+//            servidor mandou à mesma conexão em seguida (sem contar pings e
+//            confirmações). Na reprodução espera-se uma resposta do mesmo
+//            tipo (e operação, se for CONTROLE); as que não chegam contam
+//            em "sem_resposta". As diferenças vão em porcentagem. A
+//            latência gravada pelo servidor não inclui a rede; a gravada
+//            pelo cliente e a reproduzida incluem.
+//            Tudo roda em uma única thread com epoll, como o --bench.
+//
+// COMO EXECUTAR: ./client --reproduzir <uri> <rastro>... [--ritmo original|maximo]
+//                         [--formato csv|json] [--espera S]
+//
+// Exemplo: ./server 8080 --rastro servidor.rastro
+//          ./client --reproduzir tcp://127.0.0.1:8080 servidor.rastro --ritmo maximo
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include "protocolo.h"
+#include "saida.h"
+#include "transporte.h"
+#include "metricas.h"
+#include "rastro.h"
+#include "bench.h"
+#include "reproducao.h"
+
+#define REPRODUCAO_MAX_EVENTOS 512
+#define REPRODUCAO_ESPERA_PADRAO 5           // Segundos esperando respostas depois do último quadro
+#define REPRODUCAO_SAIDA_MAX (256 * 1024)   // Bytes por enviar a uma conexão antes de esperar
+#define SEM_EVENTO ((size_t)-1)
+
+// Estados de uma conexão reproduzida
+#define CONEXAO_NOVA 0        // Ainda não aberta
+#define CONEXAO_CONECTANDO 1  // connect() em andamento
+#define CONEXAO_ABERTA 2
+#define CONEXAO_FECHADA 3
+
+// Uma abertura, um fechamento ou um quadro a enviar
+typedef struct {
+    uint64_t deslocamento;       // ns desde o primeiro registro do rastro dele
+    size_t ordem;                // Desempate: ordem dos rastros e dos registros
+    uint32_t conexao;            // Índice em `conexoes`
+    const RegistroRastro *registro;
+    uint8_t resposta_tipo;       // Tipo da resposta gravada (0 = nenhuma)
+    uint8_t resposta_operacao;   // Operação dela, se for CONTROLE
+} EventoReproducao;
+
+// Resposta esperada por um quadro já enviado
+typedef struct {
+    uint8_t tipo;
+    uint8_t operacao;
+    uint64_t enviado; // metricas_agora() do envio
+} EsperaResposta;
+
+// Conexão que refaz uma conexão do rastro
+typedef struct {
+    int fd;
+    int estado;
+    int fechar;          // A original fechou: shutdown() quando nada mais faltar
+    int escrita_fechada;
+    int na_lista;        // Já está em `sujas`
+    LeitorQuadros leitor;
+    SaidaQuadros saida;
+    EsperaResposta *esperas;
+    size_t esperas_inicio, esperas_total, esperas_capacidade;
+} ConexaoReproducao;
+
+// Quadros e bytes em cada sentido e duração, gravados ou reproduzidos
+typedef struct {
+    uint64_t enviados, bytes_enviados;
+    uint64_t recebidos, bytes_recebidos;
+    uint64_t duracao; // ns
+    Amostras latencia;
+} TotaisReproducao;
+
+// Configuração da reprodução
+typedef struct {
+    EnderecoTransporte endereco;
+    struct sockaddr_storage destino;
+    socklen_t tamanho_destino;
+    int maximo; // --ritmo maximo
+    int csv;
+    int espera; // Segundos
+} ConfigReproducao;
+
+// Estado da reprodução
+typedef struct {
+    ConfigReproducao cfg;
+    int epoll_fd;
+    EventoReproducao *eventos;
+    size_t total_eventos, capacidade_eventos;
+    ConexaoReproducao *conexoes;
+    size_t total_conexoes;
+    uint32_t *sujas; // Conexões com quadros enfileirados nesta volta
+    size_t total_sujas;
+    TotaisReproducao gravado, reproduzido;
+    uint64_t trocas, sem_resposta, perdidos;
+    uint64_t inicio, ultimo;
+} Reproducao;
+
+// Função para saber se um registro é um quadro que o cliente mandou ao
+// servidor (o resto dos quadros fez o caminho inverso)
+static int do_cliente(const Rastro *rastro, const RegistroRastro *r) {
+    return (rastro->origem == RASTRO_SERVIDOR && r->evento == RASTRO_RECEBIDO) ||
+           (rastro->origem == RASTRO_CLIENTE && r->evento == RASTRO_ENVIADO);
+}
+
+// Função para obter a operação de um quadro CONTROLE (0 nos demais)
+static uint8_t operacao_controle(uint8_t tipo, const uint8_t *payload, size_t disponivel) {
+    return tipo == QUADRO_CONTROLE && disponivel >= 1 ? payload[0] : 0;
+}
+
+// Função para saber se um quadro do cliente fica de fora da reprodução:
+// confirmações e retomadas são da sessão gravada, e os pongs respondem a
+// pings que agora são outros
+static int pular_quadro(const RegistroRastro *r) {
+    uint8_t operacao = operacao_controle(r->tipo, r->payload, r->gravado);
+    return r->tipo == QUADRO_CONTROLE && (operacao == CONTROLE_CONFIRMA ||
+                                          operacao == CONTROLE_RETOMAR ||
+                                          operacao == CONTROLE_PONG);
+}
+
+// Função para saber se um quadro do servidor conta como tráfego: pings e
+// confirmações dependem do relógio e da sessão, não do que o cliente fez
+static int eh_manutencao(uint8_t tipo, uint8_t operacao) {
+    return tipo == QUADRO_CONTROLE &&
+           (operacao == CONTROLE_PING || operacao == CONTROLE_CONFIRMA);
+}
+
+// Função para acrescentar um evento
+// Retorna o índice dele ou SEM_EVENTO se faltou memória
+static size_t acrescentar_evento(Reproducao *rep, const RegistroRastro *r, uint64_t base,
+                                 uint32_t conexao) {
+    if (rep->total_eventos == rep->capacidade_eventos) {
+        size_t nova = rep->capacidade_eventos ? rep->capacidade_eventos * 2 : 4096;
+        EventoReproducao *novos = realloc(rep->eventos, nova * sizeof(EventoReproducao));
+        if (novos == NULL) return SEM_EVENTO;
+        rep->eventos = novos;
+        rep->capacidade_eventos = nova;
+    }
+    EventoReproducao *e = &rep->eventos[rep->total_eventos];
+    memset(e, 0, sizeof(*e));
+    e->deslocamento = r->instante - base;
+    e->ordem = rep->total_eventos;
+    e->conexao = conexao;
+    e->registro = r;
+    return rep->total_eventos++;
+}
+
+// Função para transformar os registros de um rastro em eventos, dando a
+// cada conexão dele um índice em `conexoes`, e somar o que foi gravado:
+// quadros e bytes, duração e a latência de cada quadro até a resposta
+// Retorna -1 se faltou memória
+static int preparar_rastro(Reproducao *rep, const Rastro *rastro) {
+    if (rastro->total == 0) return 0;
+    uint64_t maior = 0;
+    for (size_t i = 0; i < rastro->total; i++) {
+        if (rastro->registros[i].conexao > maior) maior = rastro->registros[i].conexao;
+    }
+    uint32_t *indices = malloc((size_t)(maior + 1) * sizeof(uint32_t));
+    size_t *pendentes = malloc((size_t)(maior + 1) * sizeof(size_t));
+    if (indices == NULL || pendentes == NULL) {
+        free(indices);
+        free(pendentes);
+        return -1;
+    }
+    for (uint64_t i = 0; i <= maior; i++) {
+        indices[i] = UINT32_MAX;
+        pendentes[i] = SEM_EVENTO;
+    }
+
+    uint64_t base = rastro->registros[0].instante;
+    uint64_t duracao = rastro->registros[rastro->total - 1].instante - base;
+    if (duracao > rep->gravado.duracao) rep->gravado.duracao = duracao;
+
+    int resultado = 0;
+    for (size_t i = 0; i < rastro->total && resultado == 0; i++) {
+        const RegistroRastro *r = &rastro->registros[i];
+        if (indices[r->conexao] == UINT32_MAX) indices[r->conexao] = (uint32_t)rep->total_conexoes++;
+        uint32_t conexao = indices[r->conexao];
+
+        if (r->evento == RASTRO_ABERTA || r->evento == RASTRO_FECHADA) {
+            if (acrescentar_evento(rep, r, base, conexao) == SEM_EVENTO) resultado = -1;
+            pendentes[r->conexao] = SEM_EVENTO;
+        } else if (do_cliente(rastro, r)) {
+            if (pular_quadro(r)) continue;
+            size_t evento = acrescentar_evento(rep, r, base, conexao);
+            if (evento == SEM_EVENTO) resultado = -1;
+            rep->gravado.enviados++;
+            rep->gravado.bytes_enviados += PROTOCOLO_CABECALHO + (uint64_t)r->tamanho;
+            pendentes[r->conexao] = evento;
+        } else {
+            uint8_t operacao = operacao_controle(r->tipo, r->payload, r->gravado);
+            if (eh_manutencao(r->tipo, operacao)) continue;
+            rep->gravado.recebidos++;
+            rep->gravado.bytes_recebidos += PROTOCOLO_CABECALHO + (uint64_t)r->tamanho;
+            size_t evento = pendentes[r->conexao];
+            if (evento == SEM_EVENTO) continue;
+            EventoReproducao *e = &rep->eventos[evento];
+            e->resposta_tipo = r->tipo;
+            e->resposta_operacao = operacao;
+            amostras_adicionar(&rep->gravado.latencia, r->instante - e->registro->instante);
+            pendentes[r->conexao] = SEM_EVENTO;
+        }
+    }
+    free(indices);
+    free(pendentes);
+    return resultado;
+}
+
+// Função de comparação para ordenar os eventos de todos os rastros
+static int comparar_eventos(const void *a, const void *b) {
+    const EventoReproducao *x = a, *y = b;
+    if (x->deslocamento != y->deslocamento) return x->deslocamento < y->deslocamento ? -1 : 1;
+    return (x->ordem > y->ordem) - (x->ordem < y->ordem);
+}
+
+// Função para abrir, sem bloquear, a conexão que refaz uma do rastro
+// Retorna -1 se o socket não pôde ser criado
+static int abrir_conexao(Reproducao *rep, ConexaoReproducao *c) {
+    c->fd = socket(rep->cfg.destino.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c->fd < 0) return -1;
+    if (rep->cfg.endereco.tipo == TRANSPORTE_TCP) saida_configurar_socket(c->fd, ENVIO_INTERATIVO);
+    if (connect(c->fd, (struct sockaddr *)&rep->cfg.destino, rep->cfg.tamanho_destino) < 0 &&
+        errno != EINPROGRESS) {
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = c;
+    epoll_ctl(rep->epoll_fd, EPOLL_CTL_ADD, c->fd, &ev);
+    c->estado = CONEXAO_CONECTANDO;
+    return 0;
+}
+
+// Função para fechar uma conexão; o que ela ainda esperava fica sem resposta
+static void fechar_conexao(Reproducao *rep, ConexaoReproducao *c) {
+    if (c->estado == CONEXAO_FECHADA) return;
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+    c->estado = CONEXAO_FECHADA;
+    rep->sem_resposta += c->esperas_total - c->esperas_inicio;
+    c->esperas_inicio = c->esperas_total = 0;
+}
+
+// Função para marcar que a conexão tem quadros a descarregar nesta volta
+static void marcar_suja(Reproducao *rep, ConexaoReproducao *c) {
+    if (c->na_lista) return;
+    c->na_lista = 1;
+    rep->sujas[rep->total_sujas++] = (uint32_t)(c - rep->conexoes);
+}
+
+// Função para enviar o que a conexão tem na fila e, se a original já
+// fechou e não falta enviar nem receber nada, fechar o lado de escrita (o
+// servidor encerra a sessão e a conexão termina quando ele fechar a dele).
+// Antes das respostas não: o servidor não responde ao que chega junto com
+// o fim da conexão.
+static void descarregar(Reproducao *rep, ConexaoReproducao *c) {
+    if (c->estado != CONEXAO_ABERTA) return;
+    if (saida_pendente(&c->saida) > 0 && saida_descarregar(&c->saida, c->fd, 0) < 0) {
+        fechar_conexao(rep, c);
+        return;
+    }
+    if (c->fechar && !c->escrita_fechada && saida_pendente(&c->saida) == 0 &&
+        c->esperas_total == c->esperas_inicio) {
+        shutdown(c->fd, SHUT_WR);
+        c->escrita_fechada = 1;
+    }
+}
+
+// Função para esperar a resposta a um quadro enviado
+// Retorna -1 se faltou memória
+static int esperar_resposta(ConexaoReproducao *c, uint8_t tipo, uint8_t operacao, uint64_t agora) {
+    if (c->esperas_inicio == c->esperas_total) c->esperas_inicio = c->esperas_total = 0;
+    if (c->esperas_total == c->esperas_capacidade) {
+        size_t nova = c->esperas_capacidade ? c->esperas_capacidade * 2 : 16;
+        EsperaResposta *novas = realloc(c->esperas, nova * sizeof(EsperaResposta));
+        if (novas == NULL) return -1;
+        c->esperas = novas;
+        c->esperas_capacidade = nova;
+    }
+    c->esperas[c->esperas_total].tipo = tipo;
+    c->esperas[c->esperas_total].operacao = operacao;
+    c->esperas[c->esperas_total].enviado = agora;
+    c->esperas_total++;
+    return 0;
+}
+
+// Função para enfileirar na conexão o quadro de um registro, completando
+// com zeros o que não está no rastro
+// Retorna -1 se faltou memória
+static int enfileirar_registro(ConexaoReproducao *c, const RegistroRastro *r) {
+    size_t total = PROTOCOLO_CABECALHO + (size_t)r->tamanho;
+    uint8_t *q = saida_reservar(&c->saida, total);
+    if (q == NULL) return -1;
+    q[0] = PROTOCOLO_VERSAO;
+    q[1] = r->tipo;
+    q[2] = (uint8_t)(r->flags >> 8);
+    q[3] = (uint8_t)r->flags;
+    q[4] = (uint8_t)(r->tamanho >> 24);
+    q[5] = (uint8_t)(r->tamanho >> 16);
+    q[6] = (uint8_t)(r->tamanho >> 8);
+    q[7] = (uint8_t)r->tamanho;
+    memcpy(q + PROTOCOLO_CABECALHO, r->payload, r->gravado);
+    memset(q + PROTOCOLO_CABECALHO + r->gravado, 0, r->tamanho - r->gravado);
+    saida_avancar(&c->saida, total);
+    return 0;
+}
+
+// Função para executar um evento
+// Retorna 0 se o evento foi feito, 1 se a conexão dele precisa esvaziar a
+// saída antes ou -1 se faltou memória
+static int executar_evento(Reproducao *rep, const EventoReproducao *e, uint64_t agora) {
+    ConexaoReproducao *c = &rep->conexoes[e->conexao];
+    const RegistroRastro *r = e->registro;
+    if (r->evento == RASTRO_FECHADA) {
+        c->fechar = 1;
+        if (c->estado == CONEXAO_ABERTA) marcar_suja(rep, c);
+        return 0;
+    }
+    if (c->estado == CONEXAO_NOVA && abrir_conexao(rep, c) < 0) {
+        perror("[ERRO] Conexão falhou");
+        c->estado = CONEXAO_FECHADA;
+    }
+    if (r->evento == RASTRO_ABERTA) return 0;
+    if (c->estado == CONEXAO_FECHADA) {
+        rep->perdidos++; // O servidor já fechou esta conexão
+        return 0;
+    }
+    if (saida_pendente(&c->saida) >= REPRODUCAO_SAIDA_MAX) return 1;
+    if (enfileirar_registro(c, r) < 0) return -1;
+    if (e->resposta_tipo != 0 &&
+        esperar_resposta(c, e->resposta_tipo, e->resposta_operacao, agora) < 0) {
+        return -1;
+    }
+    rep->reproduzido.enviados++;
+    rep->reproduzido.bytes_enviados += PROTOCOLO_CABECALHO + (uint64_t)r->tamanho;
+    rep->ultimo = agora;
+    marcar_suja(rep, c);
+    return 0;
+}
+
+// Função para tratar um quadro recebido: responde aos pings e confere se é
+// a resposta a um quadro enviado. Uma resposta que chega depois de outras
+// esperadas deixa as anteriores sem resposta.
+static void tratar_quadro(Reproducao *rep, ConexaoReproducao *c, const Quadro *q, uint64_t agora) {
+    uint8_t operacao = operacao_controle(q->tipo, q->payload, q->tamanho);
+    if (q->tipo == QUADRO_CONTROLE && operacao == CONTROLE_PING) {
+        uint8_t *destino = saida_reservar(&c->saida, PROTOCOLO_CONTROLE_MINIMO);
+        if (destino != NULL) {
+            saida_avancar(&c->saida, protocolo_codificar_controle(destino, CONTROLE_PONG, NULL, 0));
+            marcar_suja(rep, c);
+        }
+        return;
+    }
+    if (eh_manutencao(q->tipo, operacao)) return;
+    rep->reproduzido.recebidos++;
+    rep->reproduzido.bytes_recebidos += PROTOCOLO_CABECALHO + (uint64_t)q->tamanho;
+    rep->ultimo = agora;
+    for (size_t i = c->esperas_inicio; i < c->esperas_total; i++) {
+        const EsperaResposta *espera = &c->esperas[i];
+        if (espera->tipo != q->tipo ||
+            (q->tipo == QUADRO_CONTROLE && espera->operacao != operacao)) {
+            continue;
+        }
+        rep->sem_resposta += i - c->esperas_inicio;
+        rep->trocas++;
+        amostras_adicionar(&rep->reproduzido.latencia, agora - espera->enviado);
+        c->esperas_inicio = i + 1;
+        if (c->fechar) marcar_suja(rep, c); // Talvez seja a última: fecha a escrita
+        break;
+    }
+}
+
+// Função para ler tudo o que chegou em uma conexão
+static void ler_conexao(Reproducao *rep, ConexaoReproducao *c) {
+    while (c->estado == CONEXAO_ABERTA) {
+        size_t livre;
+        uint8_t *destino = leitor_espaco(&c->leitor, &livre);
+        if (destino == NULL) {
+            fechar_conexao(rep, c);
+            return;
+        }
+        ssize_t n = transporte_receber(c->fd, destino, livre, 0);
+        if (n > 0) {
+            leitor_avancar(&c->leitor, (size_t)n);
+            uint64_t agora = metricas_agora();
+            Quadro q;
+            int r;
+            while ((r = leitor_proximo(&c->leitor, &q)) == QUADRO_PRONTO) {
+                tratar_quadro(rep, c, &q, agora);
+            }
+            if (r == QUADRO_ERRO) fechar_conexao(rep, c);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            fechar_conexao(rep, c);
+        }
+    }
+}
+
+// Função para tratar os eventos do epoll de uma conexão
+static void tratar_conexao(Reproducao *rep, ConexaoReproducao *c, uint32_t eventos) {
+    if (c->estado == CONEXAO_CONECTANDO) {
+        int erro = 0;
+        socklen_t tamanho = sizeof(erro);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &erro, &tamanho);
+        if (erro != 0 || (eventos & EPOLLERR)) {
+            fechar_conexao(rep, c);
+            return;
+        }
+        if (!(eventos & EPOLLOUT)) return;
+        c->estado = CONEXAO_ABERTA;
+    }
+    if (eventos & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) ler_conexao(rep, c);
+    if (eventos & EPOLLOUT) descarregar(rep, c);
+}
+
+// Função para saber se a conexão ainda espera algo do servidor
+static int conexao_pendente(const ConexaoReproducao *c) {
+    if (c->estado == CONEXAO_FECHADA || c->estado == CONEXAO_NOVA) return 0;
+    return c->estado == CONEXAO_CONECTANDO || saida_pendente(&c->saida) > 0 ||
+           c->esperas_total > c->esperas_inicio;
+}
+
+// Função para calcular a diferença, em porcentagem, do reproduzido sobre
+// o gravado
+static double delta(double gravado, double reproduzido) {
+    return gravado > 0 ? (reproduzido - gravado) / gravado * 100.0 : 0;
+}
+
+// Função para imprimir o relatório em CSV ou JSON
+static void imprimir_relatorio(Reproducao *rep, int rastros) {
+    TotaisReproducao *g = &rep->gravado, *r = &rep->reproduzido;
+    amostras_ordenar(&g->latencia);
+    amostras_ordenar(&r->latencia);
+    double s_gravado = (double)g->duracao / 1e9, s_reproduzido = (double)r->duracao / 1e9;
+    double q_gravado = s_gravado > 0 ? (double)(g->enviados + g->recebidos) / s_gravado : 0;
+    double q_reproduzido =
+        s_reproduzido > 0 ? (double)(r->enviados + r->recebidos) / s_reproduzido : 0;
+    double mb_gravado = s_gravado > 0 ? (double)(g->bytes_enviados + g->bytes_recebidos) /
+                                            s_gravado / (1024.0 * 1024.0) : 0;
+    double mb_reproduzido = s_reproduzido > 0 ? (double)(r->bytes_enviados + r->bytes_recebidos) /
+                                                    s_reproduzido / (1024.0 * 1024.0) : 0;
+    double p50_g = amostras_percentil(&g->latencia, 0.50) / 1e3;
+    double p50_r = amostras_percentil(&r->latencia, 0.50) / 1e3;
+    double p99_g = amostras_percentil(&g->latencia, 0.99) / 1e3;
+    double p99_r = amostras_percentil(&r->latencia, 0.99) / 1e3;
+
+    if (rep->cfg.csv) {
+        printf("rastros,conexoes,ritmo,enviados,bytes_enviados,recebidos_gravados,recebidos,"
+               "duracao_gravada_s,duracao_s,vazao_gravada_quadros_s,vazao_quadros_s,"
+               "delta_vazao_pct,vazao_gravada_mb_s,vazao_mb_s,trocas,sem_resposta,perdidos,"
+               "latencia_gravada_p50_us,latencia_p50_us,delta_p50_pct,"
+               "latencia_gravada_p99_us,latencia_p99_us,delta_p99_pct\n");
+        printf("%d,%zu,%s,%llu,%llu,%llu,%llu,%.3f,%.3f,%.1f,%.1f,%.1f,%.3f,%.3f,%llu,%llu,%llu,"
+               "%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+               rastros, rep->total_conexoes, rep->cfg.maximo ? "maximo" : "original",
+               (unsigned long long)r->enviados, (unsigned long long)r->bytes_enviados,
+               (unsigned long long)g->recebidos, (unsigned long long)r->recebidos,
+               s_gravado, s_reproduzido, q_gravado, q_reproduzido, delta(q_gravado, q_reproduzido),
+               mb_gravado, mb_reproduzido, (unsigned long long)rep->trocas,
+               (unsigned long long)rep->sem_resposta, (unsigned long long)rep->perdidos,
+               p50_g, p50_r, delta(p50_g, p50_r), p99_g, p99_r, delta(p99_g, p99_r));
+    } else {
+        printf("{\"rastros\": %d, \"conexoes\": %zu, \"ritmo\": \"%s\", "
+               "\"enviados\": %llu, \"bytes_enviados\": %llu, "
+               "\"recebidos\": {\"gravado\": %llu, \"reproduzido\": %llu}, "
+               "\"duracao_s\": {\"gravado\": %.3f, \"reproduzido\": %.3f}, "
+               "\"vazao_quadros_s\": {\"gravado\": %.1f, \"reproduzido\": %.1f, \"delta_pct\": %.1f}, "
+               "\"vazao_mb_s\": {\"gravado\": %.3f, \"reproduzido\": %.3f}, "
+               "\"trocas\": %llu, \"sem_resposta\": %llu, \"perdidos\": %llu, "
+               "\"latencia_p50_us\": {\"gravado\": %.1f, \"reproduzido\": %.1f, \"delta_pct\": %.1f}, "
+               "\"latencia_p99_us\": {\"gravado\": %.1f, \"reproduzido\": %.1f, \"delta_pct\": %.1f}}\n",
+               rastros, rep->total_conexoes, rep->cfg.maximo ? "maximo" : "original",
+               (unsigned long long)r->enviados, (unsigned long long)r->bytes_enviados,
+               (unsigned long long)g->recebidos, (unsigned long long)r->recebidos,
+               s_gravado, s_reproduzido, q_gravado, q_reproduzido, delta(q_gravado, q_reproduzido),
+               mb_gravado, mb_reproduzido, (unsigned long long)rep->trocas,
+               (unsigned long long)rep->sem_resposta, (unsigned long long)rep->perdidos,
+               p50_g, p50_r, delta(p50_g, p50_r), p99_g, p99_r, delta(p99_g, p99_r));
+    }
+}
+
+// Função para refazer os eventos contra o servidor, no ritmo pedido, e
+// esperar as respostas por até --espera segundos depois do último
+// Retorna -1 se faltou memória
+static int reproduzir(Reproducao *rep) {
+    struct epoll_event eventos[REPRODUCAO_MAX_EVENTOS];
+    size_t proximo = 0;
+    uint64_t fim_eventos = 0;
+    rep->inicio = rep->ultimo = metricas_agora();
+
+    while (1) {
+        uint64_t agora = metricas_agora();
+        int bloqueado = 0;
+        while (proximo < rep->total_eventos) {
+            const EventoReproducao *e = &rep->eventos[proximo];
+            if (!rep->cfg.maximo && rep->inicio + e->deslocamento > agora) break;
+            int r = executar_evento(rep, e, agora);
+            if (r < 0) return -1;
+            if (r == 1) {
+                bloqueado = 1; // A ordem vale entre conexões: todas esperam esta
+                break;
+            }
+            proximo++;
+        }
+        // Um envio por conexão com tudo o que a volta gerou
+        for (size_t i = 0; i < rep->total_sujas; i++) {
+            ConexaoReproducao *c = &rep->conexoes[rep->sujas[i]];
+            c->na_lista = 0;
+            descarregar(rep, c);
+        }
+        rep->total_sujas = 0;
+
+        int prazo = 100;
+        if (proximo < rep->total_eventos) {
+            if (!rep->cfg.maximo && !bloqueado) {
+                uint64_t devido = rep->inicio + rep->eventos[proximo].deslocamento;
+                prazo = devido > agora ? (int)((devido - agora + 999999) / 1000000) : 0;
+            } else if (!bloqueado) {
+                prazo = 0;
+            }
+        } else {
+            if (fim_eventos == 0) fim_eventos = agora;
+            int pendentes = 0;
+            for (size_t i = 0; i < rep->total_conexoes && !pendentes; i++) {
+                pendentes = conexao_pendente(&rep->conexoes[i]);
+            }
+            if (!pendentes || agora - fim_eventos >= (uint64_t)rep->cfg.espera * 1000000000ULL) {
+                break;
+            }
+        }
+
+        int n = epoll_wait(rep->epoll_fd, eventos, REPRODUCAO_MAX_EVENTOS, prazo);
+        if (n < 0 && errno != EINTR) {
+            perror("[ERRO] epoll_wait falhou");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            tratar_conexao(rep, eventos[i].data.ptr, eventos[i].events);
+        }
+    }
+    rep->reproduzido.duracao = rep->ultimo - rep->inicio;
+    for (size_t i = 0; i < rep->total_conexoes; i++) {
+        ConexaoReproducao *c = &rep->conexoes[i];
+        if (c->estado != CONEXAO_NOVA) fechar_conexao(rep, c);
+    }
+    return 0;
+}
+
+// Função para exibir o uso da reprodução
+static void exibir_uso_reproducao(const char *programa) {
+    fprintf(stderr,
+        "Uso: %s --reproduzir <uri> <rastro>... [opções]\n"
+        "  --ritmo R      original (os intervalos gravados) ou maximo (padrão original)\n"
+        "  --formato F    csv ou json (padrão csv)\n"
+        "  --espera S     segundos esperando respostas depois do último quadro (padrão %d)\n"
+        "  A URI é tcp://host:porta ou unix:///caminho; os rastros vêm de --rastro.\n",
+        programa, REPRODUCAO_ESPERA_PADRAO);
+}
+
+// Função para interpretar os argumentos da reprodução
+// Retorna o índice do primeiro rastro em argv ou -1 se são inválidos
+static int ler_config(int argc, char *argv[], ConfigReproducao *cfg) {
+    static struct option opcoes[] = {
+        {"ritmo", required_argument, 0, 'r'},
+        {"formato", required_argument, 0, 'f'},
+        {"espera", required_argument, 0, 'e'},
+        {0, 0, 0, 0}
+    };
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->csv = 1;
+    cfg->espera = REPRODUCAO_ESPERA_PADRAO;
+
+    int opcao;
+    optind = 2; // argv[1] é o próprio "--reproduzir"
+    while ((opcao = getopt_long(argc, argv, "r:f:e:", opcoes, NULL)) != -1) {
+        switch (opcao) {
+            case 'r':
+                if (strcmp(optarg, "original") == 0) cfg->maximo = 0;
+                else if (strcmp(optarg, "maximo") == 0) cfg->maximo = 1;
+                else return -1;
+                break;
+            case 'f':
+                if (strcmp(optarg, "json") == 0) cfg->csv = 0;
+                else if (strcmp(optarg, "csv") == 0) cfg->csv = 1;
+                else return -1;
+                break;
+            case 'e':
+                cfg->espera = atoi(optarg);
+                if (cfg->espera < 0) return -1;
+                break;
+            default:
+                return -1;
+        }
+    }
+    if (argc - optind < 2 || transporte_ler_uri(argv[optind], &cfg->endereco) < 0) return -1;
+    return optind + 1;
+}
+
+// Função principal da reprodução
+int executar_reproducao(int argc, char *argv[]) {
+    Reproducao rep;
+    memset(&rep, 0, sizeof(rep));
+    int primeiro = ler_config(argc, argv, &rep.cfg);
+    if (primeiro < 0) {
+        exibir_uso_reproducao(argv[0]);
+        return 1;
+    }
+    if (transporte_resolver(&rep.cfg.endereco, &rep.cfg.destino, &rep.cfg.tamanho_destino) < 0) {
+        fprintf(stderr, "[ERRO] Endereço inválido para a reprodução: %s "
+                        "(shm:// não é aceito)\n", argv[primeiro - 1]);
+        return 1;
+    }
+
+    int rastros = argc - primeiro;
+    Rastro *carregados = calloc((size_t)rastros, sizeof(Rastro));
+    if (carregados == NULL) {
+        perror("[ERRO] Não foi possível carregar os rastros");
+        return 1;
+    }
+    int resultado = 0;
+    for (int i = 0; i < rastros && resultado == 0; i++) {
+        if (rastro_carregar(argv[primeiro + i], &carregados[i]) < 0) {
+            fprintf(stderr, "[ERRO] Rastro inválido: %s (%s)\n", argv[primeiro + i],
+                    strerror(errno));
+            resultado = 1;
+        } else if (preparar_rastro(&rep, &carregados[i]) < 0) {
+            perror("[ERRO] Não foi possível preparar o rastro");
+            resultado = 1;
+        }
+    }
+    if (resultado == 0) {
+        qsort(rep.eventos, rep.total_eventos, sizeof(EventoReproducao), comparar_eventos);
+
+        // Cada conexão do rastro consome um descritor
+        struct rlimit limite;
+        if (getrlimit(RLIMIT_NOFILE, &limite) == 0 && limite.rlim_cur < limite.rlim_max) {
+            limite.rlim_cur = limite.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &limite);
+        }
+        rep.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        rep.conexoes = calloc(rep.total_conexoes + 1, sizeof(ConexaoReproducao));
+        rep.sujas = calloc(rep.total_conexoes + 1, sizeof(uint32_t));
+        if (rep.epoll_fd < 0 || rep.conexoes == NULL || rep.sujas == NULL) {
+            perror("[ERRO] Não foi possível iniciar a reprodução");
+            resultado = 1;
+        }
+    }
+    if (resultado == 0) {
+        for (size_t i = 0; i < rep.total_conexoes; i++) {
+            rep.conexoes[i].fd = -1;
+            leitor_iniciar(&rep.conexoes[i].leitor);
+            saida_iniciar(&rep.conexoes[i].saida, ENVIO_INTERATIVO);
+        }
+        if (reproduzir(&rep) < 0) {
+            perror("[ERRO] Falha na reprodução");
+            resultado = 1;
+        } else {
+            imprimir_relatorio(&rep, rastros);
+        }
+        for (size_t i = 0; i < rep.total_conexoes; i++) {
+            leitor_liberar(&rep.conexoes[i].leitor);
+            saida_liberar(&rep.conexoes[i].saida);
+            free(rep.conexoes[i].esperas);
+        }
+    }
+
+    if (rep.epoll_fd > 0) close(rep.epoll_fd);
+    free(rep.conexoes);
+    free(rep.sujas);
+    free(rep.eventos);
+    free(rep.gravado.latencia.valores);
+    free(rep.reproduzido.latencia.valores);
+    for (int i = 0; i < rastros; i++) rastro_liberar(&carregados[i]);
+    free(carregados);
+    return resultado;
+}
@@ -0,0 +1,13 @@
+// ============================================================================
+// ARQUIVO: reproducao.h
+//
+// DESCRIÇÃO: Reprodução de rastros de sessão contra um servidor
+//            ("--reproduzir", reproducao.c).
+// ============================================================================
+
+#ifndef REPRODUCAO_H
+#define REPRODUCAO_H
+
+int executar_reproducao(int argc, char *argv[]);
+
+#endif
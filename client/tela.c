@@ -0,0 +1,129 @@
+// ============================================================================
+// ARQUIVO: tela.c
+//
+// DESCRIÇÃO: Implementação da camada de desenho do terminal (ver tela.h).
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include "tela.h"
+
+#define TELA_CAPACIDADE_INICIAL 4096
+
+static char *quadro = NULL;  // Bytes do próximo write()
+static size_t tamanho_quadro = 0;
+static size_t capacidade_quadro = 0;
+
+static int entrada_visivel = 0; // A linha de entrada está desenhada na última linha
+
+static char horario[8] = "";
+static time_t proximo_minuto = 0; // Quando `horario` deixa de valer
+
+// Função para garantir espaço para mais `tamanho` bytes no quadro
+// Retorna -1 se faltou memória
+static int reservar(size_t tamanho) {
+    if (tamanho_quadro + tamanho <= capacidade_quadro) return 0;
+    size_t nova = capacidade_quadro ? capacidade_quadro * 2 : TELA_CAPACIDADE_INICIAL;
+    while (nova < tamanho_quadro + tamanho) nova *= 2;
+    char *novo = realloc(quadro, nova);
+    if (novo == NULL) return -1;
+    quadro = novo;
+    capacidade_quadro = nova;
+    return 0;
+}
+
+// Função para acrescentar bytes ao quadro
+void tela_escrever(const char *texto, size_t tamanho) {
+    if (reservar(tamanho) < 0) return;
+    memcpy(quadro + tamanho_quadro, texto, tamanho);
+    tamanho_quadro += tamanho;
+}
+
+// Função para acrescentar texto formatado ao quadro
+void tela_printf(const char *formato, ...) {
+    va_list args;
+    va_start(args, formato);
+    int tamanho = vsnprintf(quadro ? quadro + tamanho_quadro : NULL,
+                            capacidade_quadro - tamanho_quadro, formato, args);
+    va_end(args);
+    if (tamanho < 0) return;
+    if ((size_t)tamanho >= capacidade_quadro - tamanho_quadro) {
+        // Não coube: cresce e formata de novo
+        if (reservar((size_t)tamanho + 1) < 0) return;
+        va_start(args, formato);
+        vsnprintf(quadro + tamanho_quadro, (size_t)tamanho + 1, formato, args);
+        va_end(args);
+    }
+    tamanho_quadro += (size_t)tamanho;
+}
+
+// Função para apagar a linha de entrada, se estiver desenhada, antes de
+// escrever outra coisa no lugar
+void tela_apagar_entrada() {
+    if (!entrada_visivel) return;
+    tela_escrever("\r\033[K", 4);
+    entrada_visivel = 0;
+}
+
+// Função para desenhar a linha de entrada (prompt e texto digitado) na
+// última linha da tela
+void tela_desenhar_entrada(const char *nickname, const char *entrada) {
+    tela_printf("\033[36m[%s] %s(você): \033[0m%s", tela_horario(), nickname, entrada);
+    entrada_visivel = 1;
+}
+
+// Função para consultar se a linha de entrada está desenhada
+int tela_entrada_visivel() {
+    return entrada_visivel;
+}
+
+// Função para mandar o quadro acumulado ao terminal com um único write().
+// O stdout pode ter herdado o O_NONBLOCK do stdin (mesmo terminal): se o
+// terminal não aceitar tudo, espera ficar gravável.
+void tela_descarregar() {
+    fflush(stdout); // O que ainda tiver sido escrito com printf() vai antes
+    size_t enviado = 0;
+    while (enviado < tamanho_quadro) {
+        ssize_t n = write(STDOUT_FILENO, quadro + enviado, tamanho_quadro - enviado);
+        if (n > 0) {
+            enviado += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd saida = { STDOUT_FILENO, POLLOUT, 0 };
+            poll(&saida, 1, -1);
+        } else {
+            break; // Terminal fechado: não há para onde desenhar
+        }
+    }
+    tamanho_quadro = 0;
+}
+
+// Função para obter o horário atual ("HH:MM"). A formatação só é refeita
+// quando o minuto muda.
+const char *tela_horario() {
+    struct timespec agora;
+    clock_gettime(CLOCK_REALTIME_COARSE, &agora);
+    if (agora.tv_sec >= proximo_minuto) {
+        struct tm t;
+        localtime_r(&agora.tv_sec, &t);
+        strftime(horario, sizeof(horario), "%H:%M", &t);
+        proximo_minuto = agora.tv_sec - t.tm_sec + 60;
+    }
+    return horario;
+}
+
+// Função para liberar o buffer do quadro
+void tela_liberar() {
+    free(quadro);
+    quadro = NULL;
+    tamanho_quadro = capacidade_quadro = 0;
+}
@@ -0,0 +1,31 @@
+// ============================================================================
+// ARQUIVO: tela.h
+//
+// DESCRIÇÃO: Camada de desenho do terminal durante o chat. Tudo o que vai
+//            para a tela é acumulado em um buffer e sai em um único write()
+//            por volta do laço principal (tela_descarregar), em vez de um
+//            printf + fflush por tecla ou por mensagem.
+//
+//            A tela guarda um modelo mínimo do que está desenhado: se a
+//            linha de entrada (prompt + texto digitado) está visível na
+//            última linha. Assim, uma rajada de mensagens apaga a linha de
+//            entrada uma vez e a redesenha uma vez, no fim.
+//
+//            Só a thread principal desenha.
+// ============================================================================
+
+#ifndef TELA_H
+#define TELA_H
+
+#include <stddef.h>
+
+void tela_printf(const char *formato, ...) __attribute__((format(printf, 1, 2)));
+void tela_escrever(const char *texto, size_t tamanho);
+void tela_apagar_entrada(void);
+void tela_desenhar_entrada(const char *nickname, const char *entrada);
+int tela_entrada_visivel(void);
+void tela_descarregar(void);
+const char *tela_horario(void);
+void tela_liberar(void);
+
+#endif
@@ -0,0 +1,470 @@
+// ============================================================================
+// ARQUIVO: transferencia.c
+//
+// DESCRIÇÃO: Implementação da transferência de arquivos (ver transferencia.h).
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "transferencia.h"
+#include "transporte.h"
+#include "metricas.h"
+
+// DIRETORIO_RECEBIDOS/nome.NN
+#define CAMINHO_RECEBIDO_MAX (sizeof(DIRETORIO_RECEBIDOS) + NAME_MAX + 4)
+
+// Arquivo sendo enviado (só a thread principal mexe)
+typedef struct {
+    int fd; // -1 = nenhum envio em andamento
+    uint32_t id;
+    char nome[NAME_MAX + 1];
+    uint64_t tamanho;
+    off_t posicao;
+    double inicio;
+    double ultimo_aviso;
+} Envio;
+
+// Arquivo sendo recebido (só a thread de recebimento mexe)
+typedef struct {
+    int ativo;
+    int fd;
+    char origem[PROTOCOLO_ORIGEM_MAX + 1];
+    uint32_t id;
+    char caminho[CAMINHO_RECEBIDO_MAX];
+    uint64_t tamanho;
+    uint64_t recebido;
+    double inicio;
+    double ultimo_aviso;
+} Recebimento;
+
+static Envio envio = { .fd = -1 };
+static uint32_t proximo_id = 0;
+
+static Recebimento recebimentos[TRANSFERENCIAS_MAX];
+static int tubo[2] = { -1, -1 }; // Pipe do splice() socket -> arquivo
+
+// Função para obter o tempo monotônico em segundos
+static double agora() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+// Função para escrever um tamanho em bytes de forma legível (ex.: "1.5 GB")
+static void formatar_bytes(char *destino, size_t capacidade, double bytes) {
+    static const char *unidades[] = { "B", "KB", "MB", "GB", "TB" };
+    int u = 0;
+    while (bytes >= 1024 && u < 4) {
+        bytes /= 1024;
+        u++;
+    }
+    snprintf(destino, capacidade, u == 0 ? "%.0f %s" : "%.1f %s", bytes, unidades[u]);
+}
+
+// Função para descrever o andamento de uma transferência em `aviso`
+static void descrever_progresso(char *aviso, const char *acao, const char *nome,
+                                uint64_t feito, uint64_t tamanho, double inicio) {
+    char total[32], taxa[32];
+    double decorrido = agora() - inicio;
+    formatar_bytes(total, sizeof(total), (double)tamanho);
+    formatar_bytes(taxa, sizeof(taxa), decorrido > 0 ? (double)feito / decorrido : 0);
+    snprintf(aviso, AVISO_TRANSFERENCIA_MAX, "%s %s: %d%% de %s (%s/s)", acao, nome,
+             tamanho > 0 ? (int)(feito * 100 / tamanho) : 100, total, taxa);
+}
+
+// Função para descrever uma transferência concluída em `aviso`
+static void descrever_conclusao(char *aviso, const char *nome, const char *acao,
+                                uint64_t tamanho, double inicio) {
+    char total[32], taxa[32];
+    double decorrido = agora() - inicio;
+    formatar_bytes(total, sizeof(total), (double)tamanho);
+    formatar_bytes(taxa, sizeof(taxa), decorrido > 0 ? (double)tamanho / decorrido : 0);
+    snprintf(aviso, AVISO_TRANSFERENCIA_MAX, "%s %s: %s em %.1f s (%s/s)", nome, acao, total,
+             decorrido, taxa);
+}
+
+// Função para enfileirar um quadro ARQUIVO pequeno (início, fim, cancelamento)
+// Retorna -1 se faltou memória
+static int enfileirar_arquivo(SaidaQuadros *saida, uint8_t operacao, uint32_t id,
+                              const uint8_t *dados, size_t tamanho) {
+    uint8_t *destino = saida_reservar(saida, PROTOCOLO_CABECALHO + 1 + PROTOCOLO_ARQUIVO_PREFIXO +
+                                                 tamanho);
+    if (destino == NULL) return -1;
+    size_t prefixo = protocolo_codificar_arquivo(destino, operacao, id, tamanho);
+    if (tamanho > 0) memcpy(destino + prefixo, dados, tamanho);
+    saida_avancar(saida, prefixo + tamanho);
+    return 0;
+}
+
+// Função para começar a enviar um arquivo à sala. Só o anúncio é
+// enfileirado aqui; os blocos saem em transferencia_enviar_bloco().
+// Retorna -1 (com o motivo em `aviso`) se o envio não pôde começar
+int transferencia_iniciar_envio(SaidaQuadros *saida, const char *caminho, char *aviso) {
+    aviso[0] = '\0';
+    if (envio.fd >= 0) {
+        snprintf(aviso, AVISO_TRANSFERENCIA_MAX, "Já há um envio em andamento (%s)", envio.nome);
+        return -1;
+    }
+    int fd = open(caminho, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        snprintf(aviso, AVISO_TRANSFERENCIA_MAX, "Não foi possível abrir %s: %s", caminho,
+                 strerror(errno));
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode)) {
+        snprintf(aviso, AVISO_TRANSFERENCIA_MAX, "%s não é um arquivo comum", caminho);
+        close(fd);
+        return -1;
+    }
+    // A leitura é toda sequencial: o kernel pode ler bem à frente
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    const char *nome = strrchr(caminho, '/');
+    nome = nome ? nome + 1 : caminho;
+    size_t tamanho_nome = strlen(nome);
+    if (tamanho_nome > NAME_MAX) tamanho_nome = NAME_MAX;
+
+    // Identificadores distintos entre execuções, para o mesmo nickname
+    if (proximo_id == 0) proximo_id = (uint32_t)time(NULL);
+    uint32_t id = proximo_id++;
+
+    uint8_t anuncio[8 + NAME_MAX];
+    uint64_t tamanho = (uint64_t)info.st_size;
+    for (int i = 0; i < 8; i++) {
+        anuncio[i] = (uint8_t)(tamanho >> (56 - 8 * i));
+    }
+    memcpy(anuncio + 8, nome, tamanho_nome);
+    if (enfileirar_arquivo(saida, ARQUIVO_INICIO, id, anuncio, 8 + tamanho_nome) < 0) {
+        snprintf(aviso, AVISO_TRANSFERENCIA_MAX, "Memória insuficiente para enviar %s", caminho);
+        close(fd);
+        return -1;
+    }
+
+    envio.fd = fd;
+    envio.id = id;
+    memcpy(envio.nome, nome, tamanho_nome);
+    envio.nome[tamanho_nome] = '\0';
+    envio.tamanho = tamanho;
+    envio.posicao = 0;
+    envio.inicio = envio.ultimo_aviso = agora();
+    descrever_progresso(aviso, "Enviando", envio.nome, 0, envio.tamanho, envio.inicio);
+    return 0;
+}
+
+// Função para consultar se há um envio em andamento
+int transferencia_enviando() {
+    return envio.fd >= 0;
+}
+
+// Função para enviar o próximo bloco do arquivo, junto com o que já
+// estiver enfileirado em `saida`. O socket precisa ser bloqueante.
+// Retorna 1 se o envio terminou, 0 se ainda há blocos e -1 se a conexão falhou
+int transferencia_enviar_bloco(SaidaQuadros *saida, int sock, char *aviso) {
+    aviso[0] = '\0';
+    if (envio.fd < 0) return 1;
+
+    uint64_t restante = envio.tamanho - (uint64_t)envio.posicao;
+    size_t bloco = restante > PROTOCOLO_ARQUIVO_BLOCO ? PROTOCOLO_ARQUIVO_BLOCO : (size_t)restante;
+    if (bloco > 0) {
+        uint8_t *destino = saida_reservar(saida, PROTOCOLO_CABECALHO + 1 + PROTOCOLO_ARQUIVO_PREFIXO);
+        if (destino == NULL) return -1;
+        saida_avancar(saida, protocolo_codificar_arquivo(destino, ARQUIVO_BLOCO, envio.id, bloco));
+        // Um quadro pela metade não tem volta: qualquer falha encerra a conexão
+        if (saida_enviar_arquivo(saida, sock, envio.fd, &envio.posicao, bloco) < 0) return -1;
+    }
+
+    if ((uint64_t)envio.posicao == envio.tamanho) {
+        if (enfileirar_arquivo(saida, ARQUIVO_FIM, envio.id, NULL, 0) < 0) return -1;
+        descrever_conclusao(aviso, envio.nome, "enviado", envio.tamanho, envio.inicio);
+        close(envio.fd);
+        envio.fd = -1;
+        return 1;
+    }
+    double instante = agora();
+    if (instante - envio.ultimo_aviso >= 1.0) {
+        envio.ultimo_aviso = instante;
+        descrever_progresso(aviso, "Enviando", envio.nome, (uint64_t)envio.posicao,
+                            envio.tamanho, envio.inicio);
+    }
+    return 0;
+}
+
+// Função para desistir do envio em andamento (ex.: /quit), avisando a sala
+void transferencia_cancelar_envio(SaidaQuadros *saida) {
+    if (envio.fd < 0) return;
+    enfileirar_arquivo(saida, ARQUIVO_CANCELADO, envio.id, NULL, 0);
+    close(envio.fd);
+    envio.fd = -1;
+}
+
+// Função para encontrar o recebimento de uma transferência
+static Recebimento *buscar_recebimento(const char *origem, size_t tamanho_origem, uint32_t id) {
+    for (int i = 0; i < TRANSFERENCIAS_MAX; i++) {
+        Recebimento *r = &recebimentos[i];
+        if (r->ativo && r->id == id && strlen(r->origem) == tamanho_origem &&
+            memcmp(r->origem, origem, tamanho_origem) == 0) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+// Função para fechar o arquivo de um recebimento e liberar a vaga
+static void encerrar_recebimento(Recebimento *r) {
+    close(r->fd);
+    r->ativo = 0;
+}
+
+// Função para desistir de um recebimento por erro de gravação
+static void falhar_recebimento(Recebimento *r, int erro, char *aviso) {
+    snprintf(aviso, AVISO_TRANSFERENCIA_MAX, "Falha ao gravar %s: %s", r->caminho, strerror(erro));
+    encerrar_recebimento(r);
+}
+
+// Função para criar o arquivo de destino em DIRETORIO_RECEBIDOS. O nome vem
+// da rede: só a parte depois da última '/' é usada, e um arquivo existente
+// nunca é sobrescrito (ganha um sufixo numérico).
+// Retorna o descritor ou -1
+static int criar_destino(const char *nome, size_t tamanho_nome, char *caminho) {
+    char base[NAME_MAX + 1];
+    if (tamanho_nome > NAME_MAX) tamanho_nome = NAME_MAX;
+    memcpy(base, nome, tamanho_nome);
+    base[tamanho_nome] = '\0';
+    base[strcspn(base, "\n\r")] = '\0';
+    char *barra = strrchr(base, '/');
+    const char *final = barra ? barra + 1 : base;
+    if (final[0] == '\0' || strcmp(final, ".") == 0 || strcmp(final, "..") == 0) {
+        final = "arquivo";
+    }
+
+    if (mkdir(DIRETORIO_RECEBIDOS, 0755) < 0 && errno != EEXIST) return -1;
+    for (int tentativa = 0; tentativa < 100; tentativa++) {
+        if (tentativa == 0) {
+            snprintf(caminho, CAMINHO_RECEBIDO_MAX, "%s/%s", DIRETORIO_RECEBIDOS, final);
+        } else {
+            snprintf(caminho, CAMINHO_RECEBIDO_MAX, "%s/%s.%d", DIRETORIO_RECEBIDOS, final, tentativa);
+        }
+        int fd = open(caminho, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd >= 0 || errno != EEXIST) return fd;
+    }
+    errno = EEXIST;
+    return -1;
+}
+
+// Função para começar a receber um arquivo anunciado por `origem`. Sem vaga
+// livre, o recebimento mais antigo é abandonado (o remetente pode ter caído
+// sem avisar).
+static void iniciar_recebimento(const char *origem, size_t tamanho_origem, uint32_t id,
+                                const char *dados, size_t tamanho, char *aviso) {
+    // Um novo anúncio com o mesmo identificador substitui o anterior
+    Recebimento *r = buscar_recebimento(origem, tamanho_origem, id);
+    if (r != NULL) encerrar_recebimento(r);
+    for (int i = 0; r == NULL && i < TRANSFERENCIAS_MAX; i++) {
+        if (!recebimentos[i].ativo) r = &recebimentos[i];
+    }
+    if (r == NULL) {
+        r = &recebimentos[0];
+        for (int i = 1; i < TRANSFERENCIAS_MAX; i++) {
+            if (recebimentos[i].inicio < r->inicio) r = &recebimentos[i];
+        }
+        encerrar_recebimento(r);
+    }
+
+    uint64_t total = 0;
+    for (int i = 0; i < 8; i++) {
+        total = (total << 8) | (uint8_t)dados[i];
+    }
+    r->fd = criar_destino(dados + 8, tamanho - 8, r->caminho);
+    if (r->fd < 0) {
+        snprintf(aviso, AVISO_TRANSFERENCIA_MAX, "Não foi possível criar o arquivo em %s: %s",
+                 DIRETORIO_RECEBIDOS, strerror(errno));
+        return;
+    }
+    r->ativo = 1;
+    memcpy(r->origem, origem, tamanho_origem);
+    r->origem[tamanho_origem] = '\0';
+    r->id = id;
+    r->tamanho = total;
+    r->recebido = 0;
+    r->inicio = r->ultimo_aviso = agora();
+
+    char tamanho_legivel[32];
+    formatar_bytes(tamanho_legivel, sizeof(tamanho_legivel), (double)total);
+    snprintf(aviso, AVISO_TRANSFERENCIA_MAX, "%s está enviando %s (%s)", r->origem, r->caminho,
+             tamanho_legivel);
+}
+
+// Função para avisar o andamento de um recebimento, no máximo uma vez por segundo
+static void avisar_recebimento(Recebimento *r, char *aviso) {
+    double instante = agora();
+    if (instante - r->ultimo_aviso < 1.0) return;
+    r->ultimo_aviso = instante;
+    descrever_progresso(aviso, "Recebendo", r->caminho, r->recebido, r->tamanho, r->inicio);
+}
+
+// Função para gravar bytes de um bloco que já estão na memória
+static void gravar_bloco(Recebimento *r, const char *dados, size_t tamanho, char *aviso) {
+    while (tamanho > 0) {
+        ssize_t n = write(r->fd, dados, tamanho);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            falhar_recebimento(r, n < 0 ? errno : ENOSPC, aviso);
+            return;
+        }
+        dados += n;
+        tamanho -= (size_t)n;
+        r->recebido += (uint64_t)n;
+    }
+}
+
+// Função para tratar um quadro ARQUIVO completo recebido do servidor
+// Retorna -1 se o corpo estiver malformado
+int transferencia_tratar_quadro(const char *origem, size_t tamanho_origem,
+                                const char *corpo, size_t tamanho, char *aviso) {
+    uint8_t operacao;
+    uint32_t id;
+    const char *dados;
+    size_t tamanho_dados;
+
+    aviso[0] = '\0';
+    if (protocolo_separar_arquivo(corpo, tamanho, &operacao, &id, &dados, &tamanho_dados) < 0) {
+        return -1;
+    }
+    if (operacao == ARQUIVO_INICIO) {
+        if (tamanho_dados < 8) return -1;
+        iniciar_recebimento(origem, tamanho_origem, id, dados, tamanho_dados, aviso);
+        return 0;
+    }
+
+    // Blocos de transferências desconhecidas (ou que falharam) são ignorados
+    Recebimento *r = buscar_recebimento(origem, tamanho_origem, id);
+    if (r == NULL) return 0;
+    if (operacao == ARQUIVO_BLOCO) {
+        gravar_bloco(r, dados, tamanho_dados, aviso);
+        if (r->ativo) avisar_recebimento(r, aviso);
+    } else if (operacao == ARQUIVO_FIM) {
+        if (r->recebido == r->tamanho) {
+            descrever_conclusao(aviso, r->caminho, "recebido", r->recebido, r->inicio);
+        } else {
+            snprintf(aviso, AVISO_TRANSFERENCIA_MAX, "%s incompleto: %llu de %llu bytes",
+                     r->caminho, (unsigned long long)r->recebido,
+                     (unsigned long long)r->tamanho);
+        }
+        encerrar_recebimento(r);
+    } else if (operacao == ARQUIVO_CANCELADO) {
+        snprintf(aviso, AVISO_TRANSFERENCIA_MAX, "%s cancelou o envio de %s", r->origem,
+                 r->caminho);
+        encerrar_recebimento(r);
+    }
+    return 0;
+}
+
+// Função para levar `tamanho` bytes do socket ao arquivo com splice(),
+// passando pelo pipe. Se a gravação falhar, o resto ainda é lido do socket
+// (e jogado fora) para não perder o alinhamento dos quadros.
+// Retorna -1 se a conexão falhou
+static int encaminhar_socket(int sock, Recebimento *r, size_t tamanho, char *aviso) {
+    while (tamanho > 0) {
+        ssize_t n = splice(sock, NULL, tubo[1], NULL, tamanho, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n == 0) errno = ECONNRESET;
+            return -1;
+        }
+        tamanho -= (size_t)n;
+        metricas_somar(METRICA_BYTES_RECEBIDOS, (uint64_t)n);
+        while (n > 0) {
+            ssize_t gravados = r->ativo ? splice(tubo[0], NULL, r->fd, NULL, (size_t)n,
+                                                 SPLICE_F_MOVE) : -1;
+            if (gravados < 0 && errno == EINTR) continue;
+            if (gravados > 0) {
+                n -= gravados;
+                r->recebido += (uint64_t)gravados;
+                continue;
+            }
+            if (r->ativo) falhar_recebimento(r, gravados < 0 ? errno : ENOSPC, aviso);
+            char descarte[4096];
+            ssize_t lidos = read(tubo[0], descarte,
+                                 (size_t)n < sizeof(descarte) ? (size_t)n : sizeof(descarte));
+            if (lidos <= 0) return -1;
+            n -= lidos;
+        }
+    }
+    return 0;
+}
+
+// Função para receber direto do socket o restante de um bloco que chegou
+// pela metade. Só o começo do bloco passou pelo buffer do leitor; o resto
+// vai ao arquivo por splice() e o leitor é esvaziado. Se a conexão cai no
+// meio, o arquivo volta ao começo do bloco: numa retomada, o bloco inteiro
+// chega outra vez. Os bytes de uma conexão por memória compartilhada não
+// passam pelo kernel e seguem pelo leitor.
+// Retorna o tamanho do quadro recebido assim (0 se nenhum) ou -1 se a
+// conexão falhou
+ssize_t transferencia_receber_direto(int sock, LeitorQuadros *leitor, char *aviso) {
+    Quadro q;
+    size_t disponivel;
+
+    aviso[0] = '\0';
+    if (transporte_memoria(sock)) return 0;
+    if (!leitor_parcial(leitor, &q, &disponivel) || q.tipo != QUADRO_ARQUIVO) return 0;
+    // Origem, operação e identificador precisam já estar no buffer
+    if (disponivel < 1 || disponivel < 1 + (size_t)q.payload[0] + PROTOCOLO_ARQUIVO_PREFIXO ||
+        q.tamanho < 1 + (size_t)q.payload[0] + PROTOCOLO_ARQUIVO_PREFIXO) {
+        return 0;
+    }
+    size_t tamanho_origem = q.payload[0];
+    const char *origem = (const char *)q.payload + 1;
+    const char *corpo = origem + tamanho_origem;
+    size_t cabecalho = 1 + tamanho_origem + PROTOCOLO_ARQUIVO_PREFIXO;
+    uint8_t operacao;
+    uint32_t id;
+    const char *dados;
+    size_t ignorado;
+    protocolo_separar_arquivo(corpo, PROTOCOLO_ARQUIVO_PREFIXO, &operacao, &id, &dados, &ignorado);
+    if (operacao != ARQUIVO_BLOCO) return 0;
+    Recebimento *r = buscar_recebimento(origem, tamanho_origem, id);
+    if (r == NULL) return 0;
+    if (tubo[0] < 0 && pipe2(tubo, O_CLOEXEC) < 0) return 0; // Segue pelo leitor
+
+    uint64_t antes = r->recebido;
+    gravar_bloco(r, dados, disponivel - cabecalho, aviso);
+    size_t restante = q.tamanho - disponivel;
+    leitor_descartar(leitor);
+    if (encaminhar_socket(sock, r, restante, aviso) < 0) {
+        if (r->ativo && ftruncate(r->fd, (off_t)antes) == 0 &&
+            lseek(r->fd, (off_t)antes, SEEK_SET) >= 0) {
+            r->recebido = antes;
+        }
+        return -1;
+    }
+    if (r->ativo) avisar_recebimento(r, aviso);
+    return PROTOCOLO_CABECALHO + (ssize_t)q.tamanho;
+}
+
+// Função para fechar o arquivo em envio, os recebimentos (os arquivos
+// parciais ficam em DIRETORIO_RECEBIDOS) e o pipe do splice()
+void transferencia_finalizar() {
+    if (envio.fd >= 0) {
+        close(envio.fd);
+        envio.fd = -1;
+    }
+    for (int i = 0; i < TRANSFERENCIAS_MAX; i++) {
+        if (recebimentos[i].ativo) encerrar_recebimento(&recebimentos[i]);
+    }
+    if (tubo[0] >= 0) {
+        close(tubo[0]);
+        close(tubo[1]);
+        tubo[0] = tubo[1] = -1;
+    }
+}
@@ -0,0 +1,45 @@
+// ============================================================================
+// ARQUIVO: transferencia.h
+//
+// DESCRIÇÃO: Transferência de arquivos pelo chat (/send <caminho>), para os
+//            outros membros da sala.
+//
+//            Envio (thread principal): um arquivo por vez, em blocos de até
+//            PROTOCOLO_ARQUIVO_BLOCO bytes. Cada bloco é um quadro ARQUIVO
+//            cujo corpo sai com sendfile() direto do cache de páginas; entre
+//            um bloco e outro o laço principal volta a atender o teclado e
+//            a rede, então o chat continua fluindo durante a transferência.
+//
+//            Recebimento (thread de recebimento): os arquivos são gravados
+//            em DIRETORIO_RECEBIDOS. Quando só o começo de um bloco chegou,
+//            o restante vai do socket para o arquivo com splice(), por um
+//            pipe, sem passar pela memória do processo.
+//
+//            As funções preenchem `aviso` com o texto de progresso a exibir
+//            (no máximo um por segundo por transferência); aviso[0] == '\0'
+//            significa que não há nada a mostrar.
+// ============================================================================
+
+#ifndef TRANSFERENCIA_H
+#define TRANSFERENCIA_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "protocolo.h"
+#include "saida.h"
+
+#define DIRETORIO_RECEBIDOS "recebidos"
+#define TRANSFERENCIAS_MAX 8 // Recebimentos simultâneos
+#define AVISO_TRANSFERENCIA_MAX 1024
+
+int transferencia_iniciar_envio(SaidaQuadros *saida, const char *caminho, char *aviso);
+int transferencia_enviando(void);
+int transferencia_enviar_bloco(SaidaQuadros *saida, int sock, char *aviso);
+void transferencia_cancelar_envio(SaidaQuadros *saida);
+int transferencia_tratar_quadro(const char *origem, size_t tamanho_origem,
+                                const char *corpo, size_t tamanho, char *aviso);
+ssize_t transferencia_receber_direto(int sock, LeitorQuadros *leitor, char *aviso);
+void transferencia_finalizar(void);
+
+#endif
@@ -0,0 +1,40 @@
+// ============================================================================
+// ARQUIVO: buffer.c
+//
+// DESCRIÇÃO: Implementação do buffer com contagem de referências
+//            (ver buffer.h).
+// ============================================================================
+
+#include <string.h>
+
+#include "buffer.h"
+#include "slab.h"
+
+// Função para criar um buffer com uma referência (a de quem o criou). A
+// memória vem do alocador de blocos (ver slab.h).
+BufferCompartilhado *buffer_criar(size_t tamanho) {
+    BufferCompartilhado *buffer = slab_alocar(sizeof(BufferCompartilhado) + tamanho);
+    if (buffer == NULL) return NULL;
+    atomic_init(&buffer->referencias, 1);
+    buffer->tamanho = (uint32_t)tamanho;
+    return buffer;
+}
+
+// Função para criar um buffer com uma cópia de `dados`
+BufferCompartilhado *buffer_copiar(const void *dados, size_t tamanho) {
+    BufferCompartilhado *buffer = buffer_criar(tamanho);
+    if (buffer != NULL) memcpy(buffer->dados, dados, tamanho);
+    return buffer;
+}
+
+// Função para registrar mais um dono do buffer
+void buffer_reter(BufferCompartilhado *buffer) {
+    atomic_fetch_add_explicit(&buffer->referencias, 1, memory_order_relaxed);
+}
+
+// Função para largar uma referência; a última libera a memória
+void buffer_soltar(BufferCompartilhado *buffer) {
+    if (atomic_fetch_sub_explicit(&buffer->referencias, 1, memory_order_acq_rel) == 1) {
+        slab_liberar(buffer);
+    }
+}
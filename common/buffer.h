@@ -0,0 +1,29 @@
+// ============================================================================
+// ARQUIVO: buffer.h
+//
+// DESCRIÇÃO: Buffer imutável com contagem de referências atômica. Um quadro
+//            é codificado uma única vez em um BufferCompartilhado e a mesma
+//            memória é enfileirada em todas as conexões de destino; cada
+//            fila segura uma referência e o buffer é liberado quando a
+//            última conexão termina de enviá-lo.
+// ============================================================================
+
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    _Atomic uint32_t referencias;
+    uint32_t tamanho;
+    uint8_t dados[];
+} BufferCompartilhado;
+
+BufferCompartilhado *buffer_criar(size_t tamanho);
+BufferCompartilhado *buffer_copiar(const void *dados, size_t tamanho);
+void buffer_reter(BufferCompartilhado *buffer);
+void buffer_soltar(BufferCompartilhado *buffer);
+
+#endif
@@ -0,0 +1,148 @@
+// ============================================================================
+// ARQUIVO: comandos.c
+//
+// DESCRIÇÃO: Implementação do reconhecimento de comandos (ver comandos.h).
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "comandos.h"
+
+// Hash perfeito dos nomes (sem a '/'): duas vezes o tamanho + a última
+// letra, módulo o número de baldes ("status" e "search" empatam em tamanho
+// e primeira letra). A tabela é conferida por conferir_tabela(), abaixo.
+#define COMANDOS_BALDES 32
+#define COMANDOS_HASH(tamanho, ultima) \
+    ((2 * (size_t)(tamanho) + (unsigned char)(ultima)) & (COMANDOS_BALDES - 1))
+
+// Os comandos: nome, última letra (à parte: nome[n] não é constante para o
+// compilador) e valor
+#define COMANDOS_LISTA(X) \
+    X("quit", 't', COMANDO_QUIT) \
+    X("help", 'p', COMANDO_HELP) \
+    X("status", 's', COMANDO_STATUS) \
+    X("stats", 's', COMANDO_STATS) \
+    X("nick", 'k', COMANDO_NICK) \
+    X("join", 'n', COMANDO_JOIN) \
+    X("leave", 'e', COMANDO_LEAVE) \
+    X("history", 'y', COMANDO_HISTORY) \
+    X("send", 'd', COMANDO_SEND) \
+    X("msg", 'g', COMANDO_MSG) \
+    X("who", 'o', COMANDO_WHO) \
+    X("search", 'h', COMANDO_SEARCH)
+
+#define COMANDO_ENTRADA(nome, ultima, valor) \
+    [COMANDOS_HASH(sizeof(nome) - 1, ultima)] = { nome, sizeof(nome) - 1, valor },
+#define COMANDO_BALDE(nome, ultima, valor) \
+    case COMANDOS_HASH(sizeof(nome) - 1, ultima):
+
+typedef struct {
+    const char *nome;
+    size_t tamanho;
+    Comando comando;
+} EntradaComando;
+
+static const EntradaComando tabela[COMANDOS_BALDES] = {
+    COMANDOS_LISTA(COMANDO_ENTRADA)
+};
+
+// Função para conferir a tabela antes do main(). Dois nomes no mesmo balde
+// não compilam: viram rótulos case repetidos no switch, um erro em qualquer
+// nível de aviso. Uma última letra que não é a do nome põe a entrada fora
+// do seu balde, e o programa para na partida.
+__attribute__((constructor)) static void conferir_tabela(void) {
+    switch (0) {
+        COMANDOS_LISTA(COMANDO_BALDE)
+        default:
+            break;
+    }
+    for (size_t i = 0; i < COMANDOS_BALDES; i++) {
+        const EntradaComando *entrada = &tabela[i];
+        if (entrada->nome != NULL &&
+            COMANDOS_HASH(entrada->tamanho, entrada->nome[entrada->tamanho - 1]) != i) {
+            fprintf(stderr, "[ERRO] A última letra do comando /%s está errada na tabela\n",
+                    entrada->nome);
+            abort();
+        }
+    }
+}
+
+// Função para saber se um byte separa palavras (os mesmos do %s do scanf)
+static int eh_espaco(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Função para procurar um nome de comando (sem a '/') na tabela
+static Comando procurar(const char *nome, size_t tamanho) {
+    if (tamanho == 0) return COMANDO_DESCONHECIDO;
+    const EntradaComando *entrada = &tabela[COMANDOS_HASH(tamanho, nome[tamanho - 1])];
+    if (entrada->nome != NULL && entrada->tamanho == tamanho &&
+        memcmp(entrada->nome, nome, tamanho) == 0) {
+        return entrada->comando;
+    }
+    return COMANDO_DESCONHECIDO;
+}
+
+// Função para analisar uma linha digitada: identifica o comando e separa o
+// primeiro argumento e o resto da linha, sem copiar nada
+// Retorna o comando (também gravado em resultado->comando)
+Comando comando_analisar(const char *linha, size_t tamanho, LinhaComando *resultado) {
+    const char *fim = linha + tamanho;
+    while (linha < fim && eh_espaco(*linha)) linha++;
+    while (fim > linha && eh_espaco(fim[-1])) fim--;
+
+    resultado->argumento.inicio = resultado->texto.inicio = fim;
+    resultado->argumento.tamanho = resultado->texto.tamanho = 0;
+    if (linha == fim || *linha != '/') {
+        resultado->comando = COMANDO_NENHUM;
+        resultado->resto.inicio = linha;
+        resultado->resto.tamanho = (size_t)(fim - linha);
+        return COMANDO_NENHUM;
+    }
+
+    const char *nome = linha + 1;
+    const char *p = nome;
+    while (p < fim && !eh_espaco(*p)) p++;
+    resultado->comando = procurar(nome, (size_t)(p - nome));
+
+    while (p < fim && eh_espaco(*p)) p++;
+    resultado->resto.inicio = p;
+    resultado->resto.tamanho = (size_t)(fim - p);
+    const char *q = p;
+    while (q < fim && !eh_espaco(*q)) q++;
+    resultado->argumento.inicio = p;
+    resultado->argumento.tamanho = (size_t)(q - p);
+    while (q < fim && eh_espaco(*q)) q++;
+    resultado->texto.inicio = q;
+    resultado->texto.tamanho = (size_t)(fim - q);
+    return resultado->comando;
+}
+
+// Função para copiar um trecho para uma string terminada em '\0', cortando
+// o que não couber em `capacidade`
+// Retorna quantos bytes foram copiados
+size_t trecho_copiar(Trecho trecho, char *destino, size_t capacidade) {
+    size_t tamanho = trecho.tamanho < capacidade ? trecho.tamanho : capacidade - 1;
+    memcpy(destino, trecho.inicio, tamanho);
+    destino[tamanho] = '\0';
+    return tamanho;
+}
+
+// Função para ler um trecho como número inteiro não negativo
+// Retorna -1 se o trecho estiver vazio, tiver algo além de dígitos ou não
+// couber em um int
+int trecho_numero(Trecho trecho, int *valor) {
+    if (trecho.tamanho == 0) return -1;
+    int numero = 0;
+    for (size_t i = 0; i < trecho.tamanho; i++) {
+        char c = trecho.inicio[i];
+        if (c < '0' || c > '9') return -1;
+        if (numero > (INT_MAX - (c - '0')) / 10) return -1;
+        numero = numero * 10 + (c - '0');
+    }
+    *valor = numero;
+    return 0;
+}
@@ -0,0 +1,59 @@
+// ============================================================================
+// ARQUIVO: comandos.h
+//
+// DESCRIÇÃO: Reconhecimento dos comandos digitados ("/nick ana", "/quit"),
+//            compartilhado pelo lobby e pelo chat do cliente e pela
+//            interface do operador do servidor.
+//
+//            A linha é analisada no lugar: o resultado são trechos
+//            (ponteiro + tamanho) que apontam para dentro da própria linha,
+//            sem cópias nem alocação. O nome do comando é procurado em uma
+//            tabela de hash perfeito montada em tempo de compilação (ver
+//            comandos.c), com uma única comparação de bytes no fim.
+//
+//            Cada programa decide quais comandos aceita; os que ele não
+//            trata são tratados como desconhecidos.
+// ============================================================================
+
+#ifndef COMANDOS_H
+#define COMANDOS_H
+
+#include <stddef.h>
+
+typedef enum {
+    COMANDO_NENHUM = 0,   // A linha não começa com '/': é uma mensagem
+    COMANDO_DESCONHECIDO, // Começa com '/', mas o nome não existe
+    COMANDO_QUIT,
+    COMANDO_HELP,
+    COMANDO_STATUS,
+    COMANDO_STATS,
+    COMANDO_NICK,
+    COMANDO_JOIN,
+    COMANDO_LEAVE,
+    COMANDO_HISTORY,
+    COMANDO_SEND,
+    COMANDO_MSG,
+    COMANDO_WHO,
+    COMANDO_SEARCH
+} Comando;
+
+// Trecho de uma linha; não termina em '\0'
+typedef struct {
+    const char *inicio;
+    size_t tamanho;
+} Trecho;
+
+// Resultado da análise de uma linha
+typedef struct {
+    Comando comando;
+    Trecho argumento; // Primeira palavra depois do comando (vazio se não houver)
+    Trecho resto;     // Tudo depois do comando (ou a mensagem inteira), sem os
+                      // espaços das pontas
+    Trecho texto;     // Tudo depois do argumento, sem os espaços das pontas
+} LinhaComando;
+
+Comando comando_analisar(const char *linha, size_t tamanho, LinhaComando *resultado);
+size_t trecho_copiar(Trecho trecho, char *destino, size_t capacidade);
+int trecho_numero(Trecho trecho, int *valor);
+
+#endif
@@ -0,0 +1,462 @@
+// ============================================================================
+// ARQUIVO: editor.c
+//
+// DESCRIÇÃO: Implementação do editor da linha de entrada (ver editor.h).
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+
+#include "editor.h"
+
+// Estados da leitura de uma sequência de escape
+enum {
+    ESCAPE_NENHUM = 0,
+    ESCAPE_INICIO, // Chegou ESC
+    ESCAPE_CSI,    // ESC [ (parâmetros até o byte final)
+    ESCAPE_SS3     // ESC O (uma letra)
+};
+
+#define ESC 0x1b
+#define CONTROLE(letra) ((letra) & 0x1f)
+
+// Função para iniciar um editor vazio para textos de até `capacidade` bytes
+// Retorna -1 se faltou memória
+int editor_iniciar(Editor *editor, size_t capacidade) {
+    memset(editor, 0, sizeof(*editor));
+    editor->linha = malloc(capacidade + 1);
+    if (editor->linha == NULL) return -1;
+    editor->linha[0] = '\0';
+    editor->capacidade = capacidade;
+    return 0;
+}
+
+// Função para liberar o texto e o histórico do editor
+void editor_liberar(Editor *editor) {
+    free(editor->linha);
+    free(editor->rascunho);
+    for (int i = 0; i < EDITOR_HISTORICO; i++) free(editor->historico[i]);
+    memset(editor, 0, sizeof(*editor));
+}
+
+// Função para ler do terminal tudo o que couber, se os bytes da leitura
+// anterior já foram tratados
+// Retorna o resultado do read() (0 = fim da entrada, -1 com EAGAIN = nada
+// disponível) ou o que ainda falta tratar
+ssize_t editor_ler(Editor *editor, int fd) {
+    if (editor->inicio_entrada < editor->fim_entrada) {
+        return (ssize_t)(editor->fim_entrada - editor->inicio_entrada);
+    }
+    ssize_t n;
+    do {
+        n = read(fd, editor->entrada, sizeof(editor->entrada));
+    } while (n < 0 && errno == EINTR);
+    editor->inicio_entrada = 0;
+    editor->fim_entrada = n > 0 ? (size_t)n : 0;
+    return n;
+}
+
+// Retorna quantos bytes lidos ainda não foram tratados
+size_t editor_pendente(const Editor *editor) {
+    return editor->fim_entrada - editor->inicio_entrada;
+}
+
+// Função para consultar se `c` continua um caractere UTF-8
+static int continuacao(unsigned char c) {
+    return (c & 0xc0) == 0x80;
+}
+
+// Retorna a posição do caractere seguinte ao de `posicao`. Um caractere é
+// um byte inicial e até 3 bytes de continuação; uma continuação solta
+// (UTF-8 inválido, colado ou digitado) é um caractere sozinha, para nenhum
+// caractere passar de 4 bytes no desenho
+static size_t seguinte(const Editor *editor, size_t posicao) {
+    if (posicao >= editor->tamanho) return editor->tamanho;
+    if (continuacao((unsigned char)editor->linha[posicao])) return posicao + 1;
+    size_t fim = posicao + 1;
+    while (fim < editor->tamanho && fim - posicao < 4 &&
+           continuacao((unsigned char)editor->linha[fim])) {
+        fim++;
+    }
+    return fim;
+}
+
+// Retorna a posição do caractere anterior a `posicao` (o mesmo que
+// seguinte() percorreria para chegar a `posicao`)
+static size_t anterior(const Editor *editor, size_t posicao) {
+    if (posicao == 0) return 0;
+    for (size_t volta = 1; volta <= 4 && volta <= posicao; volta++) {
+        if (!continuacao((unsigned char)editor->linha[posicao - volta])) {
+            if (seguinte(editor, posicao - volta) == posicao) return posicao - volta;
+            break;
+        }
+    }
+    return posicao - 1; // Continuação solta
+}
+
+// Função para consultar se o byte em `posicao` separa palavras
+static int separador(const Editor *editor, size_t posicao) {
+    char c = editor->linha[posicao];
+    return c == ' ' || c == '\t' || c == '\n';
+}
+
+// Retorna o início da palavra antes de `posicao`
+static size_t palavra_anterior(const Editor *editor, size_t posicao) {
+    while (posicao > 0 && separador(editor, posicao - 1)) posicao--;
+    while (posicao > 0 && !separador(editor, posicao - 1)) posicao--;
+    return posicao;
+}
+
+// Retorna o fim da palavra depois de `posicao`
+static size_t palavra_seguinte(const Editor *editor, size_t posicao) {
+    while (posicao < editor->tamanho && separador(editor, posicao)) posicao++;
+    while (posicao < editor->tamanho && !separador(editor, posicao)) posicao++;
+    return posicao;
+}
+
+// Função para apagar os bytes de [inicio, fim)
+static void apagar(Editor *editor, size_t inicio, size_t fim) {
+    if (inicio >= fim) return;
+    memmove(editor->linha + inicio, editor->linha + fim, editor->tamanho - fim + 1);
+    editor->tamanho -= fim - inicio;
+    editor->cursor = inicio;
+    editor->alterada = 1;
+}
+
+// Função para mover o cursor
+static void mover(Editor *editor, size_t posicao) {
+    if (posicao == editor->cursor) return;
+    editor->cursor = posicao;
+    editor->alterada = 1;
+}
+
+// Função para inserir um trecho no cursor com um único memmove. Em uma
+// colagem, '\r' vira quebra de linha e os outros controles são descartados;
+// o que não couber na capacidade é descartado inteiro, sem cortar um
+// caractere ao meio.
+static void inserir(Editor *editor, const char *texto, size_t tamanho, int colagem) {
+    size_t espaco = editor->capacidade - editor->tamanho;
+    if (tamanho > espaco) {
+        tamanho = espaco;
+        while (tamanho > 0 && continuacao((unsigned char)texto[tamanho])) tamanho--;
+    }
+    if (tamanho == 0) return;
+    char *destino = editor->linha + editor->cursor;
+    memmove(destino + tamanho, destino, editor->tamanho - editor->cursor + 1);
+    size_t escritos = tamanho;
+    if (!colagem) {
+        memcpy(destino, texto, tamanho);
+    } else {
+        escritos = 0;
+        for (size_t i = 0; i < tamanho; i++) {
+            unsigned char c = (unsigned char)texto[i];
+            int era_cr = editor->depois_de_cr;
+            editor->depois_de_cr = c == '\r';
+            if (c == '\r') c = '\n';
+            else if (c == '\n' && era_cr) continue;
+            else if (c < 0x20 && c != '\t' && c != '\n') continue;
+            destino[escritos++] = (char)c;
+        }
+        if (escritos < tamanho) {
+            memmove(destino + escritos, destino + tamanho, editor->tamanho - editor->cursor + 1);
+        }
+    }
+    editor->tamanho += escritos;
+    editor->cursor += escritos;
+    editor->alterada = 1;
+}
+
+// Função para trocar o texto em edição por `texto` (linha do histórico)
+static void substituir(Editor *editor, const char *texto) {
+    size_t tamanho = strlen(texto);
+    if (tamanho > editor->capacidade) tamanho = editor->capacidade;
+    memcpy(editor->linha, texto, tamanho);
+    editor->linha[tamanho] = '\0';
+    editor->tamanho = editor->cursor = tamanho;
+    editor->deslocamento = 0;
+    editor->alterada = 1;
+}
+
+// Retorna a linha enviada `atras` posições antes da última (1 = a última)
+static const char *linha_historico(const Editor *editor, int atras) {
+    int indice = (editor->proximo_historico - atras + EDITOR_HISTORICO) % EDITOR_HISTORICO;
+    return editor->historico[indice];
+}
+
+// Função para exibir uma linha mais antiga do histórico (↑)
+static void historico_anterior(Editor *editor) {
+    if (editor->navegando >= editor->total_historico) return;
+    if (editor->navegando == 0) {
+        free(editor->rascunho);
+        editor->rascunho = strdup(editor->linha);
+        if (editor->rascunho == NULL) return;
+    }
+    editor->navegando++;
+    substituir(editor, linha_historico(editor, editor->navegando));
+}
+
+// Função para exibir uma linha mais nova do histórico, ou o rascunho (↓)
+static void historico_seguinte(Editor *editor) {
+    if (editor->navegando == 0) return;
+    editor->navegando--;
+    if (editor->navegando > 0) {
+        substituir(editor, linha_historico(editor, editor->navegando));
+    } else {
+        substituir(editor, editor->rascunho);
+        free(editor->rascunho);
+        editor->rascunho = NULL;
+    }
+}
+
+// Função para guardar no histórico a linha enviada (sem repetir a última)
+static void guardar_historico(Editor *editor) {
+    if (editor->total_historico > 0 && strcmp(linha_historico(editor, 1), editor->linha) == 0) {
+        return;
+    }
+    char *copia = strdup(editor->linha);
+    if (copia == NULL) return;
+    free(editor->historico[editor->proximo_historico]);
+    editor->historico[editor->proximo_historico] = copia;
+    editor->proximo_historico = (editor->proximo_historico + 1) % EDITOR_HISTORICO;
+    if (editor->total_historico < EDITOR_HISTORICO) editor->total_historico++;
+}
+
+// Função para entregar a linha pronta em `destino` e recomeçar vazio
+static void concluir(Editor *editor, char *destino, size_t capacidade) {
+    size_t tamanho = editor->tamanho < capacidade - 1 ? editor->tamanho : capacidade - 1;
+    memcpy(destino, editor->linha, tamanho);
+    destino[tamanho] = '\0';
+    guardar_historico(editor);
+    free(editor->rascunho);
+    editor->rascunho = NULL;
+    editor->navegando = 0;
+    editor->linha[0] = '\0';
+    editor->tamanho = editor->cursor = editor->deslocamento = 0;
+    editor->alterada = 1;
+}
+
+// Função para tratar o byte final de uma sequência ESC [ ou ESC O
+static void tratar_sequencia(Editor *editor, char final) {
+    editor->sequencia[editor->tamanho_sequencia] = '\0';
+    int numero = atoi(editor->sequencia);
+    // Ctrl (5) ou Alt (3) junto da seta: "1;5C"
+    const char *modificador = strchr(editor->sequencia, ';');
+    int palavra = modificador != NULL && (modificador[1] == '5' || modificador[1] == '3');
+    if (final == '~' && numero == 200) {
+        editor->colando = 1;
+        editor->depois_de_cr = 0;
+        return;
+    }
+    if (final == '~' && numero == 201) {
+        editor->colando = 0;
+        return;
+    }
+    if (editor->colando) return; // Nada de teclas no meio de uma colagem
+    switch (final) {
+        case 'A': historico_anterior(editor); break;
+        case 'B': historico_seguinte(editor); break;
+        case 'C':
+            mover(editor, palavra ? palavra_seguinte(editor, editor->cursor)
+                                  : seguinte(editor, editor->cursor));
+            break;
+        case 'D':
+            mover(editor, palavra ? palavra_anterior(editor, editor->cursor)
+                                  : anterior(editor, editor->cursor));
+            break;
+        case 'H': mover(editor, 0); break;
+        case 'F': mover(editor, editor->tamanho); break;
+        case '~':
+            if (numero == 1 || numero == 7) mover(editor, 0);
+            else if (numero == 4 || numero == 8) mover(editor, editor->tamanho);
+            else if (numero == 3) apagar(editor, editor->cursor, seguinte(editor, editor->cursor));
+            break;
+        default: break; // Tecla sem uso aqui
+    }
+}
+
+// Função para tratar um byte de uma sequência de escape em andamento
+// Retorna 0 se o byte não faz parte da sequência e deve ser tratado de novo
+static int tratar_escape(Editor *editor, unsigned char c) {
+    if (editor->escape == ESCAPE_INICIO) {
+        editor->escape = ESCAPE_NENHUM;
+        if (c == '[') {
+            editor->escape = ESCAPE_CSI;
+            editor->tamanho_sequencia = 0;
+        } else if (c == 'O') {
+            editor->escape = ESCAPE_SS3;
+            editor->tamanho_sequencia = 0;
+        } else if (c == ESC) {
+            editor->escape = ESCAPE_INICIO;
+        } else if (c == 'b' && !editor->colando) {
+            mover(editor, palavra_anterior(editor, editor->cursor));
+        } else if (c == 'f' && !editor->colando) {
+            mover(editor, palavra_seguinte(editor, editor->cursor));
+        } else {
+            return 0; // ESC sozinho: o byte seguinte é uma tecla comum
+        }
+        return 1;
+    }
+    if (editor->escape == ESCAPE_CSI && c >= 0x20 && c <= 0x3f) {
+        // Parâmetros e intermediários; o excesso é ignorado
+        if (editor->tamanho_sequencia < EDITOR_SEQUENCIA_MAX - 1) {
+            editor->sequencia[editor->tamanho_sequencia++] = (char)c;
+        }
+        return 1;
+    }
+    editor->escape = ESCAPE_NENHUM;
+    if (c >= 0x40 && c <= 0x7e) tratar_sequencia(editor, (char)c);
+    return 1;
+}
+
+// Função para tratar uma tecla de controle fora de uma colagem
+// Retorna 1 se foi o Enter de uma linha não vazia
+static int tratar_controle(Editor *editor, unsigned char c) {
+    switch (c) {
+        case '\r':
+        case '\n':
+            return editor->tamanho > 0;
+        case 127:
+        case CONTROLE('H'):
+            apagar(editor, anterior(editor, editor->cursor), editor->cursor);
+            break;
+        case CONTROLE('D'):
+            apagar(editor, editor->cursor, seguinte(editor, editor->cursor));
+            break;
+        case CONTROLE('W'):
+            apagar(editor, palavra_anterior(editor, editor->cursor), editor->cursor);
+            break;
+        case CONTROLE('U'):
+            apagar(editor, 0, editor->cursor);
+            break;
+        case CONTROLE('K'):
+            apagar(editor, editor->cursor, editor->tamanho);
+            break;
+        case CONTROLE('A'): mover(editor, 0); break;
+        case CONTROLE('E'): mover(editor, editor->tamanho); break;
+        case CONTROLE('B'): mover(editor, anterior(editor, editor->cursor)); break;
+        case CONTROLE('F'): mover(editor, seguinte(editor, editor->cursor)); break;
+        case CONTROLE('P'): historico_anterior(editor); break;
+        case CONTROLE('N'): historico_seguinte(editor); break;
+        case '\t': inserir(editor, "\t", 1, 0); break;
+        default: break; // Outros controles são ignorados
+    }
+    return 0;
+}
+
+// Função para tratar os bytes lidos até acabarem ou até uma linha ficar
+// pronta (Enter), que é copiada para `destino` (até `capacidade` - 1 bytes
+// e '\0'). Os bytes depois do Enter ficam para a próxima chamada.
+// Retorna 1 se uma linha ficou pronta
+int editor_processar(Editor *editor, char *destino, size_t capacidade) {
+    while (editor->inicio_entrada < editor->fim_entrada) {
+        const char *bytes = editor->entrada;
+        unsigned char c = (unsigned char)bytes[editor->inicio_entrada];
+        if (editor->escape != ESCAPE_NENHUM) {
+            if (tratar_escape(editor, c)) editor->inicio_entrada++;
+            continue;
+        }
+        if (c == ESC) {
+            editor->escape = ESCAPE_INICIO;
+            editor->inicio_entrada++;
+            continue;
+        }
+        // Um trecho de texto entra de uma vez: na colagem, tudo até o
+        // próximo ESC; digitado, até o próximo controle
+        size_t fim = editor->inicio_entrada;
+        if (editor->colando) {
+            const char *esc = memchr(bytes + fim, ESC, editor->fim_entrada - fim);
+            fim = esc != NULL ? (size_t)(esc - bytes) : editor->fim_entrada;
+        } else {
+            while (fim < editor->fim_entrada && (unsigned char)bytes[fim] >= 0x20 &&
+                   (unsigned char)bytes[fim] != 127) {
+                fim++;
+            }
+        }
+        if (fim > editor->inicio_entrada) {
+            inserir(editor, bytes + editor->inicio_entrada, fim - editor->inicio_entrada,
+                    editor->colando);
+            editor->inicio_entrada = fim;
+            continue;
+        }
+        editor->inicio_entrada++;
+        if (tratar_controle(editor, c)) {
+            concluir(editor, destino, capacidade);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Função para ajustar a rolagem horizontal para o cursor caber em uma
+// janela de `largura` colunas, andando no máximo `largura` caracteres
+static void rolar(Editor *editor, size_t largura) {
+    if (editor->cursor < editor->deslocamento) {
+        editor->deslocamento = editor->cursor;
+        return;
+    }
+    size_t posicao = editor->deslocamento, colunas = 0;
+    while (posicao < editor->cursor && colunas < largura) {
+        posicao = seguinte(editor, posicao);
+        colunas++;
+    }
+    if (colunas < largura) return;
+    // O cursor saiu pela direita: ele fica na última coluna da janela
+    posicao = editor->cursor;
+    for (size_t k = 0; k + 1 < largura && posicao > 0; k++) posicao = anterior(editor, posicao);
+    editor->deslocamento = posicao;
+}
+
+// Função para desenhar em `destino` (EDITOR_EXIBICAO_MAX bytes) a parte
+// visível do texto em `largura` colunas, seguida do recuo do cursor do
+// terminal até a posição do cursor do editor
+// Retorna o tamanho escrito (sem o '\0')
+size_t editor_exibir(Editor *editor, size_t largura, char *destino) {
+    if (largura < EDITOR_LARGURA_MIN) largura = EDITOR_LARGURA_MIN;
+    if (largura > EDITOR_LARGURA_MAX) largura = EDITOR_LARGURA_MAX;
+    rolar(editor, largura);
+    size_t escritos = 0, colunas = 0, colunas_cursor = 0;
+    size_t posicao = editor->deslocamento;
+    while (posicao < editor->tamanho && colunas < largura) {
+        unsigned char c = (unsigned char)editor->linha[posicao];
+        size_t proxima = seguinte(editor, posicao);
+        // Cada caractere ocupa no máximo 4 bytes; sobra espaço para o recuo
+        if (escritos + 4 > EDITOR_EXIBICAO_MAX - 16) break;
+        if (posicao <= editor->cursor) colunas_cursor = colunas;
+        if (c == '\n') {
+            memcpy(destino + escritos, "↵", 3);
+            escritos += 3;
+        } else if (c < 0x20) {
+            destino[escritos++] = ' ';
+        } else {
+            memcpy(destino + escritos, editor->linha + posicao, proxima - posicao);
+            escritos += proxima - posicao;
+        }
+        colunas++;
+        posicao = proxima;
+    }
+    if (editor->cursor >= posicao) colunas_cursor = colunas;
+    if (colunas > colunas_cursor) {
+        escritos += (size_t)sprintf(destino + escritos, "\033[%zuD", colunas - colunas_cursor);
+    }
+    destino[escritos] = '\0';
+    return escritos;
+}
+
+// Retorna quantas colunas ocupam os `tamanho` bytes UTF-8 de `texto`
+size_t editor_colunas(const char *texto, size_t tamanho) {
+    size_t colunas = 0;
+    for (size_t i = 0; i < tamanho; i++) colunas += !continuacao((unsigned char)texto[i]);
+    return colunas;
+}
+
+// Retorna a largura do terminal de `fd` (80 se não for um terminal)
+size_t editor_largura_terminal(int fd) {
+    struct winsize janela;
+    if (ioctl(fd, TIOCGWINSZ, &janela) < 0 || janela.ws_col == 0) return 80;
+    return janela.ws_col;
+}
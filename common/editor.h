@@ -0,0 +1,90 @@
+// ============================================================================
+// ARQUIVO: editor.h
+//
+// DESCRIÇÃO: Editor da linha de entrada do terminal, compartilhado pelo
+//            chat do cliente e pela interface do operador do servidor.
+//
+//            A cada despertar, quem usa lê de uma vez tudo o que o terminal
+//            tem (editor_ler, até EDITOR_LEITURA bytes por read()) e o
+//            editor trata os bytes em sequência (editor_processar): trechos
+//            de texto entram na linha com um único memmove, e as teclas de
+//            edição movem o cursor ou apagam. A linha só é redesenhada uma
+//            vez por rajada, e o desenho (editor_exibir) custa o tamanho da
+//            janela visível, não o do texto: o tempo de resposta a uma tecla
+//            não depende do tamanho do que foi colado.
+//
+//            Com o modo de colagem do terminal ligado (EDITOR_COLAGEM_LIGAR),
+//            o texto colado chega entre ESC [200~ e ESC [201~ e entra inteiro
+//            na linha, quebras de linha inclusive: o Enter seguinte envia
+//            tudo como uma única mensagem de várias linhas.
+//
+//            Teclas:
+//              ← → (Ctrl-B, Ctrl-F)        um caractere
+//              Ctrl-← Ctrl-→ (Alt-B, Alt-F) uma palavra
+//              Home End (Ctrl-A, Ctrl-E)   início e fim da linha
+//              ↑ ↓ (Ctrl-P, Ctrl-N)        linhas já enviadas nesta sessão
+//              Backspace, Delete (Ctrl-D)  apagam antes e sob o cursor
+//              Ctrl-W, Ctrl-U, Ctrl-K      apagam a palavra anterior, até o
+//                                          início e até o fim da linha
+//
+//            Uma linha longa rola na horizontal para caber na largura do
+//            terminal; as quebras de uma colagem aparecem como "↵". Cada
+//            caractere UTF-8 conta como uma coluna.
+// ============================================================================
+
+#ifndef EDITOR_H
+#define EDITOR_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define EDITOR_LEITURA 4096        // Bytes por read() do terminal
+#define EDITOR_HISTORICO 100       // Linhas lembradas para ↑ e ↓
+#define EDITOR_SEQUENCIA_MAX 16    // Parâmetros de uma sequência de escape
+#define EDITOR_LARGURA_MIN 8       // Colunas mínimas para o texto
+#define EDITOR_LARGURA_MAX 1024
+#define EDITOR_EXIBICAO_MAX (4 * EDITOR_LARGURA_MAX + 16) // Bytes de editor_exibir
+
+// Modo de colagem do terminal (bracketed paste)
+#define EDITOR_COLAGEM_LIGAR "\033[?2004h"
+#define EDITOR_COLAGEM_DESLIGAR "\033[?2004l"
+
+typedef struct {
+    char *linha;          // Texto em edição, terminado em '\0'
+    size_t tamanho;
+    size_t capacidade;    // Máximo de bytes do texto
+    size_t cursor;        // Em bytes, sempre no início de um caractere
+    size_t deslocamento;  // Primeiro byte visível (rolagem horizontal)
+    int alterada;         // Mudou desde o último desenho (quem usa zera)
+
+    // Linhas já enviadas, em anel; `navegando` = quantas linhas para trás
+    // está a exibida (0 = a que estava sendo digitada, guardada em `rascunho`)
+    char *historico[EDITOR_HISTORICO];
+    int total_historico;
+    int proximo_historico;
+    int navegando;
+    char *rascunho;
+
+    // Sequência de escape em andamento (pode chegar partida entre leituras)
+    int escape;
+    char sequencia[EDITOR_SEQUENCIA_MAX];
+    size_t tamanho_sequencia;
+    int colando;          // Entre ESC [200~ e ESC [201~
+    int depois_de_cr;     // Um '\n' logo depois de '\r' em uma colagem é a mesma quebra
+
+    // Bytes lidos e ainda não tratados
+    char entrada[EDITOR_LEITURA];
+    size_t inicio_entrada;
+    size_t fim_entrada;
+} Editor;
+
+int editor_iniciar(Editor *editor, size_t capacidade);
+ssize_t editor_ler(Editor *editor, int fd);
+size_t editor_pendente(const Editor *editor);
+int editor_processar(Editor *editor, char *destino, size_t capacidade);
+size_t editor_exibir(Editor *editor, size_t largura, char *destino);
+size_t editor_colunas(const char *texto, size_t tamanho);
+size_t editor_largura_terminal(int fd);
+void editor_liberar(Editor *editor);
+
+#endif
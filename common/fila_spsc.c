@@ -0,0 +1,115 @@
+// ============================================================================
+// ARQUIVO: fila_spsc.c
+//
+// DESCRIÇÃO: Implementação da fila SPSC sem travas (ver fila_spsc.h).
+//
+//            `cauda` só é escrita pelo produtor e `cabeca` só pelo
+//            consumidor. Cada lado guarda uma cópia local do índice do outro
+//            e só relê o atômico quando a cópia indica fila cheia/vazia,
+//            evitando tráfego de cache a cada operação.
+// ============================================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#include "fila_spsc.h"
+
+// Função para inicializar a fila; a capacidade é arredondada para potência de 2
+int fila_spsc_iniciar(FilaSPSC *fila, size_t capacidade, size_t tamanho_elemento,
+                      PoliticaTransbordo politica) {
+    size_t potencia = 2;
+    while (potencia < capacidade) potencia <<= 1;
+
+    memset(fila, 0, sizeof(*fila));
+    fila->slots = calloc(potencia, tamanho_elemento);
+    if (fila->slots == NULL) return -1;
+    fila->mascara = potencia - 1;
+    fila->tamanho_elemento = tamanho_elemento;
+    fila->politica = politica;
+    atomic_init(&fila->cauda, 0);
+    atomic_init(&fila->cabeca, 0);
+    atomic_init(&fila->descartados, 0);
+    atomic_init(&fila->marca_maxima, 0);
+    return 0;
+}
+
+// Função para liberar os slots da fila (os elementos não são liberados)
+void fila_spsc_liberar(FilaSPSC *fila) {
+    free(fila->slots);
+    fila->slots = NULL;
+}
+
+// Função para inserir um elemento (somente a thread produtora)
+// Retorna 1 se inseriu e 0 se o elemento foi descartado por falta de espaço
+int fila_spsc_inserir(FilaSPSC *fila, const void *elemento) {
+    size_t cauda = atomic_load_explicit(&fila->cauda, memory_order_relaxed);
+
+    if (cauda - fila->cabeca_cache > fila->mascara) {
+        fila->cabeca_cache = atomic_load_explicit(&fila->cabeca, memory_order_acquire);
+        while (cauda - fila->cabeca_cache > fila->mascara) {
+            if (fila->politica == FILA_DESCARTAR_NOVA) {
+                atomic_store_explicit(&fila->descartados,
+                    atomic_load_explicit(&fila->descartados, memory_order_relaxed) + 1,
+                    memory_order_relaxed);
+                return 0;
+            }
+            sched_yield();
+            fila->cabeca_cache = atomic_load_explicit(&fila->cabeca, memory_order_acquire);
+        }
+    }
+
+    memcpy(fila->slots + (cauda & fila->mascara) * fila->tamanho_elemento,
+           elemento, fila->tamanho_elemento);
+    atomic_store_explicit(&fila->cauda, cauda + 1, memory_order_release);
+
+    // Atualiza o pico de ocupação; só relê a cabeça quando o pico pode ter subido
+    size_t ocupacao = cauda + 1 - fila->cabeca_cache;
+    if (ocupacao > atomic_load_explicit(&fila->marca_maxima, memory_order_relaxed)) {
+        fila->cabeca_cache = atomic_load_explicit(&fila->cabeca, memory_order_acquire);
+        ocupacao = cauda + 1 - fila->cabeca_cache;
+        if (ocupacao > atomic_load_explicit(&fila->marca_maxima, memory_order_relaxed)) {
+            atomic_store_explicit(&fila->marca_maxima, ocupacao, memory_order_relaxed);
+        }
+    }
+    return 1;
+}
+
+// Função para remover o elemento mais antigo (somente a thread consumidora)
+// Retorna 1 se removeu e 0 se a fila estava vazia
+int fila_spsc_remover(FilaSPSC *fila, void *elemento) {
+    size_t cabeca = atomic_load_explicit(&fila->cabeca, memory_order_relaxed);
+
+    if (cabeca == fila->cauda_cache) {
+        fila->cauda_cache = atomic_load_explicit(&fila->cauda, memory_order_acquire);
+        if (cabeca == fila->cauda_cache) return 0;
+    }
+
+    memcpy(elemento, fila->slots + (cabeca & fila->mascara) * fila->tamanho_elemento,
+           fila->tamanho_elemento);
+    atomic_store_explicit(&fila->cabeca, cabeca + 1, memory_order_release);
+    return 1;
+}
+
+// Função para consultar a ocupação atual (aproximada se lida por terceiros)
+size_t fila_spsc_ocupacao(FilaSPSC *fila) {
+    // A cabeça é lida primeiro para que nunca ultrapasse a cauda lida depois
+    size_t cabeca = atomic_load_explicit(&fila->cabeca, memory_order_acquire);
+    size_t cauda = atomic_load_explicit(&fila->cauda, memory_order_acquire);
+    return cauda - cabeca;
+}
+
+// Função para consultar a capacidade da fila
+size_t fila_spsc_capacidade(const FilaSPSC *fila) {
+    return fila->mascara + 1;
+}
+
+// Função para consultar quantos elementos foram descartados por transbordo
+uint64_t fila_spsc_descartados(FilaSPSC *fila) {
+    return atomic_load_explicit(&fila->descartados, memory_order_relaxed);
+}
+
+// Função para consultar o pico de ocupação observado pelo produtor
+size_t fila_spsc_marca_maxima(FilaSPSC *fila) {
+    return atomic_load_explicit(&fila->marca_maxima, memory_order_relaxed);
+}
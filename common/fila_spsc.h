@@ -0,0 +1,60 @@
+// ============================================================================
+// ARQUIVO: fila_spsc.h
+//
+// DESCRIÇÃO: Fila circular limitada, sem travas, para exatamente um
+//            produtor e um consumidor (SPSC). Os elementos têm tamanho fixo
+//            escolhido na inicialização e são copiados por valor, então a
+//            fila guarda descritores pequenos (ponteiro + tamanho) e nunca
+//            aloca memória depois de iniciada.
+//
+//            Política de transbordo (quando a fila está cheia):
+//              FILA_DESCARTAR_NOVA - o elemento novo é recusado e contado
+//                                    em `descartados`; quem insere decide o
+//                                    que fazer com ele (ex.: liberar).
+//              FILA_AGUARDAR       - o produtor cede a CPU até o consumidor
+//                                    abrir espaço (nada se perde).
+// ============================================================================
+
+#ifndef FILA_SPSC_H
+#define FILA_SPSC_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FILA_LINHA_CACHE 64
+
+typedef enum {
+    FILA_DESCARTAR_NOVA = 0,
+    FILA_AGUARDAR = 1
+} PoliticaTransbordo;
+
+typedef struct {
+    // Lado do produtor
+    _Alignas(FILA_LINHA_CACHE) _Atomic size_t cauda;
+    size_t cabeca_cache;
+    _Atomic uint64_t descartados;
+    _Atomic size_t marca_maxima;
+
+    // Lado do consumidor
+    _Alignas(FILA_LINHA_CACHE) _Atomic size_t cabeca;
+    size_t cauda_cache;
+
+    // Somente leitura após a inicialização
+    _Alignas(FILA_LINHA_CACHE) size_t mascara;
+    size_t tamanho_elemento;
+    PoliticaTransbordo politica;
+    unsigned char *slots;
+} FilaSPSC;
+
+int fila_spsc_iniciar(FilaSPSC *fila, size_t capacidade, size_t tamanho_elemento,
+                      PoliticaTransbordo politica);
+void fila_spsc_liberar(FilaSPSC *fila);
+int fila_spsc_inserir(FilaSPSC *fila, const void *elemento);
+int fila_spsc_remover(FilaSPSC *fila, void *elemento);
+size_t fila_spsc_ocupacao(FilaSPSC *fila);
+size_t fila_spsc_capacidade(const FilaSPSC *fila);
+uint64_t fila_spsc_descartados(FilaSPSC *fila);
+size_t fila_spsc_marca_maxima(FilaSPSC *fila);
+
+#endif
@@ -0,0 +1,442 @@
+// ============================================================================
+// ARQUIVO: metricas.c
+//
+// DESCRIÇÃO: Implementação do registro de métricas (ver metricas.h).
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "metricas.h"
+
+#define METRICAS_PEDIDO_MAX 1024     // Bytes lidos do pedido de quem consulta
+#define METRICAS_ESPERA_PEDIDO_MS 100 // Quem conecta e não pede nada recebe o texto puro
+
+// Bloco de métricas de uma thread; só ela grava, qualquer thread lê
+typedef struct BlocoMetricas {
+    _Atomic uint64_t contadores[METRICA_CONTADORES];
+    _Atomic int64_t medidores[METRICA_MEDIDORES];
+    struct {
+        _Atomic uint64_t baldes[METRICAS_BALDES];
+        _Atomic uint64_t soma;
+        _Atomic uint64_t maximo;
+    } histogramas[METRICA_HISTOGRAMAS];
+    struct BlocoMetricas *proximo;
+} BlocoMetricas;
+
+// Nome (no Prometheus, sem o prefixo), descrição e rótulo do /stats
+typedef struct {
+    const char *nome;
+    const char *descricao;
+    const char *rotulo;
+} DescricaoMetrica;
+
+static const DescricaoMetrica descricoes_contadores[METRICA_CONTADORES] = {
+    { "bytes_recebidos_total", "Bytes lidos dos sockets", "Bytes recebidos" },
+    { "bytes_enviados_total", "Bytes escritos nos sockets", "Bytes enviados" },
+    { "quadros_recebidos_total", "Quadros completos recebidos", "Quadros recebidos" },
+    { "quadros_enviados_total", "Quadros colocados na saída", "Quadros enviados" },
+    { "erros_envio_total", "Envios que falharam e derrubaram a conexão", "Erros de envio" },
+    { "pings_enviados_total", "Pings mandados a conexões caladas", "Pings enviados" },
+    { "conexoes_expiradas_total", "Conexões derrubadas sem resposta ao ping ou por ociosidade",
+      "Conexões expiradas" },
+    { "sessoes_retomadas_total", "Conexões que caíram e retomaram a mesma sessão",
+      "Sessões retomadas" },
+    { "quadros_descartados_total", "Quadros tirados de filas de saída cheias",
+      "Quadros descartados" },
+    { "conexoes_lentas_total", "Conexões derrubadas com a fila de saída no limite",
+      "Conexões lentas derrubadas" },
+    { "leituras_pausadas_total", "Leituras paradas por uma fila de saída acima da marca alta",
+      "Leituras pausadas" },
+    { "slab_recargas_total", "Lotes de blocos trocados entre o cache de uma thread e o depósito",
+      "Recargas do slab" },
+    { "slab_fora_das_classes_total", "Alocações maiores que a maior classe do slab",
+      "Alocações fora do slab" },
+    { "mensagens_privadas_total", "Mensagens privadas (/msg) encaminhadas ao destino",
+      "Mensagens privadas" },
+    { "federacao_enviados_total", "Registros colocados na saída das ligações com outros nós",
+      "Federação: registros enviados" },
+    { "federacao_recebidos_total", "Registros recebidos de outros nós",
+      "Federação: registros recebidos" },
+    { "federacao_duplicados_total", "Cópias de registros que chegaram por outro caminho",
+      "Federação: cópias descartadas" },
+    { "federacao_descartados_total", "Registros perdidos em filas cheias ou ligações lentas",
+      "Federação: registros perdidos" }
+};
+
+static const DescricaoMetrica descricoes_medidores[METRICA_MEDIDORES] = {
+    { "fila_saida_bytes", "Bytes esperando para sair pelo socket", "Fila de saída (bytes)" },
+    { "fila_exibicao_mensagens", "Mensagens esperando a interface", "Fila de exibição (mensagens)" },
+    { "slab_reservado_bytes", "Bytes reservados pelo alocador de blocos", "Slab reservado (bytes)" },
+    { "slab_em_uso_bytes", "Bytes de blocos em uso", "Slab em uso (bytes)" },
+    { "nicknames", "Nicknames registrados no servidor", "Nicknames registrados" }
+};
+
+// Os baldes do Prometheus são as potências de dois entre `primeira` e
+// `ultima`; `escala` converte a unidade gravada para a exportada
+static const struct {
+    DescricaoMetrica descricao;
+    double escala;
+    int tempo; // Valores em nanossegundos
+    int primeira;
+    int ultima;
+} descricoes_histogramas[METRICA_HISTOGRAMAS] = {
+    { { "recepcao_exibicao_segundos", "Da chegada de uma mensagem até ela ir para a tela",
+        "Recepção → exibição" }, 1e-9, 1, 10, 34 },
+    { { "entrada_envio_segundos", "Do Enter até a mensagem ser entregue para envio",
+        "Entrada → envio" }, 1e-9, 1, 10, 34 },
+    { { "tamanho_recv_bytes", "Bytes devolvidos por cada recv()", "Tamanho do recv" },
+      1.0, 0, 0, 17 },
+    { { "tecla_tela_segundos", "Da leitura do teclado até a linha de entrada redesenhada",
+        "Tecla → tela" }, 1e-9, 1, 10, 34 }
+};
+
+static _Atomic(BlocoMetricas *) blocos = NULL; // Lista de todos os blocos
+static _Thread_local BlocoMetricas *bloco_local = NULL;
+
+// Endpoint
+static int servidor_fd = -1;
+static pthread_t thread_servidor;
+static char caminho_servidor[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static const char *prefixo_servidor = "";
+
+// Função para obter o bloco da thread atual, criando-o na primeira gravação.
+// O bloco entra na lista com um compare-and-swap e nunca sai: as métricas
+// de threads que terminaram continuam somadas.
+static BlocoMetricas *bloco_atual() {
+    if (bloco_local != NULL) return bloco_local;
+    BlocoMetricas *bloco = calloc(1, sizeof(BlocoMetricas));
+    if (bloco == NULL) return NULL;
+    BlocoMetricas *cabeca = atomic_load_explicit(&blocos, memory_order_relaxed);
+    do {
+        bloco->proximo = cabeca;
+    } while (!atomic_compare_exchange_weak_explicit(&blocos, &cabeca, bloco,
+                                                    memory_order_release, memory_order_relaxed));
+    bloco_local = bloco;
+    return bloco;
+}
+
+// Função para somar a um campo que só a thread atual grava
+static void somar_campo(_Atomic uint64_t *campo, uint64_t valor) {
+    atomic_store_explicit(campo, atomic_load_explicit(campo, memory_order_relaxed) + valor,
+                          memory_order_relaxed);
+}
+
+// Função para calcular o balde de um valor: os menores que
+// METRICAS_SUBBALDES têm um balde cada; acima disso, o expoente escolhe a
+// potência de dois e os bits seguintes, o balde dentro dela
+static int indice_balde(uint64_t valor) {
+    if (valor < METRICAS_SUBBALDES) return (int)valor;
+    int expoente = 63 - __builtin_clzll(valor);
+    return (expoente - 2) * METRICAS_SUBBALDES +
+           (int)((valor >> (expoente - 3)) & (METRICAS_SUBBALDES - 1));
+}
+
+// Função para calcular o menor valor de um balde e a largura dele
+static uint64_t inicio_balde(int indice, uint64_t *largura) {
+    if (indice < METRICAS_SUBBALDES) {
+        *largura = 1;
+        return (uint64_t)indice;
+    }
+    int expoente = indice / METRICAS_SUBBALDES + 2;
+    *largura = UINT64_C(1) << (expoente - 3);
+    return (uint64_t)(METRICAS_SUBBALDES + indice % METRICAS_SUBBALDES) << (expoente - 3);
+}
+
+// Função para somar `valor` a um contador
+void metricas_somar(Contador contador, uint64_t valor) {
+    BlocoMetricas *bloco = bloco_atual();
+    if (bloco == NULL) return;
+    somar_campo(&bloco->contadores[contador], valor);
+}
+
+// Função para somar uma variação (positiva ou negativa) a um medidor
+void metricas_ajustar(Medidor medidor, int64_t variacao) {
+    BlocoMetricas *bloco = bloco_atual();
+    if (bloco == NULL) return;
+    _Atomic int64_t *campo = &bloco->medidores[medidor];
+    atomic_store_explicit(campo, atomic_load_explicit(campo, memory_order_relaxed) + variacao,
+                          memory_order_relaxed);
+}
+
+// Função para registrar uma amostra em um histograma
+void metricas_registrar(Histograma histograma, uint64_t valor) {
+    BlocoMetricas *bloco = bloco_atual();
+    if (bloco == NULL) return;
+    somar_campo(&bloco->histogramas[histograma].baldes[indice_balde(valor)], 1);
+    somar_campo(&bloco->histogramas[histograma].soma, valor);
+    if (valor > atomic_load_explicit(&bloco->histogramas[histograma].maximo, memory_order_relaxed)) {
+        atomic_store_explicit(&bloco->histogramas[histograma].maximo, valor, memory_order_relaxed);
+    }
+}
+
+// Função para obter o relógio monotônico em nanossegundos, para medir
+// latências com metricas_registrar()
+uint64_t metricas_agora() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000ull + (uint64_t)t.tv_nsec;
+}
+
+// Função para somar os blocos de todas as threads em `metricas`
+void metricas_coletar(Metricas *metricas) {
+    memset(metricas, 0, sizeof(*metricas));
+    BlocoMetricas *bloco = atomic_load_explicit(&blocos, memory_order_acquire);
+    for (; bloco != NULL; bloco = bloco->proximo) {
+        for (int c = 0; c < METRICA_CONTADORES; c++) {
+            metricas->contadores[c] +=
+                atomic_load_explicit(&bloco->contadores[c], memory_order_relaxed);
+        }
+        for (int m = 0; m < METRICA_MEDIDORES; m++) {
+            metricas->medidores[m] +=
+                atomic_load_explicit(&bloco->medidores[m], memory_order_relaxed);
+        }
+        for (int h = 0; h < METRICA_HISTOGRAMAS; h++) {
+            ResumoHistograma *resumo = &metricas->histogramas[h];
+            for (int i = 0; i < METRICAS_BALDES; i++) {
+                uint64_t n = atomic_load_explicit(&bloco->histogramas[h].baldes[i],
+                                                  memory_order_relaxed);
+                resumo->baldes[i] += n;
+                resumo->total += n;
+            }
+            resumo->soma += atomic_load_explicit(&bloco->histogramas[h].soma, memory_order_relaxed);
+            uint64_t maximo = atomic_load_explicit(&bloco->histogramas[h].maximo,
+                                                   memory_order_relaxed);
+            if (maximo > resumo->maximo) resumo->maximo = maximo;
+        }
+    }
+}
+
+// Função para estimar o valor abaixo do qual fica a fração `fracao` das
+// amostras (ex.: 0.99). Devolve o meio do balde, limitado ao máximo visto.
+uint64_t metricas_percentil(const ResumoHistograma *histograma, double fracao) {
+    if (histograma->total == 0) return 0;
+    double posicao = fracao * (double)histograma->total;
+    uint64_t alvo = (uint64_t)posicao;
+    if ((double)alvo < posicao || alvo == 0) alvo++;
+    uint64_t acumulado = 0;
+    for (int i = 0; i < METRICAS_BALDES; i++) {
+        acumulado += histograma->baldes[i];
+        if (acumulado >= alvo) {
+            uint64_t largura;
+            uint64_t valor = inicio_balde(i, &largura) + largura / 2;
+            return valor < histograma->maximo ? valor : histograma->maximo;
+        }
+    }
+    return histograma->maximo;
+}
+
+// Função para escrever um valor de histograma com a unidade adequada
+static void escrever_valor(FILE *saida, uint64_t valor, int tempo) {
+    if (!tempo) {
+        fprintf(saida, "%llu B", (unsigned long long)valor);
+    } else if (valor < 1000) {
+        fprintf(saida, "%lluns", (unsigned long long)valor);
+    } else if (valor < 1000000) {
+        fprintf(saida, "%.1fµs", (double)valor / 1e3);
+    } else if (valor < 1000000000) {
+        fprintf(saida, "%.1fms", (double)valor / 1e6);
+    } else {
+        fprintf(saida, "%.2fs", (double)valor / 1e9);
+    }
+}
+
+// Função para escrever o resumo das métricas, uma por linha, no estilo das
+// telas de status (/stats)
+void metricas_relatorio(FILE *saida) {
+    static Metricas metricas; // Grande demais para a pilha; só a interface chama
+    metricas_coletar(&metricas);
+    for (int c = 0; c < METRICA_CONTADORES; c++) {
+        fprintf(saida, "\033[32m✓ %s: %llu\033[0m\n", descricoes_contadores[c].rotulo,
+                (unsigned long long)metricas.contadores[c]);
+    }
+    for (int m = 0; m < METRICA_MEDIDORES; m++) {
+        fprintf(saida, "\033[32m✓ %s: %lld\033[0m\n", descricoes_medidores[m].rotulo,
+                (long long)metricas.medidores[m]);
+    }
+    static const double fracoes[] = { 0.5, 0.9, 0.99, 0.999 };
+    static const char *nomes_fracoes[] = { "p50", "p90", "p99", "p99.9" };
+    for (int h = 0; h < METRICA_HISTOGRAMAS; h++) {
+        const ResumoHistograma *resumo = &metricas.histogramas[h];
+        int tempo = descricoes_histogramas[h].tempo;
+        fprintf(saida, "\033[32m✓ %s: %llu amostras", descricoes_histogramas[h].descricao.rotulo,
+                (unsigned long long)resumo->total);
+        if (resumo->total > 0) {
+            for (size_t f = 0; f < sizeof(fracoes) / sizeof(fracoes[0]); f++) {
+                fprintf(saida, ", %s ", nomes_fracoes[f]);
+                escrever_valor(saida, metricas_percentil(resumo, fracoes[f]), tempo);
+            }
+            fprintf(saida, ", máx ");
+            escrever_valor(saida, resumo->maximo, tempo);
+        }
+        fprintf(saida, "\033[0m\n");
+    }
+}
+
+// Função para escrever os comentários HELP e TYPE de uma métrica
+static void escrever_cabecalho(FILE *saida, const char *prefixo, const DescricaoMetrica *d,
+                               const char *tipo) {
+    fprintf(saida, "# HELP %s%s %s\n# TYPE %s%s %s\n", prefixo, d->nome, d->descricao,
+            prefixo, d->nome, tipo);
+}
+
+// Função para escrever todas as métricas no formato de texto do Prometheus.
+// Cada balde `le` conta os valores menores que a potência de dois, ou seja,
+// até 2^k - 1 na unidade gravada.
+void metricas_prometheus(FILE *saida, const char *prefixo) {
+    static Metricas metricas; // Só a thread do endpoint chama
+    metricas_coletar(&metricas);
+    for (int c = 0; c < METRICA_CONTADORES; c++) {
+        escrever_cabecalho(saida, prefixo, &descricoes_contadores[c], "counter");
+        fprintf(saida, "%s%s %llu\n", prefixo, descricoes_contadores[c].nome,
+                (unsigned long long)metricas.contadores[c]);
+    }
+    for (int m = 0; m < METRICA_MEDIDORES; m++) {
+        escrever_cabecalho(saida, prefixo, &descricoes_medidores[m], "gauge");
+        fprintf(saida, "%s%s %lld\n", prefixo, descricoes_medidores[m].nome,
+                (long long)metricas.medidores[m]);
+    }
+    for (int h = 0; h < METRICA_HISTOGRAMAS; h++) {
+        const ResumoHistograma *resumo = &metricas.histogramas[h];
+        const char *nome = descricoes_histogramas[h].descricao.nome;
+        double escala = descricoes_histogramas[h].escala;
+        escrever_cabecalho(saida, prefixo, &descricoes_histogramas[h].descricao, "histogram");
+        uint64_t acumulado = 0;
+        int proximo = 0; // Primeiro balde ainda não somado
+        for (int k = descricoes_histogramas[h].primeira; k <= descricoes_histogramas[h].ultima; k++) {
+            int limite = indice_balde(UINT64_C(1) << k);
+            for (; proximo < limite; proximo++) acumulado += resumo->baldes[proximo];
+            fprintf(saida, "%s%s_bucket{le=\"%.9g\"} %llu\n", prefixo, nome,
+                    (double)((UINT64_C(1) << k) - 1) * escala, (unsigned long long)acumulado);
+        }
+        fprintf(saida, "%s%s_bucket{le=\"+Inf\"} %llu\n", prefixo, nome,
+                (unsigned long long)resumo->total);
+        fprintf(saida, "%s%s_sum %.9g\n", prefixo, nome, (double)resumo->soma * escala);
+        fprintf(saida, "%s%s_count %llu\n", prefixo, nome, (unsigned long long)resumo->total);
+    }
+}
+
+// Função para enviar `tamanho` bytes inteiros a quem consultou
+static void enviar_tudo(int fd, const char *dados, size_t tamanho) {
+    while (tamanho > 0) {
+        ssize_t n = send(fd, dados, tamanho, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        dados += n;
+        tamanho -= (size_t)n;
+    }
+}
+
+// Função para atender uma consulta ao endpoint. Um pedido HTTP é lido até
+// o fim do cabeçalho (fechar com bytes não lidos derrubaria a resposta);
+// quem não pede nada em METRICAS_ESPERA_PEDIDO_MS recebe só o texto.
+static void responder(int cliente) {
+    char pedido[METRICAS_PEDIDO_MAX + 1];
+    size_t lidos = 0;
+    struct pollfd evento = { cliente, POLLIN, 0 };
+    while (lidos < METRICAS_PEDIDO_MAX && poll(&evento, 1, METRICAS_ESPERA_PEDIDO_MS) > 0) {
+        ssize_t n = recv(cliente, pedido + lidos, METRICAS_PEDIDO_MAX - lidos, 0);
+        if (n <= 0) break;
+        lidos += (size_t)n;
+        pedido[lidos] = '\0';
+        if (lidos >= 4 && strncmp(pedido, "GET ", 4) != 0) break;
+        if (strstr(pedido, "\r\n\r\n") != NULL || strstr(pedido, "\n\n") != NULL) break;
+    }
+    int http = lidos >= 4 && strncmp(pedido, "GET ", 4) == 0;
+
+    char *texto = NULL;
+    size_t tamanho = 0;
+    FILE *corpo = open_memstream(&texto, &tamanho);
+    if (corpo == NULL) return;
+    metricas_prometheus(corpo, prefixo_servidor);
+    fclose(corpo);
+
+    if (http) {
+        char cabecalho[160];
+        int n = snprintf(cabecalho, sizeof(cabecalho),
+                         "HTTP/1.0 200 OK\r\n"
+                         "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                         "Content-Length: %zu\r\n"
+                         "Connection: close\r\n\r\n", tamanho);
+        enviar_tudo(cliente, cabecalho, (size_t)n);
+    }
+    enviar_tudo(cliente, texto, tamanho);
+    free(texto);
+}
+
+// Função executada pela thread do endpoint: atende uma consulta por vez
+// até metricas_parar() desligar o socket
+static void *atender_consultas(void *arg) {
+    (void)arg;
+    while (1) {
+        int cliente = accept4(servidor_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (cliente < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        // Quem consulta e não lê a resposta não segura o endpoint
+        struct timeval limite = { 1, 0 };
+        setsockopt(cliente, SOL_SOCKET, SO_SNDTIMEO, &limite, sizeof(limite));
+        responder(cliente);
+        close(cliente);
+    }
+    return NULL;
+}
+
+// Função para abrir o endpoint em um socket UNIX no `caminho` (um arquivo
+// antigo com o mesmo nome é substituído). As métricas saem com `prefixo`
+// na frente do nome. Retorna -1 em erro
+int metricas_servir(const char *caminho, const char *prefixo) {
+    struct sockaddr_un endereco;
+    memset(&endereco, 0, sizeof(endereco));
+    endereco.sun_family = AF_UNIX;
+    if (strlen(caminho) >= sizeof(endereco.sun_path)) {
+        fprintf(stderr, "[ERRO] Caminho do socket de métricas longo demais: %s\n", caminho);
+        return -1;
+    }
+    strcpy(endereco.sun_path, caminho);
+
+    servidor_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (servidor_fd < 0) {
+        perror("[ERRO] Não foi possível criar o socket de métricas");
+        return -1;
+    }
+    unlink(caminho);
+    if (bind(servidor_fd, (struct sockaddr *)&endereco, sizeof(endereco)) < 0 ||
+        listen(servidor_fd, 16) < 0) {
+        perror("[ERRO] Não foi possível abrir o socket de métricas");
+        close(servidor_fd);
+        servidor_fd = -1;
+        return -1;
+    }
+    strcpy(caminho_servidor, caminho);
+    prefixo_servidor = prefixo;
+    if (pthread_create(&thread_servidor, NULL, atender_consultas, NULL) != 0) {
+        perror("[ERRO] Não foi possível criar a thread de métricas");
+        close(servidor_fd);
+        servidor_fd = -1;
+        unlink(caminho);
+        return -1;
+    }
+    return 0;
+}
+
+// Função para fechar o endpoint, se estiver aberto, e apagar o socket.
+// O shutdown() acorda o accept() da thread do endpoint.
+void metricas_parar() {
+    if (servidor_fd < 0) return;
+    shutdown(servidor_fd, SHUT_RDWR);
+    pthread_join(thread_servidor, NULL);
+    close(servidor_fd);
+    servidor_fd = -1;
+    unlink(caminho_servidor);
+}
@@ -0,0 +1,111 @@
+// ============================================================================
+// ARQUIVO: metricas.h
+//
+// DESCRIÇÃO: Registro de métricas do caminho quente, usado pelo cliente e
+//            pelo servidor: contadores, medidores e histogramas de latência.
+//
+//            Cada thread grava no próprio bloco de métricas (criado na
+//            primeira gravação e ligado a uma lista global sem travas), com
+//            um load + store atômico relaxado: não há travas nem instruções
+//            com prefixo lock no caminho quente, então a coleta fica sempre
+//            ligada. Quem lê (/stats ou o endpoint) soma os blocos de todas
+//            as threads; uma leitura pode ver uma gravação pela metade entre
+//            dois campos, mas nunca um valor rasgado.
+//
+//            Os medidores são somas de variações: cada thread soma o que
+//            entra e subtrai o que sai, e o total de todas as threads é o
+//            valor atual (ex.: a thread de rede incrementa a fila de exibição
+//            e a interface decrementa).
+//
+//            Os histogramas são log-lineares, no estilo HDR: cada potência
+//            de dois é dividida em METRICAS_SUBBALDES baldes iguais, o que dá
+//            erro relativo de no máximo 1/METRICAS_SUBBALDES em qualquer
+//            escala, de nanossegundos a minutos, com memória fixa.
+//
+//            metricas_servir() abre um socket UNIX que responde com todas as
+//            métricas no formato de texto do Prometheus (com cabeçalhos HTTP
+//            se o pedido começar com "GET", como o do curl --unix-socket).
+// ============================================================================
+
+#ifndef METRICAS_H
+#define METRICAS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define METRICAS_SUBBALDES 8 // Baldes por potência de dois
+#define METRICAS_BALDES (62 * METRICAS_SUBBALDES) // Cobre todo o uint64_t
+
+// Contadores (só crescem)
+typedef enum {
+    METRICA_BYTES_RECEBIDOS = 0,
+    METRICA_BYTES_ENVIADOS,
+    METRICA_QUADROS_RECEBIDOS,
+    METRICA_QUADROS_ENVIADOS,
+    METRICA_ERROS_ENVIO,
+    METRICA_PINGS_ENVIADOS,
+    METRICA_CONEXOES_EXPIRADAS, // Derrubadas sem PONG ou por ociosidade
+    METRICA_SESSOES_RETOMADAS,  // Conexões que caíram e voltaram à mesma sessão
+    METRICA_QUADROS_DESCARTADOS, // Tirados de filas de saída cheias (política de lentos)
+    METRICA_CONEXOES_LENTAS,     // Derrubadas com a fila de saída no limite
+    METRICA_LEITURAS_PAUSADAS,   // Leituras paradas pela marca alta de uma fila de saída
+    METRICA_SLAB_RECARGAS,       // Lotes trocados entre o cache de uma thread e o depósito
+    METRICA_SLAB_FORA,           // Alocações maiores que a maior classe (malloc)
+    METRICA_MENSAGENS_PRIVADAS,  // Mensagens de /msg encaminhadas ao destino
+    METRICA_FEDERACAO_ENVIADOS,  // Registros colocados na saída das ligações entre nós
+    METRICA_FEDERACAO_RECEBIDOS, // Registros recebidos de outros nós
+    METRICA_FEDERACAO_DUPLICADOS, // Cópias que chegaram por outro caminho (descartadas)
+    METRICA_FEDERACAO_DESCARTADOS, // Perdidos em filas cheias ou ligações lentas
+    METRICA_CONTADORES
+} Contador;
+
+// Medidores (sobem e descem)
+typedef enum {
+    MEDIDOR_FILA_SAIDA = 0, // Bytes esperando para sair pelo socket
+    MEDIDOR_FILA_EXIBICAO,  // Mensagens esperando a interface
+    MEDIDOR_SLAB_RESERVADO, // Bytes pedidos ao malloc pelo alocador de blocos
+    MEDIDOR_SLAB_EM_USO,    // Bytes desses blocos entregues e ainda não liberados
+    MEDIDOR_NICKNAMES,      // Nicknames no registro do servidor
+    METRICA_MEDIDORES
+} Medidor;
+
+// Histogramas
+typedef enum {
+    HISTOGRAMA_RECEPCAO_EXIBICAO = 0, // ns da chegada à tela
+    HISTOGRAMA_ENTRADA_ENVIO,         // ns do Enter até o envio
+    HISTOGRAMA_TAMANHO_RECV,          // Bytes devolvidos por recv()
+    HISTOGRAMA_TECLA_TELA,            // ns da leitura do teclado à linha redesenhada
+    METRICA_HISTOGRAMAS
+} Histograma;
+
+// Soma das métricas de todas as threads em um instante
+typedef struct {
+    uint64_t baldes[METRICAS_BALDES];
+    uint64_t total;
+    uint64_t soma;
+    uint64_t maximo;
+} ResumoHistograma;
+
+typedef struct {
+    uint64_t contadores[METRICA_CONTADORES];
+    int64_t medidores[METRICA_MEDIDORES];
+    ResumoHistograma histogramas[METRICA_HISTOGRAMAS];
+} Metricas;
+
+// Gravação (caminho quente, só afeta o bloco da thread que chama)
+void metricas_somar(Contador contador, uint64_t valor);
+void metricas_ajustar(Medidor medidor, int64_t variacao);
+void metricas_registrar(Histograma histograma, uint64_t valor);
+uint64_t metricas_agora(void);
+
+// Leitura
+void metricas_coletar(Metricas *metricas);
+uint64_t metricas_percentil(const ResumoHistograma *histograma, double fracao);
+void metricas_relatorio(FILE *saida);
+void metricas_prometheus(FILE *saida, const char *prefixo);
+
+// Endpoint local (socket UNIX)
+int metricas_servir(const char *caminho, const char *prefixo);
+void metricas_parar(void);
+
+#endif
@@ -0,0 +1,380 @@
+// ============================================================================
+// ARQUIVO: protocolo.c
+//
+// DESCRIÇÃO: Implementação do protocolo de quadros (ver protocolo.h).
+// ============================================================================
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "protocolo.h"
+
+#define LEITOR_CAPACIDADE_INICIAL 4096
+#define LEITOR_CAPACIDADE_MAXIMA (PROTOCOLO_CABECALHO + PROTOCOLO_PAYLOAD_MAX)
+
+// Função para ler um inteiro de 32 bits em ordem de rede
+static uint32_t ler_u32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Função para escrever o cabeçalho de um quadro
+static void escrever_cabecalho(uint8_t *destino, uint8_t tipo, uint16_t flags, uint32_t tamanho) {
+    destino[0] = PROTOCOLO_VERSAO;
+    destino[1] = tipo;
+    destino[2] = (uint8_t)(flags >> 8);
+    destino[3] = (uint8_t)flags;
+    destino[4] = (uint8_t)(tamanho >> 24);
+    destino[5] = (uint8_t)(tamanho >> 16);
+    destino[6] = (uint8_t)(tamanho >> 8);
+    destino[7] = (uint8_t)tamanho;
+}
+
+// Função para inicializar um leitor vazio (o buffer é alocado sob demanda)
+int leitor_iniciar(LeitorQuadros *leitor) {
+    memset(leitor, 0, sizeof(*leitor));
+    return 0;
+}
+
+// Função para liberar o buffer do leitor
+void leitor_liberar(LeitorQuadros *leitor) {
+    free(leitor->buffer);
+    memset(leitor, 0, sizeof(*leitor));
+}
+
+// Função para obter a região onde o próximo recv() deve escrever.
+// Compacta e cresce o buffer apenas o necessário para o quadro pendente.
+// Ponteiros de quadros devolvidos antes desta chamada deixam de valer.
+uint8_t *leitor_espaco(LeitorQuadros *leitor, size_t *livre) {
+    size_t pendente = leitor->fim - leitor->inicio;
+    size_t necessario = PROTOCOLO_CABECALHO;
+
+    if (pendente == 0) {
+        leitor->inicio = leitor->fim = 0;
+    }
+    if (pendente >= PROTOCOLO_CABECALHO) {
+        uint32_t tamanho = ler_u32(leitor->buffer + leitor->inicio + 4);
+        if (tamanho <= PROTOCOLO_PAYLOAD_MAX) {
+            necessario = PROTOCOLO_CABECALHO + tamanho;
+        }
+    }
+    if (necessario < LEITOR_CAPACIDADE_INICIAL) {
+        necessario = LEITOR_CAPACIDADE_INICIAL;
+    }
+
+    // Move o quadro parcial para o início se o final do buffer está apertado
+    if (leitor->inicio > 0 && leitor->capacidade - leitor->inicio < necessario) {
+        memmove(leitor->buffer, leitor->buffer + leitor->inicio, pendente);
+        leitor->inicio = 0;
+        leitor->fim = pendente;
+    }
+
+    if (leitor->capacidade < necessario) {
+        size_t nova = leitor->capacidade ? leitor->capacidade : LEITOR_CAPACIDADE_INICIAL;
+        while (nova < necessario) nova *= 2;
+        if (nova > LEITOR_CAPACIDADE_MAXIMA) nova = LEITOR_CAPACIDADE_MAXIMA;
+        uint8_t *novo = realloc(leitor->buffer, nova);
+        if (novo == NULL) {
+            *livre = 0;
+            return NULL;
+        }
+        leitor->buffer = novo;
+        leitor->capacidade = nova;
+    }
+
+    *livre = leitor->capacidade - leitor->fim;
+    return leitor->buffer + leitor->fim;
+}
+
+// Função para registrar quantos bytes o recv() escreveu em leitor_espaco()
+void leitor_avancar(LeitorQuadros *leitor, size_t recebidos) {
+    leitor->fim += recebidos;
+}
+
+// Função para guardar no fim do leitor bytes que chegaram enquanto quem lê
+// não processa quadros (ex.: leitura pausada), crescendo o buffer o quanto
+// for preciso, mesmo além de um quadro
+// Retorna -1 se faltou memória
+int leitor_acrescentar(LeitorQuadros *leitor, const uint8_t *dados, size_t tamanho) {
+    size_t pendente = leitor->fim - leitor->inicio;
+    if (leitor->inicio > 0 && leitor->capacidade - leitor->fim < tamanho) {
+        memmove(leitor->buffer, leitor->buffer + leitor->inicio, pendente);
+        leitor->inicio = 0;
+        leitor->fim = pendente;
+    }
+    if (leitor->capacidade - leitor->fim < tamanho) {
+        size_t nova = leitor->capacidade ? leitor->capacidade : LEITOR_CAPACIDADE_INICIAL;
+        while (nova - leitor->fim < tamanho) nova *= 2;
+        uint8_t *novo = realloc(leitor->buffer, nova);
+        if (novo == NULL) return -1;
+        leitor->buffer = novo;
+        leitor->capacidade = nova;
+    }
+    memcpy(leitor->buffer + leitor->fim, dados, tamanho);
+    leitor->fim += tamanho;
+    return 0;
+}
+
+// Função para extrair o próximo quadro completo, se houver
+int leitor_proximo(LeitorQuadros *leitor, Quadro *quadro) {
+    size_t pendente = leitor->fim - leitor->inicio;
+    if (pendente < PROTOCOLO_CABECALHO) {
+        return QUADRO_INCOMPLETO;
+    }
+
+    const uint8_t *p = leitor->buffer + leitor->inicio;
+    quadro->versao = p[0];
+    quadro->tipo = p[1];
+    quadro->flags = (uint16_t)((p[2] << 8) | p[3]);
+    quadro->tamanho = ler_u32(p + 4);
+
+    if (quadro->versao != PROTOCOLO_VERSAO || quadro->tamanho > PROTOCOLO_PAYLOAD_MAX) {
+        return QUADRO_ERRO;
+    }
+    if (pendente < PROTOCOLO_CABECALHO + (size_t)quadro->tamanho) {
+        return QUADRO_INCOMPLETO;
+    }
+
+    quadro->payload = p + PROTOCOLO_CABECALHO;
+    leitor->inicio += PROTOCOLO_CABECALHO + quadro->tamanho;
+    return QUADRO_PRONTO;
+}
+
+// Função para consultar o quadro incompleto no início do leitor: cabeçalho
+// já recebido, payload ainda pela metade. `disponivel` recebe quantos bytes
+// do payload já estão no buffer (a partir de quadro->payload).
+// Retorna 1 se há um quadro assim e 0 caso contrário
+int leitor_parcial(const LeitorQuadros *leitor, Quadro *quadro, size_t *disponivel) {
+    size_t pendente = leitor->fim - leitor->inicio;
+    if (pendente < PROTOCOLO_CABECALHO) return 0;
+
+    const uint8_t *p = leitor->buffer + leitor->inicio;
+    quadro->versao = p[0];
+    quadro->tipo = p[1];
+    quadro->flags = (uint16_t)((p[2] << 8) | p[3]);
+    quadro->tamanho = ler_u32(p + 4);
+    if (quadro->versao != PROTOCOLO_VERSAO || quadro->tamanho > PROTOCOLO_PAYLOAD_MAX ||
+        pendente >= PROTOCOLO_CABECALHO + (size_t)quadro->tamanho) {
+        return 0;
+    }
+    quadro->payload = p + PROTOCOLO_CABECALHO;
+    *disponivel = pendente - PROTOCOLO_CABECALHO;
+    return 1;
+}
+
+// Função para descartar os bytes pendentes do leitor, depois que quem usa
+// consumiu o restante do quadro parcial direto do socket
+void leitor_descartar(LeitorQuadros *leitor) {
+    leitor->inicio = leitor->fim = 0;
+}
+
+// Função para calcular o tamanho de um quadro com origem e corpo
+size_t protocolo_tamanho_quadro(size_t origem, size_t corpo) {
+    return PROTOCOLO_CABECALHO + 1 + origem + corpo;
+}
+
+// Função para escrever cabeçalho e origem de um quadro cujo corpo tem
+// `tamanho_corpo` bytes. Retorna quantos bytes foram escritos em `destino`.
+static size_t codificar_prefixo(uint8_t *destino, uint8_t tipo, const char *origem,
+                                size_t tamanho_corpo) {
+    size_t tamanho_origem = origem ? strlen(origem) : 0;
+    if (tamanho_origem > PROTOCOLO_ORIGEM_MAX) tamanho_origem = PROTOCOLO_ORIGEM_MAX;
+
+    escrever_cabecalho(destino, tipo, 0, (uint32_t)(1 + tamanho_origem + tamanho_corpo));
+    destino[PROTOCOLO_CABECALHO] = (uint8_t)tamanho_origem;
+    if (tamanho_origem > 0) {
+        memcpy(destino + PROTOCOLO_CABECALHO + 1, origem, tamanho_origem);
+    }
+    return PROTOCOLO_CABECALHO + 1 + tamanho_origem;
+}
+
+// Função para codificar um quadro CHAT, NICK, QUIT ou SALA em `destino`.
+// `destino` precisa de protocolo_tamanho_quadro() bytes. Retorna o tamanho.
+size_t protocolo_codificar(uint8_t *destino, uint8_t tipo, const char *origem,
+                           const char *corpo, size_t tamanho_corpo) {
+    size_t prefixo = codificar_prefixo(destino, tipo, origem, tamanho_corpo);
+    if (tamanho_corpo > 0) {
+        memcpy(destino + prefixo, corpo, tamanho_corpo);
+    }
+    return prefixo + tamanho_corpo;
+}
+
+// Função para codificar um quadro CONTROLE (sem origem): a operação e
+// depois `tamanho` bytes de `dados`.
+// `destino` precisa de PROTOCOLO_CONTROLE_MINIMO + tamanho bytes. Retorna o tamanho.
+size_t protocolo_codificar_controle(uint8_t *destino, uint8_t operacao, const uint8_t *dados,
+                                    size_t tamanho) {
+    escrever_cabecalho(destino, QUADRO_CONTROLE, 0, (uint32_t)(1 + tamanho));
+    destino[PROTOCOLO_CABECALHO] = operacao;
+    if (tamanho > 0) {
+        memcpy(destino + PROTOCOLO_CONTROLE_MINIMO, dados, tamanho);
+    }
+    return PROTOCOLO_CONTROLE_MINIMO + tamanho;
+}
+
+// Função para escrever um inteiro de 64 bits em ordem de rede (tokens e
+// posições no fluxo)
+void protocolo_escrever_u64(uint8_t *destino, uint64_t valor) {
+    for (int i = 0; i < 8; i++) {
+        destino[i] = (uint8_t)(valor >> (56 - 8 * i));
+    }
+}
+
+// Função para ler um inteiro de 64 bits em ordem de rede
+uint64_t protocolo_ler_u64(const uint8_t *origem) {
+    uint64_t valor = 0;
+    for (int i = 0; i < 8; i++) {
+        valor = (valor << 8) | origem[i];
+    }
+    return valor;
+}
+
+// Função para codificar o início de um quadro ARQUIVO com origem vazia:
+// cabeçalho, operação e identificador. Os `tamanho_dados` bytes seguintes
+// ficam por conta de quem chama (ex.: sendfile() de um bloco do arquivo).
+// `destino` precisa de PROTOCOLO_CABECALHO + 1 + PROTOCOLO_ARQUIVO_PREFIXO bytes.
+// Retorna quantos bytes foram escritos
+size_t protocolo_codificar_arquivo(uint8_t *destino, uint8_t operacao, uint32_t id,
+                                   size_t tamanho_dados) {
+    size_t prefixo = codificar_prefixo(destino, QUADRO_ARQUIVO, NULL,
+                                       PROTOCOLO_ARQUIVO_PREFIXO + tamanho_dados);
+    destino[prefixo] = operacao;
+    destino[prefixo + 1] = (uint8_t)(id >> 24);
+    destino[prefixo + 2] = (uint8_t)(id >> 16);
+    destino[prefixo + 3] = (uint8_t)(id >> 8);
+    destino[prefixo + 4] = (uint8_t)id;
+    return prefixo + PROTOCOLO_ARQUIVO_PREFIXO;
+}
+
+// Função para separar operação, identificador e dados do corpo de um quadro ARQUIVO
+// Retorna -1 se o corpo for curto demais
+int protocolo_separar_arquivo(const char *corpo, size_t tamanho, uint8_t *operacao, uint32_t *id,
+                              const char **dados, size_t *tamanho_dados) {
+    if (tamanho < PROTOCOLO_ARQUIVO_PREFIXO) return -1;
+    *operacao = (uint8_t)corpo[0];
+    *id = ler_u32((const uint8_t *)corpo + 1);
+    *dados = corpo + PROTOCOLO_ARQUIVO_PREFIXO;
+    *tamanho_dados = tamanho - PROTOCOLO_ARQUIVO_PREFIXO;
+    return 0;
+}
+
+// Função para montar o corpo de um quadro PRIVADO enviado pelo cliente: o
+// nickname de destino (cortado em PROTOCOLO_ORIGEM_MAX) e depois o texto.
+// `destino` precisa de 1 + tamanho_nickname + tamanho_texto bytes.
+// Retorna o tamanho do corpo
+size_t protocolo_codificar_privado(char *destino, const char *nickname, size_t tamanho_nickname,
+                                   const char *texto, size_t tamanho_texto) {
+    if (tamanho_nickname > PROTOCOLO_ORIGEM_MAX) tamanho_nickname = PROTOCOLO_ORIGEM_MAX;
+    destino[0] = (char)tamanho_nickname;
+    memcpy(destino + 1, nickname, tamanho_nickname);
+    memcpy(destino + 1 + tamanho_nickname, texto, tamanho_texto);
+    return 1 + tamanho_nickname + tamanho_texto;
+}
+
+// Função para separar o nickname de destino e o texto do corpo de um
+// quadro PRIVADO enviado pelo cliente
+// Retorna -1 se o corpo for curto demais
+int protocolo_separar_privado(const char *corpo, size_t tamanho, const char **nickname,
+                              size_t *tamanho_nickname, const char **texto, size_t *tamanho_texto) {
+    if (tamanho < 1 || (size_t)(uint8_t)corpo[0] + 1 > tamanho) return -1;
+    *tamanho_nickname = (uint8_t)corpo[0];
+    *nickname = corpo + 1;
+    *texto = *nickname + *tamanho_nickname;
+    *tamanho_texto = tamanho - 1 - *tamanho_nickname;
+    return 0;
+}
+
+// Função para reempacotar um quadro já codificado como quadro de histórico:
+// mesmo tipo, QUADRO_FLAG_HISTORICO e o instante antes do payload.
+// `destino` precisa de `tamanho` + PROTOCOLO_INSTANTE bytes. Retorna o tamanho.
+size_t protocolo_codificar_historico(uint8_t *destino, const uint8_t *quadro, size_t tamanho,
+                                     int64_t instante) {
+    size_t payload = tamanho - PROTOCOLO_CABECALHO;
+    escrever_cabecalho(destino, quadro[1], QUADRO_FLAG_HISTORICO,
+                       (uint32_t)(PROTOCOLO_INSTANTE + payload));
+    uint64_t valor = (uint64_t)instante;
+    for (int i = 0; i < PROTOCOLO_INSTANTE; i++) {
+        destino[PROTOCOLO_CABECALHO + i] = (uint8_t)(valor >> (56 - 8 * i));
+    }
+    memcpy(destino + PROTOCOLO_CABECALHO + PROTOCOLO_INSTANTE, quadro + PROTOCOLO_CABECALHO, payload);
+    return tamanho + PROTOCOLO_INSTANTE;
+}
+
+// Função para separar o instante de um quadro de histórico; `original`
+// passa a descrever o quadro como ele foi enviado na primeira vez
+// Retorna -1 se o payload for curto demais
+int protocolo_separar_historico(const Quadro *quadro, int64_t *instante, Quadro *original) {
+    if (quadro->tamanho < PROTOCOLO_INSTANTE) return -1;
+    uint64_t valor = 0;
+    for (int i = 0; i < PROTOCOLO_INSTANTE; i++) {
+        valor = (valor << 8) | quadro->payload[i];
+    }
+    *instante = (int64_t)valor;
+    *original = *quadro;
+    original->flags &= (uint16_t)~QUADRO_FLAG_HISTORICO;
+    original->tamanho -= PROTOCOLO_INSTANTE;
+    original->payload += PROTOCOLO_INSTANTE;
+    return 0;
+}
+
+// Função para separar origem e corpo do payload de um quadro CHAT, NICK, QUIT ou SALA
+// Retorna -1 se o payload estiver malformado
+int protocolo_separar_origem(const Quadro *quadro, const char **origem, size_t *tamanho_origem,
+                             const char **corpo, size_t *tamanho_corpo) {
+    if (quadro->tamanho < 1 || (size_t)quadro->payload[0] + 1 > quadro->tamanho) {
+        return -1;
+    }
+    *tamanho_origem = quadro->payload[0];
+    *origem = (const char *)quadro->payload + 1;
+    *corpo = *origem + *tamanho_origem;
+    *tamanho_corpo = quadro->tamanho - 1 - *tamanho_origem;
+    return 0;
+}
+
+// Função para enviar um quadro em um socket bloqueante, sem copiar o corpo.
+// Retorna o total de bytes enviados ou -1 em caso de erro.
+ssize_t protocolo_enviar(int fd, uint8_t tipo, const char *origem,
+                         const char *corpo, size_t tamanho_corpo) {
+    uint8_t cabecalho[PROTOCOLO_CABECALHO + 1 + PROTOCOLO_ORIGEM_MAX];
+    if (tamanho_corpo > PROTOCOLO_PAYLOAD_MAX - 1 - PROTOCOLO_ORIGEM_MAX) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    size_t tamanho_cabecalho = codificar_prefixo(cabecalho, tipo, origem, tamanho_corpo);
+
+    struct iovec partes[2] = {
+        { cabecalho, tamanho_cabecalho },
+        { (void *)corpo, tamanho_corpo }
+    };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = partes;
+    msg.msg_iovlen = tamanho_corpo > 0 ? 2 : 1;
+
+    size_t total = tamanho_cabecalho + tamanho_corpo;
+    size_t enviado = 0;
+    while (enviado < total) {
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        enviado += (size_t)n;
+        // Avança os iovecs após uma escrita parcial
+        while (n > 0 && msg.msg_iovlen > 0) {
+            if ((size_t)n >= msg.msg_iov[0].iov_len) {
+                n -= (ssize_t)msg.msg_iov[0].iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            } else {
+                msg.msg_iov[0].iov_base = (uint8_t *)msg.msg_iov[0].iov_base + n;
+                msg.msg_iov[0].iov_len -= (size_t)n;
+                n = 0;
+            }
+        }
+    }
+    return (ssize_t)total;
+}
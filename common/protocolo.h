@@ -0,0 +1,183 @@
+// ============================================================================
+// ARQUIVO: protocolo.h
+//
+// DESCRIÇÃO: Protocolo binário de quadros usado entre cliente e servidor.
+//
+//            Cada quadro tem um cabeçalho fixo de 8 bytes (ordem de rede):
+//
+//              +--------+------+---------+------------------+
+//              | versao | tipo |  flags  |     tamanho      |
+//              |   1B   |  1B  |   2B    |        4B        |
+//              +--------+------+---------+------------------+
+//
+//            seguido de `tamanho` bytes de payload. Os quadros CHAT, NICK,
+//            QUIT e SALA carregam no payload o nickname de origem (1 byte
+//            de comprimento + bytes) e depois o corpo da mensagem. O cliente
+//            envia a origem vazia; o servidor a preenche ao repassar.
+//
+//            Os quadros ARQUIVO também levam a origem; o corpo começa com a
+//            operação (1 byte) e o identificador da transferência (4 bytes),
+//            escolhido pelo remetente. Os blocos de um arquivo são quadros
+//            comuns, intercalados com os de chat na mesma conexão.
+//
+//            Um quadro com QUADRO_FLAG_HISTORICO foi reenviado do histórico
+//            do servidor: o payload começa com o instante original (8 bytes,
+//            segundos desde a época) e segue como o do quadro original.
+//
+//            O servidor manda CONTROLE_PING a uma conexão que ficou calada
+//            por algum tempo e a derruba se nada chegar até o prazo; o
+//            cliente responde com CONTROLE_PONG. Qualquer byte recebido vale
+//            como sinal de vida, não só o PONG.
+//
+//            Retomada de sessão: cada sentido da conexão é um fluxo de
+//            bytes, e a posição de um quadro nesse fluxo faz as vezes de
+//            número de sequência. O servidor abre toda sessão com
+//            CONTROLE_SESSAO, que leva o token dela. De tempos em tempos
+//            cada lado avisa com CONTROLE_CONFIRMA até onde já tratou o
+//            fluxo do outro, e guarda o que enviou e ainda não foi
+//            confirmado. Se a conexão cai, o cliente abre outra e, antes de
+//            qualquer outro quadro, manda CONTROLE_RETOMAR com o token e a
+//            posição até onde recebeu. O servidor responde com o mesmo
+//            token e a sua posição, e cada lado reenvia o que o outro não
+//            recebeu. Se a resposta vem com token 0, a sessão não existe
+//            mais e a conexão segue como uma sessão nova. Os quadros RETOMAR
+//            ficam fora dos fluxos.
+//
+//            Mensagens privadas (/msg): o cliente manda um quadro PRIVADO
+//            cujo corpo leva o nickname de destino (1 byte de comprimento +
+//            bytes) e depois o texto. O servidor entrega ao destino um
+//            quadro PRIVADO comum, com o remetente na origem e só o texto no
+//            corpo, ou responde com CONTROLE_ERRO se ninguém usa o nickname.
+//            Os nicknames são únicos no servidor: um NICK recusado também
+//            volta como CONTROLE_ERRO, com o nickname que continua valendo.
+//            CONTROLE_QUEM pede os nicknames conectados (que começam com o
+//            prefixo dado, se houver); a resposta leva quantos são e a
+//            lista, separada por '\n', cortada se não couber.
+//
+//            Busca (/search): CONTROLE_BUSCA leva o texto da consulta
+//            (palavras, "#sala" e "@nick", todos exigidos). O servidor
+//            responde com as mensagens achadas que o /history mostraria a
+//            quem pede (da sala dele e de difusão), como quadros de
+//            histórico, e fecha com um CONTROLE_BUSCA que leva quantas foram e quanto
+//            a consulta levou em microssegundos (4 + 4 bytes, ordem de
+//            rede). Sem histórico no servidor, a resposta é CONTROLE_ERRO.
+//
+//            O leitor é incremental: aceita leituras parciais do socket e
+//            devolve quadros apontando para dentro do próprio buffer, sem
+//            copiar o payload.
+// ============================================================================
+
+#ifndef PROTOCOLO_H
+#define PROTOCOLO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define PROTOCOLO_VERSAO 1
+#define PROTOCOLO_CABECALHO 8
+#define PROTOCOLO_PAYLOAD_MAX (64 * 1024)
+#define PROTOCOLO_ORIGEM_MAX 255
+
+// Tipos de quadro
+typedef enum {
+    QUADRO_CHAT = 1,     // Mensagem de texto
+    QUADRO_NICK = 2,     // Troca de nickname (corpo = novo nickname)
+    QUADRO_QUIT = 3,     // Encerramento da conversa
+    QUADRO_CONTROLE = 4, // Mensagens de controle (primeiro byte = operação)
+    QUADRO_SALA = 5,     // Entrada/saída de sala (corpo = nome, vazio = sair)
+    QUADRO_ARQUIVO = 6,  // Transferência de arquivo (ver ARQUIVO_* abaixo)
+    QUADRO_PRIVADO = 7   // Mensagem para um só nickname (ver acima)
+} TipoQuadro;
+
+// Flags do cabeçalho
+#define QUADRO_FLAG_ECO 0x0001       // Difusão em sala inclui o próprio remetente
+#define QUADRO_FLAG_HISTORICO 0x0002 // Quadro reenviado do histórico (ver acima)
+#define PROTOCOLO_INSTANTE 8         // Bytes do instante nos quadros de histórico
+
+// Operações de QUADRO_CONTROLE (primeiro byte do payload)
+#define CONTROLE_ECO 1       // O servidor devolve o quadro inteiro ao remetente
+#define CONTROLE_HISTORICO 2 // Pede as últimas N mensagens (4 bytes, ordem de rede)
+#define CONTROLE_PING 3      // Pede um CONTROLE_PONG de volta (sem dados)
+#define CONTROLE_PONG 4      // Resposta a um CONTROLE_PING
+#define CONTROLE_SESSAO 5    // Token da sessão (8 bytes), primeiro quadro do servidor
+#define CONTROLE_CONFIRMA 6  // Bytes do fluxo do outro lado já tratados (8 bytes)
+#define CONTROLE_RETOMAR 7   // Token e bytes do fluxo do outro lado recebidos (8 + 8)
+#define CONTROLE_QUEM 8      // Pedido: prefixo (opcional); resposta: total (4 bytes) e lista
+#define CONTROLE_ERRO 9      // Código (ERRO_*, 1 byte) e o nickname a que ele se refere
+#define CONTROLE_BUSCA 10    // Pedido: consulta; resposta: total e microssegundos (4 + 4 bytes)
+#define PROTOCOLO_FLUXO 8    // Bytes de um token ou de uma posição no fluxo
+#define PROTOCOLO_CONTROLE_MINIMO (PROTOCOLO_CABECALHO + 1) // Quadro só com a operação
+
+// Códigos de CONTROLE_ERRO
+#define ERRO_NICK_EM_USO 1     // NICK recusado: outra sessão usa o nickname
+#define ERRO_NICK_INVALIDO 2   // NICK recusado: vazio, com espaços ou caracteres de controle
+#define ERRO_DESTINO_AUSENTE 3 // PRIVADO para um nickname que ninguém usa
+#define ERRO_SEM_HISTORICO 4   // BUSCA em um servidor sem --historico
+
+// Operações de QUADRO_ARQUIVO (primeiro byte do corpo, depois o identificador)
+#define ARQUIVO_INICIO 1    // Tamanho total (8 bytes, ordem de rede) e nome do arquivo
+#define ARQUIVO_BLOCO 2     // Bytes do arquivo, em ordem
+#define ARQUIVO_FIM 3       // Todos os blocos foram enviados
+#define ARQUIVO_CANCELADO 4 // O remetente desistiu da transferência
+#define PROTOCOLO_ARQUIVO_PREFIXO 5 // Operação + identificador
+// Maior bloco que ainda cabe em um quadro depois que o servidor preenche a origem
+#define PROTOCOLO_ARQUIVO_BLOCO \
+    (PROTOCOLO_PAYLOAD_MAX - 1 - PROTOCOLO_ORIGEM_MAX - PROTOCOLO_ARQUIVO_PREFIXO)
+
+// Quadro decodificado; o payload aponta para dentro do buffer do leitor
+typedef struct {
+    uint8_t versao;
+    uint8_t tipo;
+    uint16_t flags;
+    uint32_t tamanho;
+    const uint8_t *payload;
+} Quadro;
+
+// Leitor incremental de quadros
+typedef struct {
+    uint8_t *buffer;
+    size_t capacidade;
+    size_t inicio; // Primeiro byte ainda não consumido
+    size_t fim;    // Fim dos bytes recebidos
+} LeitorQuadros;
+
+// Resultados de leitor_proximo
+#define QUADRO_ERRO -1
+#define QUADRO_INCOMPLETO 0
+#define QUADRO_PRONTO 1
+
+int leitor_iniciar(LeitorQuadros *leitor);
+void leitor_liberar(LeitorQuadros *leitor);
+uint8_t *leitor_espaco(LeitorQuadros *leitor, size_t *livre);
+void leitor_avancar(LeitorQuadros *leitor, size_t recebidos);
+int leitor_acrescentar(LeitorQuadros *leitor, const uint8_t *dados, size_t tamanho);
+int leitor_proximo(LeitorQuadros *leitor, Quadro *quadro);
+int leitor_parcial(const LeitorQuadros *leitor, Quadro *quadro, size_t *disponivel);
+void leitor_descartar(LeitorQuadros *leitor);
+
+// Codificação
+size_t protocolo_tamanho_quadro(size_t origem, size_t corpo);
+size_t protocolo_codificar(uint8_t *destino, uint8_t tipo, const char *origem,
+                           const char *corpo, size_t tamanho_corpo);
+size_t protocolo_codificar_historico(uint8_t *destino, const uint8_t *quadro, size_t tamanho,
+                                     int64_t instante);
+int protocolo_separar_historico(const Quadro *quadro, int64_t *instante, Quadro *original);
+size_t protocolo_codificar_controle(uint8_t *destino, uint8_t operacao, const uint8_t *dados,
+                                    size_t tamanho);
+void protocolo_escrever_u64(uint8_t *destino, uint64_t valor);
+uint64_t protocolo_ler_u64(const uint8_t *origem);
+size_t protocolo_codificar_arquivo(uint8_t *destino, uint8_t operacao, uint32_t id,
+                                   size_t tamanho_dados);
+int protocolo_separar_arquivo(const char *corpo, size_t tamanho, uint8_t *operacao, uint32_t *id,
+                              const char **dados, size_t *tamanho_dados);
+size_t protocolo_codificar_privado(char *destino, const char *nickname, size_t tamanho_nickname,
+                                   const char *texto, size_t tamanho_texto);
+int protocolo_separar_privado(const char *corpo, size_t tamanho, const char **nickname,
+                              size_t *tamanho_nickname, const char **texto, size_t *tamanho_texto);
+int protocolo_separar_origem(const Quadro *quadro, const char **origem, size_t *tamanho_origem,
+                             const char **corpo, size_t *tamanho_corpo);
+ssize_t protocolo_enviar(int fd, uint8_t tipo, const char *origem,
+                         const char *corpo, size_t tamanho_corpo);
+
+#endif
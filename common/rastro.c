@@ -0,0 +1,337 @@
+// ============================================================================
+// ARQUIVO: rastro.c
+//
+// DESCRIÇÃO: Gravação e leitura dos rastros de sessão (ver rastro.h).
+// ============================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "rastro.h"
+#include "metricas.h"
+
+#define VARINT_MAX 10 // Bytes de um uint64_t em varint
+#define RASTRO_REGISTRO_MAX (1 + 4 * VARINT_MAX + 1 + VARINT_MAX) // Sem os bytes do payload
+
+// Bloco de registros de uma thread, ainda não gravado
+typedef struct {
+    uint8_t *dados;     // CabecalhoBloco e depois os registros
+    size_t usado;       // Bytes de registros
+    uint32_t registros;
+    uint64_t base;      // Instante do primeiro registro
+    uint64_t anterior;  // Instante do último registro
+} BlocoRastro;
+
+static int arquivo_rastro = -1;
+static uint64_t inicio_rastro; // metricas_agora() ao abrir
+static _Thread_local BlocoRastro bloco;
+
+// Função para escrever um varint (7 bits por byte, o bit alto diz que há mais)
+// Retorna quantos bytes escreveu
+static size_t escrever_varint(uint8_t *destino, uint64_t valor) {
+    size_t n = 0;
+    while (valor >= 0x80) {
+        destino[n++] = (uint8_t)(valor | 0x80);
+        valor >>= 7;
+    }
+    destino[n++] = (uint8_t)valor;
+    return n;
+}
+
+// Função para ler um varint de no máximo `fim - *posicao` bytes
+// Retorna -1 se o varint não termina antes do fim
+static int ler_varint(const uint8_t *dados, size_t fim, size_t *posicao, uint64_t *valor) {
+    uint64_t resultado = 0;
+    for (int deslocamento = 0; *posicao < fim && deslocamento < 64; deslocamento += 7) {
+        uint8_t byte = dados[(*posicao)++];
+        resultado |= (uint64_t)(byte & 0x7f) << deslocamento;
+        if (!(byte & 0x80)) {
+            *valor = resultado;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Função para abrir o arquivo do rastro (truncando um anterior) e gravar o
+// cabeçalho. Precisa ser chamada antes de as threads registrarem algo.
+// Retorna -1 se o arquivo não pôde ser criado
+int rastro_abrir(const char *caminho, uint8_t origem) {
+    int fd = open(caminho, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    CabecalhoRastro cabecalho;
+    memset(&cabecalho, 0, sizeof(cabecalho));
+    cabecalho.magico = RASTRO_MAGICO;
+    cabecalho.versao = RASTRO_VERSAO;
+    cabecalho.origem = origem;
+    cabecalho.inicio = (int64_t)time(NULL);
+    if (write(fd, &cabecalho, sizeof(cabecalho)) != (ssize_t)sizeof(cabecalho)) {
+        close(fd);
+        return -1;
+    }
+    inicio_rastro = metricas_agora();
+    arquivo_rastro = fd;
+    return 0;
+}
+
+// Função para saber se há um rastro sendo gravado
+int rastro_ligado() {
+    return arquivo_rastro >= 0;
+}
+
+// Função para gravar o bloco da thread atual, se tiver registros
+static void gravar_bloco() {
+    if (bloco.registros == 0) return;
+    CabecalhoBloco cabecalho;
+    cabecalho.tamanho = (uint32_t)bloco.usado;
+    cabecalho.registros = bloco.registros;
+    cabecalho.base = bloco.base;
+    memcpy(bloco.dados, &cabecalho, sizeof(cabecalho));
+    // Um único write() com O_APPEND: o bloco não se mistura aos de outras threads
+    size_t total = sizeof(cabecalho) + bloco.usado;
+    if (write(arquivo_rastro, bloco.dados, total) != (ssize_t)total) {
+        perror("[ERRO] Falha ao gravar o rastro");
+    }
+    bloco.usado = 0;
+    bloco.registros = 0;
+}
+
+// Função para começar um registro no bloco da thread, gravando antes o
+// bloco se ele não tiver `bytes` livres ou se já estiver velho
+// Retorna onde escrever o resto do registro ou NULL se faltou memória
+static uint8_t *comecar_registro(uint64_t conexao, uint8_t evento, size_t bytes) {
+    uint64_t agora = metricas_agora() - inicio_rastro;
+    if (bloco.dados == NULL) {
+        bloco.dados = malloc(sizeof(CabecalhoBloco) + RASTRO_BLOCO);
+        if (bloco.dados == NULL) return NULL;
+    }
+    if (bloco.registros > 0 &&
+        (bloco.usado + bytes > RASTRO_BLOCO ||
+         agora - bloco.base > (uint64_t)RASTRO_ATRASO_MS * 1000000)) {
+        gravar_bloco();
+    }
+    if (bloco.registros == 0) bloco.base = bloco.anterior = agora;
+    // Threads diferentes leem o relógio em momentos diferentes; dentro do
+    // bloco o delta nunca é negativo
+    if (agora < bloco.anterior) agora = bloco.anterior;
+
+    uint8_t *destino = bloco.dados + sizeof(CabecalhoBloco) + bloco.usado;
+    *destino++ = evento;
+    destino += escrever_varint(destino, agora - bloco.anterior);
+    destino += escrever_varint(destino, conexao);
+    bloco.anterior = agora;
+    bloco.registros++;
+    return destino;
+}
+
+// Função para encerrar o registro começado, que termina em `fim`
+static void terminar_registro(const uint8_t *fim) {
+    bloco.usado = (size_t)(fim - (bloco.dados + sizeof(CabecalhoBloco)));
+}
+
+// Função para registrar a abertura ou o fechamento de uma conexão
+void rastro_conexao(uint64_t conexao, uint8_t evento) {
+    if (arquivo_rastro < 0) return;
+    uint8_t *destino = comecar_registro(conexao, evento, RASTRO_REGISTRO_MAX);
+    if (destino != NULL) terminar_registro(destino);
+}
+
+// Função para registrar um quadro do qual só os `disponivel` primeiros bytes
+// do payload estão na memória (o resto passou direto do/para o arquivo)
+static void registrar(uint64_t conexao, uint8_t evento, uint8_t tipo, uint16_t flags,
+                      uint32_t tamanho, const uint8_t *payload, size_t disponivel) {
+    size_t gravado = disponivel < tamanho ? disponivel : tamanho;
+    // Dos blocos de arquivo só ficam a origem, a operação e o identificador
+    if (tipo == QUADRO_ARQUIVO && gravado > 0) {
+        size_t prefixo = 1 + (size_t)payload[0] + PROTOCOLO_ARQUIVO_PREFIXO;
+        if (gravado > prefixo && payload[prefixo - PROTOCOLO_ARQUIVO_PREFIXO] == ARQUIVO_BLOCO) {
+            gravado = prefixo;
+        }
+    }
+    uint8_t *destino = comecar_registro(conexao, evento, RASTRO_REGISTRO_MAX + gravado);
+    if (destino == NULL) return;
+    *destino++ = tipo;
+    destino += escrever_varint(destino, flags);
+    destino += escrever_varint(destino, tamanho);
+    destino += escrever_varint(destino, gravado);
+    memcpy(destino, payload, gravado);
+    terminar_registro(destino + gravado);
+}
+
+// Função para registrar um quadro já decodificado
+void rastro_quadro(uint64_t conexao, uint8_t evento, const Quadro *quadro, size_t disponivel) {
+    if (arquivo_rastro < 0) return;
+    registrar(conexao, evento, quadro->tipo, quadro->flags, quadro->tamanho, quadro->payload,
+              disponivel);
+}
+
+// Função para registrar os quadros codificados em `dados`. O último pode
+// estar incompleto (o resto sai por sendfile()).
+void rastro_bytes(uint64_t conexao, uint8_t evento, const uint8_t *dados, size_t tamanho) {
+    if (arquivo_rastro < 0) return;
+    while (tamanho >= PROTOCOLO_CABECALHO) {
+        uint16_t flags = (uint16_t)((dados[2] << 8) | dados[3]);
+        uint32_t tamanho_payload = ((uint32_t)dados[4] << 24) | ((uint32_t)dados[5] << 16) |
+                                   ((uint32_t)dados[6] << 8) | dados[7];
+        size_t disponivel = tamanho - PROTOCOLO_CABECALHO;
+        registrar(conexao, evento, dados[1], flags, tamanho_payload,
+                  dados + PROTOCOLO_CABECALHO, disponivel);
+        if (disponivel <= tamanho_payload) return;
+        dados += PROTOCOLO_CABECALHO + tamanho_payload;
+        tamanho -= PROTOCOLO_CABECALHO + tamanho_payload;
+    }
+}
+
+// Função para gravar o bloco da thread atual e liberar o buffer dele. Toda
+// thread que registra algo a chama antes de terminar.
+void rastro_descarregar() {
+    if (arquivo_rastro >= 0) gravar_bloco();
+    free(bloco.dados);
+    bloco.dados = NULL;
+    bloco.usado = 0;
+    bloco.registros = 0;
+}
+
+// Função para gravar o bloco da thread atual e fechar o arquivo. As outras
+// threads já precisam ter chamado rastro_descarregar().
+void rastro_fechar() {
+    if (arquivo_rastro < 0) return;
+    rastro_descarregar();
+    close(arquivo_rastro);
+    arquivo_rastro = -1;
+}
+
+// Função de comparação para ordenar os registros por instante; empates
+// mantêm a ordem do arquivo
+static int comparar_registros(const void *a, const void *b) {
+    const RegistroRastro *x = a, *y = b;
+    if (x->instante != y->instante) return x->instante < y->instante ? -1 : 1;
+    return (x > y) - (x < y);
+}
+
+// Função para decodificar os registros de um bloco
+// Retorna -1 se o bloco está corrompido
+static int ler_bloco(Rastro *rastro, const uint8_t *dados, size_t fim, size_t posicao,
+                     const CabecalhoBloco *cabecalho) {
+    uint64_t instante = cabecalho->base;
+    for (uint32_t i = 0; i < cabecalho->registros; i++) {
+        RegistroRastro *r = &rastro->registros[rastro->total];
+        uint64_t delta, conexao;
+        memset(r, 0, sizeof(*r));
+        if (posicao >= fim) return -1;
+        r->evento = dados[posicao++];
+        if (ler_varint(dados, fim, &posicao, &delta) < 0 ||
+            ler_varint(dados, fim, &posicao, &conexao) < 0) {
+            return -1;
+        }
+        instante += delta;
+        r->instante = instante;
+        r->conexao = conexao;
+        if (r->evento == RASTRO_RECEBIDO || r->evento == RASTRO_ENVIADO) {
+            uint64_t flags, tamanho, gravado;
+            if (posicao >= fim) return -1;
+            r->tipo = dados[posicao++];
+            if (ler_varint(dados, fim, &posicao, &flags) < 0 ||
+                ler_varint(dados, fim, &posicao, &tamanho) < 0 ||
+                ler_varint(dados, fim, &posicao, &gravado) < 0 ||
+                tamanho > PROTOCOLO_PAYLOAD_MAX || gravado > tamanho || gravado > fim - posicao) {
+                return -1;
+            }
+            r->flags = (uint16_t)flags;
+            r->tamanho = (uint32_t)tamanho;
+            r->gravado = (uint32_t)gravado;
+            r->payload = dados + posicao;
+            posicao += gravado;
+        } else if (r->evento != RASTRO_ABERTA && r->evento != RASTRO_FECHADA) {
+            return -1;
+        }
+        rastro->total++;
+    }
+    return posicao == fim ? 0 : -1;
+}
+
+// Função para carregar um rastro inteiro na memória, com os registros de
+// todos os blocos em ordem de tempo. Um bloco cortado no fim do arquivo
+// (gravação interrompida) é ignorado.
+// Retorna -1 (com errno) se o arquivo não pôde ser lido ou não é um rastro
+int rastro_carregar(const char *caminho, Rastro *rastro) {
+    memset(rastro, 0, sizeof(*rastro));
+    int fd = open(caminho, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(CabecalhoRastro)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    size_t tamanho = (size_t)info.st_size;
+    rastro->dados = malloc(tamanho);
+    size_t lidos = 0;
+    while (rastro->dados != NULL && lidos < tamanho) {
+        ssize_t n = read(fd, rastro->dados + lidos, tamanho - lidos);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        lidos += (size_t)n;
+    }
+    close(fd);
+    if (rastro->dados == NULL || lidos < tamanho) {
+        rastro_liberar(rastro);
+        errno = EIO;
+        return -1;
+    }
+
+    CabecalhoRastro cabecalho;
+    memcpy(&cabecalho, rastro->dados, sizeof(cabecalho));
+    if (cabecalho.magico != RASTRO_MAGICO || cabecalho.versao != RASTRO_VERSAO) {
+        rastro_liberar(rastro);
+        errno = EINVAL;
+        return -1;
+    }
+    rastro->origem = cabecalho.origem;
+    rastro->inicio = cabecalho.inicio;
+
+    // Primeira passada: quantos registros há, para alocar de uma vez
+    size_t total = 0;
+    size_t posicao = sizeof(cabecalho);
+    while (tamanho - posicao >= sizeof(CabecalhoBloco)) {
+        CabecalhoBloco b;
+        memcpy(&b, rastro->dados + posicao, sizeof(b));
+        if (b.tamanho > tamanho - posicao - sizeof(b)) break;
+        total += b.registros;
+        posicao += sizeof(b) + b.tamanho;
+    }
+    rastro->registros = malloc((total > 0 ? total : 1) * sizeof(RegistroRastro));
+    if (rastro->registros == NULL) {
+        rastro_liberar(rastro);
+        errno = ENOMEM;
+        return -1;
+    }
+    posicao = sizeof(cabecalho);
+    while (tamanho - posicao >= sizeof(CabecalhoBloco)) {
+        CabecalhoBloco b;
+        memcpy(&b, rastro->dados + posicao, sizeof(b));
+        if (b.tamanho > tamanho - posicao - sizeof(b)) break;
+        posicao += sizeof(b);
+        if (ler_bloco(rastro, rastro->dados, posicao + b.tamanho, posicao, &b) < 0) {
+            rastro_liberar(rastro);
+            errno = EINVAL;
+            return -1;
+        }
+        posicao += b.tamanho;
+    }
+    qsort(rastro->registros, rastro->total, sizeof(RegistroRastro), comparar_registros);
+    return 0;
+}
+
+// Função para liberar um rastro carregado
+void rastro_liberar(Rastro *rastro) {
+    free(rastro->registros);
+    free(rastro->dados);
+    memset(rastro, 0, sizeof(*rastro));
+}
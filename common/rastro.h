@@ -0,0 +1,104 @@
+// ============================================================================
+// ARQUIVO: rastro.h
+//
+// DESCRIÇÃO: Rastro de sessões (--rastro ARQUIVO, no servidor e no
+//            cliente): cada quadro enviado ou recebido vai para um arquivo
+//            binário compacto, com o instante (relógio monotônico, contado
+//            do início da gravação) e o número da conexão, além da abertura
+//            e do fechamento de cada conexão. O cliente reproduz rastros
+//            contra um servidor com --reproduzir (reproducao.c).
+//
+//            Cada thread junta seus registros em um bloco próprio, sem
+//            trava, e grava o bloco inteiro com um único write() no arquivo
+//            aberto com O_APPEND: blocos de threads diferentes não se
+//            misturam. Um bloco vai para o arquivo quando enche, quando o
+//            primeiro registro dele passa de RASTRO_ATRASO_MS e quando a
+//            thread termina (rastro_descarregar). Por isso os blocos não
+//            ficam em ordem de tempo; rastro_carregar() os ordena.
+//
+//            Formato (na ordem de bytes da máquina que gravou):
+//              CabecalhoRastro, depois blocos
+//              bloco:    CabecalhoBloco | registros
+//              registro: evento (1 byte) | ns desde o registro anterior do
+//                        bloco (varint) | conexão (varint) e, nos quadros,
+//                        tipo (1) | flags (varint) | tamanho do payload
+//                        (varint) | bytes gravados (varint) | os bytes
+//
+//            Os dados dos blocos de arquivo (ARQUIVO_BLOCO) não são
+//            gravados, só o tamanho: a reprodução completa com zeros.
+// ============================================================================
+
+#ifndef RASTRO_H
+#define RASTRO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "protocolo.h"
+
+#define RASTRO_MAGICO 0x52545352u // "RSTR"
+#define RASTRO_VERSAO 1
+#define RASTRO_BLOCO (PROTOCOLO_PAYLOAD_MAX + 64 * 1024) // Cabe qualquer registro
+#define RASTRO_ATRASO_MS 1000 // Tempo máximo de um registro no bloco da thread
+
+// Quem gravou o rastro
+#define RASTRO_SERVIDOR 1
+#define RASTRO_CLIENTE 2
+
+// Eventos de um registro
+#define RASTRO_ABERTA 1   // Conexão aceita (servidor) ou estabelecida (cliente)
+#define RASTRO_FECHADA 2  // Conexão fechada
+#define RASTRO_RECEBIDO 3 // Quadro recebido por quem gravou
+#define RASTRO_ENVIADO 4  // Quadro enviado por quem gravou
+
+// Início do arquivo
+typedef struct {
+    uint32_t magico;
+    uint16_t versao;
+    uint8_t origem;   // RASTRO_SERVIDOR ou RASTRO_CLIENTE
+    uint8_t reservado;
+    int64_t inicio;   // Segundos desde a época ao começar a gravação
+} CabecalhoRastro;
+
+// Início de cada bloco
+typedef struct {
+    uint32_t tamanho;   // Bytes de registros depois deste cabeçalho
+    uint32_t registros;
+    uint64_t base;      // Instante (ns) a que o primeiro delta se soma
+} CabecalhoBloco;
+
+// Um registro lido de volta
+typedef struct {
+    uint64_t instante; // ns desde o início da gravação
+    uint64_t conexao;
+    uint8_t evento;
+    uint8_t tipo;
+    uint16_t flags;
+    uint32_t tamanho;        // Payload do quadro
+    uint32_t gravado;        // Bytes do payload que estão no rastro (o resto é zero)
+    const uint8_t *payload;  // Aponta para dentro de Rastro.dados
+} RegistroRastro;
+
+// Rastro carregado na memória, com os registros em ordem de tempo
+typedef struct {
+    uint8_t origem;
+    int64_t inicio;
+    RegistroRastro *registros;
+    size_t total;
+    uint8_t *dados;
+} Rastro;
+
+// Gravação
+int rastro_abrir(const char *caminho, uint8_t origem);
+int rastro_ligado(void);
+void rastro_conexao(uint64_t conexao, uint8_t evento);
+void rastro_quadro(uint64_t conexao, uint8_t evento, const Quadro *quadro, size_t disponivel);
+void rastro_bytes(uint64_t conexao, uint8_t evento, const uint8_t *dados, size_t tamanho);
+void rastro_descarregar(void);
+void rastro_fechar(void);
+
+// Leitura
+int rastro_carregar(const char *caminho, Rastro *rastro);
+void rastro_liberar(Rastro *rastro);
+
+#endif
@@ -0,0 +1,285 @@
+// ============================================================================
+// ARQUIVO: saida.c
+//
+// DESCRIÇÃO: Implementação do buffer de saída de uma conexão (ver saida.h).
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "protocolo.h"
+#include "saida.h"
+#include "transporte.h"
+#include "metricas.h"
+#include "rastro.h"
+
+#define SAIDA_CAPACIDADE_INICIAL 16384
+
+// Função para iniciar um buffer de saída vazio
+void saida_iniciar(SaidaQuadros *saida, ModoEnvio modo) {
+    memset(saida, 0, sizeof(*saida));
+    saida->modo = modo;
+}
+
+// Função para liberar a memória do buffer de saída
+void saida_liberar(SaidaQuadros *saida) {
+    metricas_ajustar(MEDIDOR_FILA_SAIDA, -(int64_t)saida_pendente(saida));
+    free(saida->dados);
+    saida->dados = NULL;
+    saida->tamanho = saida->enviado = saida->capacidade = 0;
+}
+
+// Função para ajustar o Nagle do socket ao modo de envio
+// Retorna -1 se o setsockopt falhou
+int saida_configurar_socket(int fd, ModoEnvio modo) {
+    int ligado = modo == ENVIO_INTERATIVO;
+    return setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &ligado, sizeof(ligado));
+}
+
+// Função para ler o tamanho total (cabeçalho + payload) do quadro que
+// começa em `quadro`
+static size_t tamanho_quadro(const uint8_t *quadro) {
+    return PROTOCOLO_CABECALHO + (((size_t)quadro[4] << 24) | ((size_t)quadro[5] << 16) |
+                                  ((size_t)quadro[6] << 8) | quadro[7]);
+}
+
+// Função para tirar do começo do buffer o que não será mais enviado: os
+// bytes já enviados ou, com retenção, os já confirmados
+static void compactar(SaidaQuadros *saida) {
+    size_t inutil = saida->retido_max ? saida->confirmado : saida->enviado;
+    if (inutil == 0) return;
+    memmove(saida->dados, saida->dados + inutil, saida->tamanho - inutil);
+    saida->tamanho -= inutil;
+    saida->enviado -= inutil;
+    if (saida->retido_max) saida->confirmado = 0;
+    saida->fluxo_inicio += inutil;
+}
+
+// Função para achar o começo do quadro que contém a posição `posicao` do
+// buffer, andando de quadro em quadro a partir de `confirmado` (que, com
+// retenção, está sempre no começo de um quadro)
+static size_t inicio_do_quadro(const SaidaQuadros *saida, size_t posicao) {
+    size_t inicio = saida->confirmado;
+    while (inicio + PROTOCOLO_CABECALHO <= saida->tamanho) {
+        size_t fim = inicio + tamanho_quadro(saida->dados + inicio);
+        if (fim > posicao) break;
+        inicio = fim;
+    }
+    return inicio;
+}
+
+// Função para garantir espaço para mais `total` bytes contíguos no fim do
+// buffer. Os bytes já enviados (com retenção, os já confirmados, e os
+// quadros mais antigos além de `retido_max`) são descartados antes de crescer.
+// Retorna onde escrever ou NULL se faltou memória
+uint8_t *saida_reservar(SaidaQuadros *saida, size_t total) {
+    if (saida->tamanho + total > saida->capacidade) {
+        while (saida->retido_max && saida->enviado - saida->confirmado > saida->retido_max) {
+            saida->confirmado += tamanho_quadro(saida->dados + saida->confirmado);
+        }
+        compactar(saida);
+    }
+    if (saida->tamanho + total > saida->capacidade) {
+        size_t nova = saida->capacidade ? saida->capacidade * 2 : SAIDA_CAPACIDADE_INICIAL;
+        while (nova < saida->tamanho + total) nova *= 2;
+        uint8_t *novo = realloc(saida->dados, nova);
+        if (novo == NULL) return NULL;
+        saida->dados = novo;
+        saida->capacidade = nova;
+    }
+    return saida->dados + saida->tamanho;
+}
+
+// Função para confirmar `total` bytes escritos no espaço reservado (um
+// quadro, ou o começo dele quando o resto sai por sendfile())
+void saida_avancar(SaidaQuadros *saida, size_t total) {
+    if (saida->rastro != 0) {
+        rastro_bytes(saida->rastro, RASTRO_ENVIADO, saida->dados + saida->tamanho, total);
+    }
+    saida->tamanho += total;
+    metricas_somar(METRICA_QUADROS_ENVIADOS, 1);
+    metricas_ajustar(MEDIDOR_FILA_SAIDA, (int64_t)total);
+}
+
+// Função para codificar um quadro com origem vazia no fim do buffer
+// Retorna -1 se o corpo é grande demais ou se faltou memória
+int saida_enfileirar(SaidaQuadros *saida, uint8_t tipo, const char *corpo, size_t tamanho) {
+    if (tamanho > PROTOCOLO_PAYLOAD_MAX - 1) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    size_t total = protocolo_tamanho_quadro(0, tamanho);
+    uint8_t *destino = saida_reservar(saida, total);
+    if (destino == NULL) return -1;
+    saida_avancar(saida, protocolo_codificar(destino, tipo, NULL, corpo, tamanho));
+    return 0;
+}
+
+// Função para consultar quantos bytes ainda faltam enviar
+size_t saida_pendente(const SaidaQuadros *saida) {
+    return saida->tamanho - saida->enviado;
+}
+
+// Função para enviar os bytes enfileirados com as flags de send() dadas
+// Retorna 0 se esvaziou, 1 se o socket não aceitou tudo (EAGAIN) e -1 em erro
+static int descarregar(SaidaQuadros *saida, int fd, int flags) {
+    while (saida->enviado < saida->tamanho) {
+        ssize_t n = transporte_enviar(fd, saida->dados + saida->enviado,
+                                      saida->tamanho - saida->enviado, flags);
+        if (n > 0) {
+            saida->enviado += (size_t)n;
+            metricas_somar(METRICA_BYTES_ENVIADOS, (uint64_t)n);
+            metricas_ajustar(MEDIDOR_FILA_SAIDA, -(int64_t)n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 1;
+        } else {
+            metricas_somar(METRICA_ERROS_ENVIO, 1);
+            return -1;
+        }
+    }
+    if (!saida->retido_max) {
+        saida->fluxo_inicio += saida->tamanho;
+        saida->tamanho = saida->enviado = 0;
+    }
+    return 0;
+}
+
+// Função para enviar tudo o que estiver enfileirado sem bloquear, mesmo em
+// um socket bloqueante. `mais` avisa que outros quadros virão logo; no modo
+// vazão isso vira MSG_MORE.
+// Retorna 0 se esvaziou, 1 se o socket não aceitou tudo (EAGAIN) e -1 em erro
+int saida_descarregar(SaidaQuadros *saida, int fd, int mais) {
+    int flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+    if (mais && saida->modo == ENVIO_VAZAO) flags |= MSG_MORE;
+    return descarregar(saida, fd, flags);
+}
+
+// Função para enviar o que estiver enfileirado seguido de `tamanho` bytes
+// de `arquivo` a partir de *posicao, com sendfile(): o kernel copia do
+// cache de páginas direto para o socket. Os bytes do arquivo costumam
+// completar o quadro enfileirado antes, então o buffer sai com MSG_MORE.
+// Só para sockets bloqueantes. Retorna 0 se enviou tudo e -1 em erro
+int saida_enviar_arquivo(SaidaQuadros *saida, int fd, int arquivo, off_t *posicao,
+                         size_t tamanho) {
+    if (descarregar(saida, fd, MSG_NOSIGNAL | MSG_MORE) != 0) return -1;
+    // Os bytes do arquivo não passam pelo buffer e não podem ser retidos:
+    // a retenção recomeça depois deles
+    saida->fluxo_inicio += saida->tamanho;
+    saida->tamanho = saida->enviado = saida->confirmado = 0;
+    while (tamanho > 0) {
+        ssize_t n = transporte_enviar_arquivo(fd, arquivo, posicao, tamanho);
+        if (n > 0) {
+            tamanho -= (size_t)n;
+            saida->fluxo_inicio += (uint64_t)n;
+            metricas_somar(METRICA_BYTES_ENVIADOS, (uint64_t)n);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            metricas_somar(METRICA_ERROS_ENVIO, 1);
+            if (n == 0) errno = EIO; // O arquivo encolheu durante o envio
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Função para passar a reter o que for enviado até a confirmação, com no
+// máximo `maximo` bytes não confirmados (além disso os quadros mais
+// antigos são esquecidos). `maximo` precisa caber um quadro inteiro.
+void saida_reter(SaidaQuadros *saida, size_t maximo) {
+    saida->retido_max = maximo;
+    saida->confirmado = saida->enviado;
+}
+
+// Função para consultar a posição no fluxo do fim do que já foi enviado
+uint64_t saida_fluxo_enviado(const SaidaQuadros *saida) {
+    return saida->fluxo_inicio + saida->enviado;
+}
+
+// Função para consultar quantos bytes enviados aguardam a confirmação
+size_t saida_nao_confirmado(const SaidaQuadros *saida) {
+    return saida->retido_max ? saida->enviado - saida->confirmado : 0;
+}
+
+// Função para registrar que o outro lado recebeu o fluxo até `fluxo`: os
+// bytes retidos até ali podem ser descartados
+void saida_confirmar(SaidaQuadros *saida, uint64_t fluxo) {
+    if (!saida->retido_max || fluxo <= saida->fluxo_inicio + saida->confirmado) return;
+    if (fluxo > saida->fluxo_inicio + saida->enviado) {
+        fluxo = saida->fluxo_inicio + saida->enviado; // Nunca além do enviado
+    }
+    saida->confirmado = (size_t)(fluxo - saida->fluxo_inicio);
+}
+
+// Função para voltar o envio à posição `fluxo`, a última que o outro lado
+// recebeu antes de a conexão cair: tudo o que veio depois sai de novo. Se
+// essa posição não está mais retida (foi esquecida ou caiu no meio de
+// bytes de sendfile()), o que havia entre ela e o retido se perdeu: o
+// envio recomeça do retido, que passa a ocupar a posição `fluxo`.
+// Retorna 1 se houve perda e 0 se não
+int saida_retomar(SaidaQuadros *saida, uint64_t fluxo) {
+    size_t antes = saida->enviado;
+    int perda = 0;
+    if (fluxo >= saida->fluxo_inicio + saida->confirmado &&
+        fluxo <= saida->fluxo_inicio + saida->enviado) {
+        saida->enviado = (size_t)(fluxo - saida->fluxo_inicio);
+    } else {
+        perda = 1;
+        saida->enviado = saida->confirmado;
+    }
+    metricas_ajustar(MEDIDOR_FILA_SAIDA, (int64_t)(antes - saida->enviado));
+    saida->confirmado = saida->enviado;
+    if (perda) {
+        compactar(saida);
+        saida->fluxo_inicio = fluxo;
+    }
+    return perda;
+}
+
+// Função para começar um fluxo novo (a sessão anterior não existe mais): o
+// que foi enviado é esquecido, e o que falta enviar, a partir do começo do
+// quadro que ficou pela metade, segue depois dos `tamanho` bytes de
+// `prefixo` (quadros que a sessão nova precisa receber antes de tudo)
+// Retorna -1 se faltou memória
+int saida_reiniciar_fluxo(SaidaQuadros *saida, const uint8_t *prefixo, size_t tamanho) {
+    size_t antes = saida->enviado;
+    if (saida->retido_max) saida->enviado = inicio_do_quadro(saida, saida->enviado);
+    metricas_ajustar(MEDIDOR_FILA_SAIDA, (int64_t)(antes - saida->enviado));
+    saida->confirmado = saida->enviado;
+    compactar(saida);
+    saida->fluxo_inicio = 0;
+    if (tamanho == 0) return 0;
+    size_t pendente = saida->tamanho;
+    if (saida_reservar(saida, tamanho) == NULL) return -1;
+    memmove(saida->dados + tamanho, saida->dados, pendente);
+    memcpy(saida->dados, prefixo, tamanho);
+    if (saida->rastro != 0) rastro_bytes(saida->rastro, RASTRO_ENVIADO, prefixo, tamanho);
+    saida->tamanho += tamanho;
+    metricas_ajustar(MEDIDOR_FILA_SAIDA, (int64_t)tamanho);
+    return 0;
+}
+
+// Função para interpretar o nome de um modo ("interativo" ou "vazao")
+// Retorna -1 se o nome for desconhecido
+int saida_modo_ler(const char *nome, ModoEnvio *modo) {
+    if (strcmp(nome, "interativo") == 0) {
+        *modo = ENVIO_INTERATIVO;
+    } else if (strcmp(nome, "vazao") == 0) {
+        *modo = ENVIO_VAZAO;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Função para obter o nome de um modo de envio
+const char *saida_modo_nome(ModoEnvio modo) {
+    return modo == ENVIO_VAZAO ? "vazao" : "interativo";
+}
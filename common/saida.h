@@ -0,0 +1,81 @@
+// ============================================================================
+// ARQUIVO: saida.h
+//
+// DESCRIÇÃO: Buffer de saída de uma conexão. Os quadros são codificados em
+//            sequência no mesmo buffer e enviados juntos por
+//            saida_descarregar(), que trata escritas parciais e nunca
+//            bloqueia, nem em um socket bloqueante (o que sobrar fica para a
+//            próxima chamada, quando o socket aceitar mais).
+//            saida_enviar_arquivo() completa o último quadro com bytes de
+//            um arquivo via sendfile(), sem passar pela memória do processo.
+//            O envio passa por transporte.h: o descritor pode ser um socket
+//            TCP ou UNIX ou uma conexão por memória compartilhada.
+//
+//            Dois modos de envio:
+//              ENVIO_INTERATIVO - TCP_NODELAY ligado; quem usa descarrega
+//                                 ao fim de cada rajada (ex.: cada linha
+//                                 ou colagem do teclado), então cada
+//                                 mensagem sai na hora.
+//              ENVIO_VAZAO      - Nagle ligado e MSG_MORE enquanto quem
+//                                 usa avisa que há mais por vir; o kernel
+//                                 junta os quadros em segmentos cheios.
+//
+//            Com saida_reter(), os bytes enviados continuam no buffer até o
+//            outro lado confirmar que os recebeu (saida_confirmar), para
+//            serem reenviados por saida_retomar() se a conexão cair (ver a
+//            retomada em protocolo.h). `fluxo_inicio` é a posição de
+//            dados[0] no fluxo de saída. O que sai por sendfile() não fica
+//            no buffer: a janela recomeça depois desses bytes.
+//
+//            Com `rastro` diferente de zero, cada quadro vai para o rastro
+//            de sessão (--rastro) ao ser enfileirado.
+// ============================================================================
+
+#ifndef SAIDA_H
+#define SAIDA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// No modo vazão, quem usa descarrega antes do fim da rajada (com MSG_MORE)
+// quando o buffer passa deste tamanho
+#define SAIDA_LOTE (64 * 1024)
+
+typedef enum {
+    ENVIO_INTERATIVO = 0,
+    ENVIO_VAZAO = 1
+} ModoEnvio;
+
+typedef struct {
+    uint8_t *dados;
+    size_t tamanho;    // Fim dos bytes enfileirados
+    size_t enviado;    // Bytes do início já enviados
+    size_t capacidade;
+    ModoEnvio modo;
+    size_t retido_max;     // 0 = não retém o enviado
+    size_t confirmado;     // Bytes do início já confirmados (só com retenção)
+    uint64_t fluxo_inicio; // Posição de dados[0] no fluxo de saída
+    uint64_t rastro;       // Conexão no rastro (rastro.h) dos quadros enfileirados; 0 = nenhum
+} SaidaQuadros;
+
+void saida_iniciar(SaidaQuadros *saida, ModoEnvio modo);
+void saida_liberar(SaidaQuadros *saida);
+int saida_configurar_socket(int fd, ModoEnvio modo);
+uint8_t *saida_reservar(SaidaQuadros *saida, size_t total);
+void saida_avancar(SaidaQuadros *saida, size_t total);
+int saida_enfileirar(SaidaQuadros *saida, uint8_t tipo, const char *corpo, size_t tamanho);
+size_t saida_pendente(const SaidaQuadros *saida);
+int saida_descarregar(SaidaQuadros *saida, int fd, int mais);
+int saida_enviar_arquivo(SaidaQuadros *saida, int fd, int arquivo, off_t *posicao,
+                         size_t tamanho);
+void saida_reter(SaidaQuadros *saida, size_t maximo);
+uint64_t saida_fluxo_enviado(const SaidaQuadros *saida);
+size_t saida_nao_confirmado(const SaidaQuadros *saida);
+void saida_confirmar(SaidaQuadros *saida, uint64_t fluxo);
+int saida_retomar(SaidaQuadros *saida, uint64_t fluxo);
+int saida_reiniciar_fluxo(SaidaQuadros *saida, const uint8_t *prefixo, size_t tamanho);
+int saida_modo_ler(const char *nome, ModoEnvio *modo);
+const char *saida_modo_nome(ModoEnvio modo);
+
+#endif
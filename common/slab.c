@@ -0,0 +1,153 @@
+// ============================================================================
+// ARQUIVO: slab.c
+//
+// DESCRIÇÃO: Implementação do alocador de blocos por classes de tamanho
+//            (ver slab.h).
+// ============================================================================
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "slab.h"
+#include "metricas.h"
+
+#define SLAB_CABECALHO 16             // Guarda a classe; mantém o alinhamento de 16
+#define SLAB_CLASSES 6
+#define SLAB_PEDACO (1024 * 1024)     // Memória pedida ao malloc de cada vez
+#define SLAB_CACHE_BYTES (256 * 1024) // Quanto cada thread guarda por classe
+#define SLAB_CACHE_MAX 256
+#define SLAB_CACHE_MIN 4
+#define SLAB_FORA UINT32_MAX          // Classe dos blocos que vieram do malloc
+
+// Tamanho total dos blocos de cada classe, com o cabeçalho. A maior cabe um
+// quadro de PROTOCOLO_PAYLOAD_MAX com o cabeçalho do BufferCompartilhado.
+static const size_t tamanhos[SLAB_CLASSES] = { 64, 256, 1024, 4096, 16384, 68 * 1024 };
+
+// Bloco livre: o elo fica depois do cabeçalho, que guarda a classe
+typedef struct BlocoLivre {
+    struct BlocoLivre *proximo;
+} BlocoLivre;
+
+typedef struct {
+    pthread_mutex_t trava;
+    BlocoLivre *livres;
+} Deposito;
+
+typedef struct {
+    void *blocos[SLAB_CACHE_MAX];
+    int total;
+} CacheClasse;
+
+#define DEPOSITO_VAZIO { PTHREAD_MUTEX_INITIALIZER, NULL }
+static Deposito depositos[SLAB_CLASSES] = {
+    DEPOSITO_VAZIO, DEPOSITO_VAZIO, DEPOSITO_VAZIO,
+    DEPOSITO_VAZIO, DEPOSITO_VAZIO, DEPOSITO_VAZIO
+};
+static _Thread_local CacheClasse caches[SLAB_CLASSES];
+
+// Função para saber quantos blocos de uma classe o cache de uma thread guarda
+static int limite_cache(int classe) {
+    size_t limite = SLAB_CACHE_BYTES / tamanhos[classe];
+    if (limite > SLAB_CACHE_MAX) limite = SLAB_CACHE_MAX;
+    if (limite < SLAB_CACHE_MIN) limite = SLAB_CACHE_MIN;
+    return (int)limite;
+}
+
+// Função para obter o elo de um bloco livre (depois do cabeçalho)
+static BlocoLivre *elo(void *bloco) {
+    return (BlocoLivre *)((uint8_t *)bloco + SLAB_CABECALHO);
+}
+
+// Função para encher metade do cache de uma thread com blocos do depósito,
+// cortando um pedaço novo se o depósito não tiver o bastante. Com a trava
+// do depósito.
+static void recarregar(int classe, CacheClasse *cache) {
+    Deposito *deposito = &depositos[classe];
+    int lote = limite_cache(classe) / 2;
+    metricas_somar(METRICA_SLAB_RECARGAS, 1);
+
+    pthread_mutex_lock(&deposito->trava);
+    while (cache->total < lote) {
+        if (deposito->livres == NULL) {
+            uint8_t *pedaco = malloc(SLAB_PEDACO);
+            if (pedaco == NULL) break;
+            metricas_ajustar(MEDIDOR_SLAB_RESERVADO, SLAB_PEDACO);
+            size_t total = SLAB_PEDACO / tamanhos[classe];
+            for (size_t i = 0; i < total; i++) {
+                void *bloco = pedaco + i * tamanhos[classe];
+                *(uint32_t *)bloco = (uint32_t)classe;
+                elo(bloco)->proximo = deposito->livres;
+                deposito->livres = bloco;
+            }
+        }
+        void *bloco = deposito->livres;
+        deposito->livres = elo(bloco)->proximo;
+        cache->blocos[cache->total++] = bloco;
+    }
+    pthread_mutex_unlock(&deposito->trava);
+}
+
+// Função para devolver ao depósito os `quantos` blocos do topo do cache
+static void devolver(int classe, CacheClasse *cache, int quantos) {
+    Deposito *deposito = &depositos[classe];
+    metricas_somar(METRICA_SLAB_RECARGAS, 1);
+
+    pthread_mutex_lock(&deposito->trava);
+    while (quantos-- > 0 && cache->total > 0) {
+        void *bloco = cache->blocos[--cache->total];
+        elo(bloco)->proximo = deposito->livres;
+        deposito->livres = bloco;
+    }
+    pthread_mutex_unlock(&deposito->trava);
+}
+
+// Função para alocar `tamanho` bytes alinhados a 16, da menor classe em que
+// eles cabem (ou do malloc, se não couberem em nenhuma)
+// Retorna NULL se faltou memória
+void *slab_alocar(size_t tamanho) {
+    size_t total = tamanho + SLAB_CABECALHO;
+    int classe = 0;
+    while (classe < SLAB_CLASSES && tamanhos[classe] < total) classe++;
+    if (classe == SLAB_CLASSES) {
+        uint8_t *bloco = malloc(total);
+        if (bloco == NULL) return NULL;
+        metricas_somar(METRICA_SLAB_FORA, 1);
+        *(uint32_t *)bloco = SLAB_FORA;
+        return bloco + SLAB_CABECALHO;
+    }
+
+    CacheClasse *cache = &caches[classe];
+    if (cache->total == 0) {
+        recarregar(classe, cache);
+        if (cache->total == 0) return NULL;
+    }
+    uint8_t *bloco = cache->blocos[--cache->total];
+    metricas_ajustar(MEDIDOR_SLAB_EM_USO, (int64_t)tamanhos[classe]);
+    return bloco + SLAB_CABECALHO;
+}
+
+// Função para liberar um bloco de slab_alocar(), de qualquer thread
+void slab_liberar(void *bloco) {
+    if (bloco == NULL) return;
+    uint8_t *inicio = (uint8_t *)bloco - SLAB_CABECALHO;
+    uint32_t classe = *(uint32_t *)inicio;
+    if (classe == SLAB_FORA) {
+        free(inicio);
+        return;
+    }
+
+    CacheClasse *cache = &caches[classe];
+    int limite = limite_cache((int)classe);
+    if (cache->total == limite) devolver((int)classe, cache, limite / 2);
+    cache->blocos[cache->total++] = inicio;
+    metricas_ajustar(MEDIDOR_SLAB_EM_USO, -(int64_t)tamanhos[classe]);
+}
+
+// Função para devolver ao depósito todos os blocos no cache da thread que
+// chama (antes de ela terminar, para que não fiquem presos)
+void slab_esvaziar_cache(void) {
+    for (int classe = 0; classe < SLAB_CLASSES; classe++) {
+        if (caches[classe].total > 0) devolver(classe, &caches[classe], caches[classe].total);
+    }
+}
@@ -0,0 +1,33 @@
+// ============================================================================
+// ARQUIVO: slab.h
+//
+// DESCRIÇÃO: Alocador de blocos por classes de tamanho, para a memória do
+//            caminho das mensagens (quadros compartilhados do servidor e as
+//            mensagens entregues às interfaces).
+//
+//            Cada classe tem um depósito global, protegido por uma trava,
+//            e cada thread tem um cache próprio por classe. Alocar e liberar
+//            só tocam o cache; o depósito é visitado a cada lote de blocos,
+//            quando o cache esvazia ou enche. Um bloco liberado por outra
+//            thread (o quadro que um shard criou e outro terminou de
+//            enviar) vai para o cache de quem o liberou.
+//
+//            Os blocos saem de pedaços grandes pedidos ao malloc e nunca
+//            voltam a ele: depois do pico, a memória fica estável e o
+//            caminho das mensagens não chama o malloc. Pedidos maiores que
+//            a maior classe caem no malloc e são contados.
+//
+//            As métricas slab_reservado_bytes e slab_em_uso_bytes mostram a
+//            utilização; slab_recargas_total conta as visitas ao depósito.
+// ============================================================================
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+void *slab_alocar(size_t tamanho);
+void slab_liberar(void *bloco);
+void slab_esvaziar_cache(void);
+
+#endif
@@ -0,0 +1,785 @@
+// ============================================================================
+// ARQUIVO: transporte.c
+//
+// DESCRIÇÃO: Implementação dos transportes TCP, UNIX e por memória
+//            compartilhada (ver transporte.h).
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <linux/futex.h>
+
+#include "transporte.h"
+
+#define MEMORIA_MAGICO 0x414e454cu     // "ANEL"
+#define MEMORIA_CABECALHO 4096         // Os dados dos anéis começam na página seguinte
+#define MEMORIA_ESPERA_MS 1000         // Cochilo máximo do cliente entre conferências do socket
+#define MEMORIA_ARQUIVO_BLOCO (64 * 1024)
+
+// Tabela de conexões por memória, indexada pelo descritor. As páginas são
+// criadas sob demanda e nunca liberadas; cada entrada só é escrita pela
+// thread dona do descritor, antes de outras threads o usarem.
+#define TABELA_PAGINA 1024
+#define TABELA_PAGINAS 1024
+
+// Um sentido do anel. Produtor e consumidor escrevem em linhas de cache
+// diferentes.
+typedef struct {
+    _Atomic uint64_t escrito;   // Só o produtor muda
+    uint8_t separa_escrito[56];
+    _Atomic uint64_t lido;      // Só o consumidor muda
+    _Atomic uint32_t esperando; // O produtor encheu o anel e quer um aviso de espaço
+    uint8_t separa_lido[52];
+} AnelBytes;
+
+// Selos do memfd: o tamanho não muda mais (um ftruncate do outro lado
+// faria o próximo acesso à região morrer com SIGBUS) e ninguém tira os selos
+#define MEMORIA_SELOS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+// Início do memfd compartilhado; os dados de `ida` e `volta` vêm depois
+// de MEMORIA_CABECALHO bytes
+typedef struct {
+    uint32_t magico;
+    uint32_t capacidade;              // Bytes de cada anel (potência de 2)
+    _Atomic uint32_t sinal_cliente;   // Futex: muda a cada aviso ao cliente
+    _Atomic uint32_t cliente_dormindo;
+    _Atomic uint32_t servidor_avisado; // eventfd do servidor escrito e ainda não visto
+    _Atomic uint32_t fechado;          // Um dos lados fechou a conexão
+    uint8_t separa[40];
+    AnelBytes ida;   // Cliente -> servidor
+    AnelBytes volta; // Servidor -> cliente
+} RegiaoMemoria;
+
+// Estado local de uma conexão por memória
+typedef struct {
+    RegiaoMemoria *regiao;
+    size_t tamanho_regiao;
+    uint32_t capacidade; // Cópia local: a região pode ser escrita pelo outro processo
+    int servidor;  // Este processo é o lado do servidor
+    int aviso_fd;  // eventfd que acorda o servidor (lido por ele)
+    int espaco_fd; // eventfd que avisa o cliente de espaço em `ida`
+    AnelBytes *saida;
+    AnelBytes *entrada;
+    uint8_t *dados_saida;
+    uint8_t *dados_entrada;
+    _Atomic int interrompida; // transporte_interromper(): a recepção retorna 0
+} ConexaoMemoria;
+
+typedef _Atomic(ConexaoMemoria *) EntradaTabela;
+static _Atomic(EntradaTabela *) paginas[TABELA_PAGINAS];
+
+// Função para obter a conexão por memória de um descritor
+// Retorna NULL se o descritor é um socket comum
+static ConexaoMemoria *buscar_conexao(int fd) {
+    if (fd < 0 || fd >= TABELA_PAGINA * TABELA_PAGINAS) return NULL;
+    EntradaTabela *pagina = atomic_load_explicit(&paginas[fd / TABELA_PAGINA],
+                                                 memory_order_acquire);
+    if (pagina == NULL) return NULL;
+    return atomic_load_explicit(&pagina[fd % TABELA_PAGINA], memory_order_acquire);
+}
+
+// Função para ligar (ou desligar, com NULL) uma conexão por memória ao descritor
+// Retorna -1 se o descritor é alto demais ou faltou memória
+static int guardar_conexao(int fd, ConexaoMemoria *c) {
+    if (fd < 0 || fd >= TABELA_PAGINA * TABELA_PAGINAS) {
+        errno = EMFILE;
+        return -1;
+    }
+    _Atomic(EntradaTabela *) *lugar = &paginas[fd / TABELA_PAGINA];
+    EntradaTabela *pagina = atomic_load_explicit(lugar, memory_order_acquire);
+    if (pagina == NULL) {
+        if (c == NULL) return 0;
+        EntradaTabela *nova = calloc(TABELA_PAGINA, sizeof(EntradaTabela));
+        if (nova == NULL) return -1;
+        if (atomic_compare_exchange_strong(lugar, &pagina, nova)) {
+            pagina = nova;
+        } else {
+            free(nova); // Outra thread criou a página primeiro
+        }
+    }
+    atomic_store_explicit(&pagina[fd % TABELA_PAGINA], c, memory_order_release);
+    return 0;
+}
+
+// Função para chamar o futex (entre processos: sem FUTEX_PRIVATE_FLAG)
+static long futex(_Atomic uint32_t *endereco, int operacao, uint32_t valor,
+                  const struct timespec *prazo) {
+    return syscall(SYS_futex, (uint32_t *)endereco, operacao, valor, prazo, NULL, 0);
+}
+
+// Função para somar 1 a um eventfd
+static void sinalizar(int evento_fd) {
+    uint64_t um = 1;
+    if (write(evento_fd, &um, sizeof(um)) < 0 && errno != EAGAIN) {
+        perror("[ERRO] Falha ao sinalizar a conexão por memória");
+    }
+}
+
+// Função para esvaziar um eventfd não bloqueante
+static void drenar(int evento_fd) {
+    uint64_t contador;
+    while (read(evento_fd, &contador, sizeof(contador)) > 0) {
+    }
+}
+
+// Função para acordar o servidor: o eventfd só é escrito se ele ainda não
+// foi avisado desde a última vez que olhou o anel
+static void acordar_servidor(ConexaoMemoria *c) {
+    if (!atomic_exchange(&c->regiao->servidor_avisado, 1)) sinalizar(c->aviso_fd);
+}
+
+// Função para acordar o cliente; o futex só é chamado se ele dorme
+static void acordar_cliente(ConexaoMemoria *c) {
+    atomic_fetch_add(&c->regiao->sinal_cliente, 1);
+    if (atomic_load(&c->regiao->cliente_dormindo)) {
+        futex(&c->regiao->sinal_cliente, FUTEX_WAKE, INT_MAX, NULL);
+    }
+}
+
+// Função para avisar o outro lado de que há dados no anel de saída
+static void avisar_dados(ConexaoMemoria *c) {
+    if (c->servidor) acordar_cliente(c);
+    else acordar_servidor(c);
+}
+
+// Função para avisar o produtor do anel de entrada, se ele pediu, de que
+// há espaço de novo
+static void avisar_espaco(ConexaoMemoria *c) {
+    if (!atomic_load_explicit(&c->entrada->esperando, memory_order_relaxed) ||
+        !atomic_exchange(&c->entrada->esperando, 0)) {
+        return;
+    }
+    if (c->servidor) sinalizar(c->espaco_fd);
+    else acordar_servidor(c);
+}
+
+// Função para copiar para o anel de saída o que couber das partes, a
+// partir do byte `pular`
+// Retorna quantos bytes foram copiados
+static size_t anel_escrever(ConexaoMemoria *c, const struct iovec *partes, int total,
+                            size_t pular) {
+    uint32_t capacidade = c->capacidade;
+    uint64_t escrito = atomic_load_explicit(&c->saida->escrito, memory_order_relaxed);
+    uint64_t lido = atomic_load_explicit(&c->saida->lido, memory_order_acquire);
+    // Posições fora do lugar (o outro processo pode escrever qualquer
+    // coisa) nunca levam a cópia para fora do anel
+    size_t ocupado = (size_t)(escrito - lido);
+    size_t livre = ocupado < capacidade ? capacidade - ocupado : 0;
+    size_t copiados = 0;
+
+    for (int i = 0; i < total && livre > 0; i++) {
+        const uint8_t *origem = partes[i].iov_base;
+        size_t tamanho = partes[i].iov_len;
+        if (pular >= tamanho) {
+            pular -= tamanho;
+            continue;
+        }
+        origem += pular;
+        tamanho -= pular;
+        pular = 0;
+        if (tamanho > livre) tamanho = livre;
+        size_t posicao = (size_t)(escrito + copiados) & (capacidade - 1);
+        size_t ate_o_fim = capacidade - posicao;
+        if (tamanho <= ate_o_fim) {
+            memcpy(c->dados_saida + posicao, origem, tamanho);
+        } else {
+            memcpy(c->dados_saida + posicao, origem, ate_o_fim);
+            memcpy(c->dados_saida, origem + ate_o_fim, tamanho - ate_o_fim);
+        }
+        copiados += tamanho;
+        livre -= tamanho;
+    }
+    if (copiados > 0) {
+        atomic_store_explicit(&c->saida->escrito, escrito + copiados, memory_order_seq_cst);
+    }
+    return copiados;
+}
+
+// Função para tirar até `tamanho` bytes do anel de entrada
+// Retorna quantos bytes foram lidos
+static size_t anel_ler(ConexaoMemoria *c, uint8_t *destino, size_t tamanho) {
+    uint32_t capacidade = c->capacidade;
+    uint64_t lido = atomic_load_explicit(&c->entrada->lido, memory_order_relaxed);
+    uint64_t escrito = atomic_load_explicit(&c->entrada->escrito, memory_order_acquire);
+    size_t disponivel = (size_t)(escrito - lido);
+    if (disponivel > capacidade) disponivel = capacidade;
+    if (tamanho > disponivel) tamanho = disponivel;
+    if (tamanho == 0) return 0;
+
+    size_t posicao = (size_t)lido & (capacidade - 1);
+    size_t ate_o_fim = capacidade - posicao;
+    if (tamanho <= ate_o_fim) {
+        memcpy(destino, c->dados_entrada + posicao, tamanho);
+    } else {
+        memcpy(destino, c->dados_entrada + posicao, ate_o_fim);
+        memcpy(destino + ate_o_fim, c->dados_entrada, tamanho - ate_o_fim);
+    }
+    atomic_store_explicit(&c->entrada->lido, lido + tamanho, memory_order_seq_cst);
+    return tamanho;
+}
+
+// Função para saber se há bytes no anel de entrada
+static int anel_tem_dados(ConexaoMemoria *c) {
+    return atomic_load(&c->entrada->escrito) != atomic_load(&c->entrada->lido);
+}
+
+// Função para saber se há espaço no anel de saída
+static int anel_tem_espaco(ConexaoMemoria *c) {
+    return atomic_load(&c->saida->escrito) - atomic_load(&c->saida->lido) < c->capacidade;
+}
+
+// Função para saber se o outro lado do socket da apresentação fechou
+static int socket_fechado(int fd) {
+    char byte;
+    return recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == 0;
+}
+
+// Função para escrever no anel. Sem `bloquear`, escreve o que couber e
+// retorna (EAGAIN se nada coube, com o aviso de espaço pedido); com
+// `bloquear` (só o cliente), espera espaço até escrever tudo.
+// Retorna os bytes escritos ou -1 em erro
+static ssize_t enviar_memoria(int fd, ConexaoMemoria *c, const struct iovec *partes,
+                              int total, int bloquear) {
+    size_t tamanho = 0;
+    for (int i = 0; i < total; i++) tamanho += partes[i].iov_len;
+    size_t enviados = 0;
+
+    while (1) {
+        if (atomic_load(&c->regiao->fechado)) {
+            errno = EPIPE;
+            return -1;
+        }
+        size_t n = anel_escrever(c, partes, total, enviados);
+        if (n > 0) {
+            enviados += n;
+            avisar_dados(c);
+        }
+        if (enviados == tamanho || (enviados > 0 && !bloquear)) return (ssize_t)enviados;
+
+        // Anel cheio: pede o aviso de espaço e confere de novo, para não
+        // perder um consumo que aconteceu no meio
+        if (!c->servidor) drenar(c->espaco_fd);
+        atomic_store(&c->saida->esperando, 1);
+        if (anel_tem_espaco(c)) continue;
+        if (!bloquear) {
+            errno = EAGAIN;
+            return -1;
+        }
+        struct pollfd espera = { c->espaco_fd, POLLIN, 0 };
+        if (poll(&espera, 1, MEMORIA_ESPERA_MS) == 0 && socket_fechado(fd)) {
+            errno = EPIPE;
+            return -1;
+        }
+    }
+}
+
+// Função para ler do anel. Sem `bloquear` (sempre, no servidor), retorna
+// EAGAIN se o anel está vazio; com `bloquear`, o cliente dorme no futex,
+// conferindo de tempos em tempos se o servidor não sumiu sem avisar.
+// Retorna os bytes lidos, 0 se a conexão fechou ou -1 em erro
+static ssize_t receber_memoria(int fd, ConexaoMemoria *c, void *destino, size_t tamanho,
+                               int bloquear) {
+    RegiaoMemoria *r = c->regiao;
+    if (c->servidor && atomic_load_explicit(&r->servidor_avisado, memory_order_relaxed)) {
+        // Zerado antes de olhar o anel: o que o cliente escrever depois
+        // disso sinaliza o eventfd de novo
+        atomic_store(&r->servidor_avisado, 0);
+        drenar(c->aviso_fd);
+    }
+
+    while (1) {
+        size_t n = anel_ler(c, destino, tamanho);
+        if (n > 0) {
+            avisar_espaco(c);
+            return (ssize_t)n;
+        }
+        if (atomic_load(&r->fechado) || atomic_load(&c->interrompida)) return 0;
+        if (!bloquear) {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        uint32_t sinal = atomic_load(&r->sinal_cliente);
+        atomic_store(&r->cliente_dormindo, 1);
+        int dormiu = 0;
+        if (!anel_tem_dados(c) && !atomic_load(&r->fechado) && !atomic_load(&c->interrompida)) {
+            struct timespec prazo = { MEMORIA_ESPERA_MS / 1000, (MEMORIA_ESPERA_MS % 1000) * 1000000L };
+            dormiu = futex(&r->sinal_cliente, FUTEX_WAIT, sinal, &prazo) < 0 &&
+                     errno == ETIMEDOUT;
+        }
+        atomic_store(&r->cliente_dormindo, 0);
+        if (dormiu && !anel_tem_dados(c) && socket_fechado(fd)) return 0;
+    }
+}
+
+// Função para liberar o estado local de uma conexão por memória
+static void liberar_conexao(ConexaoMemoria *c) {
+    if (c->regiao != NULL) munmap(c->regiao, c->tamanho_regiao);
+    if (c->aviso_fd >= 0) close(c->aviso_fd);
+    if (c->espaco_fd >= 0) close(c->espaco_fd);
+    free(c);
+}
+
+// Função para preparar o estado local sobre uma região já mapeada
+static void ligar_aneis(ConexaoMemoria *c) {
+    uint8_t *base = (uint8_t *)c->regiao + MEMORIA_CABECALHO;
+    uint32_t capacidade = c->capacidade;
+    if (c->servidor) {
+        c->saida = &c->regiao->volta;
+        c->entrada = &c->regiao->ida;
+        c->dados_saida = base + capacidade;
+        c->dados_entrada = base;
+    } else {
+        c->saida = &c->regiao->ida;
+        c->entrada = &c->regiao->volta;
+        c->dados_saida = base;
+        c->dados_entrada = base + capacidade;
+    }
+}
+
+// Função para interpretar uma URI tcp://host:porta, unix://caminho ou
+// shm://caminho (o caminho de "unix:///tmp/chat.sock" é "/tmp/chat.sock")
+// Retorna -1 se a URI é inválida
+int transporte_ler_uri(const char *uri, EnderecoTransporte *endereco) {
+    memset(endereco, 0, sizeof(*endereco));
+    const char *resto;
+    if (strncmp(uri, "tcp://", 6) == 0) {
+        resto = uri + 6;
+        const char *separador = strrchr(resto, ':');
+        if (separador == NULL || separador == resto) return -1;
+        const char *host = resto;
+        size_t tamanho_host = (size_t)(separador - resto);
+        if (host[0] == '[' && tamanho_host >= 2 && host[tamanho_host - 1] == ']') {
+            host++; // [::1]:8080
+            tamanho_host -= 2;
+        }
+        if (tamanho_host == 0 || tamanho_host >= TRANSPORTE_HOST_MAX) return -1;
+        char host_copia[TRANSPORTE_HOST_MAX];
+        memcpy(host_copia, host, tamanho_host);
+        host_copia[tamanho_host] = '\0';
+        return transporte_ler_host_porta(host_copia, separador + 1, endereco);
+    }
+    if (strncmp(uri, "unix://", 7) == 0) {
+        endereco->tipo = TRANSPORTE_UNIX;
+        resto = uri + 7;
+    } else if (strncmp(uri, "shm://", 6) == 0) {
+        endereco->tipo = TRANSPORTE_MEMORIA;
+        resto = uri + 6;
+    } else {
+        return -1;
+    }
+    size_t tamanho = strlen(resto);
+    if (tamanho == 0 || tamanho >= TRANSPORTE_CAMINHO_MAX) return -1;
+    memcpy(endereco->caminho, resto, tamanho + 1);
+    return 0;
+}
+
+// Função para montar um endereço TCP a partir de host e porta separados
+// Retorna -1 se algum dos dois é inválido
+int transporte_ler_host_porta(const char *host, const char *porta, EnderecoTransporte *endereco) {
+    memset(endereco, 0, sizeof(*endereco));
+    endereco->tipo = TRANSPORTE_TCP;
+    char *fim;
+    long numero = strtol(porta, &fim, 10);
+    if (*porta == '\0' || *fim != '\0' || numero <= 0 || numero > 65535 ||
+        strlen(host) == 0 || strlen(host) >= TRANSPORTE_HOST_MAX) {
+        return -1;
+    }
+    snprintf(endereco->host, TRANSPORTE_HOST_MAX, "%s", host);
+    snprintf(endereco->porta, sizeof(endereco->porta), "%ld", numero);
+    return 0;
+}
+
+// Função para descrever um endereço para a tela ("127.0.0.1:8080",
+// "unix:///tmp/chat.sock"...)
+void transporte_descrever(const EnderecoTransporte *endereco, char *destino, size_t capacidade) {
+    if (endereco->tipo == TRANSPORTE_TCP) {
+        int ipv6 = strchr(endereco->host, ':') != NULL;
+        snprintf(destino, capacidade, ipv6 ? "[%s]:%s" : "%s:%s", endereco->host, endereco->porta);
+    } else {
+        snprintf(destino, capacidade, "%s://%s", transporte_nome(endereco->tipo),
+                 endereco->caminho);
+    }
+}
+
+// Função para obter o nome (o esquema da URI) de um transporte
+const char *transporte_nome(TipoTransporte tipo) {
+    switch (tipo) {
+        case TRANSPORTE_UNIX: return "unix";
+        case TRANSPORTE_MEMORIA: return "shm";
+        default: return "tcp";
+    }
+}
+
+// Função para montar o endereço de um socket UNIX
+static socklen_t endereco_unix(const char *caminho, struct sockaddr_un *destino) {
+    memset(destino, 0, sizeof(*destino));
+    destino->sun_family = AF_UNIX;
+    snprintf(destino->sun_path, sizeof(destino->sun_path), "%s", caminho);
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + strlen(destino->sun_path) + 1);
+}
+
+// Função para aplicar um prazo (segundos; 0 = sem prazo) ao connect() e
+// às leituras e escritas de um socket bloqueante
+static void aplicar_prazo(int fd, int segundos) {
+    struct timeval prazo = { segundos, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &prazo, sizeof(prazo));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &prazo, sizeof(prazo));
+}
+
+// Função para conectar por TCP, tentando cada endereço do nome em ordem
+// Retorna o socket ou -1
+static int conectar_tcp(const EnderecoTransporte *endereco, int prazo_segundos) {
+    struct addrinfo dicas, *enderecos;
+    memset(&dicas, 0, sizeof(dicas));
+    dicas.ai_family = AF_UNSPEC;
+    dicas.ai_socktype = SOCK_STREAM;
+    int erro = getaddrinfo(endereco->host, endereco->porta, &dicas, &enderecos);
+    if (erro != 0) {
+        fprintf(stderr, "[ERRO] Endereço inválido: %s (%s)\n", endereco->host, gai_strerror(erro));
+        errno = EHOSTUNREACH;
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo *e = enderecos; e != NULL; e = e->ai_next) {
+        fd = socket(e->ai_family, e->ai_socktype | SOCK_CLOEXEC, e->ai_protocol);
+        if (fd < 0) continue;
+        if (prazo_segundos > 0) aplicar_prazo(fd, prazo_segundos);
+        if (connect(fd, e->ai_addr, e->ai_addrlen) == 0) break;
+        int erro_connect = errno;
+        close(fd);
+        fd = -1;
+        errno = erro_connect;
+    }
+    freeaddrinfo(enderecos);
+    return fd;
+}
+
+// Função para receber do servidor, pelo socket da apresentação, o memfd
+// com os anéis e os dois eventfds
+// Retorna -1 se a resposta não veio ou é inválida
+static int receber_memoria_servidor(int fd) {
+    uint32_t cabecalho[2];
+    struct iovec parte = { cabecalho, sizeof(cabecalho) };
+    union {
+        struct cmsghdr alinhamento;
+        char espaco[CMSG_SPACE(3 * sizeof(int))];
+    } controle;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &parte;
+    msg.msg_iovlen = 1;
+    msg.msg_control = controle.espaco;
+    msg.msg_controllen = sizeof(controle.espaco);
+
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    } while (n < 0 && errno == EINTR);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (n != (ssize_t)sizeof(cabecalho) || cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET ||
+        cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        if (n >= 0) errno = EPROTO;
+        return -1;
+    }
+    int fds[3];
+    memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+    ConexaoMemoria *c = calloc(1, sizeof(ConexaoMemoria));
+    uint32_t capacidade = cabecalho[1];
+    size_t tamanho = MEMORIA_CABECALHO + 2 * (size_t)capacidade;
+    struct stat info;
+    int selos = fcntl(fds[0], F_GET_SEALS);
+    if (c == NULL || cabecalho[0] != MEMORIA_MAGICO || capacidade == 0 ||
+        (capacidade & (capacidade - 1)) != 0 || selos < 0 ||
+        (selos & MEMORIA_SELOS) != MEMORIA_SELOS || fstat(fds[0], &info) < 0 ||
+        (size_t)info.st_size < tamanho) {
+        if (c != NULL) errno = EPROTO;
+        free(c);
+        for (int i = 0; i < 3; i++) close(fds[i]);
+        return -1;
+    }
+    c->regiao = mmap(NULL, tamanho, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    c->aviso_fd = fds[1];
+    c->espaco_fd = fds[2];
+    c->tamanho_regiao = tamanho;
+    c->capacidade = capacidade;
+    if (c->regiao == MAP_FAILED) {
+        c->regiao = NULL;
+        liberar_conexao(c);
+        return -1;
+    }
+    if (c->regiao->magico != MEMORIA_MAGICO || c->regiao->capacidade != capacidade) {
+        liberar_conexao(c);
+        errno = EPROTO;
+        return -1;
+    }
+    ligar_aneis(c);
+    if (guardar_conexao(fd, c) < 0) {
+        liberar_conexao(c);
+        return -1;
+    }
+    return 0;
+}
+
+// Função para conectar ao servidor, com prazo para o connect() e para as
+// leituras e escritas (0 = sem prazo; quem chama pode desfazê-lo depois).
+// Na memória compartilhada, o socket devolvido já tem o anel ligado.
+// Retorna o descritor (bloqueante) ou -1 com errno
+int transporte_conectar(const EnderecoTransporte *endereco, int prazo_segundos) {
+    if (endereco->tipo == TRANSPORTE_TCP) return conectar_tcp(endereco, prazo_segundos);
+
+    struct sockaddr_un local;
+    socklen_t tamanho = endereco_unix(endereco->caminho, &local);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (prazo_segundos > 0) aplicar_prazo(fd, prazo_segundos);
+    if (connect(fd, (struct sockaddr *)&local, tamanho) < 0 ||
+        (endereco->tipo == TRANSPORTE_MEMORIA && receber_memoria_servidor(fd) < 0)) {
+        int erro = errno;
+        close(fd);
+        errno = erro;
+        return -1;
+    }
+    return fd;
+}
+
+// Função para obter o endereço de socket de um transporte TCP (o primeiro
+// que o nome resolve) ou UNIX, para quem abre conexões não bloqueantes
+// Retorna -1 se não resolveu ou se o transporte é por memória
+int transporte_resolver(const EnderecoTransporte *endereco, struct sockaddr_storage *destino,
+                        socklen_t *tamanho) {
+    memset(destino, 0, sizeof(*destino));
+    if (endereco->tipo == TRANSPORTE_UNIX) {
+        *tamanho = endereco_unix(endereco->caminho, (struct sockaddr_un *)destino);
+        return 0;
+    }
+    if (endereco->tipo != TRANSPORTE_TCP) return -1;
+    struct addrinfo dicas, *enderecos;
+    memset(&dicas, 0, sizeof(dicas));
+    dicas.ai_family = AF_UNSPEC;
+    dicas.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(endereco->host, endereco->porta, &dicas, &enderecos) != 0) return -1;
+    memcpy(destino, enderecos->ai_addr, enderecos->ai_addrlen);
+    *tamanho = enderecos->ai_addrlen;
+    freeaddrinfo(enderecos);
+    return 0;
+}
+
+// Função para obter o que esperar no poll() até a conexão aceitar mais
+// bytes: o próprio socket com POLLOUT ou, na memória compartilhada, o
+// eventfd do aviso de espaço com POLLIN
+// Retorna o descritor a esperar
+int transporte_fd_envio(int fd, short *eventos) {
+    ConexaoMemoria *c = buscar_conexao(fd);
+    if (c == NULL) {
+        *eventos = POLLOUT;
+        return fd;
+    }
+    *eventos = POLLIN;
+    return c->espaco_fd;
+}
+
+// Função para acordar quem está parado em transporte_receber() (shutdown
+// do socket, e também do futex do anel)
+void transporte_interromper(int fd, int como) {
+    shutdown(fd, como);
+    ConexaoMemoria *c = buscar_conexao(fd);
+    if (c == NULL) return;
+    atomic_store(&c->interrompida, 1);
+    atomic_fetch_add(&c->regiao->sinal_cliente, 1);
+    futex(&c->regiao->sinal_cliente, FUTEX_WAKE, INT_MAX, NULL);
+}
+
+// Função para abrir o socket de escuta de um transporte local (UNIX ou
+// memória), não bloqueante. Um arquivo de socket que sobrou de uma
+// execução anterior é removido.
+// Retorna o socket ou -1
+int transporte_escutar(const EnderecoTransporte *endereco, int backlog) {
+    if (endereco->tipo == TRANSPORTE_TCP) {
+        errno = EINVAL;
+        return -1;
+    }
+    struct sockaddr_un local;
+    socklen_t tamanho = endereco_unix(endereco->caminho, &local);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    struct stat info;
+    if (lstat(endereco->caminho, &info) == 0 && S_ISSOCK(info.st_mode)) {
+        unlink(endereco->caminho);
+    }
+    if (bind(fd, (struct sockaddr *)&local, tamanho) < 0 || listen(fd, backlog) < 0) {
+        int erro = errno;
+        close(fd);
+        errno = erro;
+        return -1;
+    }
+    return fd;
+}
+
+// Função para dar a uma conexão recém-aceita no socket de memória os seus
+// anéis: cria o memfd (selado no tamanho, ver MEMORIA_SELOS) e os eventfds
+// e os manda ao cliente (SCM_RIGHTS).
+// Um socket recém-aceito tem o buffer de envio vazio, então o sendmsg()
+// não bloqueia.
+// Retorna -1 se falhou (o socket continua aberto)
+int transporte_servir_memoria(int fd) {
+    ConexaoMemoria *c = calloc(1, sizeof(ConexaoMemoria));
+    if (c == NULL) return -1;
+    c->servidor = 1;
+    c->aviso_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    // Começa sinalizado: como o POLLOUT de um socket, fica pronto até o
+    // cliente achar o anel cheio (enviar_memoria o esvazia nessa hora)
+    c->espaco_fd = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+    c->tamanho_regiao = MEMORIA_CABECALHO + 2 * (size_t)TRANSPORTE_ANEL_BYTES;
+    int memoria = memfd_create("chat-anel", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (c->aviso_fd < 0 || c->espaco_fd < 0 || memoria < 0 ||
+        ftruncate(memoria, (off_t)c->tamanho_regiao) < 0 ||
+        fcntl(memoria, F_ADD_SEALS, MEMORIA_SELOS) < 0) {
+        if (memoria >= 0) close(memoria);
+        liberar_conexao(c);
+        return -1;
+    }
+    c->regiao = mmap(NULL, c->tamanho_regiao, PROT_READ | PROT_WRITE, MAP_SHARED, memoria, 0);
+    if (c->regiao == MAP_FAILED) {
+        c->regiao = NULL;
+        close(memoria);
+        liberar_conexao(c);
+        return -1;
+    }
+    c->regiao->magico = MEMORIA_MAGICO;
+    c->regiao->capacidade = c->capacidade = TRANSPORTE_ANEL_BYTES;
+    ligar_aneis(c);
+
+    uint32_t cabecalho[2] = { MEMORIA_MAGICO, TRANSPORTE_ANEL_BYTES };
+    struct iovec parte = { cabecalho, sizeof(cabecalho) };
+    union {
+        struct cmsghdr alinhamento;
+        char espaco[CMSG_SPACE(3 * sizeof(int))];
+    } controle;
+    memset(&controle, 0, sizeof(controle));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &parte;
+    msg.msg_iovlen = 1;
+    msg.msg_control = controle.espaco;
+    msg.msg_controllen = sizeof(controle.espaco);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    int fds[3] = { memoria, c->aviso_fd, c->espaco_fd };
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    close(memoria); // O mapeamento segura a memória
+    if (n != (ssize_t)sizeof(cabecalho) || guardar_conexao(fd, c) < 0) {
+        liberar_conexao(c);
+        return -1;
+    }
+    return 0;
+}
+
+// Função para obter o eventfd que acorda o servidor para uma conexão por
+// memória; ele vai ao epoll no lugar do socket
+// Retorna -1 se o descritor é um socket comum
+int transporte_fd_aviso(int fd) {
+    ConexaoMemoria *c = buscar_conexao(fd);
+    return c != NULL ? c->aviso_fd : -1;
+}
+
+// Função para dar por visto o aviso de uma conexão por memória, antes de
+// olhar os dois anéis: o que o cliente escrever ou consumir depois disso
+// sinaliza o eventfd de novo
+void transporte_atender_aviso(int fd) {
+    ConexaoMemoria *c = buscar_conexao(fd);
+    if (c == NULL || !atomic_load_explicit(&c->regiao->servidor_avisado, memory_order_relaxed)) {
+        return;
+    }
+    atomic_store(&c->regiao->servidor_avisado, 0);
+    drenar(c->aviso_fd);
+}
+
+// Função para saber se um descritor é de uma conexão por memória
+int transporte_memoria(int fd) {
+    return buscar_conexao(fd) != NULL;
+}
+
+// Função para enviar como send()
+// Retorna os bytes enviados ou -1 com errno
+ssize_t transporte_enviar(int fd, const void *dados, size_t tamanho, int flags) {
+    ConexaoMemoria *c = buscar_conexao(fd);
+    if (c == NULL) return send(fd, dados, tamanho, flags);
+    struct iovec parte = { (void *)dados, tamanho };
+    return enviar_memoria(fd, c, &parte, 1, !c->servidor && !(flags & MSG_DONTWAIT));
+}
+
+// Função para enviar várias partes como sendmsg()
+// Retorna os bytes enviados ou -1 com errno
+ssize_t transporte_enviar_iov(int fd, const struct iovec *partes, int total, int flags) {
+    ConexaoMemoria *c = buscar_conexao(fd);
+    if (c == NULL) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (struct iovec *)partes;
+        msg.msg_iovlen = (size_t)total;
+        return sendmsg(fd, &msg, flags);
+    }
+    return enviar_memoria(fd, c, partes, total, !c->servidor && !(flags & MSG_DONTWAIT));
+}
+
+// Função para enviar bytes de um arquivo como sendfile(). No anel não há
+// atalho pelo kernel: o bloco é lido para a memória e copiado para o anel.
+// Retorna os bytes enviados ou -1 com errno
+ssize_t transporte_enviar_arquivo(int fd, int arquivo, off_t *posicao, size_t tamanho) {
+    ConexaoMemoria *c = buscar_conexao(fd);
+    if (c == NULL) return sendfile(fd, arquivo, posicao, tamanho);
+    uint8_t bloco[MEMORIA_ARQUIVO_BLOCO];
+    if (tamanho > sizeof(bloco)) tamanho = sizeof(bloco);
+    ssize_t lidos = pread(arquivo, bloco, tamanho, *posicao);
+    if (lidos <= 0) return lidos;
+    struct iovec parte = { bloco, (size_t)lidos };
+    ssize_t n = enviar_memoria(fd, c, &parte, 1, !c->servidor);
+    if (n > 0) *posicao += n;
+    return n;
+}
+
+// Função para receber como recv() (das flags, o anel só olha MSG_DONTWAIT)
+// Retorna os bytes recebidos, 0 se a conexão fechou ou -1 com errno
+ssize_t transporte_receber(int fd, void *destino, size_t tamanho, int flags) {
+    ConexaoMemoria *c = buscar_conexao(fd);
+    if (c == NULL) return recv(fd, destino, tamanho, flags);
+    return receber_memoria(fd, c, destino, tamanho, !c->servidor && !(flags & MSG_DONTWAIT));
+}
+
+// Função para fechar uma conexão de qualquer transporte. Na memória
+// compartilhada, o outro lado é avisado pelo anel antes de o socket fechar.
+void transporte_fechar(int fd) {
+    ConexaoMemoria *c = buscar_conexao(fd);
+    if (c != NULL) {
+        guardar_conexao(fd, NULL);
+        atomic_store(&c->regiao->fechado, 1);
+        if (c->servidor) acordar_cliente(c);
+        else acordar_servidor(c);
+        liberar_conexao(c);
+    }
+    close(fd);
+}
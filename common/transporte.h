@@ -0,0 +1,86 @@
+// ============================================================================
+// ARQUIVO: transporte.h
+//
+// DESCRIÇÃO: Transportes de uma conexão entre cliente e servidor, escolhidos
+//            por URI:
+//              tcp://host:porta   - TCP (IPv4, IPv6 ou nome); "host porta"
+//                                   continua valendo na linha de comando
+//              unix:///caminho    - socket UNIX de fluxo, para quem roda na
+//                                   mesma máquina que o servidor
+//              shm:///caminho     - memória compartilhada: o cliente se
+//                                   apresenta pelo socket UNIX do caminho e
+//                                   recebe do servidor um memfd com dois
+//                                   anéis SPSC de bytes, um por sentido; os
+//                                   quadros não passam mais pelo kernel
+//
+//            Quem usa continua falando em descritores: a conexão por
+//            memória também tem um (o socket da apresentação, que só serve
+//            para notar a queda do outro lado), e transporte_enviar() e
+//            transporte_receber() trocam send()/recv() nos caminhos de
+//            envio e recepção, indo ao anel quando o descritor tem um.
+//
+//            Acordar quem dorme no anel: o cliente espera dados com um futex
+//            na própria memória compartilhada (só há chamada ao kernel se ele
+//            estiver dormindo); o servidor multiplexa tudo em um epoll e é
+//            acordado por um eventfd, escrito uma vez até ele voltar a olhar
+//            o anel. Quem enche o anel pede um aviso de espaço: o servidor
+//            o recebe pelo mesmo eventfd, o cliente por um segundo eventfd,
+//            que a thread principal espera no poll() no lugar do POLLOUT
+//            (ver transporte_fd_envio). O lado do servidor nunca bloqueia;
+//            o do cliente bloqueia sem MSG_DONTWAIT, como um socket.
+// ============================================================================
+
+#ifndef TRANSPORTE_H
+#define TRANSPORTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define TRANSPORTE_HOST_MAX 256
+#define TRANSPORTE_CAMINHO_MAX 108 // sun_path
+#define TRANSPORTE_DESCRICAO_MAX (TRANSPORTE_HOST_MAX + 16)
+#define TRANSPORTE_ANEL_BYTES (1024 * 1024) // Capacidade de cada sentido do anel
+
+typedef enum {
+    TRANSPORTE_TCP = 0,
+    TRANSPORTE_UNIX = 1,
+    TRANSPORTE_MEMORIA = 2
+} TipoTransporte;
+
+typedef struct {
+    TipoTransporte tipo;
+    char host[TRANSPORTE_HOST_MAX];      // TCP
+    char porta[8];                       // TCP
+    char caminho[TRANSPORTE_CAMINHO_MAX]; // UNIX e memória
+} EnderecoTransporte;
+
+int transporte_ler_uri(const char *uri, EnderecoTransporte *endereco);
+int transporte_ler_host_porta(const char *host, const char *porta, EnderecoTransporte *endereco);
+void transporte_descrever(const EnderecoTransporte *endereco, char *destino, size_t capacidade);
+const char *transporte_nome(TipoTransporte tipo);
+
+// Cliente
+int transporte_conectar(const EnderecoTransporte *endereco, int prazo_segundos);
+int transporte_resolver(const EnderecoTransporte *endereco, struct sockaddr_storage *destino,
+                        socklen_t *tamanho);
+int transporte_fd_envio(int fd, short *eventos);
+void transporte_interromper(int fd, int como);
+
+// Servidor
+int transporte_escutar(const EnderecoTransporte *endereco, int backlog);
+int transporte_servir_memoria(int fd);
+int transporte_fd_aviso(int fd);
+void transporte_atender_aviso(int fd);
+
+// Os dois lados
+int transporte_memoria(int fd);
+ssize_t transporte_enviar(int fd, const void *dados, size_t tamanho, int flags);
+ssize_t transporte_enviar_iov(int fd, const struct iovec *partes, int total, int flags);
+ssize_t transporte_enviar_arquivo(int fd, int arquivo, off_t *posicao, size_t tamanho);
+ssize_t transporte_receber(int fd, void *destino, size_t tamanho, int flags);
+void transporte_fechar(int fd);
+
+#endif
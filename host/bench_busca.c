@@ -0,0 +1,285 @@
+// ============================================================================
+// ARQUIVO: bench_busca.c
+//
+// DESCRIÇÃO: Medição do índice de busca ("./server --bench-busca DIR").
+//
+//            Enche o histórico de DIR com mensagens sintéticas (palavras
+//            de um vocabulário com frequências de Zipf, salas e autores
+//            sorteados) pelo mesmo caminho dos shards, espera o índice
+//            alcançar o histórico e então mede consultas de vários tipos,
+//            feitas por um membro de uma sala sorteada (a da consulta, se
+//            ela filtra por sala), do início de busca_procurar() até o
+//            buffer de resposta pronto.
+//            Tudo fica em disco, em DIR: rodar de novo com o mesmo DIR mede
+//            o índice reaberto, com mais mensagens.
+//
+//            Saída: uma linha CSV por tipo de consulta (latências em µs) e
+//            um resumo da indexação na saída de erro.
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "protocolo.h"
+#include "buffer.h"
+#include "historico.h"
+#include "busca.h"
+#include "metricas.h"
+#include "bench_busca.h"
+
+#define BENCH_VOCABULARIO 50000
+#define BENCH_SALAS 100
+#define BENCH_AUTORES 5000
+#define BENCH_TIPOS 5
+
+static const char *nomes_tipos[BENCH_TIPOS] = {
+    "rara", "duas_comuns", "comum_sala", "autor_palavra", "tres_medias"
+};
+
+static uint64_t estado_aleatorio = 88172645463325252ull;
+static double acumulada[BENCH_VOCABULARIO]; // Distribuição de Zipf das palavras
+
+// Função para sortear um número (xorshift64)
+static uint64_t sortear() {
+    estado_aleatorio ^= estado_aleatorio << 13;
+    estado_aleatorio ^= estado_aleatorio >> 7;
+    estado_aleatorio ^= estado_aleatorio << 17;
+    return estado_aleatorio;
+}
+
+// Função para sortear um inteiro em [0, limite)
+static size_t sortear_ate(size_t limite) {
+    return (size_t)(sortear() % limite);
+}
+
+// Função para montar a distribuição acumulada de Zipf (s = 1)
+static void preparar_zipf() {
+    double soma = 0;
+    for (size_t i = 0; i < BENCH_VOCABULARIO; i++) {
+        soma += 1.0 / (double)(i + 1);
+        acumulada[i] = soma;
+    }
+    for (size_t i = 0; i < BENCH_VOCABULARIO; i++) acumulada[i] /= soma;
+}
+
+// Função para sortear a posição de uma palavra segundo a distribuição
+static size_t sortear_palavra() {
+    double u = (double)(sortear() >> 11) / (double)(1ull << 53);
+    size_t baixo = 0, alto = BENCH_VOCABULARIO - 1;
+    while (baixo < alto) {
+        size_t meio = (baixo + alto) / 2;
+        if (acumulada[meio] < u) baixo = meio + 1;
+        else alto = meio;
+    }
+    return baixo;
+}
+
+// Função para escrever a palavra de posição `i` ("p" e a posição em base 36)
+// Retorna o tamanho escrito
+static size_t escrever_palavra(char *destino, size_t i) {
+    char digitos[16];
+    size_t n = 0;
+    do {
+        digitos[n++] = "0123456789abcdefghijklmnopqrstuvwxyz"[i % 36];
+        i /= 36;
+    } while (i > 0);
+    destino[0] = 'p';
+    for (size_t k = 0; k < n; k++) destino[1 + k] = digitos[n - 1 - k];
+    return 1 + n;
+}
+
+// Função para comparar amostras na ordenação
+static int comparar_amostras(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Função para somar o tamanho dos arquivos do índice em `diretorio`
+static uint64_t tamanho_indice(const char *diretorio) {
+    DIR *dir = opendir(diretorio);
+    if (dir == NULL) return 0;
+    uint64_t total = 0;
+    struct dirent *entrada;
+    while ((entrada = readdir(dir)) != NULL) {
+        size_t n = strlen(entrada->d_name);
+        if (n < 6 || strcmp(entrada->d_name + n - 6, ".busca") != 0) continue;
+        struct stat info;
+        if (fstatat(dirfd(dir), entrada->d_name, &info, 0) == 0) total += (uint64_t)info.st_size;
+    }
+    closedir(dir);
+    return total;
+}
+
+// Função para gravar `total` mensagens sintéticas no histórico, pelo
+// produtor 0, esperando a fila esvaziar quando ela enche
+// Retorna -1 se faltou memória
+static int gerar_mensagens(long total, BufferCompartilhado **salas) {
+    char corpo[512], autor[32];
+    for (long m = 0; m < total; m++) {
+        size_t tamanho = 0;
+        int palavras = 4 + (int)sortear_ate(9);
+        for (int k = 0; k < palavras; k++) {
+            if (k > 0) corpo[tamanho++] = ' ';
+            tamanho += escrever_palavra(corpo + tamanho, sortear_palavra());
+        }
+        snprintf(autor, sizeof(autor), "user%zu", sortear_ate(BENCH_AUTORES));
+        BufferCompartilhado *quadro = buffer_criar(protocolo_tamanho_quadro(strlen(autor), tamanho));
+        if (quadro == NULL) return -1;
+        protocolo_codificar(quadro->dados, QUADRO_CHAT, autor, corpo, tamanho);
+        BufferCompartilhado *sala = salas[sortear_ate(BENCH_SALAS)];
+        while (!historico_registrar(0, HISTORICO_SALA, sala, quadro)) {
+            historico_publicar(0);
+            usleep(200);
+        }
+        buffer_soltar(quadro);
+        if (m % 256 == 255) historico_publicar(0);
+    }
+    historico_publicar(0);
+    return 0;
+}
+
+// Função para montar uma consulta do tipo `tipo` (o de sala filtra por `sala`)
+// Retorna o tamanho da consulta
+static size_t montar_consulta(int tipo, size_t sala, char *consulta) {
+    size_t n = 0;
+    switch (tipo) {
+        case 0: // Uma palavra da cauda
+            n = escrever_palavra(consulta, 20000 + sortear_ate(BENCH_VOCABULARIO - 20000));
+            break;
+        case 1: // Duas das 100 mais frequentes
+            n = escrever_palavra(consulta, sortear_ate(100));
+            consulta[n++] = ' ';
+            n += escrever_palavra(consulta + n, sortear_ate(100));
+            break;
+        case 2: // Uma frequente em uma sala
+            n = escrever_palavra(consulta, sortear_ate(100));
+            n += (size_t)sprintf(consulta + n, " #sala%zu", sala);
+            break;
+        case 3: // Um autor e uma palavra média
+            n = (size_t)sprintf(consulta, "@user%zu ", sortear_ate(BENCH_AUTORES));
+            n += escrever_palavra(consulta + n, 100 + sortear_ate(1900));
+            break;
+        default: // Três palavras médias
+            for (int k = 0; k < 3; k++) {
+                if (k > 0) consulta[n++] = ' ';
+                n += escrever_palavra(consulta + n, 100 + sortear_ate(1900));
+            }
+            break;
+    }
+    return n;
+}
+
+// Função principal da medição do índice ("--bench-busca DIR [opções]")
+int executar_bench_busca(int argc, char *argv[]) {
+    long mensagens = 1000000;
+    int consultas = 1000;
+    static struct option opcoes[] = {
+        {"mensagens", required_argument, 0, 'n'},
+        {"consultas", required_argument, 0, 'c'},
+        {0, 0, 0, 0}
+    };
+    int opcao;
+    optind = 2;
+    while ((opcao = getopt_long(argc, argv, "n:c:", opcoes, NULL)) != -1) {
+        switch (opcao) {
+            case 'n':
+                mensagens = atol(optarg);
+                break;
+            case 'c':
+                consultas = atoi(optarg);
+                break;
+            default:
+                mensagens = -1;
+                break;
+        }
+    }
+    if (optind >= argc || mensagens < 0 || consultas <= 0) {
+        fprintf(stderr, "Uso: %s --bench-busca DIR [--mensagens N] [--consultas N]\n", argv[0]);
+        return 1;
+    }
+    const char *diretorio = argv[optind];
+
+    preparar_zipf();
+    BufferCompartilhado *salas[BENCH_SALAS];
+    for (int i = 0; i < BENCH_SALAS; i++) {
+        char nome[16];
+        int n = snprintf(nome, sizeof(nome), "sala%d", i);
+        salas[i] = buffer_copiar(nome, (size_t)n);
+        if (salas[i] == NULL) {
+            perror("[ERRO] Não foi possível criar as salas");
+            return 1;
+        }
+    }
+    if (historico_iniciar(diretorio, 1, FSYNC_NUNCA) < 0) return 1;
+    if (busca_iniciar(diretorio) < 0) {
+        historico_finalizar();
+        return 1;
+    }
+
+    uint64_t antes, segmentos_antes;
+    size_t segmentos, termos;
+    busca_estatisticas(&antes, &segmentos, &termos);
+    segmentos_antes = segmentos;
+    uint64_t inicio = metricas_agora();
+    if (gerar_mensagens(mensagens, salas) < 0) {
+        perror("[ERRO] Não foi possível gerar as mensagens");
+    }
+    uint64_t gerado = metricas_agora();
+    uint64_t indexadas = antes;
+    while (indexadas < antes + (uint64_t)mensagens) {
+        usleep(1000);
+        busca_estatisticas(&indexadas, &segmentos, &termos);
+    }
+    uint64_t indexado = metricas_agora();
+    double segundos = (double)(indexado - inicio) / 1e9;
+    fprintf(stderr, "[BENCH] %ld mensagens gravadas em %.2f s e indexadas em %.2f s "
+                    "(%.0f mensagens/s); índice com %zu segmentos (antes %llu), %.1f MB em disco\n",
+            mensagens, (double)(gerado - inicio) / 1e9, segundos,
+            segundos > 0 ? (double)mensagens / segundos : 0.0, segmentos,
+            (unsigned long long)segmentos_antes, (double)tamanho_indice(diretorio) / 1e6);
+
+    uint64_t *amostras = malloc((size_t)consultas * sizeof(uint64_t));
+    if (amostras == NULL) {
+        perror("[ERRO] Não foi possível alocar as amostras");
+        busca_finalizar();
+        historico_finalizar();
+        return 1;
+    }
+    printf("consulta,consultas,p50_us,p99_us,max_us,media_resultados\n");
+    for (int tipo = 0; tipo < BENCH_TIPOS; tipo++) {
+        uint64_t resultados = 0;
+        for (int i = 0; i < consultas; i++) {
+            char consulta[128];
+            size_t sala = sortear_ate(BENCH_SALAS);
+            size_t tamanho = montar_consulta(tipo, sala, consulta);
+            uint64_t sequencias[BUSCA_RESULTADOS_MAX];
+            uint64_t t0 = metricas_agora();
+            int achadas = busca_procurar(consulta, tamanho, (const char *)salas[sala]->dados,
+                                         salas[sala]->tamanho, sequencias, BUSCA_RESULTADOS_MAX);
+            BufferCompartilhado *resposta = historico_montar(sequencias, achadas,
+                                                             (const char *)salas[sala]->dados,
+                                                             salas[sala]->tamanho, &achadas);
+            amostras[i] = metricas_agora() - t0;
+            if (resposta != NULL) buffer_soltar(resposta);
+            resultados += (uint64_t)achadas;
+        }
+        qsort(amostras, (size_t)consultas, sizeof(uint64_t), comparar_amostras);
+        printf("%s,%d,%.1f,%.1f,%.1f,%.1f\n", nomes_tipos[tipo], consultas,
+               (double)amostras[consultas / 2] / 1e3,
+               (double)amostras[(size_t)((double)(consultas - 1) * 0.99)] / 1e3,
+               (double)amostras[consultas - 1] / 1e3, (double)resultados / consultas);
+    }
+    free(amostras);
+
+    busca_finalizar();
+    historico_finalizar();
+    for (int i = 0; i < BENCH_SALAS; i++) buffer_soltar(salas[i]);
+    return 0;
+}
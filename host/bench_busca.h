@@ -0,0 +1,13 @@
+// ============================================================================
+// ARQUIVO: bench_busca.h
+//
+// DESCRIÇÃO: Medição do índice de busca em disco, sem rede
+//            (./server --bench-busca DIR, bench_busca.c).
+// ============================================================================
+
+#ifndef BENCH_BUSCA_H
+#define BENCH_BUSCA_H
+
+int executar_bench_busca(int argc, char *argv[]);
+
+#endif
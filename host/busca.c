@@ -0,0 +1,1109 @@
+// ============================================================================
+// ARQUIVO: busca.c
+//
+// DESCRIÇÃO: Índice invertido das mensagens do histórico (ver busca.h).
+//
+//            Só a thread da busca escreve: na tabela da memória, com a
+//            trava de escrita, um lote de registros por vez; e nos
+//            arquivos, sem trava, trocando a lista de segmentos no fim. As
+//            consultas (shards atendendo /search) seguram a trava de
+//            leitura do começo ao fim, então um segmento trocado por uma
+//            fusão só é desmapeado depois que nenhuma consulta o usa.
+//
+//            Uma lista de postings na memória tem o mesmo formato que no
+//            disco (diferenças em varint e a tabela de saltos), então gravar
+//            a tabela é copiar bytes, e a consulta lê as duas do mesmo jeito.
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#include "protocolo.h"
+#include "historico.h"
+#include "busca.h"
+
+#define BUSCA_NOME_MAX 256 // Termo com prefixo: '#' ou '@' e até 255 bytes
+
+// Lista de postings de um termo na tabela da memória
+typedef struct {
+    uint64_t hash;
+    uint64_t ultimo;        // Última sequência da lista
+    uint8_t *dados;         // Diferenças em varint
+    size_t usado, capacidade;
+    SaltoBloco *saltos;     // Um por bloco, sempre (no disco, só se houver mais de um)
+    uint32_t total_saltos, capacidade_saltos;
+    uint32_t total;
+    uint8_t tamanho;
+    char nome[];
+} TermoMemoria;
+
+// Tabela dos termos ainda não gravados: hash com endereçamento aberto
+typedef struct {
+    TermoMemoria **baldes;
+    size_t capacidade;      // Potência de 2
+    size_t total;
+    size_t bytes;           // Memória usada pelos termos
+    uint64_t primeira;      // Sequências já percorridas pela tabela
+    uint64_t ultima;        // 0 = nenhuma
+} TabelaMemoria;
+
+// Segmento imutável em disco
+typedef struct {
+    CabecalhoBusca cabecalho;
+    uint8_t *mapa;
+    const EntradaTermo *dicionario;
+    const char *nomes;
+    char caminho[PATH_MAX];
+} SegmentoBusca;
+
+// Leitura de uma lista de postings, da memória ou do disco
+typedef struct {
+    const uint8_t *dados, *fim, *p;
+    const SaltoBloco *saltos; // NULL = um bloco só
+    uint32_t blocos;
+    uint32_t total;
+    uint32_t lidos;
+    uint64_t atual;           // Última sequência lida
+} CursorPostings;
+
+// Montagem de um segmento novo: as listas vão para o arquivo uma a uma, o
+// dicionário e os nomes ficam na memória até o fim
+typedef struct {
+    FILE *arquivo;
+    char caminho[PATH_MAX];
+    char temporario[PATH_MAX];
+    uint64_t posicao;
+    EntradaTermo *dicionario;
+    size_t total_termos, capacidade_termos;
+    char *nomes;
+    size_t tamanho_nomes, capacidade_nomes;
+    // Lista do termo atual, nas fusões
+    uint8_t *dados;
+    size_t usado, capacidade;
+    SaltoBloco *saltos;
+    size_t total_saltos, capacidade_saltos;
+    uint64_t anterior;
+    uint32_t total;
+    int erro;
+} EscritorSegmento;
+
+static char diretorio_busca[PATH_MAX - 64]; // Sobra para "/<primeira>-<última>.busca.tmp"
+static int ativa = 0;
+static int evento_fd = -1;
+static pthread_t thread_busca;
+static volatile int parar = 0;
+
+// Protegidos pela trava (escritos só pela thread da busca)
+static pthread_rwlock_t trava = PTHREAD_RWLOCK_INITIALIZER;
+static TabelaMemoria *memoria = NULL;
+static TabelaMemoria *congelada = NULL; // Sendo gravada em disco
+static SegmentoBusca *segmentos_busca[BUSCA_MAX_SEGMENTOS];
+static size_t total_segmentos_busca = 0;
+
+static uint64_t proxima_sequencia = 1; // Primeira que o índice ainda não viu
+static _Atomic uint64_t indexadas = 0;
+
+// Função para escrever um número em varint (7 bits por byte)
+// Retorna quantos bytes foram usados (no máximo 10)
+static size_t escrever_varint(uint8_t *destino, uint64_t valor) {
+    size_t n = 0;
+    while (valor >= 0x80) {
+        destino[n++] = (uint8_t)(valor | 0x80);
+        valor >>= 7;
+    }
+    destino[n++] = (uint8_t)valor;
+    return n;
+}
+
+// Função para ler um varint sem passar de `fim`
+// Retorna o byte seguinte, ou NULL se o número está cortado
+static const uint8_t *ler_varint(const uint8_t *p, const uint8_t *fim, uint64_t *valor) {
+    uint64_t resultado = 0;
+    for (int deslocamento = 0; p < fim && deslocamento < 64; deslocamento += 7) {
+        uint8_t byte = *p++;
+        resultado |= (uint64_t)(byte & 0x7f) << deslocamento;
+        if (!(byte & 0x80)) {
+            *valor = resultado;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// Função de hash FNV-1a dos nomes de termo
+static uint64_t hash_termo(const char *nome, size_t tamanho) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < tamanho; i++) {
+        h ^= (uint8_t)nome[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// Função para comparar dois nomes de termo byte a byte (o mais curto
+// primeiro, se um for prefixo do outro)
+static int comparar_nomes(const char *a, size_t tamanho_a, const char *b, size_t tamanho_b) {
+    int c = memcmp(a, b, tamanho_a < tamanho_b ? tamanho_a : tamanho_b);
+    if (c != 0) return c;
+    return (tamanho_a > tamanho_b) - (tamanho_a < tamanho_b);
+}
+
+// Função para saber se um byte faz parte de uma palavra: letras e dígitos
+// ASCII e qualquer byte de um caractere UTF-8 de mais de um byte
+static int eh_palavra(uint8_t c) {
+    return c >= 0x80 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+           (c >= 'A' && c <= 'Z');
+}
+
+// Função para achar a próxima palavra de `texto` a partir de *posicao,
+// copiando-a em minúsculas (só ASCII) para `termo`. Palavras maiores que
+// BUSCA_TERMO_MAX são puladas.
+// Retorna o tamanho da palavra, ou 0 se o texto acabou
+static size_t proxima_palavra(const uint8_t *texto, size_t tamanho, size_t *posicao,
+                              char *termo) {
+    size_t i = *posicao;
+    while (i < tamanho) {
+        while (i < tamanho && !eh_palavra(texto[i])) i++;
+        size_t inicio = i;
+        while (i < tamanho && eh_palavra(texto[i])) i++;
+        size_t n = i - inicio;
+        if (n == 0 || n > BUSCA_TERMO_MAX) continue;
+        for (size_t k = 0; k < n; k++) {
+            uint8_t c = texto[inicio + k];
+            termo[k] = (char)(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+        }
+        *posicao = i;
+        return n;
+    }
+    *posicao = i;
+    return 0;
+}
+
+// Função para criar uma tabela vazia que começa em `primeira`
+// Retorna NULL se faltou memória
+static TabelaMemoria *tabela_criar(uint64_t primeira) {
+    TabelaMemoria *t = calloc(1, sizeof(TabelaMemoria));
+    if (t == NULL) return NULL;
+    t->capacidade = 1024;
+    t->baldes = calloc(t->capacidade, sizeof(TermoMemoria *));
+    if (t->baldes == NULL) {
+        free(t);
+        return NULL;
+    }
+    t->primeira = primeira;
+    return t;
+}
+
+// Função para liberar uma tabela e seus termos
+static void tabela_liberar(TabelaMemoria *t) {
+    if (t == NULL) return;
+    for (size_t i = 0; i < t->capacidade; i++) {
+        TermoMemoria *termo = t->baldes[i];
+        if (termo == NULL) continue;
+        free(termo->dados);
+        free(termo->saltos);
+        free(termo);
+    }
+    free(t->baldes);
+    free(t);
+}
+
+// Função para achar o balde de um termo (ocupado por ele ou vazio)
+static size_t tabela_balde(const TabelaMemoria *t, const char *nome, size_t tamanho,
+                           uint64_t hash) {
+    size_t i = (size_t)hash & (t->capacidade - 1);
+    while (t->baldes[i] != NULL) {
+        const TermoMemoria *termo = t->baldes[i];
+        if (termo->hash == hash && termo->tamanho == tamanho &&
+            memcmp(termo->nome, nome, tamanho) == 0) {
+            break;
+        }
+        i = (i + 1) & (t->capacidade - 1);
+    }
+    return i;
+}
+
+// Função para dobrar a tabela quando passa da metade
+// Retorna -1 se faltou memória
+static int tabela_crescer(TabelaMemoria *t) {
+    size_t capacidade = t->capacidade * 2;
+    TermoMemoria **baldes = calloc(capacidade, sizeof(TermoMemoria *));
+    if (baldes == NULL) return -1;
+    for (size_t i = 0; i < t->capacidade; i++) {
+        TermoMemoria *termo = t->baldes[i];
+        if (termo == NULL) continue;
+        size_t j = (size_t)termo->hash & (capacidade - 1);
+        while (baldes[j] != NULL) j = (j + 1) & (capacidade - 1);
+        baldes[j] = termo;
+    }
+    free(t->baldes);
+    t->baldes = baldes;
+    t->bytes += (capacidade - t->capacidade) * sizeof(TermoMemoria *);
+    t->capacidade = capacidade;
+    return 0;
+}
+
+// Função para acrescentar `sequencia` à lista de um termo (criado se não
+// existir). A mesma sequência duas vezes seguidas entra uma vez só.
+// Retorna -1 se faltou memória
+static int tabela_acrescentar(TabelaMemoria *t, const char *nome, size_t tamanho,
+                              uint64_t sequencia) {
+    uint64_t hash = hash_termo(nome, tamanho);
+    size_t i = tabela_balde(t, nome, tamanho, hash);
+    TermoMemoria *termo = t->baldes[i];
+    if (termo == NULL) {
+        if ((t->total + 1) * 2 > t->capacidade) {
+            if (tabela_crescer(t) < 0) return -1;
+            i = tabela_balde(t, nome, tamanho, hash);
+        }
+        termo = calloc(1, sizeof(TermoMemoria) + tamanho);
+        if (termo == NULL) return -1;
+        termo->hash = hash;
+        termo->tamanho = (uint8_t)tamanho;
+        memcpy(termo->nome, nome, tamanho);
+        t->baldes[i] = termo;
+        t->total++;
+        t->bytes += sizeof(TermoMemoria) + tamanho;
+    }
+    if (termo->total > 0 && termo->ultimo == sequencia) return 0;
+
+    if (termo->total % BUSCA_BLOCO == 0) {
+        if (termo->total_saltos == termo->capacidade_saltos) {
+            uint32_t capacidade = termo->capacidade_saltos ? termo->capacidade_saltos * 2 : 1;
+            SaltoBloco *saltos = realloc(termo->saltos, capacidade * sizeof(SaltoBloco));
+            if (saltos == NULL) return -1;
+            t->bytes += (capacidade - termo->capacidade_saltos) * sizeof(SaltoBloco);
+            termo->saltos = saltos;
+            termo->capacidade_saltos = capacidade;
+        }
+        SaltoBloco salto = { 0, (uint32_t)termo->usado, 0 };
+        termo->saltos[termo->total_saltos++] = salto;
+    }
+    if (termo->usado + 10 > termo->capacidade) {
+        size_t capacidade = termo->capacidade ? termo->capacidade * 2 : 16;
+        uint8_t *dados = realloc(termo->dados, capacidade);
+        if (dados == NULL) return -1;
+        t->bytes += capacidade - termo->capacidade;
+        termo->dados = dados;
+        termo->capacidade = capacidade;
+    }
+    termo->usado += escrever_varint(termo->dados + termo->usado, sequencia - termo->ultimo);
+    termo->ultimo = sequencia;
+    termo->saltos[termo->total_saltos - 1].ultimo = sequencia;
+    termo->total++;
+    return 0;
+}
+
+// Função para indexar um registro do histórico: só mensagens de chat de
+// sala e de difusão (as privadas para o operador nunca são reenviadas)
+static void indexar_registro(TabelaMemoria *t, const RegistroHistorico *r) {
+    if (r->escopo != HISTORICO_SALA && r->escopo != HISTORICO_DIFUSAO) return;
+    const uint8_t *bytes = (const uint8_t *)(r + 1) + r->tamanho_sala;
+    Quadro quadro;
+    quadro.versao = bytes[0];
+    quadro.tipo = bytes[1];
+    quadro.flags = (uint16_t)(bytes[2] << 8 | bytes[3]);
+    quadro.tamanho = r->tamanho_quadro - PROTOCOLO_CABECALHO;
+    quadro.payload = bytes + PROTOCOLO_CABECALHO;
+    const char *origem, *corpo;
+    size_t tamanho_origem, tamanho_corpo;
+    if (quadro.tipo != QUADRO_CHAT ||
+        protocolo_separar_origem(&quadro, &origem, &tamanho_origem, &corpo, &tamanho_corpo) < 0) {
+        return;
+    }
+
+    char termo[BUSCA_NOME_MAX];
+    int falhou = 0;
+    if (r->tamanho_sala > 0) {
+        termo[0] = '#';
+        memcpy(termo + 1, r + 1, r->tamanho_sala);
+        falhou |= tabela_acrescentar(t, termo, 1 + (size_t)r->tamanho_sala, r->sequencia);
+    }
+    if (tamanho_origem > 0 && tamanho_origem < BUSCA_NOME_MAX) {
+        termo[0] = '@';
+        memcpy(termo + 1, origem, tamanho_origem);
+        falhou |= tabela_acrescentar(t, termo, 1 + tamanho_origem, r->sequencia);
+    }
+    size_t posicao = 0, tamanho;
+    while ((tamanho = proxima_palavra((const uint8_t *)corpo, tamanho_corpo, &posicao, termo)) > 0) {
+        falhou |= tabela_acrescentar(t, termo, tamanho, r->sequencia);
+    }
+    if (falhou) perror("[ERRO] Não foi possível indexar uma mensagem");
+}
+
+// Função para posicionar um cursor no início de uma lista guardada no
+// formato do disco (tabela de saltos só se houver mais de um bloco)
+static void cursor_lista(CursorPostings *c, const uint8_t *inicio, size_t tamanho,
+                         uint32_t total) {
+    c->blocos = (total + BUSCA_BLOCO - 1) / BUSCA_BLOCO;
+    c->saltos = c->blocos > 1 ? (const SaltoBloco *)inicio : NULL;
+    c->dados = c->blocos > 1 ? inicio + c->blocos * sizeof(SaltoBloco) : inicio;
+    c->fim = inicio + tamanho;
+    c->p = c->dados;
+    c->total = total;
+    c->lidos = 0;
+    c->atual = 0;
+}
+
+// Função para posicionar um cursor no início de uma lista da memória
+static void cursor_memoria(CursorPostings *c, const TermoMemoria *termo) {
+    c->blocos = termo->total_saltos;
+    c->saltos = termo->saltos;
+    c->dados = c->p = termo->dados;
+    c->fim = termo->dados + termo->usado;
+    c->total = termo->total;
+    c->lidos = 0;
+    c->atual = 0;
+}
+
+// Função para levar o cursor ao começo do bloco `b`
+static void cursor_bloco(CursorPostings *c, uint32_t b) {
+    c->p = c->dados + (c->saltos ? c->saltos[b].posicao : 0);
+    c->atual = b > 0 ? c->saltos[b - 1].ultimo : 0;
+    c->lidos = b * BUSCA_BLOCO;
+}
+
+// Função para ler a próxima sequência da lista
+// Retorna 0 se a lista acabou
+static int cursor_proximo(CursorPostings *c, uint64_t *sequencia) {
+    if (c->lidos >= c->total) return 0;
+    uint64_t diferenca;
+    const uint8_t *p = ler_varint(c->p, c->fim, &diferenca);
+    if (p == NULL) {
+        c->lidos = c->total; // Lista corrompida: termina aqui
+        return 0;
+    }
+    c->p = p;
+    c->atual += diferenca;
+    c->lidos++;
+    *sequencia = c->atual;
+    return 1;
+}
+
+// Função para achar o primeiro bloco a partir de `desde` cuja última
+// sequência é maior ou igual a `alvo`
+// Retorna c->blocos se nenhum é
+static uint32_t cursor_achar_bloco(const CursorPostings *c, uint32_t desde, uint64_t alvo) {
+    if (c->saltos == NULL) return desde < c->blocos ? desde : c->blocos;
+    uint32_t baixo = desde, alto = c->blocos;
+    while (baixo < alto) {
+        uint32_t meio = baixo + (alto - baixo) / 2;
+        if (c->saltos[meio].ultimo < alvo) baixo = meio + 1;
+        else alto = meio;
+    }
+    return baixo;
+}
+
+// Função para avançar até a primeira sequência maior ou igual a `alvo`. A
+// última lida conta, se já servir. Blocos inteiros abaixo do alvo são
+// pulados pela tabela de saltos, sem decodificar.
+// Retorna 0 se a lista acabou antes
+static int cursor_avancar(CursorPostings *c, uint64_t alvo, uint64_t *sequencia) {
+    if (c->lidos > 0 && c->atual >= alvo) {
+        *sequencia = c->atual;
+        return 1;
+    }
+    if (c->saltos != NULL) {
+        uint32_t atual = c->lidos > 0 ? (c->lidos - 1) / BUSCA_BLOCO : 0;
+        if (c->saltos[atual].ultimo < alvo) {
+            uint32_t b = cursor_achar_bloco(c, atual + 1, alvo);
+            if (b == c->blocos) {
+                c->lidos = c->total;
+                return 0;
+            }
+            cursor_bloco(c, b);
+        }
+    }
+    while (cursor_proximo(c, sequencia)) {
+        if (*sequencia >= alvo) return 1;
+    }
+    return 0;
+}
+
+// Função para levar o cursor, em qualquer direção, ao bloco que pode ter
+// `alvo` (o primeiro cuja última sequência não é menor)
+// Retorna 0 se nenhum bloco pode ter
+static int cursor_buscar(CursorPostings *c, uint64_t alvo) {
+    uint32_t b = cursor_achar_bloco(c, 0, alvo);
+    if (b == c->blocos) {
+        c->lidos = c->total;
+        return 0;
+    }
+    cursor_bloco(c, b);
+    return 1;
+}
+
+// Função para intersectar as listas de uma fonte (a primeira é a menor),
+// do bloco mais novo para o mais antigo da menor, até achar `faltam`
+// sequências visíveis para quem está em `sala`. As achadas vão para o fim
+// de `resultados[0..faltam)`.
+// Retorna quantas foram achadas
+static size_t intersectar(CursorPostings *c, size_t total, const char *sala, size_t tamanho_sala,
+                          uint64_t *resultados, size_t faltam) {
+    size_t achadas = 0;
+    CursorPostings *menor = &c[0];
+    for (uint32_t b = menor->blocos; b-- > 0 && achadas < faltam;) {
+        uint64_t bloco[BUSCA_BLOCO];
+        size_t n = 0;
+        cursor_bloco(menor, b);
+        while (n < BUSCA_BLOCO && cursor_proximo(menor, &bloco[n])) n++;
+        if (n == 0) continue;
+
+        size_t iguais = n;
+        for (size_t i = 1; i < total && iguais > 0; i++) {
+            if (!cursor_buscar(&c[i], bloco[0])) {
+                iguais = 0;
+                break;
+            }
+            size_t mantidas = 0;
+            for (size_t k = 0; k < iguais; k++) {
+                uint64_t sequencia;
+                if (!cursor_avancar(&c[i], bloco[k], &sequencia)) break;
+                if (sequencia == bloco[k]) bloco[mantidas++] = bloco[k];
+            }
+            iguais = mantidas;
+        }
+
+        // O índice tem as mensagens de todas as salas: as de outra sala não
+        // contam, e a interseção segue para blocos mais antigos
+        size_t visiveis = 0;
+        for (size_t k = 0; k < iguais; k++) {
+            if (historico_visivel(bloco[k], sala, tamanho_sala)) bloco[visiveis++] = bloco[k];
+        }
+        iguais = visiveis;
+
+        size_t usar = iguais < faltam - achadas ? iguais : faltam - achadas;
+        memcpy(resultados + faltam - achadas - usar, bloco + iguais - usar,
+               usar * sizeof(uint64_t));
+        achadas += usar;
+    }
+    return achadas;
+}
+
+// Função para procurar um termo no dicionário de um segmento
+// Retorna a entrada ou NULL
+static const EntradaTermo *segmento_procurar(const SegmentoBusca *seg, const char *nome,
+                                             size_t tamanho) {
+    size_t baixo = 0, alto = seg->cabecalho.total_termos;
+    while (baixo < alto) {
+        size_t meio = baixo + (alto - baixo) / 2;
+        const EntradaTermo *e = &seg->dicionario[meio];
+        int c = comparar_nomes(seg->nomes + e->nome, e->tamanho_nome, nome, tamanho);
+        if (c == 0) return e;
+        if (c < 0) baixo = meio + 1;
+        else alto = meio;
+    }
+    return NULL;
+}
+
+// Função para mapear um segmento gravado e conferir o cabeçalho
+// Retorna NULL se o arquivo não é um segmento íntegro
+static SegmentoBusca *abrir_segmento_busca(const char *caminho) {
+    int fd = open(caminho, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    struct stat info;
+    SegmentoBusca *seg = NULL;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(CabecalhoBusca)) goto fim;
+    uint8_t *mapa = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapa == MAP_FAILED) goto fim;
+
+    CabecalhoBusca cabecalho;
+    memcpy(&cabecalho, mapa, sizeof(cabecalho));
+    if (cabecalho.magico != BUSCA_MAGICO || cabecalho.versao != BUSCA_VERSAO ||
+        cabecalho.tamanho != (uint64_t)info.st_size ||
+        cabecalho.posicao_nomes > cabecalho.posicao_dicionario ||
+        cabecalho.posicao_dicionario % 8 != 0 ||
+        cabecalho.total_termos > (cabecalho.tamanho - cabecalho.posicao_dicionario) /
+                                 sizeof(EntradaTermo) ||
+        (seg = calloc(1, sizeof(SegmentoBusca))) == NULL) {
+        munmap(mapa, (size_t)info.st_size);
+        goto fim;
+    }
+    seg->cabecalho = cabecalho;
+    seg->mapa = mapa;
+    seg->dicionario = (const EntradaTermo *)(mapa + cabecalho.posicao_dicionario);
+    seg->nomes = (const char *)mapa + cabecalho.posicao_nomes;
+    snprintf(seg->caminho, sizeof(seg->caminho), "%s", caminho);
+fim:
+    close(fd);
+    return seg;
+}
+
+// Função para desmapear e liberar um segmento (apagando o arquivo, se pedido)
+static void fechar_segmento_busca(SegmentoBusca *seg, int apagar) {
+    if (apagar && unlink(seg->caminho) < 0) {
+        perror("[ERRO] Não foi possível apagar um segmento da busca");
+    }
+    munmap(seg->mapa, seg->cabecalho.tamanho);
+    free(seg);
+}
+
+// Função para montar o caminho de um segmento (extensão "busca" ou "busca.tmp")
+static void caminho_busca(char *destino, uint64_t primeira, uint64_t ultima,
+                          const char *extensao) {
+    snprintf(destino, PATH_MAX, "%s/%020llu-%020llu.%.11s", diretorio_busca,
+             (unsigned long long)primeira, (unsigned long long)ultima, extensao);
+}
+
+// Função para escrever bytes no segmento em montagem
+static void escritor_escrever(EscritorSegmento *e, const void *dados, size_t tamanho) {
+    if (tamanho > 0 && fwrite(dados, 1, tamanho, e->arquivo) != tamanho) e->erro = 1;
+    e->posicao += tamanho;
+}
+
+// Função para completar com zeros até um múltiplo de 8
+static void escritor_alinhar(EscritorSegmento *e) {
+    static const uint8_t zeros[8];
+    escritor_escrever(e, zeros, (8 - e->posicao % 8) % 8);
+}
+
+// Função para começar um segmento das sequências [primeira, ultima]; ele
+// é montado em um .tmp e só ganha o nome final em escritor_fechar()
+// Retorna -1 se o arquivo não pôde ser criado
+static int escritor_abrir(EscritorSegmento *e, uint64_t primeira, uint64_t ultima) {
+    memset(e, 0, sizeof(*e));
+    caminho_busca(e->caminho, primeira, ultima, "busca");
+    caminho_busca(e->temporario, primeira, ultima, "busca.tmp");
+    e->arquivo = fopen(e->temporario, "we");
+    if (e->arquivo == NULL) return -1;
+    CabecalhoBusca vazio;
+    memset(&vazio, 0, sizeof(vazio));
+    escritor_escrever(e, &vazio, sizeof(vazio)); // Preenchido no fim
+    return 0;
+}
+
+// Função para gravar a lista inteira de um termo, já no formato final
+// (`saltos` tem uma entrada por bloco; só vai para o arquivo se houver mais
+// de um)
+static void escritor_lista(EscritorSegmento *e, const char *nome, size_t tamanho_nome,
+                           uint32_t total, const SaltoBloco *saltos, size_t blocos,
+                           const uint8_t *dados, size_t usado) {
+    if (total == 0) return;
+    if (e->total_termos == e->capacidade_termos) {
+        size_t capacidade = e->capacidade_termos ? e->capacidade_termos * 2 : 4096;
+        EntradaTermo *dicionario = realloc(e->dicionario, capacidade * sizeof(EntradaTermo));
+        if (dicionario == NULL) {
+            e->erro = 1;
+            return;
+        }
+        e->dicionario = dicionario;
+        e->capacidade_termos = capacidade;
+    }
+    if (e->tamanho_nomes + tamanho_nome > e->capacidade_nomes) {
+        size_t capacidade = e->capacidade_nomes ? e->capacidade_nomes * 2 : 64 * 1024;
+        char *nomes = realloc(e->nomes, capacidade);
+        if (nomes == NULL) {
+            e->erro = 1;
+            return;
+        }
+        e->nomes = nomes;
+        e->capacidade_nomes = capacidade;
+    }
+
+    if (blocos > 1) escritor_alinhar(e); // A tabela é lida direto do mapeamento
+    EntradaTermo *entrada = &e->dicionario[e->total_termos++];
+    memset(entrada, 0, sizeof(*entrada));
+    entrada->postings = e->posicao;
+    entrada->nome = (uint32_t)e->tamanho_nomes;
+    entrada->total = total;
+    entrada->tamanho = (uint32_t)((blocos > 1 ? blocos * sizeof(SaltoBloco) : 0) + usado);
+    entrada->tamanho_nome = (uint8_t)tamanho_nome;
+    memcpy(e->nomes + e->tamanho_nomes, nome, tamanho_nome);
+    e->tamanho_nomes += tamanho_nome;
+
+    if (blocos > 1) escritor_escrever(e, saltos, blocos * sizeof(SaltoBloco));
+    escritor_escrever(e, dados, usado);
+}
+
+// Função para acrescentar uma sequência à lista em montagem (fusões)
+static void escritor_sequencia(EscritorSegmento *e, uint64_t sequencia) {
+    if (e->total % BUSCA_BLOCO == 0) {
+        if (e->total_saltos == e->capacidade_saltos) {
+            size_t capacidade = e->capacidade_saltos ? e->capacidade_saltos * 2 : 64;
+            SaltoBloco *saltos = realloc(e->saltos, capacidade * sizeof(SaltoBloco));
+            if (saltos == NULL) {
+                e->erro = 1;
+                return;
+            }
+            e->saltos = saltos;
+            e->capacidade_saltos = capacidade;
+        }
+        SaltoBloco salto = { 0, (uint32_t)e->usado, 0 };
+        e->saltos[e->total_saltos++] = salto;
+    }
+    if (e->usado + 10 > e->capacidade) {
+        size_t capacidade = e->capacidade ? e->capacidade * 2 : 64 * 1024;
+        uint8_t *dados = realloc(e->dados, capacidade);
+        if (dados == NULL) {
+            e->erro = 1;
+            return;
+        }
+        e->dados = dados;
+        e->capacidade = capacidade;
+    }
+    e->usado += escrever_varint(e->dados + e->usado, sequencia - e->anterior);
+    e->anterior = sequencia;
+    e->saltos[e->total_saltos - 1].ultimo = sequencia;
+    e->total++;
+}
+
+// Função para gravar a lista montada com escritor_sequencia() e recomeçar
+static void escritor_termo(EscritorSegmento *e, const char *nome, size_t tamanho_nome) {
+    escritor_lista(e, nome, tamanho_nome, e->total, e->saltos, e->total_saltos, e->dados,
+                   e->usado);
+    e->usado = e->total_saltos = 0;
+    e->anterior = 0;
+    e->total = 0;
+}
+
+// Função para terminar o segmento: nomes, dicionário e cabeçalho, fsync e
+// troca do nome temporário pelo final
+// Retorna o segmento já mapeado, ou NULL em caso de erro (o .tmp é apagado)
+static SegmentoBusca *escritor_fechar(EscritorSegmento *e, uint64_t primeira, uint64_t ultima,
+                                      uint16_t nivel) {
+    CabecalhoBusca cabecalho;
+    memset(&cabecalho, 0, sizeof(cabecalho));
+    cabecalho.magico = BUSCA_MAGICO;
+    cabecalho.versao = BUSCA_VERSAO;
+    cabecalho.nivel = nivel;
+    cabecalho.primeira = primeira;
+    cabecalho.ultima = ultima;
+    cabecalho.total_termos = e->total_termos;
+    cabecalho.posicao_nomes = e->posicao;
+    escritor_escrever(e, e->nomes, e->tamanho_nomes);
+    escritor_alinhar(e);
+    cabecalho.posicao_dicionario = e->posicao;
+    escritor_escrever(e, e->dicionario, e->total_termos * sizeof(EntradaTermo));
+    cabecalho.tamanho = e->posicao;
+    if (fseek(e->arquivo, 0, SEEK_SET) < 0) e->erro = 1;
+    escritor_escrever(e, &cabecalho, sizeof(cabecalho));
+    if (fflush(e->arquivo) != 0 || fdatasync(fileno(e->arquivo)) < 0) e->erro = 1;
+    if (fclose(e->arquivo) != 0) e->erro = 1;
+
+    SegmentoBusca *seg = NULL;
+    if (!e->erro && rename(e->temporario, e->caminho) == 0) {
+        seg = abrir_segmento_busca(e->caminho);
+    } else {
+        perror("[ERRO] Não foi possível gravar um segmento da busca");
+        unlink(e->temporario);
+    }
+    free(e->dicionario);
+    free(e->nomes);
+    free(e->dados);
+    free(e->saltos);
+    return seg;
+}
+
+// Função para comparar termos da memória por nome, na ordenação
+static int comparar_termos(const void *a, const void *b) {
+    const TermoMemoria *x = *(TermoMemoria *const *)a, *y = *(TermoMemoria *const *)b;
+    return comparar_nomes(x->nome, x->tamanho, y->nome, y->tamanho);
+}
+
+// Função para gravar uma tabela da memória como segmento de nível 0
+// Retorna o segmento, ou NULL em caso de erro
+static SegmentoBusca *gravar_tabela(const TabelaMemoria *t) {
+    TermoMemoria **termos = malloc((t->total > 0 ? t->total : 1) * sizeof(TermoMemoria *));
+    EscritorSegmento e;
+    if (termos == NULL || escritor_abrir(&e, t->primeira, t->ultima) < 0) {
+        perror("[ERRO] Não foi possível gravar um segmento da busca");
+        free(termos);
+        return NULL;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < t->capacidade; i++) {
+        if (t->baldes[i] != NULL) termos[total++] = t->baldes[i];
+    }
+    qsort(termos, total, sizeof(TermoMemoria *), comparar_termos);
+    for (size_t i = 0; i < total; i++) {
+        const TermoMemoria *termo = termos[i];
+        escritor_lista(&e, termo->nome, termo->tamanho, termo->total, termo->saltos,
+                       termo->total_saltos, termo->dados, termo->usado);
+    }
+    free(termos);
+    return escritor_fechar(&e, t->primeira, t->ultima, 0);
+}
+
+// Função para fundir `total` segmentos consecutivos (em ordem de
+// sequência) em um só, do nível seguinte: os dicionários são percorridos
+// juntos, em ordem, e as listas de um mesmo termo são concatenadas
+// Retorna o segmento novo, ou NULL em caso de erro
+static SegmentoBusca *fundir(SegmentoBusca *const *fontes, size_t total) {
+    uint64_t primeira = fontes[0]->cabecalho.primeira;
+    uint64_t ultima = fontes[total - 1]->cabecalho.ultima;
+    EscritorSegmento e;
+    if (escritor_abrir(&e, primeira, ultima) < 0) {
+        perror("[ERRO] Não foi possível gravar um segmento da busca");
+        return NULL;
+    }
+    size_t posicoes[BUSCA_FUSAO] = { 0 };
+    while (!e.erro) {
+        const char *menor = NULL;
+        size_t tamanho_menor = 0;
+        for (size_t k = 0; k < total; k++) {
+            if (posicoes[k] >= fontes[k]->cabecalho.total_termos) continue;
+            const EntradaTermo *entrada = &fontes[k]->dicionario[posicoes[k]];
+            const char *nome = fontes[k]->nomes + entrada->nome;
+            if (menor == NULL ||
+                comparar_nomes(nome, entrada->tamanho_nome, menor, tamanho_menor) < 0) {
+                menor = nome;
+                tamanho_menor = entrada->tamanho_nome;
+            }
+        }
+        if (menor == NULL) break;
+
+        char nome[BUSCA_NOME_MAX];
+        memcpy(nome, menor, tamanho_menor);
+        for (size_t k = 0; k < total; k++) {
+            if (posicoes[k] >= fontes[k]->cabecalho.total_termos) continue;
+            const EntradaTermo *entrada = &fontes[k]->dicionario[posicoes[k]];
+            if (comparar_nomes(fontes[k]->nomes + entrada->nome, entrada->tamanho_nome,
+                               nome, tamanho_menor) != 0) {
+                continue;
+            }
+            CursorPostings c;
+            uint64_t sequencia;
+            cursor_lista(&c, fontes[k]->mapa + entrada->postings, entrada->tamanho,
+                         entrada->total);
+            while (cursor_proximo(&c, &sequencia)) escritor_sequencia(&e, sequencia);
+            posicoes[k]++;
+        }
+        escritor_termo(&e, nome, tamanho_menor);
+    }
+    return escritor_fechar(&e, primeira, ultima, (uint16_t)(fontes[0]->cabecalho.nivel + 1));
+}
+
+// Função para fundir, enquanto houver, os BUSCA_FUSAO segmentos mais novos
+// quando são todos do mesmo nível. Os velhos saem da lista com a trava de
+// escrita, então nenhuma consulta os usa quando são apagados.
+static void fundir_niveis() {
+    while (total_segmentos_busca >= BUSCA_FUSAO) {
+        SegmentoBusca **ultimos = &segmentos_busca[total_segmentos_busca - BUSCA_FUSAO];
+        int mesmo_nivel = 1;
+        for (size_t k = 1; k < BUSCA_FUSAO; k++) {
+            if (ultimos[k]->cabecalho.nivel != ultimos[0]->cabecalho.nivel) mesmo_nivel = 0;
+        }
+        if (!mesmo_nivel) return;
+        SegmentoBusca *novo = fundir(ultimos, BUSCA_FUSAO);
+        if (novo == NULL) return;
+
+        SegmentoBusca *velhos[BUSCA_FUSAO];
+        memcpy(velhos, ultimos, sizeof(velhos));
+        pthread_rwlock_wrlock(&trava);
+        ultimos[0] = novo;
+        total_segmentos_busca -= BUSCA_FUSAO - 1;
+        pthread_rwlock_unlock(&trava);
+        for (size_t k = 0; k < BUSCA_FUSAO; k++) fechar_segmento_busca(velhos[k], 1);
+    }
+}
+
+// Função para passar a tabela da memória para o disco. Enquanto o
+// segmento é gravado, as consultas continuam vendo a tabela congelada. Se
+// a gravação falha, os termos saem da busca até o próximo início, quando
+// as sequências depois do último segmento são indexadas de novo.
+static void gravar_memoria() {
+    TabelaMemoria *nova = tabela_criar(memoria->ultima + 1);
+    if (nova == NULL || total_segmentos_busca == BUSCA_MAX_SEGMENTOS) {
+        fprintf(stderr, "[ERRO] Não foi possível gravar o índice da busca\n");
+        tabela_liberar(nova);
+        return;
+    }
+    pthread_rwlock_wrlock(&trava);
+    congelada = memoria;
+    memoria = nova;
+    pthread_rwlock_unlock(&trava);
+
+    SegmentoBusca *seg = gravar_tabela(congelada);
+
+    TabelaMemoria *velha = congelada;
+    pthread_rwlock_wrlock(&trava);
+    if (seg != NULL) segmentos_busca[total_segmentos_busca++] = seg;
+    congelada = NULL;
+    pthread_rwlock_unlock(&trava);
+    tabela_liberar(velha);
+    fundir_niveis();
+}
+
+// Função para indexar tudo o que o histórico já publicou depois do cursor,
+// um lote de cada vez com a trava de escrita
+static void indexar_pendentes(CursorHistorico *cursor) {
+    while (1) {
+        const RegistroHistorico *lote[BUSCA_LOTE];
+        size_t total = 0;
+        while (total < BUSCA_LOTE && (lote[total] = historico_proximo(cursor)) != NULL) {
+            if (lote[total]->sequencia >= proxima_sequencia) total++;
+        }
+        if (total == 0) return;
+
+        pthread_rwlock_wrlock(&trava);
+        for (size_t i = 0; i < total; i++) indexar_registro(memoria, lote[i]);
+        memoria->ultima = lote[total - 1]->sequencia;
+        pthread_rwlock_unlock(&trava);
+        proxima_sequencia = lote[total - 1]->sequencia + 1;
+        atomic_fetch_add_explicit(&indexadas, total, memory_order_relaxed);
+
+        if (memoria->bytes >= BUSCA_MEMORIA_MAX) gravar_memoria();
+    }
+}
+
+// Função executada pela thread da busca: indexa o que o histórico gravou a
+// cada aviso dele e, ao parar, grava a tabela da memória
+static void *executar_busca(void *arg) {
+    (void)arg;
+    CursorHistorico cursor;
+    historico_posicionar(proxima_sequencia, &cursor);
+    struct pollfd evento = { evento_fd, POLLIN, 0 };
+
+    while (1) {
+        int encerrar = parar;
+        indexar_pendentes(&cursor);
+        if (encerrar) break;
+        if (poll(&evento, 1, -1) < 0 && errno != EINTR) {
+            perror("[ERRO] poll da busca falhou");
+            break;
+        }
+        uint64_t contador;
+        while (read(evento_fd, &contador, sizeof(contador)) > 0) {
+        }
+    }
+    if (memoria->ultima != 0) gravar_memoria();
+    return 0;
+}
+
+// Função para comparar segmentos na recuperação: por primeira sequência e,
+// no empate, o mais largo antes
+static int comparar_segmentos(const void *a, const void *b) {
+    const SegmentoBusca *x = *(SegmentoBusca *const *)a, *y = *(SegmentoBusca *const *)b;
+    if (x->cabecalho.primeira != y->cabecalho.primeira) {
+        return x->cabecalho.primeira < y->cabecalho.primeira ? -1 : 1;
+    }
+    return (x->cabecalho.ultima < y->cabecalho.ultima) - (x->cabecalho.ultima > y->cabecalho.ultima);
+}
+
+// Função para reabrir os segmentos do diretório. Sobras de uma gravação
+// interrompida (.tmp) e segmentos já contidos em uma fusão que terminou
+// (a queda veio antes de apagá-los) são removidos.
+static int carregar_segmentos_busca() {
+    DIR *dir = opendir(diretorio_busca);
+    if (dir == NULL) return -1;
+    SegmentoBusca *achados[BUSCA_MAX_SEGMENTOS];
+    size_t total = 0;
+    struct dirent *entrada;
+    while ((entrada = readdir(dir)) != NULL) {
+        unsigned long long primeira, ultima;
+        char extensao[12], caminho[PATH_MAX];
+        if (sscanf(entrada->d_name, "%20llu-%20llu.%11s", &primeira, &ultima, extensao) != 3) {
+            continue;
+        }
+        caminho_busca(caminho, primeira, ultima, extensao);
+        if (strcmp(extensao, "busca.tmp") == 0) {
+            unlink(caminho);
+            continue;
+        }
+        if (strcmp(extensao, "busca") != 0) continue;
+        SegmentoBusca *seg = total < BUSCA_MAX_SEGMENTOS ? abrir_segmento_busca(caminho) : NULL;
+        if (seg == NULL) {
+            fprintf(stderr, "[ERRO] Segmento da busca ignorado: %s\n", caminho);
+            continue;
+        }
+        achados[total++] = seg;
+    }
+    closedir(dir);
+    qsort(achados, total, sizeof(SegmentoBusca *), comparar_segmentos);
+
+    for (size_t i = 0; i < total; i++) {
+        SegmentoBusca *anterior = total_segmentos_busca > 0
+                                      ? segmentos_busca[total_segmentos_busca - 1] : NULL;
+        if (anterior != NULL && achados[i]->cabecalho.ultima <= anterior->cabecalho.ultima) {
+            fechar_segmento_busca(achados[i], 1);
+            continue;
+        }
+        segmentos_busca[total_segmentos_busca++] = achados[i];
+        proxima_sequencia = achados[i]->cabecalho.ultima + 1;
+    }
+    return 0;
+}
+
+// Função para abrir o índice em `diretorio` (o do histórico, que já deve
+// estar iniciado) e iniciar a thread que o mantém. O que o histórico tem
+// depois do último segmento é indexado de novo pela thread.
+int busca_iniciar(const char *diretorio) {
+    snprintf(diretorio_busca, sizeof(diretorio_busca), "%s", diretorio);
+    if (carregar_segmentos_busca() < 0) {
+        perror("[ERRO] Não foi possível ler o índice da busca");
+        return -1;
+    }
+    memoria = tabela_criar(proxima_sequencia);
+    evento_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (memoria == NULL || evento_fd < 0) {
+        perror("[ERRO] Não foi possível iniciar a busca");
+        busca_finalizar();
+        return -1;
+    }
+    historico_observar(evento_fd);
+    if (pthread_create(&thread_busca, NULL, executar_busca, NULL) != 0) {
+        perror("[ERRO] Não foi possível iniciar a thread da busca");
+        busca_finalizar();
+        return -1;
+    }
+    ativa = 1;
+    return 0;
+}
+
+// Função para saber se a busca está ligada
+int busca_ativa() {
+    return ativa;
+}
+
+// Função para separar os termos de uma consulta: "#sala" e "@nick" valem
+// inteiros; o resto passa pela mesma separação em palavras do índice.
+// Termos repetidos entram uma vez.
+// Retorna quantos termos foram separados
+static size_t separar_consulta(const char *consulta, size_t tamanho,
+                               char termos[][BUSCA_NOME_MAX], size_t *tamanhos) {
+    size_t total = 0, i = 0;
+    while (i < tamanho && total < BUSCA_TERMOS_CONSULTA) {
+        while (i < tamanho && (consulta[i] == ' ' || consulta[i] == '\t')) i++;
+        size_t inicio = i;
+        while (i < tamanho && consulta[i] != ' ' && consulta[i] != '\t') i++;
+        size_t n = i - inicio;
+        if (n == 0) break;
+
+        char *termo = termos[total];
+        if ((consulta[inicio] == '#' || consulta[inicio] == '@') && n > 1) {
+            if (n >= BUSCA_NOME_MAX) continue;
+            memcpy(termo, consulta + inicio, n);
+            tamanhos[total++] = n;
+        } else {
+            size_t posicao = 0, palavra;
+            while (total < BUSCA_TERMOS_CONSULTA &&
+                   (palavra = proxima_palavra((const uint8_t *)consulta + inicio, n, &posicao,
+                                              termos[total])) > 0) {
+                tamanhos[total++] = palavra;
+            }
+        }
+    }
+    size_t unicos = 0;
+    for (size_t k = 0; k < total; k++) {
+        int repetido = 0;
+        for (size_t j = 0; j < unicos && !repetido; j++) {
+            repetido = tamanhos[j] == tamanhos[k] && memcmp(termos[j], termos[k], tamanhos[k]) == 0;
+        }
+        if (repetido) continue;
+        if (unicos != k) memcpy(termos[unicos], termos[k], tamanhos[k]);
+        tamanhos[unicos++] = tamanhos[k];
+    }
+    return unicos;
+}
+
+// Função para ordenar os cursores de uma fonte do menor para o maior
+static void ordenar_cursores(CursorPostings *c, size_t total) {
+    for (size_t i = 1; i < total; i++) {
+        CursorPostings atual = c[i];
+        size_t j = i;
+        while (j > 0 && c[j - 1].total > atual.total) {
+            c[j] = c[j - 1];
+            j--;
+        }
+        c[j] = atual;
+    }
+}
+
+// Função para procurar as mensagens que têm todos os termos da consulta e
+// que quem está em `sala` (tamanho 0 = fora de salas) pode ver, pelas
+// mesmas regras do /history. As fontes são percorridas da mais nova (a
+// tabela da memória) para a mais antiga, e em cada uma a interseção começa
+// pela lista menor e pelo bloco mais novo, então uma consulta para assim
+// que junta `maximo` mensagens visíveis.
+// Retorna quantas sequências foram gravadas em `resultados`, em ordem
+// crescente (as mais novas)
+int busca_procurar(const char *consulta, size_t tamanho, const char *sala, size_t tamanho_sala,
+                   uint64_t *resultados, int maximo) {
+    if (!ativa || maximo <= 0) return 0;
+    char termos[BUSCA_TERMOS_CONSULTA][BUSCA_NOME_MAX];
+    size_t tamanhos[BUSCA_TERMOS_CONSULTA];
+    size_t total = separar_consulta(consulta, tamanho, termos, tamanhos);
+    if (total == 0) return 0;
+
+    size_t faltam = (size_t)maximo;
+    CursorPostings cursores[BUSCA_TERMOS_CONSULTA];
+    pthread_rwlock_rdlock(&trava);
+    TabelaMemoria *tabelas[2] = { memoria, congelada };
+    for (size_t fonte = 0; fonte < 2 + total_segmentos_busca && faltam > 0; fonte++) {
+        size_t achados = 0;
+        if (fonte < 2) {
+            const TabelaMemoria *t = tabelas[fonte];
+            if (t == NULL) continue;
+            for (; achados < total; achados++) {
+                uint64_t hash = hash_termo(termos[achados], tamanhos[achados]);
+                const TermoMemoria *termo =
+                    t->baldes[tabela_balde(t, termos[achados], tamanhos[achados], hash)];
+                if (termo == NULL) break;
+                cursor_memoria(&cursores[achados], termo);
+            }
+        } else {
+            const SegmentoBusca *seg = segmentos_busca[total_segmentos_busca - 1 - (fonte - 2)];
+            for (; achados < total; achados++) {
+                const EntradaTermo *e = segmento_procurar(seg, termos[achados], tamanhos[achados]);
+                if (e == NULL) break;
+                cursor_lista(&cursores[achados], seg->mapa + e->postings, e->tamanho, e->total);
+            }
+        }
+        if (achados < total) continue; // Algum termo não aparece nesta fonte
+        ordenar_cursores(cursores, total);
+        faltam -= intersectar(cursores, total, sala, tamanho_sala, resultados, faltam);
+    }
+    pthread_rwlock_unlock(&trava);
+
+    size_t encontradas = (size_t)maximo - faltam;
+    memmove(resultados, resultados + faltam, encontradas * sizeof(uint64_t));
+    return (int)encontradas;
+}
+
+// Função para consultar os contadores da busca
+void busca_estatisticas(uint64_t *total_indexadas, size_t *segmentos, size_t *termos_memoria) {
+    *total_indexadas = atomic_load_explicit(&indexadas, memory_order_relaxed);
+    *segmentos = 0;
+    *termos_memoria = 0;
+    if (!ativa) return;
+    pthread_rwlock_rdlock(&trava);
+    *segmentos = total_segmentos_busca;
+    *termos_memoria = memoria->total;
+    pthread_rwlock_unlock(&trava);
+}
+
+// Função para parar a thread (gravando a tabela da memória) e desmapear os
+// segmentos. Chamada antes de historico_finalizar().
+void busca_finalizar() {
+    if (ativa) {
+        parar = 1;
+        uint64_t um = 1;
+        if (write(evento_fd, &um, sizeof(um)) < 0) {
+            perror("[ERRO] Falha ao sinalizar a busca");
+        }
+        pthread_join(thread_busca, NULL);
+        ativa = 0;
+    }
+    historico_observar(-1);
+    for (size_t i = 0; i < total_segmentos_busca; i++) {
+        fechar_segmento_busca(segmentos_busca[i], 0);
+    }
+    total_segmentos_busca = 0;
+    tabela_liberar(memoria);
+    memoria = NULL;
+    if (evento_fd >= 0) close(evento_fd);
+    evento_fd = -1;
+}
@@ -0,0 +1,87 @@
+// ============================================================================
+// ARQUIVO: busca.h
+//
+// DESCRIÇÃO: Índice invertido das mensagens do histórico, para o /search
+//            (ligado junto com ./server --historico DIR, no mesmo
+//            diretório).
+//
+//            Uma thread própria segue o registro do histórico (avisada
+//            pela thread do histórico a cada lote gravado) e indexa cada
+//            mensagem de sala ou de difusão: as palavras do texto, a sala
+//            como o termo "#sala" e o autor como "@nick". Uma consulta só
+//            devolve o que o /history mostraria a quem pergunta: as
+//            mensagens da sala dele e as de difusão. Os shards nunca
+//            esperam pelo índice: eles só enfileiram para o histórico,
+//            como antes.
+//
+//            Os termos novos ficam em uma tabela na memória; quando ela
+//            passa de BUSCA_MEMORIA_MAX, vira um segmento imutável em disco
+//            (<primeira>-<última>.busca, lido com mmap). A cada
+//            BUSCA_FUSAO segmentos do mesmo nível, eles são fundidos em um
+//            do nível seguinte, então uma consulta abre poucos arquivos.
+//
+//            Formato de um segmento (na ordem de bytes da máquina):
+//              CabecalhoBusca | listas de postings | nomes dos termos |
+//              dicionário (EntradaTermo, em ordem de nome)
+//            Uma lista de postings guarda as sequências do histórico em
+//            ordem crescente, como diferenças em varint. Listas com mais de
+//            BUSCA_BLOCO sequências começam com uma tabela de saltos (a
+//            última sequência e a posição de cada bloco), usada para pular
+//            blocos inteiros na interseção.
+// ============================================================================
+
+#ifndef BUSCA_H
+#define BUSCA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BUSCA_MAGICO 0x43535542u // "BUSC"
+#define BUSCA_VERSAO 1
+#define BUSCA_TERMO_MAX 64          // Palavras maiores não são indexadas
+#define BUSCA_TERMOS_CONSULTA 16    // Termos (com os filtros) por consulta
+#define BUSCA_RESULTADOS_MAX 50     // Mensagens devolvidas por /search
+#define BUSCA_MEMORIA_MAX (64 * 1024 * 1024)
+#define BUSCA_BLOCO 128
+#define BUSCA_FUSAO 8
+#define BUSCA_MAX_SEGMENTOS 256
+#define BUSCA_LOTE 256 // Registros indexados por vez com a trava de escrita
+
+// Início de um segmento
+typedef struct {
+    uint32_t magico;
+    uint16_t versao;
+    uint16_t nivel;           // 0 = saiu da memória; n + 1 = fusão de nível n
+    uint64_t primeira;        // Sequências do histórico cobertas
+    uint64_t ultima;
+    uint64_t total_termos;
+    uint64_t posicao_nomes;
+    uint64_t posicao_dicionario;
+    uint64_t tamanho;         // Arquivo inteiro
+} CabecalhoBusca;
+
+// Um termo do dicionário
+typedef struct {
+    uint64_t postings;   // Posição da lista no arquivo
+    uint32_t nome;       // Posição do nome a partir de posicao_nomes
+    uint32_t total;      // Sequências na lista
+    uint32_t tamanho;    // Bytes da lista (com a tabela de saltos)
+    uint8_t tamanho_nome;
+    uint8_t reservado[3];
+} EntradaTermo;
+
+// Entrada da tabela de saltos de uma lista
+typedef struct {
+    uint64_t ultimo;   // Maior sequência do bloco
+    uint32_t posicao;  // Início do bloco, a partir do fim da tabela
+    uint32_t reservado;
+} SaltoBloco;
+
+int busca_iniciar(const char *diretorio);
+int busca_ativa(void);
+int busca_procurar(const char *consulta, size_t tamanho, const char *sala, size_t tamanho_sala,
+                   uint64_t *resultados, int maximo);
+void busca_estatisticas(uint64_t *indexadas, size_t *segmentos, size_t *termos_memoria);
+void busca_finalizar(void);
+
+#endif
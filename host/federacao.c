@@ -0,0 +1,1361 @@
+// ============================================================================
+// ARQUIVO: federacao.c
+//
+// DESCRIÇÃO: Implementação da federação entre nós do servidor (ver
+//            federacao.h).
+//
+//            Só a thread da federação mexe nas ligações, nas origens e na
+//            tabela de presença remota; os shards leem a tabela (/msg,
+//            /who, /nick) com a trava de leitura. Os shards e a interface
+//            falam com a thread por filas SPSC, uma por produtor, e a
+//            thread entrega a cada shard, também por uma fila SPSC, os
+//            quadros que vieram de outros nós, acordando cada shard uma vez
+//            por despertar.
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/random.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "protocolo.h"
+#include "fila_spsc.h"
+#include "federacao.h"
+#include "registro.h"
+#include "sala.h"
+#include "servidor.h"
+#include "metricas.h"
+#include "slab.h"
+
+#define FEDERACAO_MAX_EVENTOS 64
+#define FEDERACAO_REGISTRO_MAX (FEDERACAO_CABECALHO + 1 + SALA_NOME_MAX + \
+                                PROTOCOLO_CABECALHO + PROTOCOLO_PAYLOAD_MAX)
+#define FEDERACAO_LEITURA 65536
+
+// Valores de epoll_data.u64 que não são ligações; uma ligação usa o
+// índice e a geração (ver marca_par)
+#define MARCA_ESCUTA UINT64_C(0xffffffffffffff01)
+#define MARCA_EVENTO UINT64_C(0xffffffffffffff02)
+#define MARCA_RELOGIO UINT64_C(0xffffffffffffff03)
+
+// Evento de um produtor (shard ou interface) para a thread da federação
+typedef struct {
+    uint8_t tipo;                // TipoFederacao
+    uint8_t presente;            // Só na presença
+    BufferCompartilhado *nome;   // Sala, nickname de destino ou da presença
+    BufferCompartilhado *quadro; // NULL na presença
+} EventoFederacao;
+
+// Registro decodificado: o cabeçalho e os dados que vêm depois dele
+typedef struct {
+    uint8_t tipo;
+    uint8_t saltos;
+    uint16_t versao;
+    uint32_t no;
+    uint64_t encarnacao;
+    uint64_t sequencia;
+    const uint8_t *dados;
+    size_t tamanho;
+} RegistroFederacao;
+
+// Bytes de uma ligação à espera de envio ou de tratamento
+typedef struct {
+    uint8_t *dados;
+    size_t inicio;
+    size_t fim;
+    size_t capacidade;
+} BytesPar;
+
+typedef enum {
+    PAR_LIVRE = 0,
+    PAR_CONECTANDO,   // connect() não bloqueante em andamento
+    PAR_APRESENTANDO, // Esperando o FEDERACAO_OLA do outro lado
+    PAR_PRONTO
+} EstadoPar;
+
+// Ligação com outro nó
+typedef struct {
+    EstadoPar estado;
+    int fd;
+    uint32_t geracao; // Muda a cada uso da posição: eventos antigos são ignorados
+    int destino;      // Índice em `destinos` se foi discada; -1 se aceita
+    uint32_t no;
+    uint64_t encarnacao;
+    int64_t desde;    // ms; uma ligação que não se apresenta a tempo cai
+    int lento;        // Passou de FEDERACAO_SAIDA_MAX: cai no fim da rodada
+    char descricao[TRANSPORTE_DESCRICAO_MAX];
+    BytesPar entrada;
+    BytesPar saida;
+} Par;
+
+// Par configurado com --par
+typedef struct {
+    EnderecoTransporte endereco;
+    int par;      // Ligação atual (-1 = nenhuma)
+    uint32_t no;  // Nó do outro lado, desde a primeira apresentação (0 = não se sabe)
+    int avisado;  // Já avisou que não conseguiu ligar
+} Destino;
+
+// Nó de origem de registros: a janela de sequências já vistas
+typedef struct {
+    uint32_t no; // 0 = posição livre
+    uint64_t encarnacao;
+    uint64_t marca; // Maior sequência vista
+    uint64_t janela[FEDERACAO_JANELA / 64]; // Bit s % JANELA para s em (marca - JANELA, marca]
+    int64_t visto;  // ms do último registro
+    int saiu;       // Avisou que está saindo: o resto desta encarnação é ignorado
+} OrigemConhecida;
+
+// Nickname de outro nó; uma saída vira lápide por um tempo, para uma
+// entrada atrasada (com sequência menor) não ressuscitá-lo
+typedef struct EntradaRemota {
+    struct EntradaRemota *proxima; // Próxima entrada no mesmo balde
+    uint32_t no;
+    uint64_t encarnacao;
+    uint64_t sequencia;
+    int64_t removida; // ms em que virou lápide (0 = presente)
+    int via;          // Ligação por onde chegou (-1 = caiu); rota das privadas
+    uint8_t tamanho;
+    char nickname[NICKNAME_MAX];
+} EntradaRemota;
+
+// Configuração
+static uint32_t meu_no = 0;
+static uint64_t minha_encarnacao = 0;
+static int porta_escuta = 0;
+static Destino destinos[FEDERACAO_MAX_PARES];
+static int total_destinos = 0;
+
+// Estado da thread da federação
+static Par pares[FEDERACAO_MAX_PARES];
+static OrigemConhecida origens[FEDERACAO_MAX_NOS];
+static uint64_t proxima_sequencia = 1;
+static uint64_t shards_a_acordar = 0;
+static int epoll_fd = -1;
+static int relogio_fd = -1;
+static int socket_escuta = -1;
+
+// Presença remota: escrita só pela thread da federação
+static EntradaRemota *presenca[FEDERACAO_BALDES];
+static pthread_rwlock_t trava_presenca = PTHREAD_RWLOCK_INITIALIZER;
+static _Atomic int total_remotos = 0;
+static _Atomic int pares_prontos = 0;
+
+// Filas: produtores -> thread (uma por shard e uma para a interface) e
+// thread -> shards
+static FilaSPSC *filas = NULL;
+static int *pendentes = NULL; // pendentes[p]: só o produtor p mexe
+static int total_produtores = 0;
+static FilaSPSC *entregas = NULL;
+static int total_shards = 0;
+
+static int ativo = 0;
+static int evento_fd = -1;
+static pthread_t thread_federacao;
+static volatile int parar = 0;
+
+// Função para ler o relógio monotônico em milissegundos
+static int64_t agora_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Função de hash FNV-1a para o nickname
+static uint32_t hash_nickname(const char *nickname, size_t tamanho) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < tamanho; i++) {
+        h ^= (uint8_t)nickname[i];
+        h *= 16777619u;
+    }
+    return h & (FEDERACAO_BALDES - 1);
+}
+
+// Função para escrever e ler inteiros em ordem de rede
+static void escrever_u32(uint8_t *destino, uint32_t valor) {
+    destino[0] = (uint8_t)(valor >> 24);
+    destino[1] = (uint8_t)(valor >> 16);
+    destino[2] = (uint8_t)(valor >> 8);
+    destino[3] = (uint8_t)valor;
+}
+
+static uint32_t ler_u32(const uint8_t *origem) {
+    return ((uint32_t)origem[0] << 24) | ((uint32_t)origem[1] << 16) |
+           ((uint32_t)origem[2] << 8) | origem[3];
+}
+
+// Função para o valor de epoll_data.u64 de uma ligação
+static uint64_t marca_par(int indice) {
+    return ((uint64_t)pares[indice].geracao << 32) | (uint32_t)indice;
+}
+
+// Função para garantir espaço para mais `extra` bytes, trazendo os bytes
+// pendentes para o começo antes de crescer
+// Retorna -1 se faltou memória
+static int bytes_garantir(BytesPar *b, size_t extra) {
+    if (b->inicio > 0 && b->capacidade - b->fim < extra) {
+        memmove(b->dados, b->dados + b->inicio, b->fim - b->inicio);
+        b->fim -= b->inicio;
+        b->inicio = 0;
+    }
+    if (b->capacidade - b->fim >= extra) return 0;
+    size_t nova = b->capacidade ? b->capacidade : 65536;
+    while (nova - b->fim < extra) nova *= 2;
+    uint8_t *novo = realloc(b->dados, nova);
+    if (novo == NULL) return -1;
+    b->dados = novo;
+    b->capacidade = nova;
+    return 0;
+}
+
+// Função para liberar os bytes de uma ligação
+static void bytes_liberar(BytesPar *b) {
+    free(b->dados);
+    memset(b, 0, sizeof(*b));
+}
+
+// Função para conferir se um trecho é exatamente um quadro codificado,
+// antes de entregá-lo a clientes
+static int quadro_valido(const uint8_t *dados, size_t tamanho) {
+    return tamanho >= PROTOCOLO_CABECALHO + 1 && dados[0] == PROTOCOLO_VERSAO &&
+           PROTOCOLO_CABECALHO + (size_t)ler_u32(dados + 4) == tamanho;
+}
+
+// ---------------------------------------------------------------------------
+// Origens e janela de sequências
+// ---------------------------------------------------------------------------
+
+// Função para tirar da tabela os nicknames de um nó (de qualquer encarnação)
+static void esquecer_presenca(uint32_t no) {
+    int removidas = 0;
+    pthread_rwlock_wrlock(&trava_presenca);
+    for (uint32_t b = 0; b < FEDERACAO_BALDES; b++) {
+        EntradaRemota **p = &presenca[b];
+        while (*p != NULL) {
+            EntradaRemota *e = *p;
+            if (e->no != no) {
+                p = &e->proxima;
+                continue;
+            }
+            if (e->removida == 0) removidas++;
+            *p = e->proxima;
+            free(e);
+        }
+    }
+    pthread_rwlock_unlock(&trava_presenca);
+    atomic_fetch_sub_explicit(&total_remotos, removidas, memory_order_relaxed);
+}
+
+// Função para esquecer um nó: a janela e os nicknames
+static void esquecer_origem(OrigemConhecida *o) {
+    esquecer_presenca(o->no);
+    memset(o, 0, sizeof(*o));
+}
+
+// Função para achar (ou começar a acompanhar) a origem de um registro. Uma
+// encarnação mais nova do nó apaga o que se sabia da anterior.
+// Retorna NULL se o registro é de uma encarnação antiga (ou que já saiu) ou
+// se a tabela encheu
+static OrigemConhecida *conhecer_origem(uint32_t no, uint64_t encarnacao) {
+    OrigemConhecida *livre = NULL;
+    for (int i = 0; i < FEDERACAO_MAX_NOS; i++) {
+        OrigemConhecida *o = &origens[i];
+        if (o->no == no) {
+            if (encarnacao < o->encarnacao) return NULL;
+            if (encarnacao > o->encarnacao) {
+                esquecer_origem(o);
+                livre = o;
+                break;
+            }
+            if (o->saiu) return NULL;
+            o->visto = agora_ms();
+            return o;
+        }
+        if (o->no == 0 && livre == NULL) livre = o;
+    }
+    if (livre == NULL) return NULL;
+    livre->no = no;
+    livre->encarnacao = encarnacao;
+    livre->visto = agora_ms();
+    return livre;
+}
+
+// Função para marcar uma sequência como vista na janela da origem
+// Retorna 0 se ela já foi vista (ou é mais velha que a janela)
+static int marcar_sequencia(OrigemConhecida *o, uint64_t sequencia) {
+    if (sequencia > o->marca) {
+        uint64_t avanco = sequencia - o->marca;
+        if (avanco >= FEDERACAO_JANELA) {
+            memset(o->janela, 0, sizeof(o->janela));
+        } else {
+            for (uint64_t s = o->marca + 1; s < sequencia; s++) {
+                o->janela[(s % FEDERACAO_JANELA) / 64] &= ~(UINT64_C(1) << (s % 64));
+            }
+        }
+        o->marca = sequencia;
+    } else if (o->marca - sequencia >= FEDERACAO_JANELA) {
+        return 0;
+    } else if (o->janela[(sequencia % FEDERACAO_JANELA) / 64] & (UINT64_C(1) << (sequencia % 64))) {
+        return 0;
+    }
+    o->janela[(sequencia % FEDERACAO_JANELA) / 64] |= UINT64_C(1) << (sequencia % 64);
+    return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Presença remota
+// ---------------------------------------------------------------------------
+
+// Função para procurar a entrada de (nó, nickname). Com a trava.
+static EntradaRemota *procurar_entrada(uint32_t no, const char *nickname, size_t tamanho) {
+    for (EntradaRemota *e = presenca[hash_nickname(nickname, tamanho)]; e != NULL; e = e->proxima) {
+        if (e->no == no && e->tamanho == tamanho && memcmp(e->nickname, nickname, tamanho) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// Função para aplicar um registro de presença: vence a maior sequência de
+// cada (nó, nickname)
+// Retorna 1 se a tabela mudou (o registro deve seguir para os outros pares)
+static int aplicar_presenca(const RegistroFederacao *r, int presente, const char *nickname,
+                            size_t tamanho, int via) {
+    if (tamanho == 0 || tamanho >= NICKNAME_MAX) return 0;
+    pthread_rwlock_wrlock(&trava_presenca);
+    EntradaRemota *e = procurar_entrada(r->no, nickname, tamanho);
+    if (e != NULL && e->sequencia >= r->sequencia) {
+        // Nada novo, mas uma rota perdida pode ser reaprendida
+        if (e->via < 0) e->via = via;
+        pthread_rwlock_unlock(&trava_presenca);
+        return 0;
+    }
+    int estava = e != NULL && e->removida == 0;
+    if (e == NULL) {
+        e = calloc(1, sizeof(EntradaRemota));
+        if (e == NULL) {
+            pthread_rwlock_unlock(&trava_presenca);
+            return 0;
+        }
+        uint32_t balde = hash_nickname(nickname, tamanho);
+        e->no = r->no;
+        e->tamanho = (uint8_t)tamanho;
+        memcpy(e->nickname, nickname, tamanho);
+        e->proxima = presenca[balde];
+        presenca[balde] = e;
+    }
+    e->encarnacao = r->encarnacao;
+    e->sequencia = r->sequencia;
+    e->removida = presente ? 0 : agora_ms();
+    e->via = via;
+    pthread_rwlock_unlock(&trava_presenca);
+    if (presente && !estava) atomic_fetch_add_explicit(&total_remotos, 1, memory_order_relaxed);
+    if (!presente && estava) atomic_fetch_sub_explicit(&total_remotos, 1, memory_order_relaxed);
+    return 1;
+}
+
+// Função para apagar as lápides antigas
+static void limpar_lapides(int64_t agora) {
+    pthread_rwlock_wrlock(&trava_presenca);
+    for (uint32_t b = 0; b < FEDERACAO_BALDES; b++) {
+        EntradaRemota **p = &presenca[b];
+        while (*p != NULL) {
+            EntradaRemota *e = *p;
+            if (e->removida != 0 && agora - e->removida > 2 * FEDERACAO_EXPIRACAO_MS) {
+                *p = e->proxima;
+                free(e);
+            } else {
+                p = &e->proxima;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&trava_presenca);
+}
+
+// Função para saber se um nickname está em uso em outro nó
+int federacao_nick_remoto(const char *nickname, size_t tamanho) {
+    if (!ativo || atomic_load_explicit(&total_remotos, memory_order_relaxed) == 0) return 0;
+    int achou = 0;
+    pthread_rwlock_rdlock(&trava_presenca);
+    for (EntradaRemota *e = presenca[hash_nickname(nickname, tamanho)]; e != NULL; e = e->proxima) {
+        if (e->removida == 0 && e->tamanho == tamanho &&
+            memcmp(e->nickname, nickname, tamanho) == 0) {
+            achou = 1;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&trava_presenca);
+    return achou;
+}
+
+// Função para acrescentar à lista do /who os nicknames de outros nós que
+// começam com `prefixo`, depois dos `escritos` bytes que já estão em
+// `destino` (separados por '\n', como em registro_listar). `total` é
+// somado com quantos existem.
+// Retorna o novo total de bytes em `destino`
+size_t federacao_listar(const char *prefixo, size_t tamanho_prefixo, char *destino,
+                        size_t escritos, size_t capacidade, uint32_t *total) {
+    if (!ativo) return escritos;
+    pthread_rwlock_rdlock(&trava_presenca);
+    for (uint32_t b = 0; b < FEDERACAO_BALDES; b++) {
+        for (EntradaRemota *e = presenca[b]; e != NULL; e = e->proxima) {
+            if (e->removida != 0 || e->tamanho < tamanho_prefixo ||
+                memcmp(e->nickname, prefixo, tamanho_prefixo) != 0) {
+                continue;
+            }
+            (*total)++;
+            size_t separador = escritos > 0 ? 1 : 0;
+            if (escritos + separador + e->tamanho > capacidade) continue;
+            if (separador) destino[escritos++] = '\n';
+            memcpy(destino + escritos, e->nickname, e->tamanho);
+            escritos += e->tamanho;
+        }
+    }
+    pthread_rwlock_unlock(&trava_presenca);
+    return escritos;
+}
+
+// ---------------------------------------------------------------------------
+// Ligações
+// ---------------------------------------------------------------------------
+
+// Função para encaixar um registro na saída de uma ligação: o cabeçalho de
+// `r`, o `prefixo` e os dados de `r`. Uma ligação que acumula mais de
+// FEDERACAO_SAIDA_MAX bytes não recebe mais nada e cai no fim da rodada;
+// ao voltar, recebe a tabela de presença inteira de novo.
+static void anexar_registro(Par *p, const RegistroFederacao *r, const uint8_t *prefixo,
+                            size_t tamanho_prefixo) {
+    size_t tamanho = tamanho_prefixo + r->tamanho;
+    if (p->lento) return;
+    if (p->saida.fim - p->saida.inicio + FEDERACAO_CABECALHO + tamanho > FEDERACAO_SAIDA_MAX ||
+        bytes_garantir(&p->saida, FEDERACAO_CABECALHO + tamanho) < 0) {
+        metricas_somar(METRICA_FEDERACAO_DESCARTADOS, 1);
+        p->lento = 1;
+        return;
+    }
+    uint8_t *d = p->saida.dados + p->saida.fim;
+    d[0] = r->tipo;
+    d[1] = r->saltos;
+    d[2] = (uint8_t)(FEDERACAO_VERSAO >> 8);
+    d[3] = (uint8_t)FEDERACAO_VERSAO;
+    escrever_u32(d + 4, (uint32_t)tamanho);
+    escrever_u32(d + 8, r->no);
+    escrever_u32(d + 12, 0);
+    protocolo_escrever_u64(d + 16, r->encarnacao);
+    protocolo_escrever_u64(d + 24, r->sequencia);
+    if (tamanho_prefixo > 0) memcpy(d + FEDERACAO_CABECALHO, prefixo, tamanho_prefixo);
+    if (r->tamanho > 0) memcpy(d + FEDERACAO_CABECALHO + tamanho_prefixo, r->dados, r->tamanho);
+    p->saida.fim += FEDERACAO_CABECALHO + tamanho;
+    metricas_somar(METRICA_FEDERACAO_ENVIADOS, 1);
+}
+
+// Função para mandar um registro a todas as ligações prontas, menos à
+// ligação `exceto` (de onde ele veio; -1 = nenhuma)
+static void difundir_registro(const RegistroFederacao *r, const uint8_t *prefixo,
+                              size_t tamanho_prefixo, int exceto) {
+    for (int i = 0; i < FEDERACAO_MAX_PARES; i++) {
+        if (i == exceto || pares[i].estado != PAR_PRONTO) continue;
+        anexar_registro(&pares[i], r, prefixo, tamanho_prefixo);
+    }
+}
+
+// Função para fechar uma ligação. Os nicknames que vieram por ela ficam
+// sem rota até chegarem por outra (ou expirarem com o nó).
+static void fechar_par(int indice, const char *motivo) {
+    Par *p = &pares[indice];
+    if (p->estado == PAR_PRONTO) {
+        atomic_fetch_sub_explicit(&pares_prontos, 1, memory_order_relaxed);
+        if (motivo != NULL) {
+            printf("\r\033[K\033[33m[SISTEMA] Ligação com o nó %u (%s) %s.\033[0m\n", p->no,
+                   p->descricao, motivo);
+            fflush(stdout);
+        }
+        pthread_rwlock_wrlock(&trava_presenca);
+        for (uint32_t b = 0; b < FEDERACAO_BALDES; b++) {
+            for (EntradaRemota *e = presenca[b]; e != NULL; e = e->proxima) {
+                if (e->via == indice) e->via = -1;
+            }
+        }
+        pthread_rwlock_unlock(&trava_presenca);
+    }
+    if (p->destino >= 0) destinos[p->destino].par = -1;
+    close(p->fd);
+    bytes_liberar(&p->entrada);
+    bytes_liberar(&p->saida);
+    p->fd = -1;
+    p->estado = PAR_LIVRE;
+}
+
+// Função para ocupar uma posição livre com um socket conectado (ou
+// conectando) e registrá-lo no epoll
+// Retorna o índice ou -1 (o descritor é fechado)
+static int ocupar_par(int fd, EstadoPar estado, int destino, const char *descricao) {
+    int indice = -1;
+    for (int i = 0; i < FEDERACAO_MAX_PARES && indice < 0; i++) {
+        if (pares[i].estado == PAR_LIVRE) indice = i;
+    }
+    if (indice < 0) {
+        close(fd);
+        return -1;
+    }
+    Par *p = &pares[indice];
+    uint32_t geracao = p->geracao + 1;
+    memset(p, 0, sizeof(*p));
+    p->geracao = geracao;
+    p->fd = fd;
+    p->estado = estado;
+    p->destino = destino;
+    p->desde = agora_ms();
+    snprintf(p->descricao, sizeof(p->descricao), "%s", descricao);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.u64 = marca_par(indice);
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("[ERRO] Falha ao registrar a ligação da federação");
+        p->estado = PAR_LIVRE;
+        close(fd);
+        return -1;
+    }
+    if (destino >= 0) destinos[destino].par = indice;
+    return indice;
+}
+
+// Função para começar a apresentação de uma ligação conectada: mandar o
+// OLA com a identidade deste nó
+static void apresentar(int indice) {
+    Par *p = &pares[indice];
+    int opcao = 1;
+    setsockopt(p->fd, IPPROTO_TCP, TCP_NODELAY, &opcao, sizeof(opcao));
+    p->estado = PAR_APRESENTANDO;
+    RegistroFederacao ola = { FEDERACAO_OLA, 0, FEDERACAO_VERSAO, meu_no, minha_encarnacao,
+                              0, NULL, 0 };
+    anexar_registro(p, &ola, NULL, 0);
+}
+
+// Função para discar para um par configurado (connect não bloqueante)
+static void discar(int d) {
+    Destino *destino = &destinos[d];
+    struct sockaddr_storage endereco;
+    socklen_t tamanho;
+    if (transporte_resolver(&destino->endereco, &endereco, &tamanho) < 0) return;
+    int fd = socket(endereco.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return;
+    char descricao[TRANSPORTE_DESCRICAO_MAX];
+    transporte_descrever(&destino->endereco, descricao, sizeof(descricao));
+    if (connect(fd, (struct sockaddr *)&endereco, tamanho) < 0 && errno != EINPROGRESS) {
+        if (!destino->avisado) {
+            fprintf(stderr, "\r\033[K[ERRO] Não foi possível ligar ao par %s: %s\n", descricao,
+                    strerror(errno));
+            destino->avisado = 1;
+        }
+        close(fd);
+        return;
+    }
+    ocupar_par(fd, PAR_CONECTANDO, d, descricao);
+}
+
+// Função para concluir o connect() de uma ligação discada
+static void concluir_conexao(int indice) {
+    Par *p = &pares[indice];
+    int erro = 0;
+    socklen_t tamanho = sizeof(erro);
+    if (getsockopt(p->fd, SOL_SOCKET, SO_ERROR, &erro, &tamanho) < 0) erro = errno;
+    if (erro != 0) {
+        Destino *destino = &destinos[p->destino];
+        if (!destino->avisado) {
+            fprintf(stderr, "\r\033[K[ERRO] Não foi possível ligar ao par %s: %s "
+                            "(tentando a cada segundo)\n", p->descricao, strerror(erro));
+            destino->avisado = 1;
+        }
+        fechar_par(indice, NULL);
+        return;
+    }
+    apresentar(indice);
+}
+
+// Função para aceitar as ligações de outros nós (--federar)
+static void aceitar_pares() {
+    while (1) {
+        struct sockaddr_in endereco;
+        socklen_t tamanho = sizeof(endereco);
+        int fd = accept4(socket_escuta, (struct sockaddr *)&endereco, &tamanho,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("[ERRO] Falha ao aceitar um par da federação");
+            }
+            return;
+        }
+        char ip[INET_ADDRSTRLEN] = "?";
+        char descricao[TRANSPORTE_DESCRICAO_MAX];
+        inet_ntop(AF_INET, &endereco.sin_addr, ip, sizeof(ip));
+        snprintf(descricao, sizeof(descricao), "%s:%u", ip, (unsigned)ntohs(endereco.sin_port));
+        int indice = ocupar_par(fd, PAR_APRESENTANDO, -1, descricao);
+        if (indice >= 0) apresentar(indice);
+    }
+}
+
+// Função para mandar a uma ligação que acabou de se apresentar tudo o que
+// este nó sabe de presença: os próprios nicknames (com uma sequência nova)
+// e os de outros nós, com as sequências das origens
+static void enviar_tabela(int indice) {
+    Par *p = &pares[indice];
+    size_t capacidade = ((size_t)registro_total() + 64) * NICKNAME_MAX;
+    char *lista = malloc(capacidade);
+    uint32_t total = 0;
+    size_t tamanho = lista != NULL ? registro_listar("", 0, lista, capacidade, &total) : 0;
+    uint8_t presente = 1;
+    RegistroFederacao r = { FEDERACAO_PRESENCA, 0, FEDERACAO_VERSAO, meu_no, minha_encarnacao,
+                            proxima_sequencia++, NULL, 0 };
+    for (size_t inicio = 0; inicio < tamanho;) {
+        const char *fim = memchr(lista + inicio, '\n', tamanho - inicio);
+        size_t n = fim != NULL ? (size_t)(fim - (lista + inicio)) : tamanho - inicio;
+        r.dados = (const uint8_t *)lista + inicio;
+        r.tamanho = n;
+        anexar_registro(p, &r, &presente, 1);
+        inicio += n + 1;
+    }
+    free(lista);
+
+    // Só esta thread escreve na tabela: ler sem a trava é seguro aqui
+    for (uint32_t b = 0; b < FEDERACAO_BALDES; b++) {
+        for (EntradaRemota *e = presenca[b]; e != NULL; e = e->proxima) {
+            if (e->no == p->no) continue; // O próprio par sabe melhor
+            RegistroFederacao remoto = { FEDERACAO_PRESENCA, 1, FEDERACAO_VERSAO, e->no,
+                                         e->encarnacao, e->sequencia,
+                                         (const uint8_t *)e->nickname, e->tamanho };
+            presente = e->removida == 0;
+            anexar_registro(p, &remoto, &presente, 1);
+        }
+    }
+}
+
+// Função para tratar o OLA de uma ligação. Com duas ligações para o mesmo
+// nó (os dois lados discaram), fica a discada pelo nó de menor número; os
+// dois lados chegam à mesma escolha.
+static void tratar_ola(int indice, const RegistroFederacao *r) {
+    Par *p = &pares[indice];
+    if (r->versao != FEDERACAO_VERSAO) {
+        fprintf(stderr, "\r\033[K[ERRO] Par %s fala a versão %u da federação\n", p->descricao,
+                r->versao);
+        fechar_par(indice, NULL);
+        return;
+    }
+    if (p->destino >= 0) destinos[p->destino].no = r->no;
+    if (r->no == meu_no) {
+        fprintf(stderr, "\r\033[K[ERRO] O par %s é este mesmo nó (%u); ligação desfeita\n",
+                p->descricao, meu_no);
+        fechar_par(indice, NULL);
+        return;
+    }
+    if (conhecer_origem(r->no, r->encarnacao) == NULL) {
+        fechar_par(indice, NULL);
+        return;
+    }
+    uint32_t preferido = meu_no < r->no ? meu_no : r->no;
+    for (int i = 0; i < FEDERACAO_MAX_PARES; i++) {
+        Par *outro = &pares[i];
+        if (i == indice || outro->estado != PAR_PRONTO || outro->no != r->no) continue;
+        uint32_t discador = p->destino >= 0 ? meu_no : r->no;
+        uint32_t discador_outro = outro->destino >= 0 ? meu_no : outro->no;
+        if (discador == preferido && discador_outro != preferido) {
+            fechar_par(i, NULL);
+        } else {
+            fechar_par(indice, NULL);
+            return;
+        }
+    }
+    p->no = r->no;
+    p->encarnacao = r->encarnacao;
+    p->estado = PAR_PRONTO;
+    atomic_fetch_add_explicit(&pares_prontos, 1, memory_order_relaxed);
+    if (p->destino >= 0) destinos[p->destino].avisado = 0;
+    printf("\r\033[K\033[32m[SISTEMA] Ligado ao nó %u (%s).\033[0m\n", p->no, p->descricao);
+    fflush(stdout);
+    enviar_tabela(indice);
+}
+
+// ---------------------------------------------------------------------------
+// Entrega aos shards
+// ---------------------------------------------------------------------------
+
+// Função para entregar um quadro de outro nó a um shard (a fila segura as
+// próprias referências)
+static void entregar(int shard, BufferCompartilhado *quadro, BufferCompartilhado *sala,
+                     uint64_t token, int registrar) {
+    EntregaFederacao e = { quadro, sala, token, registrar };
+    buffer_reter(quadro);
+    if (sala != NULL) buffer_reter(sala);
+    if (!fila_spsc_inserir(&entregas[shard], &e)) {
+        buffer_soltar(quadro);
+        if (sala != NULL) buffer_soltar(sala);
+        metricas_somar(METRICA_FEDERACAO_DESCARTADOS, 1);
+        return;
+    }
+    shards_a_acordar |= UINT64_C(1) << shard;
+}
+
+// Função para entregar um quadro de sala aos shards que podem ter membros
+// dela; o primeiro deles grava no histórico
+static void entregar_sala(const char *nome, size_t tamanho_nome, const uint8_t *dados,
+                          size_t tamanho) {
+    uint64_t shards = sala_shards_presentes(nome, tamanho_nome);
+    if (total_shards < 64) shards &= (UINT64_C(1) << total_shards) - 1;
+    if (shards == 0) return;
+    BufferCompartilhado *quadro = buffer_copiar(dados, tamanho);
+    BufferCompartilhado *sala = buffer_copiar(nome, tamanho_nome);
+    if (quadro != NULL && sala != NULL) {
+        int registrar = 1;
+        while (shards != 0) {
+            int shard = __builtin_ctzll(shards);
+            shards &= shards - 1;
+            entregar(shard, quadro, sala, 0, registrar);
+            registrar = 0;
+        }
+    }
+    if (quadro != NULL) buffer_soltar(quadro);
+    if (sala != NULL) buffer_soltar(sala);
+}
+
+// Função para entregar uma mensagem do operador de outro nó a todos os
+// shards; o shard 0 a grava e a mostra ao operador deste nó
+static void entregar_difusao(const uint8_t *dados, size_t tamanho) {
+    BufferCompartilhado *quadro = buffer_copiar(dados, tamanho);
+    if (quadro == NULL) return;
+    for (int i = 0; i < total_shards; i++) entregar(i, quadro, NULL, 0, i == 0);
+    buffer_soltar(quadro);
+}
+
+// Função para acordar, uma vez, cada shard que recebeu quadros
+static void acordar_shards() {
+    uint64_t acordar = shards_a_acordar;
+    shards_a_acordar = 0;
+    while (acordar != 0) {
+        int shard = __builtin_ctzll(acordar);
+        acordar &= acordar - 1;
+        reator_acordar_shard(shard);
+    }
+}
+
+// Função para levar uma mensagem privada adiante, pela ligação de onde veio
+// a presença do nickname; sem rota conhecida ela é inundada (a janela das
+// origens corta as cópias)
+static void rotear_privada(const RegistroFederacao *r, const uint8_t *prefixo,
+                           size_t tamanho_prefixo, const char *nickname, size_t tamanho,
+                           int chegada) {
+    int via = -2; // -2 = ninguém com esse nickname
+    pthread_rwlock_rdlock(&trava_presenca);
+    for (EntradaRemota *e = presenca[hash_nickname(nickname, tamanho)]; e != NULL; e = e->proxima) {
+        if (e->removida == 0 && e->tamanho == tamanho &&
+            memcmp(e->nickname, nickname, tamanho) == 0) {
+            via = e->via;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&trava_presenca);
+    if (via == -2) return;
+    if (via >= 0 && via != chegada && pares[via].estado == PAR_PRONTO) {
+        anexar_registro(&pares[via], r, prefixo, tamanho_prefixo);
+    } else {
+        difundir_registro(r, prefixo, tamanho_prefixo, chegada);
+    }
+}
+
+// Função para separar o nome (sala ou nickname) do começo dos dados de um
+// registro: um byte de tamanho e o nome
+// Retorna -1 se o registro está truncado
+static int separar_nome(const RegistroFederacao *r, const char **nome, size_t *tamanho_nome,
+                        const uint8_t **resto, size_t *tamanho_resto) {
+    if (r->tamanho < 1 || r->tamanho < 1 + (size_t)r->dados[0]) return -1;
+    *nome = (const char *)r->dados + 1;
+    *tamanho_nome = r->dados[0];
+    *resto = r->dados + 1 + r->dados[0];
+    *tamanho_resto = r->tamanho - 1 - r->dados[0];
+    return 0;
+}
+
+// Função para tratar um registro vindo da ligação `indice`
+// Retorna -1 se o registro é inválido (a ligação cai)
+static int tratar_registro(int indice, RegistroFederacao *r) {
+    Par *p = &pares[indice];
+    metricas_somar(METRICA_FEDERACAO_RECEBIDOS, 1);
+    if (p->estado == PAR_APRESENTANDO) {
+        if (r->tipo != FEDERACAO_OLA) return -1;
+        tratar_ola(indice, r);
+        return 0;
+    }
+    if (r->tipo == FEDERACAO_OLA || r->no == meu_no) return 0; // Deu a volta
+    OrigemConhecida *origem = conhecer_origem(r->no, r->encarnacao);
+    if (origem == NULL) return 0; // Encarnação antiga
+
+    // O que segue adiante leva um salto a mais
+    int adiante = r->saltos + 1 < FEDERACAO_SALTOS_MAX;
+    r->saltos++;
+    const char *nome;
+    const uint8_t *quadro;
+    size_t tamanho_nome, tamanho_quadro;
+
+    if (r->tipo == FEDERACAO_PRESENCA) {
+        if (r->tamanho < 1) return -1;
+        if (aplicar_presenca(r, r->dados[0], (const char *)r->dados + 1, r->tamanho - 1, indice) &&
+            adiante) {
+            difundir_registro(r, NULL, 0, indice);
+        }
+        return 0;
+    }
+    if (!marcar_sequencia(origem, r->sequencia)) {
+        metricas_somar(METRICA_FEDERACAO_DUPLICADOS, 1);
+        return 0;
+    }
+    switch (r->tipo) {
+        case FEDERACAO_SALA:
+            if (separar_nome(r, &nome, &tamanho_nome, &quadro, &tamanho_quadro) < 0 ||
+                tamanho_nome == 0 || tamanho_nome >= SALA_NOME_MAX ||
+                !quadro_valido(quadro, tamanho_quadro)) {
+                return -1;
+            }
+            entregar_sala(nome, tamanho_nome, quadro, tamanho_quadro);
+            if (adiante) difundir_registro(r, NULL, 0, indice);
+            return 0;
+        case FEDERACAO_DIFUSAO:
+            if (!quadro_valido(r->dados, r->tamanho)) return -1;
+            entregar_difusao(r->dados, r->tamanho);
+            if (adiante) difundir_registro(r, NULL, 0, indice);
+            return 0;
+        case FEDERACAO_PRIVADO: {
+            if (separar_nome(r, &nome, &tamanho_nome, &quadro, &tamanho_quadro) < 0 ||
+                !quadro_valido(quadro, tamanho_quadro)) {
+                return -1;
+            }
+            uint64_t token = registro_buscar(nome, tamanho_nome);
+            int shard = token != 0 ? reator_shard_do_token(token) : -1;
+            if (shard >= 0 && shard < total_shards) {
+                BufferCompartilhado *buffer = buffer_copiar(quadro, tamanho_quadro);
+                if (buffer != NULL) {
+                    entregar(shard, buffer, NULL, token, 0);
+                    buffer_soltar(buffer);
+                }
+            } else if (adiante) {
+                rotear_privada(r, NULL, 0, nome, tamanho_nome, indice);
+            }
+            return 0;
+        }
+        case FEDERACAO_BATIMENTO:
+            if (adiante) difundir_registro(r, NULL, 0, indice);
+            if (r->tamanho >= 1 && r->dados[0]) {
+                // A origem fica marcada até expirar, para as cópias deste
+                // aviso que chegam por outros caminhos serem descartadas
+                printf("\r\033[K\033[33m[SISTEMA] O nó %u saiu da federação.\033[0m\n", r->no);
+                fflush(stdout);
+                esquecer_presenca(origem->no);
+                origem->saiu = 1;
+            }
+            return 0;
+        default:
+            return 0; // Tipos desconhecidos são ignorados
+    }
+}
+
+// Função para ler tudo o que chegou por uma ligação e tratar os registros
+// completos
+static void ler_par(int indice) {
+    Par *p = &pares[indice];
+    while (p->estado != PAR_LIVRE) {
+        if (bytes_garantir(&p->entrada, FEDERACAO_LEITURA) < 0) {
+            fechar_par(indice, "ficou sem memória");
+            return;
+        }
+        ssize_t n = recv(p->fd, p->entrada.dados + p->entrada.fim,
+                         p->entrada.capacidade - p->entrada.fim, 0);
+        if (n == 0) {
+            fechar_par(indice, "caiu");
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            fechar_par(indice, "caiu");
+            return;
+        }
+        p->entrada.fim += (size_t)n;
+
+        while (p->estado != PAR_LIVRE &&
+               p->entrada.fim - p->entrada.inicio >= FEDERACAO_CABECALHO) {
+            const uint8_t *d = p->entrada.dados + p->entrada.inicio;
+            size_t tamanho = ler_u32(d + 4);
+            if (FEDERACAO_CABECALHO + tamanho > FEDERACAO_REGISTRO_MAX) {
+                fechar_par(indice, "mandou um registro inválido");
+                return;
+            }
+            if (p->entrada.fim - p->entrada.inicio < FEDERACAO_CABECALHO + tamanho) {
+                // Registro incompleto: garante espaço para ele inteiro
+                if (bytes_garantir(&p->entrada, FEDERACAO_CABECALHO + tamanho) < 0) {
+                    fechar_par(indice, "ficou sem memória");
+                    return;
+                }
+                break;
+            }
+            RegistroFederacao r = { d[0], d[1], (uint16_t)((d[2] << 8) | d[3]), ler_u32(d + 8),
+                                    protocolo_ler_u64(d + 16), protocolo_ler_u64(d + 24),
+                                    d + FEDERACAO_CABECALHO, tamanho };
+            p->entrada.inicio += FEDERACAO_CABECALHO + tamanho;
+            if (tratar_registro(indice, &r) < 0) {
+                fechar_par(indice, "mandou um registro inválido");
+                return;
+            }
+        }
+        if (p->estado != PAR_LIVRE && p->entrada.inicio == p->entrada.fim) {
+            p->entrada.inicio = p->entrada.fim = 0;
+        }
+    }
+}
+
+// Função para enviar o que se acumulou na saída de uma ligação; o que não
+// couber no socket espera o próximo EPOLLOUT
+static void descarregar_par(int indice) {
+    Par *p = &pares[indice];
+    while (p->saida.inicio < p->saida.fim) {
+        ssize_t n = send(p->fd, p->saida.dados + p->saida.inicio, p->saida.fim - p->saida.inicio,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            fechar_par(indice, "caiu");
+            return;
+        }
+        p->saida.inicio += (size_t)n;
+    }
+    p->saida.inicio = p->saida.fim = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Eventos locais e relógio
+// ---------------------------------------------------------------------------
+
+// Função para transformar um evento de um produtor em registro e mandá-lo
+// às ligações
+static void tratar_evento_local(const EventoFederacao *e) {
+    RegistroFederacao r = { e->tipo, 0, FEDERACAO_VERSAO, meu_no, minha_encarnacao,
+                            proxima_sequencia++, NULL, 0 };
+    uint8_t prefixo[1 + NICKNAME_MAX + SALA_NOME_MAX];
+    size_t tamanho_prefixo = 0;
+    const char *nome = e->nome != NULL ? (const char *)e->nome->dados : NULL;
+    size_t tamanho_nome = e->nome != NULL ? e->nome->tamanho : 0;
+    if (tamanho_nome > 255) tamanho_nome = 255;
+    if (e->quadro != NULL) {
+        r.dados = e->quadro->dados;
+        r.tamanho = e->quadro->tamanho;
+    }
+    switch (e->tipo) {
+        case FEDERACAO_SALA:
+        case FEDERACAO_PRIVADO:
+            prefixo[0] = (uint8_t)tamanho_nome;
+            memcpy(prefixo + 1, nome, tamanho_nome);
+            tamanho_prefixo = 1 + tamanho_nome;
+            if (e->tipo == FEDERACAO_PRIVADO) {
+                rotear_privada(&r, prefixo, tamanho_prefixo, nome, tamanho_nome, -1);
+                return;
+            }
+            break;
+        case FEDERACAO_PRESENCA:
+            prefixo[0] = e->presente;
+            tamanho_prefixo = 1;
+            r.dados = (const uint8_t *)nome;
+            r.tamanho = tamanho_nome;
+            break;
+        default:
+            break;
+    }
+    difundir_registro(&r, prefixo, tamanho_prefixo, -1);
+}
+
+// Função para transformar em registros tudo o que os produtores
+// enfileiraram
+static void drenar_filas() {
+    EventoFederacao e;
+    for (int i = 0; i < total_produtores; i++) {
+        while (fila_spsc_remover(&filas[i], &e)) {
+            tratar_evento_local(&e);
+            if (e.nome != NULL) buffer_soltar(e.nome);
+            if (e.quadro != NULL) buffer_soltar(e.quadro);
+        }
+    }
+}
+
+// Função para mandar o batimento deste nó a todas as ligações
+static void enviar_batimento(int saindo) {
+    uint8_t dados = (uint8_t)saindo;
+    RegistroFederacao r = { FEDERACAO_BATIMENTO, 0, FEDERACAO_VERSAO, meu_no, minha_encarnacao,
+                            proxima_sequencia++, &dados, 1 };
+    difundir_registro(&r, NULL, 0, -1);
+}
+
+// Função para o relógio de um segundo: batimento, religar os pares
+// configurados que caíram, derrubar quem não se apresentou, esquecer os
+// nós calados e apagar as lápides velhas
+static void tratar_relogio() {
+    int64_t agora = agora_ms();
+    enviar_batimento(0);
+
+    for (int d = 0; d < total_destinos; d++) {
+        if (destinos[d].par >= 0 || destinos[d].no == meu_no) continue;
+        int ligado = 0;
+        for (int i = 0; i < FEDERACAO_MAX_PARES && destinos[d].no != 0; i++) {
+            if (pares[i].estado == PAR_PRONTO && pares[i].no == destinos[d].no) ligado = 1;
+        }
+        if (!ligado) discar(d);
+    }
+    for (int i = 0; i < FEDERACAO_MAX_PARES; i++) {
+        Par *p = &pares[i];
+        if ((p->estado == PAR_CONECTANDO || p->estado == PAR_APRESENTANDO) &&
+            agora - p->desde > FEDERACAO_EXPIRACAO_MS) {
+            fechar_par(i, NULL);
+        }
+    }
+    for (int i = 0; i < FEDERACAO_MAX_NOS; i++) {
+        if (origens[i].no != 0 && agora - origens[i].visto > FEDERACAO_EXPIRACAO_MS) {
+            if (origens[i].saiu) {
+                esquecer_origem(&origens[i]);
+                continue;
+            }
+            printf("\r\033[K\033[33m[SISTEMA] O nó %u não responde; seus nicknames saíram.\033[0m\n",
+                   origens[i].no);
+            fflush(stdout);
+            esquecer_origem(&origens[i]);
+        }
+    }
+    limpar_lapides(agora);
+}
+
+// Função executada pela thread da federação: a cada despertar drena as
+// filas dos produtores e as ligações, e faz um envio por ligação
+static void *executar_federacao(void *arg) {
+    (void)arg;
+    struct epoll_event eventos[FEDERACAO_MAX_EVENTOS];
+    for (int d = 0; d < total_destinos; d++) discar(d);
+
+    while (!parar) {
+        int n = epoll_wait(epoll_fd, eventos, FEDERACAO_MAX_EVENTOS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("[ERRO] epoll_wait da federação falhou");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            uint64_t marca = eventos[i].data.u64;
+            if (marca == MARCA_EVENTO) {
+                uint64_t contador;
+                while (read(evento_fd, &contador, sizeof(contador)) > 0) {
+                }
+                continue;
+            }
+            if (marca == MARCA_RELOGIO) {
+                uint64_t ticks;
+                if (read(relogio_fd, &ticks, sizeof(ticks)) == sizeof(ticks)) tratar_relogio();
+                continue;
+            }
+            if (marca == MARCA_ESCUTA) {
+                aceitar_pares();
+                continue;
+            }
+            int indice = (int)(uint32_t)marca;
+            Par *p = &pares[indice];
+            // Fechada (e talvez reaproveitada) por outro evento desta rodada
+            if (p->estado == PAR_LIVRE || marca != marca_par(indice)) continue;
+            if (p->estado == PAR_CONECTANDO) {
+                if (!(eventos[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) continue;
+                concluir_conexao(indice);
+                // O OLA do outro lado pode ter chegado junto
+                if (p->estado != PAR_LIVRE) ler_par(indice);
+                continue;
+            }
+            if (eventos[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) ler_par(indice);
+        }
+        drenar_filas();
+        for (int i = 0; i < FEDERACAO_MAX_PARES; i++) {
+            if (pares[i].lento) {
+                fechar_par(i, "não acompanhou a federação");
+            } else if (pares[i].estado != PAR_LIVRE && pares[i].estado != PAR_CONECTANDO) {
+                descarregar_par(i);
+            }
+        }
+        acordar_shards();
+    }
+
+    // Avisa os pares que este nó está saindo, numa última tentativa de envio
+    enviar_batimento(1);
+    for (int i = 0; i < FEDERACAO_MAX_PARES; i++) {
+        if (pares[i].estado == PAR_PRONTO) descarregar_par(i);
+        if (pares[i].estado != PAR_LIVRE) fechar_par(i, NULL);
+    }
+    slab_esvaziar_cache();
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Interface do módulo
+// ---------------------------------------------------------------------------
+
+// Função para escolher o número deste nó (--no; 0 = sortear)
+void federacao_configurar_no(uint32_t no) {
+    meu_no = no;
+}
+
+// Função para aceitar ligações de outros nós na porta TCP `porta`
+// Retorna -1 se a porta é inválida
+int federacao_configurar_escuta(int porta) {
+    if (porta <= 0 || porta > 65535) return -1;
+    porta_escuta = porta;
+    return 0;
+}
+
+// Função para acrescentar um par a discar (só TCP)
+// Retorna -1 se o endereço não é TCP ou se já há pares demais
+int federacao_adicionar_par(const EnderecoTransporte *endereco) {
+    if (endereco->tipo != TRANSPORTE_TCP || total_destinos == FEDERACAO_MAX_PARES) return -1;
+    destinos[total_destinos].endereco = *endereco;
+    destinos[total_destinos].par = -1;
+    total_destinos++;
+    return 0;
+}
+
+// Função para abrir o socket de escuta da federação
+// Retorna -1 se falhou
+static int escutar_pares() {
+    int opcao = 1;
+    socket_escuta = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socket_escuta < 0) return -1;
+    setsockopt(socket_escuta, SOL_SOCKET, SO_REUSEADDR, &opcao, sizeof(opcao));
+    struct sockaddr_in endereco;
+    memset(&endereco, 0, sizeof(endereco));
+    endereco.sin_family = AF_INET;
+    endereco.sin_addr.s_addr = INADDR_ANY;
+    endereco.sin_port = htons((uint16_t)porta_escuta);
+    if (bind(socket_escuta, (struct sockaddr *)&endereco, sizeof(endereco)) < 0 ||
+        listen(socket_escuta, FEDERACAO_MAX_PARES) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Função para registrar um descritor que não é ligação no epoll
+static int observar(int fd, uint64_t marca) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = marca;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+// Função para criar as filas, abrir a escuta e iniciar a thread da
+// federação. Há uma fila de produtor por shard e mais uma para a interface.
+int federacao_iniciar(int shards) {
+    if (meu_no == 0) {
+        while (meu_no == 0) {
+            if (getrandom(&meu_no, sizeof(meu_no), 0) != sizeof(meu_no)) meu_no = (uint32_t)getpid();
+        }
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    minha_encarnacao = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    for (int i = 0; i < FEDERACAO_MAX_PARES; i++) pares[i].fd = -1;
+
+    filas = calloc(shards + 1, sizeof(FilaSPSC));
+    pendentes = calloc(shards + 1, sizeof(int));
+    entregas = calloc(shards, sizeof(FilaSPSC));
+    if (filas == NULL || pendentes == NULL || entregas == NULL) {
+        perror("[ERRO] Não foi possível criar as filas da federação");
+        federacao_finalizar();
+        return -1;
+    }
+    for (int i = 0; i < shards + 1; i++) {
+        if (fila_spsc_iniciar(&filas[i], FEDERACAO_FILA_CAPACIDADE, sizeof(EventoFederacao),
+                              FILA_DESCARTAR_NOVA) < 0) {
+            perror("[ERRO] Não foi possível criar as filas da federação");
+            federacao_finalizar();
+            return -1;
+        }
+        total_produtores = i + 1;
+    }
+    for (int i = 0; i < shards; i++) {
+        if (fila_spsc_iniciar(&entregas[i], FEDERACAO_ENTREGA_CAPACIDADE, sizeof(EntregaFederacao),
+                              FILA_DESCARTAR_NOVA) < 0) {
+            perror("[ERRO] Não foi possível criar as filas da federação");
+            federacao_finalizar();
+            return -1;
+        }
+        total_shards = i + 1;
+    }
+
+    if (porta_escuta > 0 && escutar_pares() < 0) {
+        perror("[ERRO] Não foi possível escutar os pares da federação");
+        federacao_finalizar();
+        return -1;
+    }
+    struct itimerspec periodo = { { FEDERACAO_BATIMENTO_MS / 1000, 0 },
+                                  { FEDERACAO_BATIMENTO_MS / 1000, 0 } };
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    evento_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    relogio_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (epoll_fd < 0 || evento_fd < 0 || relogio_fd < 0 ||
+        timerfd_settime(relogio_fd, 0, &periodo, NULL) < 0 ||
+        observar(evento_fd, MARCA_EVENTO) < 0 || observar(relogio_fd, MARCA_RELOGIO) < 0 ||
+        (socket_escuta >= 0 && observar(socket_escuta, MARCA_ESCUTA) < 0)) {
+        perror("[ERRO] Não foi possível preparar a federação");
+        federacao_finalizar();
+        return -1;
+    }
+    ativo = 1;
+    if (pthread_create(&thread_federacao, NULL, executar_federacao, NULL) != 0) {
+        perror("[ERRO] Não foi possível iniciar a thread da federação");
+        ativo = 0;
+        federacao_finalizar();
+        return -1;
+    }
+    return 0;
+}
+
+// Função para saber se a federação está ligada
+int federacao_ativa() {
+    return ativo;
+}
+
+// Função para enfileirar um evento de um produtor. O produtor continua
+// dono das suas referências; a fila segura as próprias.
+static void enfileirar(int produtor, const EventoFederacao *e) {
+    if (e->nome != NULL) buffer_reter(e->nome);
+    if (e->quadro != NULL) buffer_reter(e->quadro);
+    if (!fila_spsc_inserir(&filas[produtor], e)) {
+        if (e->nome != NULL) buffer_soltar(e->nome);
+        if (e->quadro != NULL) buffer_soltar(e->quadro);
+        metricas_somar(METRICA_FEDERACAO_DESCARTADOS, 1);
+        return;
+    }
+    pendentes[produtor] = 1;
+}
+
+// Função para mandar aos outros nós um quadro da sala `sala`
+void federacao_enviar_sala(int produtor, BufferCompartilhado *sala, BufferCompartilhado *quadro) {
+    if (!ativo) return;
+    EventoFederacao e = { FEDERACAO_SALA, 0, sala, quadro };
+    enfileirar(produtor, &e);
+}
+
+// Função para mandar aos outros nós uma mensagem do operador para todos
+void federacao_enviar_difusao(int produtor, BufferCompartilhado *quadro) {
+    if (!ativo) return;
+    EventoFederacao e = { FEDERACAO_DIFUSAO, 0, NULL, quadro };
+    enfileirar(produtor, &e);
+}
+
+// Função para mandar uma mensagem privada a um nickname de outro nó (ver
+// federacao_nick_remoto)
+void federacao_enviar_privada(int produtor, const char *nickname, size_t tamanho,
+                              BufferCompartilhado *quadro) {
+    if (!ativo) return;
+    EventoFederacao e = { FEDERACAO_PRIVADO, 0, buffer_copiar(nickname, tamanho), quadro };
+    if (e.nome == NULL) return;
+    enfileirar(produtor, &e);
+    buffer_soltar(e.nome);
+}
+
+// Função para anunciar que um nickname entrou (presente = 1) ou saiu deste nó
+void federacao_enviar_presenca(int produtor, const char *nickname, int presente) {
+    if (!ativo) return;
+    EventoFederacao e = { FEDERACAO_PRESENCA, (uint8_t)(presente != 0),
+                          buffer_copiar(nickname, strlen(nickname)), NULL };
+    if (e.nome == NULL) return;
+    enfileirar(produtor, &e);
+    buffer_soltar(e.nome);
+}
+
+// Função para acordar a thread da federação se o produtor enfileirou algo
+// desde a última chamada (uma vez por rodada do reator)
+void federacao_publicar(int produtor) {
+    if (!ativo || !pendentes[produtor]) return;
+    pendentes[produtor] = 0;
+    uint64_t um = 1;
+    if (write(evento_fd, &um, sizeof(um)) < 0 && errno != EAGAIN) {
+        perror("[ERRO] Falha ao sinalizar a federação");
+    }
+}
+
+// Função para o shard pegar o próximo quadro vindo de outro nó
+// Retorna 0 se não há nenhum
+int federacao_proxima_entrega(int shard, EntregaFederacao *entrega) {
+    if (!ativo) return 0;
+    return fila_spsc_remover(&entregas[shard], entrega);
+}
+
+// Função para consultar o número deste nó, as ligações prontas e os
+// nicknames de outros nós
+void federacao_estatisticas(uint32_t *no, int *total_pares, int *nicknames) {
+    *no = meu_no;
+    *total_pares = atomic_load_explicit(&pares_prontos, memory_order_relaxed);
+    *nicknames = atomic_load_explicit(&total_remotos, memory_order_relaxed);
+}
+
+// Função para avisar os pares, parar a thread e liberar tudo. Chamada
+// depois que os shards pararam.
+void federacao_finalizar() {
+    if (ativo) {
+        parar = 1;
+        uint64_t um = 1;
+        if (write(evento_fd, &um, sizeof(um)) < 0) {
+            perror("[ERRO] Falha ao sinalizar a federação");
+        }
+        pthread_join(thread_federacao, NULL);
+        ativo = 0;
+    }
+    for (int i = 0; i < total_produtores; i++) {
+        EventoFederacao e;
+        while (fila_spsc_remover(&filas[i], &e)) {
+            if (e.nome != NULL) buffer_soltar(e.nome);
+            if (e.quadro != NULL) buffer_soltar(e.quadro);
+        }
+        fila_spsc_liberar(&filas[i]);
+    }
+    for (int i = 0; i < total_shards; i++) {
+        EntregaFederacao e;
+        while (fila_spsc_remover(&entregas[i], &e)) {
+            if (e.sala != NULL) buffer_soltar(e.sala);
+            buffer_soltar(e.quadro);
+        }
+        fila_spsc_liberar(&entregas[i]);
+    }
+    free(filas);
+    free(pendentes);
+    free(entregas);
+    filas = NULL;
+    pendentes = NULL;
+    entregas = NULL;
+    total_produtores = total_shards = 0;
+    memset(origens, 0, sizeof(origens));
+    for (uint32_t b = 0; b < FEDERACAO_BALDES; b++) {
+        while (presenca[b] != NULL) {
+            EntradaRemota *e = presenca[b];
+            presenca[b] = e->proxima;
+            free(e);
+        }
+    }
+    atomic_store(&total_remotos, 0);
+    if (socket_escuta >= 0) close(socket_escuta);
+    if (relogio_fd >= 0) close(relogio_fd);
+    if (evento_fd >= 0) close(evento_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+    socket_escuta = relogio_fd = evento_fd = epoll_fd = -1;
+}
@@ -0,0 +1,120 @@
+// ============================================================================
+// ARQUIVO: federacao.h
+//
+// DESCRIÇÃO: Federação de vários processos do servidor (nós) por ligações
+//            entre servidores (./server --no ID --federar PORTA
+//            --par tcp://host:porta).
+//
+//            Cada nó tem um identificador (--no) e uma encarnação (o
+//            relógio na partida, para um nó reiniciado não ser confundido
+//            com o anterior). Uma thread própria cuida das ligações com os
+//            pares, discadas (--par, refeitas a cada segundo enquanto
+//            caídas) ou aceitas (--federar). Os shards e a interface só
+//            enfileiram eventos para ela, como fazem com o histórico; a
+//            cada despertar a thread drena todas as filas, encaixa os
+//            registros na saída de cada par e faz um único envio por par
+//            (replicação em lotes).
+//
+//            O que vai pelos pares:
+//              - quadros de sala (chat, entradas e saídas, trocas de
+//                nickname, arquivos), entregues aos membros locais da sala;
+//              - mensagens do operador para todos;
+//              - mensagens privadas, roteadas pelo par de onde veio a
+//                presença do nickname de destino;
+//              - presença: um nickname que entrou ou saiu de um nó.
+//
+//            Os quadros vão inundados: cada nó repassa o que recebeu a
+//            todos os outros pares. Cada registro leva o nó de origem e uma
+//            sequência da origem; uma janela das últimas FEDERACAO_JANELA
+//            sequências de cada origem descarta as cópias que chegam por
+//            outro caminho, e o contador de saltos corta qualquer volta que
+//            escape da janela. A presença é um estado: o registro de cada
+//            (nó, nickname) com a maior sequência vence, e um nó só repassa
+//            o que mudou a sua tabela, então a inundação termina sozinha.
+//            Uma ligação nova recebe a tabela inteira.
+//
+//            Um nó anuncia que está vivo a cada segundo; os nicknames de um
+//            nó que some por FEDERACAO_EXPIRACAO_MS (ou que avisa que está
+//            saindo) deixam a tabela.
+//
+//            Formato de um registro na ligação (ordem de rede):
+//              tipo u8 | saltos u8 | versão u16 | tamanho u32 | nó u32 |
+//              reservado u32 | encarnação u64 | sequência u64 | dados
+//            Dados por tipo:
+//              SALA:       tamanho do nome u8 | nome | quadro codificado
+//              DIFUSAO:    quadro codificado
+//              PRIVADO:    tamanho do nickname u8 | nickname | quadro
+//              PRESENCA:   presente u8 | nickname
+//              BATIMENTO:  saindo u8
+// ============================================================================
+
+#ifndef FEDERACAO_H
+#define FEDERACAO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "buffer.h"
+#include "transporte.h"
+
+#define FEDERACAO_VERSAO 1
+#define FEDERACAO_CABECALHO 32
+#define FEDERACAO_MAX_PARES 32             // Ligações (discadas e aceitas)
+#define FEDERACAO_MAX_NOS 256              // Origens acompanhadas
+#define FEDERACAO_JANELA 1024              // Sequências lembradas por origem
+#define FEDERACAO_SALTOS_MAX 16
+#define FEDERACAO_FILA_CAPACIDADE 16384    // Eventos de cada produtor
+#define FEDERACAO_ENTREGA_CAPACIDADE 16384 // Quadros de outros nós para cada shard
+#define FEDERACAO_SAIDA_MAX (64 * 1024 * 1024) // Bytes por enviar antes de derrubar o par
+#define FEDERACAO_BALDES 4096              // Tabela de presença remota
+#define FEDERACAO_BATIMENTO_MS 1000
+#define FEDERACAO_EXPIRACAO_MS 5000
+
+// Tipos de registro na ligação entre nós
+typedef enum {
+    FEDERACAO_OLA = 1,       // Primeiro registro de cada lado: quem é o nó
+    FEDERACAO_SALA = 2,
+    FEDERACAO_DIFUSAO = 3,
+    FEDERACAO_PRIVADO = 4,
+    FEDERACAO_PRESENCA = 5,
+    FEDERACAO_BATIMENTO = 6
+} TipoFederacao;
+
+// Quadro de outro nó para um shard. `sala` != NULL: para os membros
+// locais da sala; senão `token` != 0: para a sessão do token; senão para
+// todas as sessões. `registrar`: este shard grava no histórico (um por nó).
+typedef struct {
+    BufferCompartilhado *quadro;
+    BufferCompartilhado *sala;
+    uint64_t token;
+    int registrar;
+} EntregaFederacao;
+
+// Configuração (antes de federacao_iniciar)
+void federacao_configurar_no(uint32_t no);
+int federacao_configurar_escuta(int porta);
+int federacao_adicionar_par(const EnderecoTransporte *endereco);
+
+int federacao_iniciar(int shards);
+int federacao_ativa(void);
+
+// Produtores: cada shard (pelo índice) e a interface (índice `shards`)
+void federacao_enviar_sala(int produtor, BufferCompartilhado *sala, BufferCompartilhado *quadro);
+void federacao_enviar_difusao(int produtor, BufferCompartilhado *quadro);
+void federacao_enviar_privada(int produtor, const char *nickname, size_t tamanho,
+                              BufferCompartilhado *quadro);
+void federacao_enviar_presenca(int produtor, const char *nickname, int presente);
+void federacao_publicar(int produtor);
+
+// Shards: quadros vindos de outros nós
+int federacao_proxima_entrega(int shard, EntregaFederacao *entrega);
+
+// Presença remota
+int federacao_nick_remoto(const char *nickname, size_t tamanho);
+size_t federacao_listar(const char *prefixo, size_t tamanho_prefixo, char *destino,
+                        size_t escritos, size_t capacidade, uint32_t *total);
+
+void federacao_estatisticas(uint32_t *no, int *pares, int *nicknames);
+void federacao_finalizar(void);
+
+#endif
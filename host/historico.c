@@ -0,0 +1,690 @@
+// ============================================================================
+// ARQUIVO: historico.c
+//
+// DESCRIÇÃO: Registro persistente das mensagens em segmentos mapeados com
+//            mmap (ver historico.h).
+//
+//            Só a thread do histórico escreve. Os leitores (shards
+//            atendendo /history e /search, a thread da busca) enxergam um segmento até `fim`, publicado
+//            com release depois que o registro inteiro foi copiado; os
+//            segmentos só são desmapeados em historico_finalizar(), quando
+//            os shards já pararam.
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#include "protocolo.h"
+#include "fila_spsc.h"
+#include "historico.h"
+#include "slab.h"
+
+#define HISTORICO_CAPACIDADE_INDICE \
+    (HISTORICO_SEGMENTO / (HISTORICO_PASSO_INDICE * sizeof(RegistroHistorico)) + 1)
+
+// Entrada do índice esparso: onde começa o registro de uma sequência
+typedef struct {
+    uint64_t sequencia;
+    uint64_t posicao;
+} EntradaIndice;
+
+typedef struct {
+    uint64_t primeira_sequencia;
+    int fd;
+    int indice_fd;
+    uint8_t *mapa;
+    _Atomic size_t fim;           // Bytes válidos; publicado após cada registro
+    EntradaIndice *indice;
+    _Atomic size_t total_indice;
+} Segmento;
+
+// Pedido de gravação, da fila de um produtor até a thread do histórico
+typedef struct {
+    BufferCompartilhado *sala; // NULL fora de salas
+    BufferCompartilhado *quadro;
+    int64_t instante;
+    uint8_t escopo;
+} PedidoHistorico;
+
+static char diretorio_historico[PATH_MAX - 32]; // Sobra para "/<sequência>.seg"
+static Segmento *segmentos[HISTORICO_MAX_SEGMENTOS];
+static _Atomic size_t total_segmentos = 0;
+
+static FilaSPSC *filas = NULL; // Uma por produtor (shards e interface)
+static int *pendentes = NULL;  // pendentes[p]: só o produtor p mexe
+static int total_produtores = 0;
+
+static int ativo = 0;
+static int evento_fd = -1;
+static _Atomic int observador_fd = -1; // Avisado a cada lote gravado (índice de busca)
+static pthread_t thread_historico;
+static volatile int parar = 0;
+static PoliticaFsync politica = FSYNC_PERIODICO;
+
+// Estado da thread do histórico
+static uint64_t proxima_sequencia = 1;
+static size_t registros_no_bloco = 0; // Desde a última entrada do índice
+static int sujo = 0;                  // Gravou algo desde o último fdatasync
+static int avisou_cheio = 0;
+static _Atomic uint64_t gravados = 0;
+
+// Função de hash FNV-1a usada para validar os registros
+static uint32_t hash_registro(const uint8_t *dados, size_t tamanho) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < tamanho; i++) {
+        h ^= dados[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Função para arredondar um tamanho para o próximo múltiplo de 8
+static size_t alinhar(size_t tamanho) {
+    return (tamanho + 7) & ~(size_t)7;
+}
+
+// Função para montar o caminho de um arquivo de segmento (".seg" ou ".idx")
+static void caminho_segmento(char *destino, uint64_t primeira, const char *extensao) {
+    snprintf(destino, PATH_MAX, "%s/%020llu.%s", diretorio_historico,
+             (unsigned long long)primeira, extensao);
+}
+
+// Função para conferir se há um registro íntegro em `posicao`
+// Retorna o registro ou NULL
+static const RegistroHistorico *registro_valido(const Segmento *seg, size_t posicao) {
+    if (posicao + sizeof(RegistroHistorico) > HISTORICO_SEGMENTO) return NULL;
+    const RegistroHistorico *r = (const RegistroHistorico *)(seg->mapa + posicao);
+    if (r->tamanho < sizeof(RegistroHistorico) || r->tamanho % 8 != 0 ||
+        posicao + r->tamanho > HISTORICO_SEGMENTO ||
+        sizeof(RegistroHistorico) + r->tamanho_sala + r->tamanho_quadro > r->tamanho ||
+        r->tamanho_quadro < PROTOCOLO_CABECALHO) {
+        return NULL;
+    }
+    const uint8_t *dados = (const uint8_t *)(r + 1);
+    if (hash_registro(dados, r->tamanho - sizeof(RegistroHistorico)) != r->verificacao) {
+        return NULL;
+    }
+    return r;
+}
+
+// Função para abrir (ou criar) um segmento e mapeá-lo
+// Retorna NULL em caso de erro
+static Segmento *abrir_segmento(uint64_t primeira) {
+    char caminho[PATH_MAX];
+    Segmento *seg = calloc(1, sizeof(Segmento));
+    if (seg == NULL) return NULL;
+    seg->primeira_sequencia = primeira;
+    seg->fd = seg->indice_fd = -1;
+    seg->mapa = MAP_FAILED;
+    seg->indice = calloc(HISTORICO_CAPACIDADE_INDICE, sizeof(EntradaIndice));
+
+    caminho_segmento(caminho, primeira, "seg");
+    seg->fd = open(caminho, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    struct stat info;
+    if (seg->indice == NULL || seg->fd < 0 || fstat(seg->fd, &info) < 0 ||
+        (info.st_size < HISTORICO_SEGMENTO && ftruncate(seg->fd, HISTORICO_SEGMENTO) < 0)) {
+        goto falha;
+    }
+    seg->mapa = mmap(NULL, HISTORICO_SEGMENTO, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+    if (seg->mapa == MAP_FAILED) goto falha;
+
+    caminho_segmento(caminho, primeira, "idx");
+    seg->indice_fd = open(caminho, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (seg->indice_fd < 0) goto falha;
+    ssize_t lidos = read(seg->indice_fd, seg->indice,
+                         HISTORICO_CAPACIDADE_INDICE * sizeof(EntradaIndice));
+    atomic_init(&seg->total_indice, lidos > 0 ? (size_t)lidos / sizeof(EntradaIndice) : 0);
+    atomic_init(&seg->fim, 0);
+    return seg;
+
+falha:
+    perror("[ERRO] Não foi possível abrir o segmento do histórico");
+    if (seg->mapa != MAP_FAILED) munmap(seg->mapa, HISTORICO_SEGMENTO);
+    if (seg->fd >= 0) close(seg->fd);
+    if (seg->indice_fd >= 0) close(seg->indice_fd);
+    free(seg->indice);
+    free(seg);
+    return NULL;
+}
+
+// Função para achar o fim de um segmento reaberto: parte da última entrada
+// íntegra do índice e avança enquanto os registros forem válidos. Entradas
+// de registros que não chegaram ao disco são descartadas.
+// Retorna a última sequência encontrada (0 se o segmento está vazio)
+static uint64_t recuperar_segmento(Segmento *seg) {
+    size_t entradas = atomic_load(&seg->total_indice);
+    while (entradas > 0 && registro_valido(seg, seg->indice[entradas - 1].posicao) == NULL) {
+        entradas--;
+    }
+    if (ftruncate(seg->indice_fd, (off_t)(entradas * sizeof(EntradaIndice))) < 0) {
+        perror("[ERRO] Não foi possível ajustar o índice do histórico");
+    }
+    atomic_store(&seg->total_indice, entradas);
+
+    size_t posicao = entradas > 0 ? seg->indice[entradas - 1].posicao : 0;
+    uint64_t ultima = 0;
+    registros_no_bloco = 0;
+    const RegistroHistorico *r;
+    while ((r = registro_valido(seg, posicao)) != NULL) {
+        ultima = r->sequencia;
+        posicao += r->tamanho;
+        registros_no_bloco++;
+    }
+    atomic_store(&seg->fim, posicao);
+    return ultima;
+}
+
+// Função para comparar nomes de segmento na ordenação
+static int comparar_primeiras(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Função para reabrir os segmentos que já existem no diretório
+static int carregar_segmentos() {
+    DIR *dir = opendir(diretorio_historico);
+    if (dir == NULL) return -1;
+
+    uint64_t primeiras[HISTORICO_MAX_SEGMENTOS];
+    size_t total = 0;
+    struct dirent *entrada;
+    while ((entrada = readdir(dir)) != NULL && total < HISTORICO_MAX_SEGMENTOS) {
+        unsigned long long primeira;
+        char extensao[8];
+        if (sscanf(entrada->d_name, "%20llu.%7s", &primeira, extensao) == 2 &&
+            strcmp(extensao, "seg") == 0) {
+            primeiras[total++] = primeira;
+        }
+    }
+    closedir(dir);
+    qsort(primeiras, total, sizeof(uint64_t), comparar_primeiras);
+
+    for (size_t i = 0; i < total; i++) {
+        Segmento *seg = abrir_segmento(primeiras[i]);
+        if (seg == NULL) return -1;
+        uint64_t ultima = recuperar_segmento(seg);
+        if (ultima >= proxima_sequencia) proxima_sequencia = ultima + 1;
+        segmentos[i] = seg;
+        atomic_store_explicit(&total_segmentos, i + 1, memory_order_release);
+    }
+    return 0;
+}
+
+// Função para forçar ao disco o que foi gravado no segmento atual
+static void sincronizar() {
+    size_t total = atomic_load_explicit(&total_segmentos, memory_order_relaxed);
+    if (total > 0 && fdatasync(segmentos[total - 1]->fd) < 0) {
+        perror("[ERRO] fdatasync do histórico falhou");
+    }
+    sujo = 0;
+}
+
+// Função para abrir um segmento novo, a partir da próxima sequência
+// Retorna NULL se o limite de segmentos foi atingido
+static Segmento *novo_segmento() {
+    size_t total = atomic_load_explicit(&total_segmentos, memory_order_relaxed);
+    if (total == HISTORICO_MAX_SEGMENTOS) {
+        if (!avisou_cheio) {
+            fprintf(stderr, "[ERRO] Histórico cheio (%d segmentos); novas mensagens não "
+                    "serão gravadas\n", HISTORICO_MAX_SEGMENTOS);
+            avisou_cheio = 1;
+        }
+        return NULL;
+    }
+    // O segmento que fecha vai inteiro para o disco antes do próximo
+    if (total > 0 && politica != FSYNC_NUNCA && sujo) sincronizar();
+
+    Segmento *seg = abrir_segmento(proxima_sequencia);
+    if (seg == NULL) return NULL;
+    registros_no_bloco = 0;
+    segmentos[total] = seg;
+    atomic_store_explicit(&total_segmentos, total + 1, memory_order_release);
+    return seg;
+}
+
+// Função para gravar um pedido no fim do segmento atual
+static void gravar(const PedidoHistorico *p) {
+    size_t tamanho_sala = p->sala ? p->sala->tamanho : 0;
+    size_t tamanho = alinhar(sizeof(RegistroHistorico) + tamanho_sala + p->quadro->tamanho);
+    if (tamanho > HISTORICO_SEGMENTO) return;
+
+    size_t total = atomic_load_explicit(&total_segmentos, memory_order_relaxed);
+    Segmento *seg = total > 0 ? segmentos[total - 1] : NULL;
+    size_t posicao = seg ? atomic_load_explicit(&seg->fim, memory_order_relaxed) : 0;
+    if (seg == NULL || posicao + tamanho > HISTORICO_SEGMENTO) {
+        seg = novo_segmento();
+        if (seg == NULL) return;
+        posicao = 0;
+    }
+
+    RegistroHistorico *r = (RegistroHistorico *)(seg->mapa + posicao);
+    uint8_t *dados = (uint8_t *)(r + 1);
+    if (tamanho_sala > 0) memcpy(dados, p->sala->dados, tamanho_sala);
+    memcpy(dados + tamanho_sala, p->quadro->dados, p->quadro->tamanho);
+    memset(dados + tamanho_sala + p->quadro->tamanho, 0,
+           tamanho - sizeof(RegistroHistorico) - tamanho_sala - p->quadro->tamanho);
+
+    RegistroHistorico cabecalho;
+    memset(&cabecalho, 0, sizeof(cabecalho));
+    cabecalho.tamanho = (uint32_t)tamanho;
+    cabecalho.sequencia = proxima_sequencia++;
+    cabecalho.instante = p->instante;
+    cabecalho.tamanho_quadro = p->quadro->tamanho;
+    cabecalho.escopo = p->escopo;
+    cabecalho.tamanho_sala = (uint8_t)tamanho_sala;
+    cabecalho.verificacao = hash_registro(dados, tamanho - sizeof(RegistroHistorico));
+    memcpy(r, &cabecalho, sizeof(cabecalho));
+
+    // Um registro a cada HISTORICO_PASSO_INDICE entra no índice esparso
+    size_t entradas = atomic_load_explicit(&seg->total_indice, memory_order_relaxed);
+    if ((entradas == 0 || registros_no_bloco == HISTORICO_PASSO_INDICE) &&
+        entradas < HISTORICO_CAPACIDADE_INDICE) {
+        EntradaIndice entrada = { cabecalho.sequencia, posicao };
+        seg->indice[entradas] = entrada;
+        atomic_store_explicit(&seg->total_indice, entradas + 1, memory_order_release);
+        if (write(seg->indice_fd, &entrada, sizeof(entrada)) < 0) {
+            perror("[ERRO] Não foi possível gravar o índice do histórico");
+        }
+        registros_no_bloco = 0;
+    }
+    registros_no_bloco++;
+
+    atomic_store_explicit(&seg->fim, posicao + tamanho, memory_order_release);
+    atomic_fetch_add_explicit(&gravados, 1, memory_order_relaxed);
+    sujo = 1;
+}
+
+// Função para gravar tudo o que os produtores enfileiraram
+static void drenar_filas() {
+    PedidoHistorico p;
+    for (int i = 0; i < total_produtores; i++) {
+        while (fila_spsc_remover(&filas[i], &p)) {
+            gravar(&p);
+            if (p.sala) buffer_soltar(p.sala);
+            buffer_soltar(p.quadro);
+        }
+    }
+}
+
+// Função para ler o relógio monotônico em milissegundos
+static int64_t agora_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Função executada pela thread do histórico: grava um lote por despertar e
+// aplica a política de fsync ao lote inteiro
+static void *executar_historico(void *arg) {
+    (void)arg;
+    int64_t ultimo_sync = agora_ms();
+    struct pollfd evento = { evento_fd, POLLIN, 0 };
+
+    while (1) {
+        int espera = -1;
+        if (politica == FSYNC_PERIODICO && sujo) {
+            int64_t restante = 1000 - (agora_ms() - ultimo_sync);
+            espera = restante > 0 ? (int)restante : 0;
+        }
+        if (poll(&evento, 1, espera) < 0 && errno != EINTR) {
+            perror("[ERRO] poll do histórico falhou");
+            break;
+        }
+        uint64_t contador;
+        while (read(evento_fd, &contador, sizeof(contador)) > 0) {
+        }
+
+        int encerrar = parar;
+        uint64_t antes = atomic_load_explicit(&gravados, memory_order_relaxed);
+        drenar_filas();
+        int observador = atomic_load_explicit(&observador_fd, memory_order_relaxed);
+        if (observador >= 0 && atomic_load_explicit(&gravados, memory_order_relaxed) != antes) {
+            uint64_t um = 1;
+            if (write(observador, &um, sizeof(um)) < 0 && errno != EAGAIN) {
+                perror("[ERRO] Falha ao sinalizar o observador do histórico");
+            }
+        }
+        if (sujo && (politica == FSYNC_LOTE || encerrar ||
+                     (politica == FSYNC_PERIODICO && agora_ms() - ultimo_sync >= 1000))) {
+            if (politica != FSYNC_NUNCA) sincronizar();
+            ultimo_sync = agora_ms();
+        }
+        if (encerrar) break;
+    }
+    slab_esvaziar_cache();
+    return 0;
+}
+
+// Função para abrir o histórico em `diretorio` (criado se não existir) e
+// iniciar a thread de gravação. `produtores` é o número de filas: uma por
+// shard e uma para a interface.
+int historico_iniciar(const char *diretorio, int produtores, PoliticaFsync escolhida) {
+    snprintf(diretorio_historico, sizeof(diretorio_historico), "%s", diretorio);
+    politica = escolhida;
+    if (mkdir(diretorio, 0755) < 0 && errno != EEXIST) {
+        perror("[ERRO] Não foi possível criar o diretório do histórico");
+        return -1;
+    }
+    if (carregar_segmentos() < 0) {
+        perror("[ERRO] Não foi possível ler o histórico");
+        historico_finalizar();
+        return -1;
+    }
+
+    filas = calloc(produtores, sizeof(FilaSPSC));
+    pendentes = calloc(produtores, sizeof(int));
+    if (filas == NULL || pendentes == NULL) {
+        perror("[ERRO] Não foi possível criar as filas do histórico");
+        historico_finalizar();
+        return -1;
+    }
+    for (int i = 0; i < produtores; i++) {
+        if (fila_spsc_iniciar(&filas[i], HISTORICO_FILA_CAPACIDADE, sizeof(PedidoHistorico),
+                              FILA_DESCARTAR_NOVA) < 0) {
+            perror("[ERRO] Não foi possível criar as filas do histórico");
+            historico_finalizar();
+            return -1;
+        }
+        total_produtores = i + 1;
+    }
+
+    evento_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (evento_fd < 0 || pthread_create(&thread_historico, NULL, executar_historico, NULL) != 0) {
+        perror("[ERRO] Não foi possível iniciar a thread do histórico");
+        historico_finalizar();
+        return -1;
+    }
+    ativo = 1;
+    return 0;
+}
+
+// Função para saber se o histórico está ligado
+int historico_ativo() {
+    return ativo;
+}
+
+// Função para enfileirar uma mensagem para gravação. O produtor continua
+// dono das suas referências; a fila segura as próprias.
+// Retorna 0 se a fila estava cheia (a mensagem foi descartada)
+int historico_registrar(int produtor, EscopoHistorico escopo,
+                        BufferCompartilhado *sala, BufferCompartilhado *quadro) {
+    if (!ativo) return 0;
+    PedidoHistorico p = { sala, quadro, (int64_t)time(NULL), (uint8_t)escopo };
+    if (sala) buffer_reter(sala);
+    buffer_reter(quadro);
+    if (!fila_spsc_inserir(&filas[produtor], &p)) {
+        if (sala) buffer_soltar(sala);
+        buffer_soltar(quadro);
+        return 0;
+    }
+    pendentes[produtor] = 1;
+    return 1;
+}
+
+// Função para acordar a thread do histórico se o produtor registrou algo
+// desde a última chamada (uma vez por rodada do reator)
+void historico_publicar(int produtor) {
+    if (!ativo || !pendentes[produtor]) return;
+    pendentes[produtor] = 0;
+    uint64_t um = 1;
+    if (write(evento_fd, &um, sizeof(um)) < 0 && errno != EAGAIN) {
+        perror("[ERRO] Falha ao sinalizar o histórico");
+    }
+}
+
+// Função para registrar um eventfd que a thread do histórico sinaliza
+// depois de cada lote gravado (-1 desliga)
+void historico_observar(int fd) {
+    atomic_store_explicit(&observador_fd, fd, memory_order_relaxed);
+}
+
+// Função para decidir se um registro pode ser reenviado a quem está em `sala`
+static int visivel(const RegistroHistorico *r, const char *sala, size_t tamanho_sala) {
+    if (r->escopo == HISTORICO_DIFUSAO) return 1;
+    return r->escopo == HISTORICO_SALA && tamanho_sala > 0 &&
+           r->tamanho_sala == tamanho_sala &&
+           memcmp(r + 1, sala, tamanho_sala) == 0;
+}
+
+// Função para montar, em um único buffer, as últimas `quantidade` mensagens
+// visíveis para quem está em `sala` (tamanho 0 = fora de salas), já
+// codificadas como quadros de histórico. Os segmentos são percorridos do
+// mais novo para o mais antigo, um bloco do índice esparso de cada vez,
+// então só as páginas desses blocos são lidas do disco.
+// Retorna NULL se não houver mensagens (ou se faltou memória); o total de
+// mensagens no buffer vai em `encontradas`
+BufferCompartilhado *historico_ultimos(const char *sala, size_t tamanho_sala, int quantidade,
+                                       int *encontradas) {
+    *encontradas = 0;
+    if (!ativo || quantidade <= 0) return NULL;
+    if (quantidade > HISTORICO_MAX_PEDIDO) quantidade = HISTORICO_MAX_PEDIDO;
+
+    const RegistroHistorico *achados[HISTORICO_MAX_PEDIDO];
+    const RegistroHistorico *bloco[HISTORICO_MAX_PEDIDO]; // Anel dos últimos do bloco
+    size_t faltam = (size_t)quantidade;
+
+    size_t total = atomic_load_explicit(&total_segmentos, memory_order_acquire);
+    for (size_t i = total; i-- > 0 && faltam > 0;) {
+        Segmento *seg = segmentos[i];
+        size_t fim = atomic_load_explicit(&seg->fim, memory_order_acquire);
+        size_t entradas = atomic_load_explicit(&seg->total_indice, memory_order_acquire);
+        size_t limite = fim;
+
+        // Sem índice, o segmento inteiro é um bloco só
+        for (size_t j = entradas > 0 ? entradas : 1; j-- > 0 && faltam > 0;) {
+            size_t inicio = entradas > 0 ? seg->indice[j].posicao : 0;
+            if (inicio >= fim) continue; // Entrada publicada depois de lermos `fim`
+            size_t encontrados = 0;
+            for (size_t pos = inicio; pos < limite;) {
+                const RegistroHistorico *r = (const RegistroHistorico *)(seg->mapa + pos);
+                if (visivel(r, sala, tamanho_sala)) bloco[encontrados++ % faltam] = r;
+                pos += r->tamanho;
+            }
+            size_t usar = encontrados < faltam ? encontrados : faltam;
+            for (size_t k = 0; k < usar; k++) {
+                achados[faltam - usar + k] = bloco[(encontrados - usar + k) % faltam];
+            }
+            faltam -= usar;
+            limite = inicio;
+        }
+    }
+
+    size_t primeiro = faltam, bytes = 0;
+    if (primeiro == (size_t)quantidade) return NULL;
+    for (size_t k = primeiro; k < (size_t)quantidade; k++) {
+        bytes += achados[k]->tamanho_quadro + PROTOCOLO_INSTANTE;
+    }
+    BufferCompartilhado *buffer = buffer_criar(bytes);
+    if (buffer == NULL) return NULL;
+    uint8_t *destino = buffer->dados;
+    for (size_t k = primeiro; k < (size_t)quantidade; k++) {
+        const RegistroHistorico *r = achados[k];
+        const uint8_t *quadro = (const uint8_t *)(r + 1) + r->tamanho_sala;
+        destino += protocolo_codificar_historico(destino, quadro, r->tamanho_quadro, r->instante);
+    }
+    *encontradas = quantidade - (int)primeiro;
+    return buffer;
+}
+
+// Função para posicionar um cursor no primeiro registro com sequência maior
+// ou igual a `sequencia`: busca binária pelos segmentos, depois pelo índice
+// esparso do segmento, e leitura a partir da entrada achada. Se a sequência
+// ainda não foi gravada, o cursor fica no fim do que já existe.
+void historico_posicionar(uint64_t sequencia, CursorHistorico *cursor) {
+    cursor->segmento = cursor->posicao = 0;
+    size_t total = atomic_load_explicit(&total_segmentos, memory_order_acquire);
+    if (total == 0) return;
+
+    size_t baixo = 0, alto = total; // Último segmento com primeira <= sequencia
+    while (alto - baixo > 1) {
+        size_t meio = baixo + (alto - baixo) / 2;
+        if (segmentos[meio]->primeira_sequencia <= sequencia) baixo = meio;
+        else alto = meio;
+    }
+    Segmento *seg = segmentos[baixo];
+    size_t fim = atomic_load_explicit(&seg->fim, memory_order_acquire);
+    size_t entradas = atomic_load_explicit(&seg->total_indice, memory_order_acquire);
+    size_t posicao = 0;
+    size_t a = 0, b = entradas; // Última entrada com sequencia <= pedida
+    while (b - a > 1) {
+        size_t meio = a + (b - a) / 2;
+        if (seg->indice[meio].sequencia <= sequencia) a = meio;
+        else b = meio;
+    }
+    if (entradas > 0 && seg->indice[a].sequencia <= sequencia &&
+        seg->indice[a].posicao < fim) {
+        posicao = seg->indice[a].posicao;
+    }
+    while (posicao < fim) {
+        const RegistroHistorico *r = (const RegistroHistorico *)(seg->mapa + posicao);
+        if (r->sequencia >= sequencia) break;
+        posicao += r->tamanho;
+    }
+    cursor->segmento = baixo;
+    cursor->posicao = posicao;
+}
+
+// Função para ler o registro na posição do cursor e avançá-lo. Pode ser
+// chamada de qualquer thread enquanto a thread do histórico grava.
+// Retorna NULL se não há registro publicado depois do cursor (ainda)
+const RegistroHistorico *historico_proximo(CursorHistorico *cursor) {
+    while (1) {
+        size_t total = atomic_load_explicit(&total_segmentos, memory_order_acquire);
+        if (cursor->segmento >= total) return NULL;
+        Segmento *seg = segmentos[cursor->segmento];
+        size_t fim = atomic_load_explicit(&seg->fim, memory_order_acquire);
+        if (cursor->posicao < fim) {
+            const RegistroHistorico *r = (const RegistroHistorico *)(seg->mapa + cursor->posicao);
+            cursor->posicao += r->tamanho;
+            return r;
+        }
+        // O fim de um segmento só é final depois que o seguinte existe; o
+        // fim é relido depois de ver o segmento novo
+        if (cursor->segmento + 1 >= total) return NULL;
+        if (cursor->posicao < atomic_load_explicit(&seg->fim, memory_order_acquire)) continue;
+        cursor->segmento++;
+        cursor->posicao = 0;
+    }
+}
+
+// Função para consultar se a mensagem `sequencia` existe e pode ser
+// reenviada a quem está em `sala` (tamanho 0 = fora de salas)
+int historico_visivel(uint64_t sequencia, const char *sala, size_t tamanho_sala) {
+    CursorHistorico cursor;
+    historico_posicionar(sequencia, &cursor);
+    const RegistroHistorico *r = historico_proximo(&cursor);
+    return r != NULL && r->sequencia == sequencia && visivel(r, sala, tamanho_sala);
+}
+
+// Função para montar, em um único buffer, os registros das `total`
+// sequências dadas (em ordem crescente), como quadros de histórico.
+// Sequências que não existem ou que quem está em `sala` não pode ver são
+// puladas.
+// Retorna NULL se nenhuma sobrou (ou se faltou memória); o total de
+// mensagens no buffer vai em `montadas`
+BufferCompartilhado *historico_montar(const uint64_t *sequencias, int total, const char *sala,
+                                      size_t tamanho_sala, int *montadas) {
+    *montadas = 0;
+    if (!ativo || total <= 0) return NULL;
+    const RegistroHistorico **registros = malloc((size_t)total * sizeof(*registros));
+    if (registros == NULL) return NULL;
+    size_t achados = 0, bytes = 0;
+    for (int i = 0; i < total; i++) {
+        CursorHistorico cursor;
+        historico_posicionar(sequencias[i], &cursor);
+        const RegistroHistorico *r = historico_proximo(&cursor);
+        if (r == NULL || r->sequencia != sequencias[i] || !visivel(r, sala, tamanho_sala)) continue;
+        registros[achados++] = r;
+        bytes += r->tamanho_quadro + PROTOCOLO_INSTANTE;
+    }
+    BufferCompartilhado *buffer = achados > 0 ? buffer_criar(bytes) : NULL;
+    if (buffer != NULL) {
+        uint8_t *destino = buffer->dados;
+        for (size_t k = 0; k < achados; k++) {
+            const RegistroHistorico *r = registros[k];
+            const uint8_t *quadro = (const uint8_t *)(r + 1) + r->tamanho_sala;
+            destino += protocolo_codificar_historico(destino, quadro, r->tamanho_quadro,
+                                                     r->instante);
+        }
+        *montadas = (int)achados;
+    }
+    free(registros);
+    return buffer;
+}
+
+// Função para consultar os contadores do histórico
+void historico_estatisticas(uint64_t *total_gravados, uint64_t *descartados, size_t *total) {
+    *total_gravados = atomic_load_explicit(&gravados, memory_order_relaxed);
+    *descartados = 0;
+    for (int i = 0; i < total_produtores; i++) {
+        *descartados += fila_spsc_descartados(&filas[i]);
+    }
+    *total = atomic_load_explicit(&total_segmentos, memory_order_relaxed);
+}
+
+// Função para gravar o que falta, parar a thread e desmapear os segmentos.
+// Chamada depois que os shards pararam.
+void historico_finalizar() {
+    if (ativo) {
+        parar = 1;
+        uint64_t um = 1;
+        if (write(evento_fd, &um, sizeof(um)) < 0) {
+            perror("[ERRO] Falha ao sinalizar o histórico");
+        }
+        pthread_join(thread_historico, NULL);
+        ativo = 0;
+    }
+    size_t total = atomic_load(&total_segmentos);
+    for (size_t i = 0; i < total; i++) {
+        munmap(segmentos[i]->mapa, HISTORICO_SEGMENTO);
+        close(segmentos[i]->fd);
+        close(segmentos[i]->indice_fd);
+        free(segmentos[i]->indice);
+        free(segmentos[i]);
+    }
+    atomic_store(&total_segmentos, 0);
+    for (int i = 0; i < total_produtores; i++) {
+        PedidoHistorico p;
+        while (fila_spsc_remover(&filas[i], &p)) {
+            if (p.sala) buffer_soltar(p.sala);
+            buffer_soltar(p.quadro);
+        }
+        fila_spsc_liberar(&filas[i]);
+    }
+    free(filas);
+    free(pendentes);
+    filas = NULL;
+    pendentes = NULL;
+    total_produtores = 0;
+    if (evento_fd >= 0) close(evento_fd);
+    evento_fd = -1;
+}
+
+// Função para interpretar o nome de uma política ("nunca", "periodico", "lote")
+// Retorna -1 se o nome for desconhecido
+int historico_politica_ler(const char *nome, PoliticaFsync *escolhida) {
+    if (strcmp(nome, "nunca") == 0) {
+        *escolhida = FSYNC_NUNCA;
+    } else if (strcmp(nome, "periodico") == 0) {
+        *escolhida = FSYNC_PERIODICO;
+    } else if (strcmp(nome, "lote") == 0) {
+        *escolhida = FSYNC_LOTE;
+    } else {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+// ============================================================================
+// ARQUIVO: historico.h
+//
+// DESCRIÇÃO: Registro persistente das mensagens do servidor, só de
+//            acréscimo (./server --historico DIR).
+//
+//            O registro é dividido em segmentos de tamanho fixo
+//            (HISTORICO_SEGMENTO), um arquivo por segmento, nomeado pela
+//            primeira sequência que contém. Cada segmento é mapeado com
+//            mmap: a thread do histórico escreve nele e as threads dos
+//            shards leem direto do mapeamento, sem cópia para a memória
+//            do processo. Ao lado de cada segmento fica um índice esparso
+//            (.idx) com a posição de um a cada HISTORICO_PASSO_INDICE
+//            registros.
+//
+//            Quem produz mensagens (cada shard e a interface) tem sua fila
+//            SPSC até a thread do histórico, que grava tudo o que chegou e
+//            então aplica a política de fsync uma vez para o lote inteiro
+//            (group commit). Se a fila encher, o registro é descartado e
+//            contado: o histórico nunca segura o caminho das mensagens.
+//            Depois de cada lote, a thread avisa o observador registrado
+//            (o índice de busca, busca.h), que lê os registros novos com
+//            um CursorHistorico.
+//
+//            Formato de um registro (alinhado a 8 bytes):
+//              RegistroHistorico | nome da sala | quadro CHAT codificado
+// ============================================================================
+
+#ifndef HISTORICO_H
+#define HISTORICO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "buffer.h"
+
+#define HISTORICO_SEGMENTO (16 * 1024 * 1024)
+#define HISTORICO_MAX_SEGMENTOS 1024
+#define HISTORICO_PASSO_INDICE 64
+#define HISTORICO_FILA_CAPACIDADE 8192
+#define HISTORICO_MAX_PEDIDO 500 // Máximo de mensagens por /history
+
+// Política de fsync aplicada a cada lote gravado
+typedef enum {
+    FSYNC_NUNCA = 0,     // Fica a cargo do kernel
+    FSYNC_PERIODICO = 1, // No máximo um fdatasync por segundo
+    FSYNC_LOTE = 2       // Um fdatasync por lote gravado
+} PoliticaFsync;
+
+// Quem pode ver um registro ao pedir o histórico
+typedef enum {
+    HISTORICO_SALA = 1,     // Mensagem de sala: só os membros da sala
+    HISTORICO_DIFUSAO = 2,  // Mensagem do operador para todos
+    HISTORICO_OPERADOR = 3  // Mensagem privada para o operador: nunca é reenviada
+} EscopoHistorico;
+
+// Cabeçalho de um registro no segmento
+typedef struct {
+    uint32_t tamanho;      // Registro inteiro, múltiplo de 8; 0 = fim do segmento
+    uint32_t verificacao;  // FNV-1a de tudo o que vem depois do cabeçalho
+    uint64_t sequencia;
+    int64_t instante;      // Segundos desde a época
+    uint32_t tamanho_quadro;
+    uint8_t escopo;
+    uint8_t tamanho_sala;
+    uint16_t reservado;
+} RegistroHistorico;
+
+// Posição de leitura sequencial no registro (historico_proximo)
+typedef struct {
+    size_t segmento;
+    size_t posicao;
+} CursorHistorico;
+
+int historico_iniciar(const char *diretorio, int produtores, PoliticaFsync politica);
+int historico_ativo(void);
+int historico_registrar(int produtor, EscopoHistorico escopo,
+                        BufferCompartilhado *sala, BufferCompartilhado *quadro);
+void historico_publicar(int produtor);
+void historico_observar(int fd);
+BufferCompartilhado *historico_ultimos(const char *sala, size_t tamanho_sala, int quantidade,
+                                       int *encontradas);
+void historico_posicionar(uint64_t sequencia, CursorHistorico *cursor);
+const RegistroHistorico *historico_proximo(CursorHistorico *cursor);
+int historico_visivel(uint64_t sequencia, const char *sala, size_t tamanho_sala);
+BufferCompartilhado *historico_montar(const uint64_t *sequencias, int total, const char *sala,
+                                      size_t tamanho_sala, int *montadas);
+void historico_estatisticas(uint64_t *gravados, uint64_t *descartados, size_t *segmentos);
+void historico_finalizar(void);
+int historico_politica_ler(const char *nome, PoliticaFsync *politica);
+
+#endif
@@ -0,0 +1,2705 @@
+// ============================================================================
+// ARQUIVO: reator.c
+//
+// DESCRIÇÃO: Reator de rede do servidor, dividido em shards. Cada shard é
+//            uma thread presa a uma CPU, com seu próprio socket de escuta
+//            (SO_REUSEPORT, o kernel distribui as conexões), seu epoll em
+//            modo edge-triggered e as sessões que aceitou. Nada do caminho
+//            de uma mensagem passa por trava.
+//
+//            A interface do operador (server.c) conversa com cada shard por
+//            duas filas SPSC sem travas: o shard entrega as mensagens
+//            recebidas em `fila_recebidas` e a interface deposita os quadros
+//            do operador em `fila_operador`, acordando o epoll_wait por
+//            meio de um eventfd. As conexões falam o protocolo de quadros
+//            descrito em common/protocolo.h.
+//
+//            Uma sala pode ter membros em vários shards. Cada par de shards
+//            tem uma caixa de correio SPSC; o quadro de uma sala é difundido
+//            aos membros locais e vai, como carta, só para os shards que
+//            têm salas naquele balde (ver sala.h), acordados uma vez por
+//            rodada. Os blocos de arquivo (/send) seguem o mesmo caminho.
+//
+//            Com --historico, as mensagens de chat (salas, difusões do
+//            operador e mensagens para o operador) são entregues também ao
+//            histórico persistente (historico.c), reusando o mesmo buffer.
+//
+//            Difusões (operador e salas) codificam o quadro uma única vez em
+//            um buffer compartilhado e enfileiram a mesma memória em cada
+//            sessão de destino. As sessões que receberam algo na rodada são
+//            marcadas e descarregadas juntas, com um sendmsg() por sessão,
+//            ao fim da rodada do epoll.
+//
+//            Cada shard tem um timerfd periódico que move uma roda de
+//            temporizadores hierárquica (temporizador.h), com um
+//            temporizador por sessão: uma conexão calada por --ping segundos
+//            recebe um CONTROLE_PING e é derrubada se nada chegar em
+//            --tempo-pong segundos; com --ocioso, a que passa esse tempo sem
+//            mandar mensagens também. Receber bytes só anota o tick atual;
+//            o temporizador confere as anotações quando vence e se reagenda.
+//
+//            A fila de saída de cada sessão é limitada em bytes e em
+//            quadros (--saida-kb, --saida-quadros). Acima da marca alta
+//            (metade do limite), quem a alimenta com blocos de arquivo, ou
+//            com respostas para si mesmo, para de ser lido até ela descer à
+//            marca baixa (um quarto): o kernel segura o resto e o TCP freia
+//            o remetente. Mensagens de chat nunca param quem as manda, para
+//            que um leitor lento não atrase a sala; quando a fila dele chega
+//            ao limite, vale a política de --lento: descartar as mensagens
+//            mais antigas, descartar as novas ou derrubar a conexão. Só os
+//            membros do mesmo shard param um remetente; os de outros shards
+//            ficam só com a política.
+//
+//            Sessões retomáveis (ver protocolo.h): toda sessão nasce com um
+//            token, cujo byte baixo é o índice do shard dono. Quando a
+//            conexão de um cliente que confirma o que recebe cai, a sessão
+//            fica suspensa por --retomada segundos, ainda na sala e
+//            acumulando a saída. Se uma conexão nova começa com
+//            CONTROLE_RETOMAR, o socket dela é passado (por uma caixa SPSC
+//            de conexões, se preciso) ao shard dono do token, onde uma
+//            sessão nova herda tudo da suspensa e reenvia o que o cliente
+//            não recebeu.
+//
+//            Os nicknames são únicos no servidor: um registro global
+//            (registro.h) liga cada nickname ao token da sessão. Uma
+//            mensagem privada acha ali o token do destino; se ele é de
+//            outro shard, vai como carta, e lá a tabela de tokens acha a
+//            sessão. Nada percorre as conexões.
+//
+//            Com --local, os clientes da mesma máquina também entram por um
+//            socket UNIX (unix://) ou pela memória compartilhada (shm://,
+//            ver transporte.h). O socket de escuta é um só, no epoll de
+//            todos os shards com EPOLLEXCLUSIVE. Uma sessão por memória
+//            fica no epoll pelo eventfd de aviso, que vale tanto para
+//            dados quanto para espaço nos anéis; o socket dela só
+//            denuncia a queda do cliente.
+//
+//            Com a federação (federacao.h), os quadros de sala, as difusões
+//            do operador, as mensagens privadas para nicknames de outros nós
+//            e a presença dos nicknames também vão à thread da federação,
+//            por uma fila SPSC de cada shard; o que chega de outros nós
+//            volta a cada shard por outra fila e segue o caminho local.
+//
+//            Com --troca (troca.h), um processo novo do servidor assume as
+//            conexões deste sem derrubá-las: os shards param, cada um grava
+//            o estado das suas sessões em um bloco e solta as sessões sem
+//            fechar os sockets, e a interface passa ao processo novo os
+//            sockets de escuta, os das sessões e os blocos. Lá, cada shard
+//            recria as suas sessões na própria thread (sala, nickname,
+//            token, fila de saída, quadro pela metade) antes da primeira
+//            rodada. Os buffers compartilhados pelas filas de um shard vão
+//            uma vez só.
+//
+//            A lógica das sessões é a mesma para os dois backends de E/S:
+//            o epoll deste arquivo e o io_uring de reator_uring.c, escolhido
+//            na inicialização (ver reator_interno.h).
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/resource.h>
+#include <sys/random.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "servidor.h"
+#include "protocolo.h"
+#include "fila_spsc.h"
+#include "buffer.h"
+#include "slab.h"
+#include "sessao.h"
+#include "sala.h"
+#include "registro.h"
+#include "historico.h"
+#include "busca.h"
+#include "federacao.h"
+#include "metricas.h"
+#include "temporizador.h"
+#include "transporte.h"
+#include "rastro.h"
+#include "troca.h"
+#include "reator_interno.h"
+
+#define MAX_EVENTOS 256
+
+// Bit baixo de epoll_data.ptr: o evento é do socket de uma sessão por
+// memória, não do eventfd de aviso (as sessões são alinhadas a 8 bytes)
+#define SOCKET_MEMORIA ((uintptr_t)1)
+
+#define TICK_MS 100 // Resolução da roda de temporizadores
+#define TICKS(segundos) ((uint64_t)(segundos) * 1000 / TICK_MS)
+
+#define CAIXA_CAPACIDADE 4096
+#define CONEXOES_CAPACIDADE 64 // Retomadas a caminho de outro shard
+#define TOKENS_BALDES 4096      // Potência de 2
+#define TOKEN_SHARD(token) ((int)((token) & 0xff))
+#define CONFIRMACAO_LIMIAR (16 * 1024) // Bytes recebidos entre duas confirmações
+
+// Marcas da fila de saída, como frações do limite
+#define MARCA_ALTA(limite) ((limite) / 2)
+#define MARCA_BAIXA(limite) ((limite) / 4)
+
+// Carta entre shards: um quadro já codificado para os membros locais de
+// uma sala, ou para uma só sessão (mensagem privada). Os buffers são
+// compartilhados; a carta segura uma referência de cada.
+typedef struct {
+    BufferCompartilhado *quadro;
+    BufferCompartilhado *sala; // Nome da sala (sem '\0'); NULL = para `token`
+    uint64_t token;            // Sessão de destino de uma mensagem privada
+} Carta;
+
+// Conexão que pediu a retomada de uma sessão de outro shard. O descritor
+// passa a ser do shard de destino.
+typedef struct {
+    int fd;
+    char ip[INET_ADDRSTRLEN];
+    uint64_t token;
+    uint64_t fluxo; // Bytes do fluxo do servidor que o cliente recebeu
+} ConexaoRetomada;
+
+// Cartas que não couberam na caixa de um destino; vão na próxima rodada
+typedef struct {
+    Carta *cartas;
+    size_t total;
+    size_t capacidade;
+} CartasAtrasadas;
+
+// Estado de um shard: um reator com seu próprio socket de escuta
+// (SO_REUSEPORT), seu epoll/io_uring e as sessões que aceitou. Só a thread
+// do shard mexe nele, exceto pelas filas SPSC e pelos contadores voláteis.
+typedef struct Reator {
+    int indice;
+    int epoll_fd;
+    int socket_escuta;
+    int evento_fd; // Acorda o shard: quadros do operador ou cartas de outros shards
+    int relogio_fd; // timerfd que move a roda (-1 sem batimentos)
+    int mensagens_na_rodada;
+
+    RodaTemporizadores roda;
+
+    // Sessões por token, para a retomada
+    Sessao *tokens[TOKENS_BALDES];
+
+    Sessao *sessoes;
+    Sessao *sessoes_fechadas; // Liberadas ao fim de cada rodada
+    Sessao *sessoes_marcadas; // Com saída enfileirada nesta rodada
+    Sessao *sessoes_orfas;    // Fechadas, com operações ainda no kernel
+    Sessao *sessoes_a_retomar; // Pausadas cuja espera terminou; voltam a ser lidas
+
+    // Quadro em tratamento: quem o mandou e a primeira fila que ele fez
+    // passar da marca alta (o remetente para de ser lido depois dele)
+    Sessao *produtor;
+    Sessao *bloqueio;
+    volatile int total_sessoes;
+
+    // Reator -> interface: descarta as mensagens mais novas se a tela não acompanhar
+    FilaSPSC fila_recebidas;
+    // Interface -> reator: buffers já codificados; nada pode se perder, o
+    // operador aguarda espaço
+    FilaSPSC fila_operador;
+
+    // caixas[i]: cartas do shard i para este shard (SPSC, uma por remetente)
+    FilaSPSC *caixas;
+    // conexoes[i]: retomadas de sessões deste shard que chegaram pelo shard i
+    FilaSPSC *conexoes;
+    // atrasadas[j]: cartas deste shard para o shard j à espera de espaço
+    CartasAtrasadas *atrasadas;
+    uint64_t shards_a_acordar; // Bit j: o shard j recebeu cartas nesta rodada
+
+    // Troca a quente: as sessões que o shard deixou para o processo novo,
+    // os buffers das filas delas (cada um uma vez) e os sockets, em ordem
+    // (um int por sessão com conexão)
+    BlocoTroca exportadas;
+    BlocoTroca buffers_exportados;
+    BlocoTroca descritores_exportados;
+    uint32_t total_exportadas;
+    uint32_t total_buffers_exportados;
+} Reator;
+
+// Um buffer já gravado no bloco do shard na troca e a sua posição lá
+typedef struct {
+    BufferCompartilhado *buffer;
+    uint32_t indice;
+} BufferExportado;
+
+// Sessão gravada pelo processo antigo, lida de um bloco de troca (os
+// textos e bytes apontam para dentro do bloco)
+typedef struct {
+    int retendo;
+    int com_socket; // Senão estava suspensa, à espera da retomada
+    uint64_t id;
+    uint64_t token;
+    uint64_t recebidos;
+    uint64_t confirmacao_enviada;
+    uint64_t fluxo_base;
+    const char *nickname;
+    size_t tamanho_nickname;
+    const char *ip;
+    size_t tamanho_ip;
+    const char *sala;
+    size_t tamanho_sala;
+    const uint8_t *leitor; // Bytes recebidos e ainda não tratados
+    uint32_t tamanho_leitor;
+    uint32_t itens;
+    uint32_t retidos;
+    const uint8_t *saida; // `itens` x (buffer u32, enviado u32, fora do fluxo u8)
+} SessaoHerdada;
+
+#define ITEM_HERDADO 9
+
+// Trecho do bloco herdado com o que é de um shard
+typedef struct {
+    int escuta; // Socket de escuta TCP (-1 depois de usado)
+    size_t inicio;
+    size_t fim;
+    uint32_t primeiro_descritor; // Sockets das sessões em estado.descritores
+    uint32_t total_descritores;
+    int adotado;
+} SegmentoHerdado;
+
+static Reator *reatores = NULL;
+static int total_reatores = 0;
+static _Thread_local Reator *reator; // Shard da thread atual
+
+static int evento_interface = -1; // Sinalizado para acordar a interface
+static int proxima_fila_interface = 0; // Rodízio entre os shards na interface
+
+// Marcadores usados em epoll_data.ptr para os descritores que não são sessões
+static int marcador_escuta;
+static int marcador_local;
+static int marcador_evento;
+static int marcador_relogio;
+
+// Transporte local (--local): um socket de escuta para todos os shards
+static EnderecoTransporte endereco_local;
+static int local_ligado = 0;
+static int socket_local = -1;
+
+static BackendReator backend = REATOR_EPOLL;
+static _Atomic unsigned long proximo_id = 1;
+static volatile int encerrando = 0;
+
+// Troca a quente (--troca): os shards param para passar as sessões a um
+// processo novo; `exportado`: já passaram, o socket local não é apagado
+static volatile int transferindo = 0;
+static uint64_t parada_transferencia = 0;
+static int exportado = 0;
+
+// Estado herdado de um processo antigo, adotado pelos shards na primeira
+// rodada; a barreira segura todos até o último terminar, para nenhum
+// difundir antes de as salas e os nicknames dos outros existirem
+static struct {
+    int ativa;
+    TrocaEstado estado;
+    int local; // Socket local (-1 depois de usado, ou se não havia)
+    SegmentoHerdado *segmentos;
+    size_t cartas; // Posição das cartas no bloco
+    pthread_barrier_t barreira;
+} heranca;
+
+// Batimentos em ticks da roda (0 = desligado) e os quadros prontos que todas
+// as sessões compartilham
+static uint64_t ticks_ping = TICKS(PING_PADRAO);
+static uint64_t ticks_pong = TICKS(TEMPO_PONG_PADRAO);
+static uint64_t ticks_ocioso = TICKS(OCIOSO_PADRAO);
+static uint64_t ticks_retomada = TICKS(RETOMADA_PADRAO); // Espera da sessão suspensa
+
+// Limites da fila de saída de cada sessão e o que fazer ao chegar neles
+static size_t saida_max_bytes = (size_t)SAIDA_KB_PADRAO * 1024;
+static uint32_t saida_max_quadros = SAIDA_QUADROS_PADRAO;
+static PoliticaLento politica_lento = LENTO_DESCARTAR_ANTIGOS;
+
+static BufferCompartilhado *quadro_ping = NULL;
+static BufferCompartilhado *quadro_pong = NULL;
+
+// Função para acordar um shard a partir de outra thread
+static void acordar_reator(Reator *destino) {
+    uint64_t um = 1;
+    if (write(destino->evento_fd, &um, sizeof(um)) < 0 && errno != EAGAIN) {
+        perror("[ERRO] Falha ao sinalizar o reator");
+    }
+}
+
+// Função para elevar o limite de descritores abertos ao máximo permitido
+static void elevar_limite_descritores() {
+    struct rlimit limite;
+    if (getrlimit(RLIMIT_NOFILE, &limite) == 0 && limite.rlim_cur < limite.rlim_max) {
+        limite.rlim_cur = limite.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limite);
+    }
+}
+
+// Função para pôr uma mensagem na fila de exibição da interface. Se a
+// fila estiver cheia a mensagem é descartada e contada.
+static void exibir_mensagem(uint8_t tipo, const char *origem, size_t tamanho_origem,
+                            const char *corpo, size_t tamanho) {
+    MensagemRecebida m;
+    m.tipo = tipo;
+    m.tamanho_origem = (uint8_t)tamanho_origem;
+    m.tamanho = (uint32_t)tamanho;
+    m.recebido = metricas_agora();
+    m.dados = slab_alocar(tamanho_origem + 1 + tamanho + 1);
+    if (m.dados == NULL) return;
+    memcpy(m.dados, origem, tamanho_origem);
+    m.dados[tamanho_origem] = '\0';
+    memcpy(MENSAGEM_CORPO(&m), corpo, tamanho);
+    MENSAGEM_CORPO(&m)[tamanho] = '\0';
+    if (fila_spsc_inserir(&reator->fila_recebidas, &m)) {
+        metricas_ajustar(MEDIDOR_FILA_EXIBICAO, 1);
+    } else {
+        slab_liberar(m.dados);
+    }
+    reator->mensagens_na_rodada++;
+}
+
+// Função para entregar uma mensagem recebida à interface do operador
+// (e ao histórico, se for de chat)
+static void entregar_mensagem(uint8_t tipo, const char *origem, const char *corpo, size_t tamanho) {
+    size_t tamanho_origem = strlen(origem);
+    if (tipo == QUADRO_CHAT && historico_ativo()) {
+        BufferCompartilhado *quadro = buffer_criar(protocolo_tamanho_quadro(tamanho_origem, tamanho));
+        if (quadro != NULL) {
+            quadro->tamanho = (uint32_t)protocolo_codificar(quadro->dados, QUADRO_CHAT, origem,
+                                                            corpo, tamanho);
+            historico_registrar(reator->indice, HISTORICO_OPERADOR, NULL, quadro);
+            buffer_soltar(quadro);
+        }
+    }
+    exibir_mensagem(tipo, origem, tamanho_origem, corpo, tamanho);
+}
+
+// Função para acordar a interface uma única vez por rodada do epoll
+static void acordar_interface() {
+    if (reator->mensagens_na_rodada == 0) return;
+    reator->mensagens_na_rodada = 0;
+    uint64_t um = 1;
+    if (write(evento_interface, &um, sizeof(um)) < 0 && errno != EAGAIN) {
+        perror("[ERRO] Falha ao sinalizar a interface");
+    }
+}
+
+static void sair_da_sala(Sessao *s);
+static void difundir_na_sala(Sala *sala, BufferCompartilhado *buffer, Sessao *remetente);
+static void soltar_esperas(Sessao *s);
+static void liberar_esperas(Sessao *s);
+static void retomar_pausadas();
+
+// Função para gerar o token de uma sessão: 56 bits do getrandom e o
+// índice do shard no byte baixo. O token é a única credencial da sessão,
+// então nenhum bit sai de um gerador que o cliente possa reconstruir a
+// partir do próprio token.
+static uint64_t gerar_token() {
+    uint64_t token;
+    do {
+        while (getrandom(&token, sizeof(token), 0) != sizeof(token)) {
+            // Só EINTR: reator_iniciar já conferiu que o getrandom funciona
+        }
+        token = (token & ~UINT64_C(0xff)) | (uint64_t)reator->indice;
+    } while ((token >> 8) == 0);
+    return token;
+}
+
+// Função para achar o balde de um token na tabela do shard
+static Sessao **balde_token(uint64_t token) {
+    return &reator->tokens[(token >> 8) & (TOKENS_BALDES - 1)];
+}
+
+// Função para registrar o token de uma sessão na tabela do shard
+static void registrar_token(Sessao *s, uint64_t token) {
+    Sessao **balde = balde_token(token);
+    s->token = token;
+    s->proxima_token = *balde;
+    *balde = s;
+}
+
+// Função para tirar o token de uma sessão da tabela do shard
+static void remover_token(Sessao *s) {
+    if (s->token == 0) return;
+    for (Sessao **p = balde_token(s->token); *p != NULL; p = &(*p)->proxima_token) {
+        if (*p == s) {
+            *p = s->proxima_token;
+            break;
+        }
+    }
+    s->token = 0;
+}
+
+// Função para procurar a sessão de um token entre as do shard
+static Sessao *buscar_token(uint64_t token) {
+    for (Sessao *s = *balde_token(token); s != NULL; s = s->proxima_token) {
+        if (s->token == token) return s;
+    }
+    return NULL;
+}
+
+// Função para tirar o socket de uma sessão do backend e fechá-lo
+static void desligar_socket(Sessao *s) {
+    if (backend == REATOR_URING) {
+        // O io_uring segura o socket até as operações pendentes terminarem;
+        // o shutdown faz o recv multishot e envios em curso concluírem. Um
+        // socket transferido segue vivo em outra sessão: só o recv desta
+        // (já cancelado) deixa de usá-lo.
+        if (!s->transferida) shutdown(s->fd, SHUT_RDWR);
+    } else {
+        // O eventfd de aviso segue aberto no cliente: fechá-lo aqui não o
+        // tiraria do epoll
+        if (s->aviso_fd >= 0) epoll_ctl(reator->epoll_fd, EPOLL_CTL_DEL, s->aviso_fd, NULL);
+        epoll_ctl(reator->epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+    }
+    transporte_fechar(s->fd);
+    rastro_conexao(s->conexao, RASTRO_FECHADA);
+    // Outros eventos da mesma rodada ainda podem apontar para esta sessão
+    s->fd = s->aviso_fd = -1;
+}
+
+// Função para fechar uma sessão e liberar seus recursos
+void fechar_sessao(Sessao *s, const char *motivo) {
+    if (motivo != NULL) {
+        printf("\r\033[K\033[33m[SISTEMA] %s (%s) %s.\033[0m\n", s->nickname, s->ip, motivo);
+        fflush(stdout);
+    }
+    if (s->fd >= 0) desligar_socket(s); // Suspensas já não têm socket
+    sair_da_sala(s);
+    roda_cancelar(&reator->roda, &s->temporizador);
+    // Uma sessão herdada já não tem token; uma passada a um processo novo
+    // (--troca) segue presente nele
+    if (registro_liberar(s->nickname, s->token) && !transferindo) {
+        federacao_enviar_presenca(reator->indice, s->nickname, 0);
+    }
+    remover_token(s);
+    soltar_esperas(s);
+    s->lenta = 0; // Já fechada: descarregar_marcadas() não a derruba de novo
+
+    if (s->anterior) s->anterior->proxima = s->proxima;
+    else reator->sessoes = s->proxima;
+    if (s->proxima) s->proxima->anterior = s->anterior;
+    reator->total_sessoes--;
+
+    s->proxima = reator->sessoes_fechadas;
+    reator->sessoes_fechadas = s;
+}
+
+// Função para tratar a queda da conexão de uma sessão. A de um cliente que
+// confirma o que recebe fica suspensa por --retomada segundos, ainda na
+// sala e acumulando a saída, à espera de uma retomada; as demais são
+// fechadas.
+void perder_conexao(Sessao *s, const char *motivo) {
+    if (!s->retendo || ticks_retomada == 0 || encerrando) {
+        fechar_sessao(s, motivo);
+        return;
+    }
+    printf("\r\033[K\033[33m[SISTEMA] %s (%s) %s; aguardando a retomada.\033[0m\n",
+           s->nickname, s->ip, motivo);
+    fflush(stdout);
+    desligar_socket(s);
+    leitor_descartar(&s->leitor); // O quadro pela metade volta inteiro na retomada
+    liberar_esperas(s); // Sem socket a fila não anda: ninguém espera por ela
+    s->suspensa = 1;
+    s->ping_pendente = 0;
+    roda_agendar(&reator->roda, &s->temporizador, ticks_retomada);
+}
+
+// Função para liberar a memória de uma sessão fechada
+static void liberar_sessao(Sessao *s) {
+    leitor_liberar(&s->leitor);
+    sessao_liberar_saida(s);
+    free(s->envio_uring);
+    free(s);
+}
+
+// Função para liberar as sessões fechadas durante a rodada. As que ainda
+// têm operações no io_uring viram órfãs e são liberadas na última conclusão.
+static void liberar_sessoes_fechadas() {
+    while (reator->sessoes_fechadas != NULL) {
+        Sessao *s = reator->sessoes_fechadas;
+        reator->sessoes_fechadas = s->proxima;
+        if (s->operacoes_pendentes > 0) {
+            s->orfa = 1;
+            s->anterior = NULL;
+            s->proxima = reator->sessoes_orfas;
+            if (reator->sessoes_orfas) reator->sessoes_orfas->anterior = s;
+            reator->sessoes_orfas = s;
+            continue;
+        }
+        liberar_sessao(s);
+    }
+}
+
+// Função para liberar uma sessão órfã cuja última operação terminou
+void liberar_sessao_orfa(Sessao *s) {
+    if (s->anterior) s->anterior->proxima = s->proxima;
+    else reator->sessoes_orfas = s->proxima;
+    if (s->proxima) s->proxima->anterior = s->anterior;
+    liberar_sessao(s);
+}
+
+// Função para incluir a sessão entre as que serão descarregadas na rodada
+void marcar_sessao(Sessao *s) {
+    if (!s->marcada) {
+        s->marcada = 1;
+        s->proxima_marcada = reator->sessoes_marcadas;
+        reator->sessoes_marcadas = s;
+    }
+}
+
+// Função para saber se a fila de saída de uma sessão está acima da marca alta
+static int acima_da_marca_alta(const Sessao *s) {
+    return s->saida_bytes > MARCA_ALTA(saida_max_bytes) ||
+           sessao_quadros_pendentes(s) > MARCA_ALTA(saida_max_quadros);
+}
+
+// Função para saber se a fila de saída de uma sessão já desceu à marca baixa
+static int abaixo_da_marca_baixa(const Sessao *s) {
+    return s->saida_bytes <= MARCA_BAIXA(saida_max_bytes) &&
+           sessao_quadros_pendentes(s) <= MARCA_BAIXA(saida_max_quadros);
+}
+
+// Função para saber se mais um buffer de `tamanho` bytes passaria do limite
+// da fila de saída
+static int passaria_do_limite(const Sessao *s, size_t tamanho) {
+    return s->saida_bytes + tamanho > saida_max_bytes ||
+           sessao_quadros_pendentes(s) >= saida_max_quadros;
+}
+
+// Função para aplicar a política de --lento a uma sessão cuja fila não
+// comporta `buffer`. Só mensagens de chat (de sala ou privadas) podem ser
+// descartadas; se o que falta enviar é de outro tipo, a conexão é derrubada
+// em qualquer política.
+// Retorna 1 se o buffer não deve ser enfileirado
+static int conter_saida(Sessao *s, const BufferCompartilhado *buffer) {
+    int chat = buffer->dados[1] == QUADRO_CHAT || buffer->dados[1] == QUADRO_PRIVADO;
+    if (politica_lento == LENTO_DESCARTAR_NOVOS && chat) {
+        metricas_somar(METRICA_QUADROS_DESCARTADOS, 1);
+        return 1;
+    }
+    if (politica_lento == LENTO_DESCARTAR_ANTIGOS) {
+        // Desce de uma vez até a marca alta, para não varrer a fila a cada
+        // quadro novo; o que está em um envio em voo não pode sair
+        uint32_t protegidos = uring_envio_em_voo(s) ? SESSAO_IOV_MAX : 0;
+        metricas_somar(METRICA_QUADROS_DESCARTADOS,
+                       sessao_descartar_antigos(s, MARCA_ALTA(saida_max_bytes),
+                                                MARCA_ALTA(saida_max_quadros), protegidos));
+        if (!passaria_do_limite(s, buffer->tamanho)) return 0;
+        if (chat) {
+            metricas_somar(METRICA_QUADROS_DESCARTADOS, 1);
+            return 1;
+        }
+    }
+    // A sessão pode estar no meio de uma difusão na sala: cai ao fim da rodada
+    s->lenta = 1;
+    marcar_sessao(s);
+    return 1;
+}
+
+// Função para enfileirar um buffer na saída de uma sessão. O envio fica
+// para descarregar_marcadas(), ao fim da rodada do epoll. Se a fila passou
+// da marca alta com um bloco de arquivo, ou com uma resposta ao próprio
+// remetente, o remetente do quadro em tratamento para de ser lido.
+// Retorna -1 se faltou memória (um buffer contido pela política não é erro)
+static int enfileirar_saida(Sessao *s, BufferCompartilhado *buffer) {
+    if (s->lenta) return 0;
+    if (passaria_do_limite(s, buffer->tamanho) && conter_saida(s, buffer)) return 0;
+    if (sessao_enfileirar(s, buffer) < 0) return -1;
+    marcar_sessao(s);
+    if (reator->produtor != NULL && reator->bloqueio == NULL && s->fd >= 0 &&
+        (s == reator->produtor || buffer->dados[1] == QUADRO_ARQUIVO) &&
+        acima_da_marca_alta(s)) {
+        reator->bloqueio = s;
+    }
+    return 0;
+}
+
+// Função para parar de ler uma sessão até a fila de `destino` descer à
+// marca baixa. No io_uring o recv multishot é cancelado; o que ele ainda
+// entregar fica no leitor.
+static void pausar_leitura(Sessao *s, Sessao *destino) {
+    s->pausada = 1;
+    s->aguardando = destino;
+    s->proxima_espera = destino->esperando;
+    destino->esperando = s;
+    metricas_somar(METRICA_LEITURAS_PAUSADAS, 1);
+    if (backend == REATOR_URING) uring_cancelar_receber(s);
+}
+
+// Função para passar as sessões à espera da fila de `s` para a lista das
+// que voltam a ser lidas ao fim da rodada
+static void liberar_esperas(Sessao *s) {
+    while (s->esperando != NULL) {
+        Sessao *parada = s->esperando;
+        s->esperando = parada->proxima_espera;
+        parada->aguardando = NULL;
+        parada->proxima_espera = reator->sessoes_a_retomar;
+        reator->sessoes_a_retomar = parada;
+    }
+}
+
+// Função para tirar de uma lista ligada por `proxima_espera`
+static void desligar_espera(Sessao **lista, Sessao *s) {
+    for (Sessao **p = lista; *p != NULL; p = &(*p)->proxima_espera) {
+        if (*p == s) {
+            *p = s->proxima_espera;
+            break;
+        }
+    }
+    s->proxima_espera = NULL;
+}
+
+// Função para desfazer as esperas de uma sessão que está sendo fechada: as
+// que esperavam por ela voltam a ser lidas e ela sai da lista em que estava
+static void soltar_esperas(Sessao *s) {
+    liberar_esperas(s);
+    if (s->aguardando != NULL) {
+        desligar_espera(&s->aguardando->esperando, s);
+    } else if (s->pausada) {
+        desligar_espera(&reator->sessoes_a_retomar, s);
+    }
+    s->aguardando = NULL;
+    s->pausada = 0;
+}
+
+// Função para conferir, depois de um envio, se a fila da sessão desceu à
+// marca baixa; se sim, quem esperava por ela volta a ser lido
+void verificar_esperas(Sessao *s) {
+    if (s->esperando != NULL && abaixo_da_marca_baixa(s)) liberar_esperas(s);
+}
+
+// Função para enfileirar um quadro de controle só para uma sessão; com
+// `frente`, à frente de toda a fila e fora do fluxo
+// Retorna -1 se faltou memória
+static int enviar_controle(Sessao *s, uint8_t operacao, const uint8_t *dados, size_t tamanho,
+                           int frente) {
+    BufferCompartilhado *buffer = buffer_criar(PROTOCOLO_CONTROLE_MINIMO + tamanho);
+    if (buffer == NULL) return -1;
+    buffer->tamanho = (uint32_t)protocolo_codificar_controle(buffer->dados, operacao, dados,
+                                                             tamanho);
+    int resultado = frente ? sessao_enfileirar_frente(s, buffer) : sessao_enfileirar(s, buffer);
+    if (resultado == 0) marcar_sessao(s);
+    buffer_soltar(buffer);
+    return resultado;
+}
+
+// Função para confirmar ao cliente até onde o fluxo dele já foi tratado
+// Retorna -1 se faltou memória
+static int enviar_confirmacao(Sessao *s) {
+    uint8_t fluxo[PROTOCOLO_FLUXO];
+    protocolo_escrever_u64(fluxo, s->recebidos);
+    s->confirmacao_enviada = s->recebidos;
+    return enviar_controle(s, CONTROLE_CONFIRMA, fluxo, sizeof(fluxo), 0);
+}
+
+// Função para saber se há batimentos ligados
+static int batimentos_ligados() {
+    return ticks_ping > 0 || ticks_ocioso > 0;
+}
+
+// Função para saber se a roda (e o relógio que a move) é necessária: para
+// os batimentos ou para o prazo das sessões suspensas
+static int roda_ligada() {
+    return batimentos_ligados() || ticks_retomada > 0;
+}
+
+// Função para calcular daqui a quantos ticks a sessão precisa ser
+// verificada: o prazo do pong, o próximo ping ou a ociosidade, o que vier
+// antes. Só é chamada com os prazos ainda no futuro.
+static uint64_t proxima_verificacao(const Sessao *s) {
+    uint64_t agora = reator->roda.agora;
+    uint64_t espera = UINT64_MAX;
+    if (s->ping_pendente) {
+        espera = s->ping_enviado + ticks_pong - agora;
+    } else if (ticks_ping > 0) {
+        espera = s->ultima_atividade + ticks_ping - agora;
+    }
+    if (ticks_ocioso > 0 && s->ultima_mensagem + ticks_ocioso - agora < espera) {
+        espera = s->ultima_mensagem + ticks_ocioso - agora;
+    }
+    return espera;
+}
+
+// Função chamada pela roda quando vence o temporizador de uma sessão:
+// derruba quem ficou ociosa ou não respondeu ao ping, manda um ping a quem
+// ficou calada e reagenda para o próximo prazo
+static void verificar_sessao(Temporizador *t) {
+    Sessao *s = (Sessao *)((char *)t - offsetof(Sessao, temporizador));
+    uint64_t agora = reator->roda.agora;
+
+    if (s->suspensa) {
+        metricas_somar(METRICA_CONEXOES_EXPIRADAS, 1);
+        fechar_sessao(s, "não retomou a sessão a tempo");
+        return;
+    }
+
+    // Qualquer byte depois do ping vale como resposta
+    if (s->ping_pendente && s->ultima_atividade >= s->ping_enviado) s->ping_pendente = 0;
+
+    if (ticks_ocioso > 0 && agora - s->ultima_mensagem >= ticks_ocioso) {
+        metricas_somar(METRICA_CONEXOES_EXPIRADAS, 1);
+        fechar_sessao(s, "ficou ociosa por tempo demais");
+        return;
+    }
+    if (s->ping_pendente) {
+        if (agora - s->ping_enviado >= ticks_pong) {
+            metricas_somar(METRICA_CONEXOES_EXPIRADAS, 1);
+            perder_conexao(s, "não respondeu ao ping");
+            return;
+        }
+    } else if (ticks_ping > 0 && agora - s->ultima_atividade >= ticks_ping) {
+        // O ping também é hora de confirmar o que ainda não foi confirmado
+        if ((s->retendo && s->recebidos != s->confirmacao_enviada &&
+             enviar_confirmacao(s) < 0) ||
+            enfileirar_saida(s, quadro_ping) < 0) {
+            fechar_sessao(s, "teve a conexão interrompida");
+            return;
+        }
+        metricas_somar(METRICA_PINGS_ENVIADOS, 1);
+        s->ping_pendente = 1;
+        s->ping_enviado = agora;
+    }
+    roda_agendar(&reator->roda, t, proxima_verificacao(s));
+}
+
+// Função para avançar a roda do shard pelos ticks do timerfd (mais de um
+// se o shard demorou a atender o relógio)
+void tratar_relogio_reator(uint64_t ticks) {
+    roda_avancar(&reator->roda, ticks, verificar_sessao);
+}
+
+// Função para descarregar a saída de todas as sessões marcadas na rodada.
+// No io_uring o envio é submetido ao anel; no encerramento, ou no epoll,
+// é feito na hora com sendmsg().
+static void descarregar_marcadas() {
+    while (reator->sessoes_marcadas != NULL) {
+        Sessao *s = reator->sessoes_marcadas;
+        reator->sessoes_marcadas = s->proxima_marcada;
+        s->marcada = 0;
+        if (s->lenta) {
+            metricas_somar(METRICA_CONEXOES_LENTAS, 1);
+            fechar_sessao(s, "não acompanhou as mensagens e foi derrubado");
+            continue;
+        }
+        if (s->fd < 0) continue;
+
+        if (s->retendo && !s->confirmacao_pedida && s->retidos_bytes >= SESSAO_RETIDOS_MAX / 2) {
+            // Retidos demais: o ping faz o cliente confirmar o que recebeu
+            if (sessao_enfileirar(s, quadro_ping) == 0) s->confirmacao_pedida = 1;
+        }
+        int resultado;
+        if (backend == REATOR_URING && !encerrando) {
+            resultado = uring_enviar(s);
+        } else if (uring_envio_em_voo(s)) {
+            continue; // Os primeiros bytes da fila ainda estão no anel
+        } else {
+            resultado = sessao_descarregar(s);
+        }
+        if (resultado < 0) {
+            metricas_somar(METRICA_ERROS_ENVIO, 1);
+            perder_conexao(s, "teve a conexão interrompida");
+        } else {
+            verificar_esperas(s);
+        }
+    }
+}
+
+// Função para postar uma carta para outro shard: para a sala `sala` ou,
+// sem sala, para a sessão de `token`. Se a caixa estiver cheia (ou já
+// houver cartas à espera, para manter a ordem), a carta espera em
+// `atrasadas` até a próxima rodada.
+static void enviar_carta(int destino, BufferCompartilhado *quadro, BufferCompartilhado *sala,
+                         uint64_t token) {
+    CartasAtrasadas *atrasadas = &reator->atrasadas[destino];
+    Carta carta = { quadro, sala, token };
+    buffer_reter(quadro);
+    if (sala != NULL) buffer_reter(sala);
+
+    if (atrasadas->total == 0 &&
+        fila_spsc_inserir(&reatores[destino].caixas[reator->indice], &carta)) {
+        reator->shards_a_acordar |= UINT64_C(1) << destino;
+        return;
+    }
+    if (atrasadas->total == atrasadas->capacidade) {
+        size_t nova = atrasadas->capacidade ? atrasadas->capacidade * 2 : 64;
+        Carta *novo = realloc(atrasadas->cartas, nova * sizeof(Carta));
+        if (novo == NULL) {
+            buffer_soltar(quadro);
+            if (sala != NULL) buffer_soltar(sala);
+            return;
+        }
+        atrasadas->cartas = novo;
+        atrasadas->capacidade = nova;
+    }
+    atrasadas->cartas[atrasadas->total++] = carta;
+}
+
+// Função para repassar um quadro de sala aos outros shards que podem ter
+// membros dela
+static void repassar_sala(Sala *sala, BufferCompartilhado *quadro) {
+    if (total_reatores == 1 || encerrando) return;
+    uint64_t destinos = sala_shards_presentes(sala->nome, strlen(sala->nome));
+    destinos &= ~(UINT64_C(1) << reator->indice);
+    while (destinos != 0) {
+        int destino = __builtin_ctzll(destinos);
+        destinos &= destinos - 1;
+        enviar_carta(destino, quadro, sala->nome_compartilhado, 0);
+    }
+}
+
+// Função para tentar de novo as cartas atrasadas e acordar, uma vez, cada
+// shard que recebeu cartas na rodada
+static void postar_cartas() {
+    int pendentes = 0;
+    for (int j = 0; j < total_reatores && reator->atrasadas != NULL; j++) {
+        CartasAtrasadas *atrasadas = &reator->atrasadas[j];
+        if (atrasadas->total == 0) continue;
+        FilaSPSC *caixa = &reatores[j].caixas[reator->indice];
+        size_t postadas = 0;
+        while (postadas < atrasadas->total &&
+               fila_spsc_inserir(caixa, &atrasadas->cartas[postadas])) {
+            postadas++;
+        }
+        if (postadas > 0) {
+            memmove(atrasadas->cartas, atrasadas->cartas + postadas,
+                    (atrasadas->total - postadas) * sizeof(Carta));
+            atrasadas->total -= postadas;
+            reator->shards_a_acordar |= UINT64_C(1) << j;
+        }
+        if (atrasadas->total > 0) pendentes = 1;
+    }
+
+    uint64_t acordar = reator->shards_a_acordar;
+    reator->shards_a_acordar = 0;
+    while (acordar != 0) {
+        int destino = __builtin_ctzll(acordar);
+        acordar &= acordar - 1;
+        acordar_reator(&reatores[destino]);
+    }
+    // O destino está atrasado: volta logo para tentar outra vez
+    if (pendentes) acordar_reator(reator);
+}
+
+// Função para entregar uma carta de outro shard (a de sala aos membros
+// locais, a privada à sessão do token, se ela ainda existe) e soltar os
+// buffers dela
+static void entregar_carta(const Carta *carta) {
+    if (carta->sala == NULL) {
+        Sessao *destino = buscar_token(carta->token);
+        if (destino != NULL) enfileirar_saida(destino, carta->quadro);
+        buffer_soltar(carta->quadro);
+        return;
+    }
+    Sala *sala = sala_buscar((const char *)carta->sala->dados, carta->sala->tamanho);
+    if (sala != NULL) difundir_na_sala(sala, carta->quadro, NULL);
+    buffer_soltar(carta->quadro);
+    buffer_soltar(carta->sala);
+}
+
+// Função para entregar as cartas vindas de outros shards
+static void receber_cartas() {
+    for (int o = 0; o < total_reatores; o++) {
+        if (o == reator->indice) continue;
+        Carta carta;
+        while (fila_spsc_remover(&reator->caixas[o], &carta)) {
+            entregar_carta(&carta);
+        }
+    }
+}
+
+// Função para encerrar uma rodada do reator: envia o que foi enfileirado,
+// libera as sessões fechadas e acorda a interface, os shards com cartas e
+// o histórico
+void fim_da_rodada() {
+    // Voltar a ler enfileira mais saída, e descarregar pode terminar outras
+    // esperas
+    do {
+        retomar_pausadas();
+        descarregar_marcadas();
+    } while (reator->sessoes_a_retomar != NULL);
+    liberar_sessoes_fechadas();
+    acordar_interface();
+    postar_cartas();
+    historico_publicar(reator->indice);
+    federacao_publicar(reator->indice);
+}
+
+// Função para enviar o mesmo buffer a todos os membros de uma sala.
+// `remetente` fica de fora, a menos que seja NULL.
+static void difundir_na_sala(Sala *sala, BufferCompartilhado *buffer, Sessao *remetente) {
+    for (uint32_t i = 0; i < sala->total; i++) {
+        Sessao *membro = sala->membros[i];
+        if (membro == remetente) continue;
+        enfileirar_saida(membro, buffer);
+    }
+}
+
+// Função para codificar um quadro uma única vez e difundi-lo na sala,
+// inclusive aos membros em outros shards
+static void difundir_quadro_sala(Sala *sala, uint8_t tipo, const char *origem,
+                                 const char *corpo, size_t tamanho, Sessao *remetente) {
+    BufferCompartilhado *buffer = buffer_criar(protocolo_tamanho_quadro(strlen(origem), tamanho));
+    if (buffer == NULL) return;
+    buffer->tamanho = (uint32_t)protocolo_codificar(buffer->dados, tipo, origem, corpo, tamanho);
+    difundir_na_sala(sala, buffer, remetente);
+    repassar_sala(sala, buffer);
+    federacao_enviar_sala(reator->indice, sala->nome_compartilhado, buffer);
+    if (tipo == QUADRO_CHAT) {
+        historico_registrar(reator->indice, HISTORICO_SALA, sala->nome_compartilhado, buffer);
+    }
+    buffer_soltar(buffer);
+}
+
+// Função para codificar um quadro e enfileirá-lo só para uma sessão
+static void difundir_quadro_resposta(Sessao *s, uint8_t tipo, const char *origem,
+                                     const char *corpo, size_t tamanho) {
+    BufferCompartilhado *buffer = buffer_criar(protocolo_tamanho_quadro(strlen(origem), tamanho));
+    if (buffer == NULL) return;
+    buffer->tamanho = (uint32_t)protocolo_codificar(buffer->dados, tipo, origem, corpo, tamanho);
+    enfileirar_saida(s, buffer);
+    buffer_soltar(buffer);
+}
+
+// Função para tirar uma sessão da sala e avisar quem ficou
+static void sair_da_sala(Sessao *s) {
+    Sala *sala = s->sala;
+    if (sala == NULL) return;
+    if (sala->total > 1 || total_reatores > 1 || federacao_ativa()) {
+        difundir_quadro_sala(sala, QUADRO_SALA, s->nickname, NULL, 0, s);
+    }
+    sala_sair(s);
+}
+
+// Função para criar uma sessão para um socket conectado e colocá-la na
+// lista do shard
+// Retorna NULL (e fecha o descritor) se faltou memória
+static Sessao *criar_sessao(int fd, const char *ip) {
+    Sessao *s = calloc(1, sizeof(Sessao));
+    if (s == NULL) {
+        close(fd);
+        return NULL;
+    }
+    // A saída já é agrupada por rodada (um sendmsg por sessão): o Nagle só
+    // atrasaria a última parte de cada rodada
+    int um = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &um, sizeof(um));
+
+    s->fd = fd;
+    s->aviso_fd = transporte_fd_aviso(fd);
+    s->id = s->conexao = atomic_fetch_add_explicit(&proximo_id, 1, memory_order_relaxed);
+    rastro_conexao(s->conexao, RASTRO_ABERTA);
+    leitor_iniciar(&s->leitor);
+    snprintf(s->nickname, NICKNAME_MAX, "Cliente#%lu", s->id);
+    snprintf(s->ip, INET_ADDRSTRLEN, "%s", ip);
+
+    s->ultima_atividade = s->ultima_mensagem = reator->roda.agora;
+    if (batimentos_ligados()) {
+        roda_agendar(&reator->roda, &s->temporizador, proxima_verificacao(s));
+    }
+
+    s->proxima = reator->sessoes;
+    if (reator->sessoes) reator->sessoes->anterior = s;
+    reator->sessoes = s;
+    reator->total_sessoes++;
+    return s;
+}
+
+// Função para registrar o nickname padrão de uma sessão nova. Se alguém já
+// escolheu "Cliente#<id>" (aqui ou em outro nó), a sessão ganha um sufixo.
+static void registrar_nickname_padrao(Sessao *s) {
+    for (unsigned tentativa = 1;
+         federacao_nick_remoto(s->nickname, strlen(s->nickname)) ||
+         registro_reservar(s->nickname, s->token) == REGISTRO_EM_USO;
+         tentativa++) {
+        snprintf(s->nickname, NICKNAME_MAX, "Cliente#%lu-%u", s->id, tentativa);
+    }
+    federacao_enviar_presenca(reator->indice, s->nickname, 1);
+}
+
+// Função para dar um token a uma sessão que começa do zero e abrir o fluxo
+// de saída com ele (CONTROLE_SESSAO)
+static void iniciar_fluxo(Sessao *s) {
+    uint8_t token[PROTOCOLO_FLUXO];
+    registrar_token(s, gerar_token());
+    registrar_nickname_padrao(s);
+    protocolo_escrever_u64(token, s->token);
+    enviar_controle(s, CONTROLE_SESSAO, token, sizeof(token), 0);
+}
+
+// Função para criar a sessão de uma conexão recém-aceita. As que vieram
+// pelo transporte local aparecem como "local" ou "memória" no lugar do IP.
+// Retorna NULL (e fecha o descritor) se faltou memória
+Sessao *nova_sessao(int fd, const struct sockaddr *endereco) {
+    char ip[INET_ADDRSTRLEN] = "?";
+    if (endereco->sa_family == AF_INET) {
+        inet_ntop(AF_INET, &((const struct sockaddr_in *)endereco)->sin_addr, ip,
+                  INET_ADDRSTRLEN);
+    } else if (endereco->sa_family == AF_UNIX) {
+        snprintf(ip, INET_ADDRSTRLEN, "%s", transporte_memoria(fd) ? "memória" : "local");
+    }
+    Sessao *s = criar_sessao(fd, ip);
+    if (s == NULL) return NULL;
+    iniciar_fluxo(s);
+
+    printf("\r\033[K\033[32m[SISTEMA] Conexão aceita de %s (%s). Sessões ativas: %d\033[0m\n",
+           s->ip, s->nickname, reator_total_sessoes());
+    fflush(stdout);
+    return s;
+}
+
+// Função para registrar o socket de uma sessão no backend de E/S do shard
+// Retorna -1 se falhou
+static int registrar_sessao(Sessao *s) {
+    if (backend == REATOR_URING) return uring_registrar(s);
+    struct epoll_event ev;
+    if (s->aviso_fd >= 0) {
+        // Memória: o aviso acorda para os dois anéis; do socket só
+        // interessa a queda
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = s;
+        if (epoll_ctl(reator->epoll_fd, EPOLL_CTL_ADD, s->aviso_fd, &ev) < 0) return -1;
+        ev.events = EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = (void *)((uintptr_t)s | SOCKET_MEMORIA);
+        return epoll_ctl(reator->epoll_fd, EPOLL_CTL_ADD, s->fd, &ev);
+    }
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = s;
+    return epoll_ctl(reator->epoll_fd, EPOLL_CTL_ADD, s->fd, &ev);
+}
+
+// Função para passar a uma sessão nova tudo o que era da antiga
+// (identidade, lugar na sala, token, fila de saída e posição do fluxo do
+// cliente) e fechar a antiga sem avisar ninguém
+static void herdar_sessao(Sessao *s, Sessao *antiga) {
+    s->id = antiga->id;
+    memcpy(s->nickname, antiga->nickname, NICKNAME_MAX);
+    if (antiga->sala != NULL) {
+        s->sala = antiga->sala;
+        s->indice_sala = antiga->indice_sala;
+        s->sala->membros[s->indice_sala] = s;
+        antiga->sala = NULL;
+    }
+    uint64_t token = antiga->token;
+    remover_token(antiga);
+    registrar_token(s, token);
+    sessao_mover_saida(s, antiga);
+    s->recebidos = s->confirmacao_enviada = antiga->recebidos;
+    fechar_sessao(antiga, NULL);
+}
+
+// Função para dar a uma sessão nova, no shard dono do token, a conexão que
+// pediu a retomada. Se a sessão do token está suspensa e ainda guarda o
+// que o cliente não recebeu, a nova herda tudo dela; senão a conexão segue
+// como sessão nova e a resposta leva token 0. Uma sessão ainda ligada nunca
+// é entregue: quem conhece o token não toma a conexão viva de outro, e o
+// cliente cuja queda o servidor não notou recebe uma sessão nova.
+static void adotar_conexao(const ConexaoRetomada *c) {
+    Sessao *s = criar_sessao(c->fd, c->ip);
+    if (s == NULL) return;
+    if (registrar_sessao(s) < 0) {
+        perror("[ERRO] Falha ao registrar a conexão retomada");
+        fechar_sessao(s, NULL);
+        return;
+    }
+
+    uint8_t resposta[2 * PROTOCOLO_FLUXO];
+    Sessao *antiga = buscar_token(c->token);
+    if (antiga != NULL && antiga->suspensa && antiga->retendo &&
+        sessao_retomar(antiga, c->fluxo) == 0) {
+        herdar_sessao(s, antiga);
+        protocolo_escrever_u64(resposta, s->token);
+        metricas_somar(METRICA_SESSOES_RETOMADAS, 1);
+        printf("\r\033[K\033[32m[SISTEMA] %s (%s) retomou a sessão.\033[0m\n", s->nickname, s->ip);
+    } else {
+        iniciar_fluxo(s);
+        protocolo_escrever_u64(resposta, 0);
+        printf("\r\033[K\033[32m[SISTEMA] Conexão aceita de %s (%s), sem sessão para retomar. "
+               "Sessões ativas: %d\033[0m\n", s->ip, s->nickname, reator_total_sessoes());
+    }
+    fflush(stdout);
+    protocolo_escrever_u64(resposta + PROTOCOLO_FLUXO, s->recebidos);
+    if (enviar_controle(s, CONTROLE_RETOMAR, resposta, sizeof(resposta), 1) < 0) {
+        fechar_sessao(s, "teve a conexão interrompida");
+    }
+}
+
+// Função para tratar um CONTROLE_RETOMAR, o primeiro quadro de uma conexão
+// que quer voltar a uma sessão antiga. O socket deixa esta sessão e vai ao
+// shard dono do token (pela caixa de conexões, se for outro shard).
+static void pedir_retomada(Sessao *s, uint64_t token, uint64_t fluxo) {
+    ConexaoRetomada c;
+    c.fd = fcntl(s->fd, F_DUPFD_CLOEXEC, 0);
+    snprintf(c.ip, INET_ADDRSTRLEN, "%s", s->ip);
+    c.token = token;
+    c.fluxo = fluxo;
+    s->transferida = 1;
+    if (backend == REATOR_URING) uring_cancelar_receber(s);
+    fechar_sessao(s, NULL);
+    if (c.fd < 0) {
+        perror("[ERRO] Falha ao duplicar o socket da retomada");
+        return;
+    }
+
+    int dono = TOKEN_SHARD(token);
+    if (dono >= total_reatores || dono == reator->indice) {
+        adotar_conexao(&c); // Deste shard, ou um token que não existe (recusado aqui)
+        return;
+    }
+    if (!fila_spsc_inserir(&reatores[dono].conexoes[reator->indice], &c)) {
+        close(c.fd); // Caixa cheia: o cliente tenta outra vez
+        return;
+    }
+    reator->shards_a_acordar |= UINT64_C(1) << dono;
+}
+
+// Função para adotar as conexões de retomada passadas por outros shards
+static void receber_conexoes() {
+    for (int o = 0; o < total_reatores; o++) {
+        if (o == reator->indice) continue;
+        ConexaoRetomada c;
+        while (fila_spsc_remover(&reator->conexoes[o], &c)) {
+            adotar_conexao(&c);
+        }
+    }
+}
+
+// Função para aceitar todas as conexões pendentes (edge-triggered) em um
+// socket de escuta: o TCP do shard ou o local, compartilhado
+static void aceitar_conexoes(int escuta) {
+    while (1) {
+        struct sockaddr_storage endereco;
+        socklen_t tamanho_endereco = sizeof(endereco);
+        int fd = accept4(escuta, (struct sockaddr *)&endereco, &tamanho_endereco,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("[ERRO] Accept falhou");
+            }
+            return;
+        }
+        if (escuta == socket_local && endereco_local.tipo == TRANSPORTE_MEMORIA &&
+            transporte_servir_memoria(fd) < 0) {
+            perror("[ERRO] Falha ao criar os anéis da conexão por memória");
+            close(fd);
+            continue;
+        }
+
+        Sessao *s = nova_sessao(fd, (struct sockaddr *)&endereco);
+        if (s == NULL) continue;
+        if (registrar_sessao(s) < 0) {
+            perror("[ERRO] Falha ao registrar conexão no epoll");
+            fechar_sessao(s, NULL);
+        }
+    }
+}
+
+// Função para copiar um campo do quadro para uma string terminada em '\0'
+static void copiar_campo(char *destino, size_t capacidade, const char *origem, size_t tamanho) {
+    if (tamanho >= capacidade) tamanho = capacidade - 1;
+    memcpy(destino, origem, tamanho);
+    destino[tamanho] = '\0';
+}
+
+// Função para responder a um /history: as mensagens do histórico visíveis
+// na sala atual e, por fim, um quadro CONTROLE_HISTORICO com quantas foram
+static void enviar_historico(Sessao *s, int quantidade) {
+    int encontradas = 0;
+    const char *sala = s->sala ? s->sala->nome : "";
+    BufferCompartilhado *mensagens = historico_ultimos(sala, strlen(sala), quantidade,
+                                                       &encontradas);
+    if (mensagens != NULL) {
+        enfileirar_saida(s, mensagens);
+        buffer_soltar(mensagens);
+    }
+
+    uint8_t corpo[4] = { (uint8_t)(encontradas >> 24), (uint8_t)(encontradas >> 16),
+                         (uint8_t)(encontradas >> 8), (uint8_t)encontradas };
+    BufferCompartilhado *fim = buffer_criar(PROTOCOLO_CONTROLE_MINIMO + sizeof(corpo));
+    if (fim == NULL) return;
+    fim->tamanho = (uint32_t)protocolo_codificar_controle(fim->dados, CONTROLE_HISTORICO, corpo,
+                                                          sizeof(corpo));
+    enfileirar_saida(s, fim);
+    buffer_soltar(fim);
+}
+
+// Função para responder com um CONTROLE_ERRO sobre `nickname`
+// Retorna -1 se faltou memória
+static int enviar_erro(Sessao *s, uint8_t codigo, const char *nickname, size_t tamanho) {
+    uint8_t dados[1 + NICKNAME_MAX];
+    if (tamanho >= NICKNAME_MAX) tamanho = NICKNAME_MAX - 1;
+    dados[0] = codigo;
+    memcpy(dados + 1, nickname, tamanho);
+    return enviar_controle(s, CONTROLE_ERRO, dados, 1 + tamanho, 0);
+}
+
+// Função para responder a um /search: as mensagens mais novas visíveis na
+// sala atual (as mesmas que o /history mostraria) que têm todos os termos
+// e, por fim, um CONTROLE_BUSCA com quantas foram e quanto a consulta levou
+// Retorna -1 se faltou memória
+static int enviar_busca(Sessao *s, const char *consulta, size_t tamanho) {
+    if (!busca_ativa()) return enviar_erro(s, ERRO_SEM_HISTORICO, "", 0);
+    uint64_t inicio = metricas_agora();
+    const char *sala = s->sala ? s->sala->nome : "";
+    uint64_t sequencias[BUSCA_RESULTADOS_MAX];
+    int achadas = busca_procurar(consulta, tamanho, sala, strlen(sala), sequencias,
+                                 BUSCA_RESULTADOS_MAX);
+    uint64_t micros = (metricas_agora() - inicio) / 1000;
+    uint32_t duracao = micros > UINT32_MAX ? UINT32_MAX : (uint32_t)micros;
+    BufferCompartilhado *mensagens = historico_montar(sequencias, achadas, sala, strlen(sala),
+                                                      &achadas);
+    if (mensagens != NULL) {
+        enfileirar_saida(s, mensagens);
+        buffer_soltar(mensagens);
+    }
+
+    uint8_t corpo[8] = { (uint8_t)(achadas >> 24), (uint8_t)(achadas >> 16),
+                         (uint8_t)(achadas >> 8), (uint8_t)achadas,
+                         (uint8_t)(duracao >> 24), (uint8_t)(duracao >> 16),
+                         (uint8_t)(duracao >> 8), (uint8_t)duracao };
+    BufferCompartilhado *fim = buffer_criar(PROTOCOLO_CONTROLE_MINIMO + sizeof(corpo));
+    if (fim == NULL) return -1;
+    fim->tamanho = (uint32_t)protocolo_codificar_controle(fim->dados, CONTROLE_BUSCA, corpo,
+                                                          sizeof(corpo));
+    int resultado = enfileirar_saida(s, fim);
+    buffer_soltar(fim);
+    return resultado;
+}
+
+// Função para trocar o nickname de uma sessão, se nenhuma outra o usa: o
+// novo é reservado antes de o antigo ser liberado, e a sala (ou o
+// operador) só fica sabendo de trocas aceitas
+// Retorna -1 se faltou memória
+static int trocar_nickname(Sessao *s, const char *corpo, size_t tamanho) {
+    char novo[NICKNAME_MAX];
+    copiar_campo(novo, NICKNAME_MAX, corpo, tamanho);
+    if (strcmp(novo, s->nickname) == 0) return 0;
+    // Um nickname em uso em outro nó da federação também está ocupado
+    int reserva = federacao_nick_remoto(novo, strlen(novo)) ? REGISTRO_EM_USO
+                                                            : registro_reservar(novo, s->token);
+    if (reserva != REGISTRO_OK) {
+        // O cliente já mudou o nickname local: a resposta diz qual vale
+        return enviar_erro(s, reserva == REGISTRO_EM_USO ? ERRO_NICK_EM_USO : ERRO_NICK_INVALIDO,
+                           s->nickname, strlen(s->nickname));
+    }
+    registro_liberar(s->nickname, s->token);
+    federacao_enviar_presenca(reator->indice, s->nickname, 0);
+    federacao_enviar_presenca(reator->indice, novo, 1);
+    if (s->sala != NULL) {
+        difundir_quadro_sala(s->sala, QUADRO_NICK, s->nickname, novo, strlen(novo), s);
+    } else {
+        entregar_mensagem(QUADRO_NICK, s->nickname, novo, strlen(novo));
+    }
+    memcpy(s->nickname, novo, NICKNAME_MAX);
+    return 0;
+}
+
+// Função para encaminhar uma mensagem privada ao nickname de destino. O
+// registro dá o token; no próprio shard a sessão sai da tabela de tokens,
+// em outro a mensagem vai como carta. Um nickname de outro nó vai pela
+// federação. Uma sessão que fechou no caminho perde a mensagem sem aviso,
+// como um membro que sai da sala.
+// Retorna -1 se faltou memória
+static int encaminhar_privada(Sessao *s, const char *nickname, size_t tamanho_nickname,
+                              const char *texto, size_t tamanho_texto) {
+    uint64_t token = registro_buscar(nickname, tamanho_nickname);
+    int dono = TOKEN_SHARD(token);
+    int remoto = token == 0 && federacao_nick_remoto(nickname, tamanho_nickname);
+    Sessao *destino = NULL;
+    if (token != 0 && dono == reator->indice) destino = buscar_token(token);
+    if (!remoto && (token == 0 || dono >= total_reatores ||
+                    (dono == reator->indice && destino == NULL))) {
+        return enviar_erro(s, ERRO_DESTINO_AUSENTE, nickname, tamanho_nickname);
+    }
+
+    BufferCompartilhado *buffer = buffer_criar(protocolo_tamanho_quadro(strlen(s->nickname),
+                                                                        tamanho_texto));
+    if (buffer == NULL) return -1;
+    buffer->tamanho = (uint32_t)protocolo_codificar(buffer->dados, QUADRO_PRIVADO, s->nickname,
+                                                    texto, tamanho_texto);
+    int resultado = 0;
+    if (remoto) {
+        federacao_enviar_privada(reator->indice, nickname, tamanho_nickname, buffer);
+    } else if (destino != NULL) {
+        resultado = enfileirar_saida(destino, buffer);
+    } else if (!encerrando) {
+        enviar_carta(dono, buffer, NULL, token);
+    }
+    metricas_somar(METRICA_MENSAGENS_PRIVADAS, 1);
+    buffer_soltar(buffer);
+    return resultado;
+}
+
+// Função para responder a um /who: quantos nicknames (deste nó e dos
+// outros da federação) começam com o prefixo pedido e a lista deles, até
+// REGISTRO_LISTA_MAX bytes
+// Retorna -1 se faltou memória
+static int enviar_quem(Sessao *s, const char *prefixo, size_t tamanho_prefixo) {
+    uint8_t dados[4 + REGISTRO_LISTA_MAX];
+    uint32_t total;
+    size_t lista = registro_listar(prefixo, tamanho_prefixo, (char *)dados + 4,
+                                   REGISTRO_LISTA_MAX, &total);
+    lista = federacao_listar(prefixo, tamanho_prefixo, (char *)dados + 4, lista,
+                             REGISTRO_LISTA_MAX, &total);
+    dados[0] = (uint8_t)(total >> 24);
+    dados[1] = (uint8_t)(total >> 16);
+    dados[2] = (uint8_t)(total >> 8);
+    dados[3] = (uint8_t)total;
+    BufferCompartilhado *buffer = buffer_criar(PROTOCOLO_CONTROLE_MINIMO + 4 + lista);
+    if (buffer == NULL) return -1;
+    buffer->tamanho = (uint32_t)protocolo_codificar_controle(buffer->dados, CONTROLE_QUEM, dados,
+                                                             4 + lista);
+    int resultado = enfileirar_saida(s, buffer);
+    buffer_soltar(buffer);
+    return resultado;
+}
+
+// Função para tratar um quadro recebido de uma sessão
+// Retorna 1 se a sessão pediu para sair e -1 se o quadro é inválido
+static int processar_quadro_sessao(Sessao *s, const Quadro *q) {
+    const char *origem, *corpo;
+    size_t tamanho_origem, tamanho_corpo;
+
+    switch (q->tipo) {
+        case QUADRO_CHAT:
+            if (protocolo_separar_origem(q, &origem, &tamanho_origem, &corpo, &tamanho_corpo) < 0) {
+                return -1;
+            }
+            if (s->sala != NULL) {
+                // Um único quadro codificado para todos os membros da sala
+                difundir_quadro_sala(s->sala, QUADRO_CHAT, s->nickname, corpo, tamanho_corpo,
+                                     (q->flags & QUADRO_FLAG_ECO) ? NULL : s);
+            } else {
+                entregar_mensagem(QUADRO_CHAT, s->nickname, corpo, tamanho_corpo);
+            }
+            return 0;
+        case QUADRO_NICK:
+            if (protocolo_separar_origem(q, &origem, &tamanho_origem, &corpo, &tamanho_corpo) < 0) {
+                return -1;
+            }
+            if (tamanho_corpo == 0) return 0;
+            return trocar_nickname(s, corpo, tamanho_corpo);
+        case QUADRO_PRIVADO: {
+            const char *nickname, *texto;
+            size_t tamanho_nickname, tamanho_texto;
+            if (protocolo_separar_origem(q, &origem, &tamanho_origem, &corpo, &tamanho_corpo) < 0 ||
+                protocolo_separar_privado(corpo, tamanho_corpo, &nickname, &tamanho_nickname,
+                                          &texto, &tamanho_texto) < 0) {
+                return -1;
+            }
+            return encaminhar_privada(s, nickname, tamanho_nickname, texto, tamanho_texto);
+        }
+        case QUADRO_SALA:
+            if (protocolo_separar_origem(q, &origem, &tamanho_origem, &corpo, &tamanho_corpo) < 0) {
+                return -1;
+            }
+            sair_da_sala(s);
+            if (tamanho_corpo == 0) {
+                // Confirma a saída só para quem saiu
+                difundir_quadro_resposta(s, QUADRO_SALA, s->nickname, NULL, 0);
+                return 0;
+            }
+            if (sala_entrar(s, corpo, tamanho_corpo) == NULL) return -1;
+            // Avisa a sala inteira, inclusive quem entrou (serve de confirmação)
+            difundir_quadro_sala(s->sala, QUADRO_SALA, s->nickname,
+                                 s->sala->nome, strlen(s->sala->nome), NULL);
+            return 0;
+        case QUADRO_ARQUIVO:
+            if (protocolo_separar_origem(q, &origem, &tamanho_origem, &corpo, &tamanho_corpo) < 0) {
+                return -1;
+            }
+            // Arquivos só circulam em salas; fora delas o quadro é ignorado
+            if (s->sala != NULL) {
+                difundir_quadro_sala(s->sala, QUADRO_ARQUIVO, s->nickname, corpo, tamanho_corpo, s);
+            }
+            return 0;
+        case QUADRO_QUIT:
+            return 1;
+        case QUADRO_CONTROLE:
+            if (q->tamanho >= 1 && q->payload[0] == CONTROLE_ECO) {
+                // Devolve o quadro como chegou, copiado do buffer de leitura
+                const uint8_t *bruto = q->payload - PROTOCOLO_CABECALHO;
+                BufferCompartilhado *buffer = buffer_copiar(bruto, PROTOCOLO_CABECALHO + q->tamanho);
+                if (buffer == NULL) return -1;
+                int resultado = enfileirar_saida(s, buffer);
+                buffer_soltar(buffer);
+                return resultado < 0 ? -1 : 0;
+            }
+            if (q->tamanho >= 1 && q->payload[0] == CONTROLE_PING) {
+                // O cliente também pede a confirmação com um ping
+                if (s->retendo && enviar_confirmacao(s) < 0) return -1;
+                return enfileirar_saida(s, quadro_pong) < 0 ? -1 : 0;
+            }
+            if (q->tamanho >= 1 + PROTOCOLO_FLUXO && q->payload[0] == CONTROLE_CONFIRMA) {
+                // Quem confirma sabe retomar: o que sai passa a ficar retido
+                s->retendo = 1;
+                s->confirmacao_pedida = 0;
+                sessao_confirmar_fluxo(s, protocolo_ler_u64(q->payload + 1));
+                return 0;
+            }
+            if (q->tamanho >= 5 && q->payload[0] == CONTROLE_HISTORICO) {
+                enviar_historico(s, (int)(((uint32_t)q->payload[1] << 24) |
+                                          ((uint32_t)q->payload[2] << 16) |
+                                          ((uint32_t)q->payload[3] << 8) | q->payload[4]));
+            }
+            if (q->tamanho >= 1 && q->payload[0] == CONTROLE_QUEM) {
+                return enviar_quem(s, (const char *)q->payload + 1, q->tamanho - 1) < 0 ? -1 : 0;
+            }
+            if (q->tamanho >= 1 && q->payload[0] == CONTROLE_BUSCA) {
+                return enviar_busca(s, (const char *)q->payload + 1, q->tamanho - 1) < 0 ? -1 : 0;
+            }
+            return 0;
+        default:
+            // Tipos desconhecidos são ignorados
+            return 0;
+    }
+}
+
+// Função para saber se um quadro é só um batimento (PING ou PONG) ou uma
+// confirmação, que não contam como mensagem para a ociosidade
+static int eh_batimento(const Quadro *q) {
+    return q->tipo == QUADRO_CONTROLE && q->tamanho >= 1 &&
+           (q->payload[0] == CONTROLE_PING || q->payload[0] == CONTROLE_PONG ||
+            q->payload[0] == CONTROLE_CONFIRMA);
+}
+
+// Função para tratar todos os quadros completos de um leitor. Chamada a
+// cada recepção, anota também a atividade da sessão para os batimentos.
+// Retorna -1 se a sessão foi encerrada
+static int processar_leitor(Sessao *s, LeitorQuadros *leitor) {
+    Quadro q;
+    int r;
+    s->ultima_atividade = reator->roda.agora;
+    if (s->pausada) return 0; // O resto fica no leitor até a espera terminar
+    while ((r = leitor_proximo(leitor, &q)) == QUADRO_PRONTO) {
+        metricas_somar(METRICA_QUADROS_RECEBIDOS, 1);
+        rastro_quadro(s->conexao, RASTRO_RECEBIDO, &q, q.tamanho);
+        if (q.tipo == QUADRO_CONTROLE && q.tamanho >= 1 + 2 * PROTOCOLO_FLUXO &&
+            q.payload[0] == CONTROLE_RETOMAR) {
+            // Só vale como primeiro quadro; fora do fluxo, não conta em
+            // `recebidos`. Os anéis de uma conexão por memória não mudam
+            // de sessão: ela não retoma.
+            if (s->recebidos > 0 || s->aviso_fd >= 0) continue;
+            pedir_retomada(s, protocolo_ler_u64(q.payload + 1),
+                           protocolo_ler_u64(q.payload + 1 + PROTOCOLO_FLUXO));
+            return -1;
+        }
+        if (!eh_batimento(&q)) s->ultima_mensagem = reator->roda.agora;
+        reator->produtor = s;
+        reator->bloqueio = NULL;
+        int resultado = processar_quadro_sessao(s, &q);
+        reator->produtor = NULL;
+        if (resultado == 1) {
+            fechar_sessao(s, "saiu do chat");
+            return -1;
+        } else if (resultado < 0) {
+            r = QUADRO_ERRO;
+            break;
+        }
+        s->recebidos += PROTOCOLO_CABECALHO + q.tamanho;
+        if (reator->bloqueio != NULL) {
+            pausar_leitura(s, reator->bloqueio);
+            break;
+        }
+    }
+    if (r == QUADRO_ERRO) {
+        fechar_sessao(s, "violou o protocolo");
+        return -1;
+    }
+    if (s->retendo && s->recebidos - s->confirmacao_enviada >= CONFIRMACAO_LIMIAR) {
+        enviar_confirmacao(s);
+    }
+    return 0;
+}
+
+// Função para tratar bytes recebidos fora do leitor da sessão (buffers
+// fornecidos ao io_uring). Se não há quadro pela metade, os quadros são
+// tratados direto de `dados` e só a sobra final é copiada para o leitor.
+// Retorna -1 se a sessão foi encerrada
+int consumir_dados(Sessao *s, const uint8_t *dados, size_t tamanho) {
+    if (s->leitor.fim == s->leitor.inicio) {
+        LeitorQuadros direto;
+        direto.buffer = (uint8_t *)dados;
+        direto.capacidade = tamanho;
+        direto.inicio = 0;
+        direto.fim = tamanho;
+        if (processar_leitor(s, &direto) < 0) return -1;
+        dados += direto.inicio;
+        tamanho -= direto.inicio;
+    }
+
+    while (tamanho > 0) {
+        if (s->pausada) {
+            // O recv ainda entrega o que já estava a caminho: espera inteiro no leitor
+            if (leitor_acrescentar(&s->leitor, dados, tamanho) < 0) {
+                fechar_sessao(s, "excedeu a memória de leitura");
+                return -1;
+            }
+            break;
+        }
+        size_t livre;
+        uint8_t *destino = leitor_espaco(&s->leitor, &livre);
+        if (destino == NULL) {
+            fechar_sessao(s, "excedeu a memória de leitura");
+            return -1;
+        }
+        if (livre > tamanho) livre = tamanho;
+        memcpy(destino, dados, livre);
+        leitor_avancar(&s->leitor, livre);
+        dados += livre;
+        tamanho -= livre;
+        if (processar_leitor(s, &s->leitor) < 0) return -1;
+    }
+    return 0;
+}
+
+// Função para ler tudo o que estiver disponível em uma sessão (edge-triggered)
+// Retorna -1 se a sessão foi encerrada
+static int ler_sessao(Sessao *s) {
+    while (!s->pausada) {
+        size_t livre;
+        uint8_t *destino = leitor_espaco(&s->leitor, &livre);
+        if (destino == NULL) {
+            fechar_sessao(s, "excedeu a memória de leitura");
+            return -1;
+        }
+        ssize_t n = transporte_receber(s->fd, destino, livre, 0);
+        if (n > 0) {
+            metricas_somar(METRICA_BYTES_RECEBIDOS, (uint64_t)n);
+            metricas_registrar(HISTOGRAMA_TAMANHO_RECV, (uint64_t)n);
+            leitor_avancar(&s->leitor, (size_t)n);
+            if (processar_leitor(s, &s->leitor) < 0) return -1;
+        } else if (n == 0) {
+            perder_conexao(s, "desconectou");
+            return -1;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else {
+            perder_conexao(s, "teve a conexão interrompida");
+            return -1;
+        }
+    }
+    return 0; // Pausada: o resto fica no socket
+}
+
+// Função para voltar a ler as sessões cuja espera terminou: primeiro os
+// quadros que ficaram no leitor, depois o socket
+static void retomar_pausadas() {
+    while (reator->sessoes_a_retomar != NULL) {
+        Sessao *s = reator->sessoes_a_retomar;
+        reator->sessoes_a_retomar = s->proxima_espera;
+        s->proxima_espera = NULL;
+        s->pausada = 0;
+        if (s->fd < 0) continue;
+        if (s->leitor.fim > s->leitor.inicio && processar_leitor(s, &s->leitor) < 0) continue;
+        if (s->pausada) continue;
+        if (backend == REATOR_URING) {
+            if (!s->recebendo && uring_registrar(s) < 0) {
+                fechar_sessao(s, "não pôde ser registrada no io_uring");
+            }
+        } else {
+            ler_sessao(s);
+        }
+    }
+}
+
+// Função para enfileirar um quadro em todas as sessões do shard
+static void difundir_no_shard(BufferCompartilhado *buffer) {
+    Sessao *s = reator->sessoes;
+    while (s != NULL) {
+        Sessao *proxima = s->proxima;
+        if (enfileirar_saida(s, buffer) < 0) {
+            fechar_sessao(s, "teve a conexão interrompida");
+        }
+        s = proxima;
+    }
+}
+
+// Função para difundir os quadros do operador a todas as sessões do shard
+static void processar_quadros_operador() {
+    BufferCompartilhado *buffer;
+    while (fila_spsc_remover(&reator->fila_operador, &buffer)) {
+        difundir_no_shard(buffer);
+        buffer_soltar(buffer);
+    }
+}
+
+// Função para entregar os quadros vindos de outros nós da federação: os de
+// sala aos membros locais, os privados à sessão do token e as difusões de
+// outro operador a todas as sessões. O shard marcado com `registrar` grava
+// no histórico (e mostra as difusões ao operador deste nó).
+static void receber_federacao() {
+    EntregaFederacao e;
+    while (federacao_proxima_entrega(reator->indice, &e)) {
+        uint8_t tipo = e.quadro->dados[1];
+        if (e.sala != NULL) {
+            Sala *sala = sala_buscar((const char *)e.sala->dados, e.sala->tamanho);
+            if (sala != NULL) difundir_na_sala(sala, e.quadro, NULL);
+            if (e.registrar && tipo == QUADRO_CHAT) {
+                historico_registrar(reator->indice, HISTORICO_SALA, e.sala, e.quadro);
+            }
+            buffer_soltar(e.sala);
+        } else if (e.token != 0) {
+            Sessao *destino = buscar_token(e.token);
+            if (destino != NULL && enfileirar_saida(destino, e.quadro) == 0) {
+                metricas_somar(METRICA_MENSAGENS_PRIVADAS, 1);
+            }
+        } else {
+            difundir_no_shard(e.quadro);
+            Quadro q = { e.quadro->dados[0], tipo, 0, e.quadro->tamanho - PROTOCOLO_CABECALHO,
+                         e.quadro->dados + PROTOCOLO_CABECALHO };
+            const char *origem, *corpo;
+            size_t tamanho_origem, tamanho_corpo;
+            if (e.registrar && tipo == QUADRO_CHAT &&
+                protocolo_separar_origem(&q, &origem, &tamanho_origem, &corpo, &tamanho_corpo) == 0) {
+                historico_registrar(reator->indice, HISTORICO_DIFUSAO, NULL, e.quadro);
+                exibir_mensagem(tipo, origem, tamanho_origem, corpo, tamanho_corpo);
+            }
+        }
+        buffer_soltar(e.quadro);
+    }
+}
+
+// Função para tratar o eventfd do shard: quadros do operador, cartas e
+// retomadas vindas de outros shards e quadros de outros nós
+void tratar_evento_reator() {
+    uint64_t contador;
+    while (read(reator->evento_fd, &contador, sizeof(contador)) > 0) {
+    }
+    processar_quadros_operador();
+    receber_cartas();
+    receber_conexoes();
+    receber_federacao();
+}
+
+// Função para listar as CPUs em que o processo pode rodar
+// Retorna quantas foram gravadas em `cpus`
+static int listar_cpus(int *cpus, int maximo) {
+    cpu_set_t permitidas;
+    int total = 0;
+    if (sched_getaffinity(0, sizeof(permitidas), &permitidas) < 0) return 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && total < maximo; cpu++) {
+        if (CPU_ISSET(cpu, &permitidas)) cpus[total++] = cpu;
+    }
+    return total;
+}
+
+// Função para criar o socket de escuta TCP de um shard (com SO_REUSEPORT)
+// Retorna -1 se falhou
+static int abrir_escuta(Reator *r, int porta, int backlog) {
+    struct sockaddr_in server_address;
+    int opcao = 1;
+
+    r->socket_escuta = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (r->socket_escuta == -1) {
+        perror("[ERRO] Não foi possível criar o socket");
+        return -1;
+    }
+    setsockopt(r->socket_escuta, SOL_SOCKET, SO_REUSEADDR, &opcao, sizeof(opcao));
+    if (setsockopt(r->socket_escuta, SOL_SOCKET, SO_REUSEPORT, &opcao, sizeof(opcao)) < 0) {
+        perror("[ERRO] SO_REUSEPORT indisponível");
+        return -1;
+    }
+
+    // Preparar a estrutura sockaddr_in
+    memset(&server_address, 0, sizeof(server_address));
+    server_address.sin_family = AF_INET;
+    server_address.sin_addr.s_addr = INADDR_ANY; // Aceita conexões de qualquer IP
+    server_address.sin_port = htons(porta);       // Porta para escuta
+
+    if (bind(r->socket_escuta, (struct sockaddr *)&server_address, sizeof(server_address)) < 0) {
+        perror("[ERRO] Bind falhou");
+        return -1;
+    }
+    if (listen(r->socket_escuta, backlog) < 0) {
+        perror("[ERRO] Listen falhou");
+        return -1;
+    }
+    return 0;
+}
+
+// Função para criar o socket de escuta (ou usar o herdado na troca), as
+// filas, as caixas de correio, o eventfd e o epoll de um shard
+static int iniciar_shard(Reator *r, int porta, int backlog) {
+    if (heranca.ativa) {
+        // As conexões que chegaram durante a troca esperam no backlog dele
+        r->socket_escuta = heranca.segmentos[r->indice].escuta;
+        heranca.segmentos[r->indice].escuta = -1;
+    } else if (abrir_escuta(r, porta, backlog) < 0) {
+        return -1;
+    }
+
+    if (fila_spsc_iniciar(&r->fila_recebidas, FILA_EXIBICAO_CAPACIDADE,
+                          sizeof(MensagemRecebida), FILA_DESCARTAR_NOVA) < 0 ||
+        fila_spsc_iniciar(&r->fila_operador, FILA_OPERADOR_CAPACIDADE,
+                          sizeof(BufferCompartilhado *), FILA_AGUARDAR) < 0) {
+        perror("[ERRO] Não foi possível criar as filas do reator");
+        return -1;
+    }
+
+    r->caixas = calloc(total_reatores, sizeof(FilaSPSC));
+    r->conexoes = calloc(total_reatores, sizeof(FilaSPSC));
+    r->atrasadas = calloc(total_reatores, sizeof(CartasAtrasadas));
+    if (r->caixas == NULL || r->conexoes == NULL || r->atrasadas == NULL) {
+        perror("[ERRO] Não foi possível criar as caixas de correio");
+        return -1;
+    }
+    for (int o = 0; o < total_reatores; o++) {
+        if (o == r->indice) continue;
+        if (fila_spsc_iniciar(&r->caixas[o], CAIXA_CAPACIDADE, sizeof(Carta),
+                              FILA_DESCARTAR_NOVA) < 0 ||
+            fila_spsc_iniciar(&r->conexoes[o], CONEXOES_CAPACIDADE, sizeof(ConexaoRetomada),
+                              FILA_DESCARTAR_NOVA) < 0) {
+            perror("[ERRO] Não foi possível criar as caixas de correio");
+            return -1;
+        }
+    }
+
+    r->evento_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r->evento_fd < 0) {
+        perror("[ERRO] Não foi possível criar os eventfds");
+        return -1;
+    }
+
+    uint64_t teste;
+    if (getrandom(&teste, sizeof(teste), 0) != sizeof(teste)) {
+        perror("[ERRO] Não foi possível gerar os tokens das sessões (getrandom)");
+        return -1;
+    }
+
+    roda_iniciar(&r->roda);
+    if (roda_ligada()) {
+        struct itimerspec periodo;
+        periodo.it_interval.tv_sec = 0;
+        periodo.it_interval.tv_nsec = TICK_MS * 1000000L;
+        periodo.it_value = periodo.it_interval;
+        r->relogio_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (r->relogio_fd < 0 || timerfd_settime(r->relogio_fd, 0, &periodo, NULL) < 0) {
+            perror("[ERRO] Não foi possível criar o relógio da roda");
+            return -1;
+        }
+    }
+
+    // O anel do io_uring é criado pela própria thread do shard
+    if (backend == REATOR_URING) return 0;
+
+    r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (r->epoll_fd < 0) {
+        perror("[ERRO] Não foi possível criar o epoll");
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &marcador_escuta;
+    epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->socket_escuta, &ev);
+    if (socket_local >= 0) {
+        // Um só socket para todos os shards: só um é acordado por conexão
+        ev.events = EPOLLIN | EPOLLET | EPOLLEXCLUSIVE;
+        ev.data.ptr = &marcador_local;
+        if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, socket_local, &ev) < 0) {
+            perror("[ERRO] Não foi possível registrar o socket local");
+            return -1;
+        }
+    }
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = &marcador_evento;
+    epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->evento_fd, &ev);
+    if (r->relogio_fd >= 0) {
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = &marcador_relogio;
+        epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->relogio_fd, &ev);
+    }
+    return 0;
+}
+
+// Função para configurar os batimentos, em segundos (0 desliga): silêncio
+// até o ping, prazo para a resposta e tempo sem mensagens até derrubar.
+// Precisa ser chamada antes de reator_iniciar().
+void reator_configurar_batimentos(int ping, int tempo_pong, int ocioso) {
+    ticks_ping = TICKS(ping);
+    ticks_pong = TICKS(tempo_pong);
+    ticks_ocioso = TICKS(ocioso);
+}
+
+// Função para configurar quantos segundos uma sessão cuja conexão caiu
+// aguarda a retomada (0 = fecha na hora, como sem retomada). Precisa ser
+// chamada antes de reator_iniciar().
+void reator_configurar_retomada(int segundos) {
+    ticks_retomada = TICKS(segundos);
+}
+
+// Função para ligar o transporte local (--local), um socket UNIX ou a
+// memória compartilhada, além do TCP (antes de reator_iniciar)
+void reator_configurar_local(const EnderecoTransporte *endereco) {
+    endereco_local = *endereco;
+    local_ligado = 1;
+}
+
+// Função para configurar os limites da fila de saída de cada sessão e a
+// política para as que chegam a eles (antes de reator_iniciar)
+void reator_configurar_saida(size_t bytes, uint32_t quadros, PoliticaLento politica) {
+    saida_max_bytes = bytes;
+    saida_max_quadros = quadros;
+    politica_lento = politica;
+}
+
+// Função para interpretar o nome de uma política de --lento
+// ("antigos", "novos" ou "derrubar")
+// Retorna -1 se o nome for desconhecido
+int reator_politica_ler(const char *nome, PoliticaLento *politica) {
+    if (strcmp(nome, "antigos") == 0) {
+        *politica = LENTO_DESCARTAR_ANTIGOS;
+    } else if (strcmp(nome, "novos") == 0) {
+        *politica = LENTO_DESCARTAR_NOVOS;
+    } else if (strcmp(nome, "derrubar") == 0) {
+        *politica = LENTO_DERRUBAR;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Função para criar os shards: sockets de escuta, epolls, eventfds e relógios
+int reator_iniciar(int porta, int backlog, BackendReator escolhido, int shards) {
+    if (shards < 1 || shards > SALA_MAX_SHARDS) {
+        fprintf(stderr, "[ERRO] Número de shards deve estar entre 1 e %d\n", SALA_MAX_SHARDS);
+        return -1;
+    }
+
+    if (heranca.ativa && (uint32_t)shards != heranca.estado.shards) {
+        fprintf(stderr, "[ERRO] O processo anterior tinha %u shards\n", heranca.estado.shards);
+        return -1;
+    }
+
+    backend = escolhido;
+    elevar_limite_descritores();
+
+    reatores = calloc(shards, sizeof(Reator));
+    if (reatores == NULL) {
+        perror("[ERRO] Não foi possível criar os shards");
+        return -1;
+    }
+    total_reatores = shards;
+    for (int i = 0; i < shards; i++) {
+        reatores[i].indice = i;
+        reatores[i].epoll_fd = reatores[i].socket_escuta = reatores[i].evento_fd = -1;
+        reatores[i].relogio_fd = -1;
+    }
+
+    quadro_ping = buffer_criar(PROTOCOLO_CONTROLE_MINIMO);
+    quadro_pong = buffer_criar(PROTOCOLO_CONTROLE_MINIMO);
+    if (quadro_ping == NULL || quadro_pong == NULL) {
+        perror("[ERRO] Não foi possível criar os quadros de batimento");
+        reator_finalizar();
+        return -1;
+    }
+    quadro_ping->tamanho = (uint32_t)protocolo_codificar_controle(quadro_ping->dados,
+                                                                  CONTROLE_PING, NULL, 0);
+    quadro_pong->tamanho = (uint32_t)protocolo_codificar_controle(quadro_pong->dados,
+                                                                  CONTROLE_PONG, NULL, 0);
+
+    evento_interface = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (evento_interface < 0) {
+        perror("[ERRO] Não foi possível criar os eventfds");
+        reator_finalizar();
+        return -1;
+    }
+    if (local_ligado) {
+        // O aviso de uma conexão por memória é um eventfd, que só o epoll espera
+        if (backend == REATOR_URING && endereco_local.tipo == TRANSPORTE_MEMORIA) {
+            fprintf(stderr, "[ERRO] A memória compartilhada (shm://) exige --io epoll\n");
+            reator_finalizar();
+            return -1;
+        }
+        if (heranca.ativa && heranca.local >= 0) {
+            socket_local = heranca.local;
+            heranca.local = -1;
+        } else {
+            socket_local = transporte_escutar(&endereco_local, backlog);
+        }
+        if (socket_local < 0) {
+            perror("[ERRO] Não foi possível escutar no socket local");
+            reator_finalizar();
+            return -1;
+        }
+    }
+    for (int i = 0; i < shards; i++) {
+        if (iniciar_shard(&reatores[i], porta, backlog) < 0) {
+            reator_finalizar();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Função para prender a thread atual a uma CPU, uma por shard
+static void fixar_cpu(int indice) {
+    int cpus[CPU_SETSIZE];
+    int total = listar_cpus(cpus, CPU_SETSIZE);
+    if (total == 0) return;
+
+    cpu_set_t conjunto;
+    CPU_ZERO(&conjunto);
+    CPU_SET(cpus[indice % total], &conjunto);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(conjunto), &conjunto) != 0) {
+        fprintf(stderr, "[ERRO] Não foi possível fixar o shard %d na CPU %d\n",
+                indice, cpus[indice % total]);
+    }
+}
+
+// Função para fechar as sessões do shard atual e liberar as fechadas e
+// órfãs. Roda na thread do shard, que é dona do anel do io_uring.
+static void finalizar_sessoes() {
+    while (reator->sessoes != NULL) {
+        fechar_sessao(reator->sessoes, NULL);
+    }
+    reator->sessoes_marcadas = NULL; // Todas as marcadas acabaram de ser fechadas
+    // Sem o anel não há mais conclusões por vir: as órfãs podem ser liberadas
+    uring_finalizar();
+    while (reator->sessoes_fechadas != NULL) {
+        Sessao *s = reator->sessoes_fechadas;
+        reator->sessoes_fechadas = s->proxima;
+        liberar_sessao(s);
+    }
+    while (reator->sessoes_orfas != NULL) {
+        liberar_sessao_orfa(reator->sessoes_orfas);
+    }
+}
+
+// Função para achar (ou gravar, na primeira vez) um buffer das filas no
+// bloco de buffers do shard, na troca
+// Retorna a posição do buffer no bloco
+static uint32_t exportar_buffer(BufferExportado *tabela, size_t mascara,
+                                BufferCompartilhado *buffer) {
+    size_t i = (size_t)(((uintptr_t)buffer >> 4) * UINT64_C(0x9E3779B97F4A7C15)) & mascara;
+    while (tabela[i].buffer != NULL) {
+        if (tabela[i].buffer == buffer) return tabela[i].indice;
+        i = (i + 1) & mascara;
+    }
+    tabela[i].buffer = buffer;
+    tabela[i].indice = reator->total_buffers_exportados++;
+    troca_escrever_u32(&reator->buffers_exportados, buffer->tamanho);
+    troca_escrever(&reator->buffers_exportados, buffer->dados, buffer->tamanho);
+    return tabela[i].indice;
+}
+
+// Função para gravar uma sessão no bloco do shard, na troca (o formato
+// que ler_sessao_herdada() lê)
+static void exportar_sessao(Sessao *s, BufferExportado *tabela, size_t mascara) {
+    BlocoTroca *b = &reator->exportadas;
+    troca_escrever_u8(b, (uint8_t)s->retendo);
+    troca_escrever_u8(b, s->fd >= 0);
+    troca_escrever_u64(b, s->id);
+    troca_escrever_u64(b, s->token);
+    troca_escrever_u64(b, s->recebidos);
+    troca_escrever_u64(b, s->confirmacao_enviada);
+    troca_escrever_u64(b, s->fluxo_base);
+    troca_escrever_texto(b, s->nickname, strlen(s->nickname));
+    troca_escrever_texto(b, s->ip, strlen(s->ip));
+    const char *sala = s->sala != NULL ? s->sala->nome : "";
+    troca_escrever_texto(b, sala, strlen(sala));
+    // Um quadro pela metade, ou quadros inteiros de uma sessão pausada
+    troca_escrever_u32(b, (uint32_t)(s->leitor.fim - s->leitor.inicio));
+    troca_escrever(b, s->leitor.buffer + s->leitor.inicio, s->leitor.fim - s->leitor.inicio);
+    troca_escrever_u32(b, s->saida_total);
+    troca_escrever_u32(b, s->saida_retidos);
+    for (uint32_t i = 0; i < s->saida_total; i++) {
+        ItemSaida *item = &s->saida[(s->saida_inicio + i) % s->saida_capacidade];
+        troca_escrever_u32(b, exportar_buffer(tabela, mascara, item->buffer));
+        troca_escrever_u32(b, item->enviado);
+        troca_escrever_u8(b, (uint8_t)item->fora_do_fluxo);
+    }
+}
+
+// Função para gravar as sessões do shard para o processo novo (--troca) e
+// soltá-las sem avisar ninguém: nem a sala nem a federação ficam sabendo,
+// e os sockets não são fechados (a interface os passa adiante). Roda na
+// thread do shard, depois da última rodada.
+static void exportar_sessoes() {
+    // Os anéis de uma conexão por memória são deste processo: ela cai, e a
+    // saída da sala vai na fila de quem fica
+    for (Sessao *s = reator->sessoes, *proxima; s != NULL; s = proxima) {
+        proxima = s->proxima;
+        if (s->aviso_fd >= 0) fechar_sessao(s, "foi desconectado pela troca do servidor");
+    }
+
+    size_t itens = 0;
+    for (Sessao *s = reator->sessoes; s != NULL; s = s->proxima) itens += s->saida_total;
+    size_t capacidade = 64;
+    while (capacidade < 2 * itens) capacidade *= 2;
+    BufferExportado *tabela = calloc(capacidade, sizeof(BufferExportado));
+    if (tabela == NULL) {
+        perror("[ERRO] Não foi possível gravar as sessões para a troca");
+        reator->exportadas.erro = 1;
+        return;
+    }
+    while (reator->sessoes != NULL) {
+        Sessao *s = reator->sessoes;
+        exportar_sessao(s, tabela, capacidade - 1);
+        if (s->fd >= 0) {
+            troca_escrever(&reator->descritores_exportados, &s->fd, sizeof(int));
+            epoll_ctl(reator->epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+            rastro_conexao(s->conexao, RASTRO_FECHADA);
+            s->fd = -1;
+        }
+        sala_sair(s);
+        fechar_sessao(s, NULL);
+        reator->total_exportadas++;
+    }
+    free(tabela);
+}
+
+// Função para ler uma sessão gravada por exportar_sessao(), conferindo os
+// tamanhos e as referências aos `total_buffers` buffers do trecho
+// Retorna -1 se o bloco está errado
+static int ler_sessao_herdada(BlocoTroca *b, SessaoHerdada *h, uint32_t total_buffers) {
+    h->retendo = troca_ler_u8(b);
+    h->com_socket = troca_ler_u8(b);
+    h->id = troca_ler_u64(b);
+    h->token = troca_ler_u64(b);
+    h->recebidos = troca_ler_u64(b);
+    h->confirmacao_enviada = troca_ler_u64(b);
+    h->fluxo_base = troca_ler_u64(b);
+    h->nickname = troca_ler_texto(b, &h->tamanho_nickname);
+    h->ip = troca_ler_texto(b, &h->tamanho_ip);
+    h->sala = troca_ler_texto(b, &h->tamanho_sala);
+    h->tamanho_leitor = troca_ler_u32(b);
+    h->leitor = troca_ler(b, h->tamanho_leitor);
+    h->itens = troca_ler_u32(b);
+    h->retidos = troca_ler_u32(b);
+    h->saida = troca_ler(b, (size_t)h->itens * ITEM_HERDADO);
+    if (b->erro || h->retidos > h->itens || h->tamanho_sala >= SALA_NOME_MAX) return -1;
+    BlocoTroca itens = { (uint8_t *)h->saida, (size_t)h->itens * ITEM_HERDADO, 0, 0, 0 };
+    for (uint32_t i = 0; i < h->itens; i++) {
+        uint32_t buffer = troca_ler_u32(&itens);
+        troca_ler(&itens, 5);
+        if (buffer >= total_buffers) return -1;
+    }
+    return 0;
+}
+
+// Função para recriar neste shard uma sessão do processo antigo, com o
+// socket dela (ou -1, se estava suspensa). A sessão volta à sala sem
+// avisar ninguém; os quadros que ficaram no leitor são tratados ao fim da
+// rodada, como os de uma sessão cuja pausa terminou.
+static void adotar_sessao(const SessaoHerdada *h, int fd, BufferCompartilhado **buffers) {
+    Sessao *s = criar_sessao(fd, "");
+    if (s == NULL) return;
+    s->id = h->id;
+    snprintf(s->nickname, NICKNAME_MAX, "%.*s", (int)h->tamanho_nickname, h->nickname);
+    snprintf(s->ip, INET_ADDRSTRLEN, "%.*s", (int)h->tamanho_ip, h->ip);
+    registrar_token(s, h->token);
+    if (registro_reservar(s->nickname, s->token) == REGISTRO_OK) {
+        federacao_enviar_presenca(reator->indice, s->nickname, 1);
+    } else {
+        snprintf(s->nickname, NICKNAME_MAX, "Cliente#%lu", s->id);
+        registrar_nickname_padrao(s);
+    }
+    s->retendo = h->retendo;
+    s->fluxo_base = h->fluxo_base;
+    s->recebidos = h->recebidos;
+    s->confirmacao_enviada = h->confirmacao_enviada;
+
+    int falhou = h->tamanho_sala > 0 && sala_entrar(s, h->sala, h->tamanho_sala) == NULL;
+    BlocoTroca itens = { (uint8_t *)h->saida, (size_t)h->itens * ITEM_HERDADO, 0, 0, 0 };
+    for (uint32_t i = 0; i < h->itens && !falhou; i++) {
+        BufferCompartilhado *buffer = buffers[troca_ler_u32(&itens)];
+        uint32_t enviado = troca_ler_u32(&itens);
+        int fora_do_fluxo = troca_ler_u8(&itens);
+        falhou = buffer == NULL || enviado > buffer->tamanho ||
+                 sessao_restaurar_item(s, buffer, enviado, fora_do_fluxo, i < h->retidos) < 0;
+    }
+    if (!falhou && h->tamanho_leitor > 0) {
+        falhou = leitor_acrescentar(&s->leitor, h->leitor, h->tamanho_leitor) < 0;
+    }
+    if (falhou) {
+        fechar_sessao(s, "não pôde ser recriada na troca do servidor");
+        return;
+    }
+
+    if (fd < 0) {
+        if (ticks_retomada == 0) {
+            fechar_sessao(s, NULL);
+            return;
+        }
+        s->suspensa = 1;
+        roda_agendar(&reator->roda, &s->temporizador, ticks_retomada);
+        return;
+    }
+    if (registrar_sessao(s) < 0) {
+        perror("[ERRO] Falha ao registrar a conexão herdada no epoll");
+        fechar_sessao(s, NULL);
+        return;
+    }
+    if (sessao_quadros_pendentes(s) > 0) marcar_sessao(s);
+    // O que já está no socket o epoll avisa desde o registro
+    if (s->leitor.fim > s->leitor.inicio) {
+        s->pausada = 1;
+        s->proxima_espera = reator->sessoes_a_retomar;
+        reator->sessoes_a_retomar = s;
+    }
+}
+
+// Função para entregar as cartas que o processo antigo tinha a caminho
+// deste shard
+static void adotar_cartas() {
+    BlocoTroca b = heranca.estado.bloco;
+    b.posicao = heranca.cartas;
+    uint32_t total = troca_ler_u32(&b);
+    for (uint32_t i = 0; i < total && !b.erro; i++) {
+        int destino = troca_ler_u8(&b);
+        size_t tamanho_sala;
+        const char *sala = troca_ler_texto(&b, &tamanho_sala);
+        uint64_t token = troca_ler_u64(&b);
+        uint32_t tamanho = troca_ler_u32(&b);
+        const uint8_t *quadro = troca_ler(&b, tamanho);
+        if (b.erro || destino != reator->indice) continue;
+        Carta carta;
+        carta.quadro = buffer_copiar(quadro, tamanho);
+        carta.sala = tamanho_sala > 0 ? buffer_copiar(sala, tamanho_sala) : NULL;
+        carta.token = token;
+        if (carta.quadro == NULL || (tamanho_sala > 0 && carta.sala == NULL)) {
+            if (carta.quadro != NULL) buffer_soltar(carta.quadro);
+            if (carta.sala != NULL) buffer_soltar(carta.sala);
+            continue;
+        }
+        entregar_carta(&carta);
+    }
+}
+
+// Função para adotar as sessões que o processo antigo deixou para este
+// shard (--troca). Todos os shards esperam o último terminar; ele avisa
+// quanto durou a troca e libera o estado herdado.
+static void adotar_herdadas() {
+    SegmentoHerdado *segmento = &heranca.segmentos[reator->indice];
+    BlocoTroca b = heranca.estado.bloco;
+    b.posicao = segmento->inicio;
+    b.tamanho = segmento->fim;
+    const int *descritores = heranca.estado.descritores + segmento->primeiro_descritor;
+    uint32_t usados = 0;
+
+    uint32_t total_buffers = troca_ler_u32(&b);
+    BufferCompartilhado **buffers = calloc(total_buffers + 1, sizeof(BufferCompartilhado *));
+    if (buffers == NULL) b.erro = 1;
+    for (uint32_t i = 0; i < total_buffers && !b.erro; i++) {
+        uint32_t tamanho = troca_ler_u32(&b);
+        const uint8_t *dados = troca_ler(&b, tamanho);
+        if (dados != NULL) buffers[i] = buffer_copiar(dados, tamanho);
+    }
+    uint32_t total = troca_ler_u32(&b);
+    for (uint32_t i = 0; i < total && !b.erro; i++) {
+        SessaoHerdada h;
+        if (ler_sessao_herdada(&b, &h, total_buffers) < 0) break;
+        int fd = -1;
+        if (h.com_socket) {
+            if (usados == segmento->total_descritores) break;
+            fd = descritores[usados++];
+        }
+        adotar_sessao(&h, fd, buffers);
+    }
+    if (b.erro) fprintf(stderr, "[ERRO] Estado herdado do shard %d incompleto\n", reator->indice);
+    while (usados < segmento->total_descritores) close(descritores[usados++]);
+    for (uint32_t i = 0; buffers != NULL && i < total_buffers; i++) {
+        if (buffers[i] != NULL) buffer_soltar(buffers[i]);
+    }
+    free(buffers);
+    adotar_cartas();
+    segmento->adotado = 1;
+
+    if (pthread_barrier_wait(&heranca.barreira) == PTHREAD_BARRIER_SERIAL_THREAD) {
+        uint64_t agora = metricas_agora();
+        printf("\r\033[K\033[32m[SISTEMA] Troca concluída: %d sessões herdadas; os clientes "
+               "ficaram %.1f ms sem atendimento (estado recebido em %.1f ms, shards de volta "
+               "%.1f ms depois).\033[0m\n",
+               reator_total_sessoes(), (double)(agora - heranca.estado.parada) / 1e6,
+               (double)(heranca.estado.recebido - heranca.estado.parada) / 1e6,
+               (double)(agora - heranca.estado.recebido) / 1e6);
+        fflush(stdout);
+        free(heranca.segmentos);
+        heranca.segmentos = NULL;
+        troca_liberar(&heranca.estado);
+        heranca.ativa = 0;
+    }
+    fim_da_rodada();
+}
+
+// Função para preparar a adoção do estado de um processo antigo (--troca),
+// antes de reator_iniciar(): confere o bloco, separa o trecho e os sockets
+// de cada shard e toma os sockets de escuta. O estado passa a ser do reator.
+// Retorna -1 se o estado está errado (os descritores são fechados)
+int reator_configurar_heranca(TrocaEstado *estado) {
+    heranca.estado = *estado;
+    memset(estado, 0, sizeof(*estado));
+    heranca.local = -1;
+    BlocoTroca *b = &heranca.estado.bloco;
+    const int *descritores = heranca.estado.descritores;
+    uint32_t total_descritores = heranca.estado.total_descritores;
+    uint32_t shards = heranca.estado.shards;
+    uint32_t proximo = 0;
+
+    if (shards < 1 || shards > SALA_MAX_SHARDS) b->erro = 1;
+    heranca.segmentos = calloc(shards > 0 ? shards : 1, sizeof(SegmentoHerdado));
+    if (heranca.segmentos == NULL) b->erro = 1;
+    if (!b->erro && troca_ler_u8(b)) {
+        endereco_local.tipo = (TipoTransporte)troca_ler_u8(b);
+        size_t tamanho;
+        const char *caminho = troca_ler_texto(b, &tamanho);
+        snprintf(endereco_local.caminho, sizeof(endereco_local.caminho), "%.*s", (int)tamanho,
+                 caminho != NULL ? caminho : "");
+        local_ligado = 1;
+        if (proximo < total_descritores) heranca.local = descritores[proximo++];
+    }
+    for (uint32_t i = 0; i < shards && !b->erro; i++) {
+        heranca.segmentos[i].escuta = proximo < total_descritores ? descritores[proximo++] : -1;
+    }
+    for (uint32_t i = 0; i < shards && !b->erro; i++) {
+        SegmentoHerdado *segmento = &heranca.segmentos[i];
+        segmento->total_descritores = troca_ler_u32(b);
+        segmento->primeiro_descritor = proximo;
+        proximo += segmento->total_descritores;
+        segmento->inicio = b->posicao;
+        uint32_t total_buffers = troca_ler_u32(b);
+        for (uint32_t k = 0; k < total_buffers && !b->erro; k++) troca_ler(b, troca_ler_u32(b));
+        uint32_t total = troca_ler_u32(b);
+        for (uint32_t k = 0; k < total && !b->erro; k++) {
+            SessaoHerdada h;
+            if (ler_sessao_herdada(b, &h, total_buffers) < 0) b->erro = 1;
+        }
+        segmento->fim = b->posicao;
+    }
+    heranca.cartas = b->posicao;
+    uint32_t cartas = troca_ler_u32(b);
+    for (uint32_t k = 0; k < cartas && !b->erro; k++) {
+        size_t tamanho;
+        troca_ler_u8(b);
+        troca_ler_texto(b, &tamanho);
+        troca_ler_u64(b);
+        troca_ler(b, troca_ler_u32(b));
+    }
+    for (uint32_t i = 0; i < shards && !b->erro; i++) {
+        if (heranca.segmentos[i].escuta < 0) b->erro = 1;
+    }
+    if (b->erro || proximo != total_descritores ||
+        pthread_barrier_init(&heranca.barreira, NULL, shards) != 0) {
+        for (uint32_t i = 0; i < total_descritores; i++) close(descritores[i]);
+        free(heranca.segmentos);
+        troca_liberar(&heranca.estado);
+        memset(&heranca, 0, sizeof(heranca));
+        errno = EPROTO;
+        return -1;
+    }
+    atomic_store(&proximo_id, heranca.estado.proximo_id);
+    heranca.ativa = 1;
+    return 0;
+}
+
+// Função para fechar o que sobrou de um estado herdado que não chegou a
+// ser adotado (o servidor novo falhou antes de os shards rodarem)
+static void abandonar_heranca() {
+    if (!heranca.ativa) return;
+    if (heranca.local >= 0) close(heranca.local);
+    for (uint32_t i = 0; i < heranca.estado.shards; i++) {
+        SegmentoHerdado *segmento = &heranca.segmentos[i];
+        if (segmento->escuta >= 0) close(segmento->escuta);
+        if (segmento->adotado) continue;
+        for (uint32_t k = 0; k < segmento->total_descritores; k++) {
+            close(heranca.estado.descritores[segmento->primeiro_descritor + k]);
+        }
+    }
+    pthread_barrier_destroy(&heranca.barreira);
+    free(heranca.segmentos);
+    troca_liberar(&heranca.estado);
+    memset(&heranca, 0, sizeof(heranca));
+}
+
+// Função executada pela thread de cada shard; `arg` é o índice do shard
+void *reator_executar(void *arg) {
+    struct epoll_event eventos[MAX_EVENTOS];
+
+    reator = &reatores[(intptr_t)arg];
+    sala_iniciar_shard(reator->indice);
+    if (total_reatores > 1) fixar_cpu(reator->indice);
+
+    if (backend == REATOR_URING) {
+        if (uring_iniciar(reator->socket_escuta, socket_local, reator->evento_fd,
+                          reator->relogio_fd) < 0) {
+            // Sem o anel o shard não atende ninguém: encerra o servidor
+            FIM_CONEXAO = 1;
+            uint64_t um = 1;
+            if (write(evento_interface, &um, sizeof(um)) < 0) {
+                perror("[ERRO] Falha ao sinalizar a interface");
+            }
+            return 0;
+        }
+        uring_executar();
+    }
+
+    if (heranca.ativa) adotar_herdadas(); // A troca exige o epoll
+
+    while (backend == REATOR_EPOLL && !encerrando) {
+        int n = epoll_wait(reator->epoll_fd, eventos, MAX_EVENTOS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("[ERRO] epoll_wait falhou");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            void *ptr = eventos[i].data.ptr;
+            uint32_t ev = eventos[i].events;
+
+            if (ptr == &marcador_escuta) {
+                aceitar_conexoes(reator->socket_escuta);
+                continue;
+            }
+            if (ptr == &marcador_local) {
+                aceitar_conexoes(socket_local);
+                continue;
+            }
+            if (ptr == &marcador_evento) {
+                tratar_evento_reator();
+                continue;
+            }
+            if (ptr == &marcador_relogio) {
+                uint64_t ticks;
+                if (read(reator->relogio_fd, &ticks, sizeof(ticks)) == sizeof(ticks)) {
+                    tratar_relogio_reator(ticks);
+                }
+                continue;
+            }
+
+            Sessao *s = (Sessao *)((uintptr_t)ptr & ~SOCKET_MEMORIA);
+            if (s->fd < 0) continue; // Fechada por outro evento desta rodada
+            if (s->aviso_fd >= 0) {
+                // Memória: um aviso pode ser de dados ou de espaço, e é
+                // dado por visto antes de olhar os anéis
+                transporte_atender_aviso(s->fd);
+                if ((uintptr_t)ptr & SOCKET_MEMORIA) {
+                    // O socket caiu: o que o cliente deixou no anel ainda conta
+                    if (ler_sessao(s) == 0) perder_conexao(s, "desconectou");
+                    continue;
+                }
+                ev = EPOLLIN | EPOLLOUT;
+            }
+            if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                if (ler_sessao(s) < 0) continue;
+            }
+            if ((ev & EPOLLOUT) && !s->marcada) {
+                if (sessao_descarregar(s) < 0) {
+                    perder_conexao(s, "teve a conexão interrompida");
+                } else {
+                    verificar_esperas(s);
+                }
+            }
+        }
+        fim_da_rodada();
+    }
+
+    // Última tentativa de entregar o que o operador enviou (ex.: /quit)
+    processar_quadros_operador();
+    descarregar_marcadas();
+    liberar_sessoes_fechadas();
+    if (transferindo) exportar_sessoes();
+    finalizar_sessoes();
+    slab_esvaziar_cache();
+    rastro_descarregar();
+    return 0;
+}
+
+// Função para a interface enviar um quadro a todas as sessões.
+// O quadro é codificado uma única vez aqui, fora das threads dos shards, e
+// o mesmo buffer é enfileirado em todas as sessões de todos os shards.
+int reator_difundir(uint8_t tipo, const char *origem, const char *corpo, size_t tamanho) {
+    BufferCompartilhado *buffer = buffer_criar(protocolo_tamanho_quadro(strlen(origem), tamanho));
+    if (buffer == NULL) return -1;
+    buffer->tamanho = (uint32_t)protocolo_codificar(buffer->dados, tipo, origem, corpo, tamanho);
+
+    for (int i = 0; i < total_reatores; i++) {
+        buffer_reter(buffer);
+        fila_spsc_inserir(&reatores[i].fila_operador, &buffer);
+        acordar_reator(&reatores[i]);
+    }
+    // A interface é o último produtor do histórico e da federação, depois
+    // dos shards
+    if (tipo == QUADRO_CHAT) {
+        historico_registrar(total_reatores, HISTORICO_DIFUSAO, NULL, buffer);
+        historico_publicar(total_reatores);
+        federacao_enviar_difusao(total_reatores, buffer);
+        federacao_publicar(total_reatores);
+    }
+    buffer_soltar(buffer);
+    return 0;
+}
+
+// Função para acordar um shard a partir de outra thread (a da federação)
+void reator_acordar_shard(int indice) {
+    acordar_reator(&reatores[indice]);
+}
+
+// Função para saber o shard dono da sessão de um token
+int reator_shard_do_token(uint64_t token) {
+    return TOKEN_SHARD(token);
+}
+
+// Função para pedir aos shards que parem após difundir o que estiver pendente
+void reator_encerrar() {
+    encerrando = 1;
+    for (int i = 0; i < total_reatores; i++) {
+        acordar_reator(&reatores[i]);
+    }
+}
+
+// Função para pedir aos shards que parem e deixem as sessões para um
+// processo novo (--troca) em vez de fechá-las
+void reator_transferir() {
+    transferindo = 1;
+    parada_transferencia = metricas_agora();
+    reator_encerrar();
+}
+
+// Função para gravar uma carta ainda não entregue ao shard `destino`
+static void exportar_carta(BlocoTroca *b, int destino, const Carta *carta) {
+    troca_escrever_u8(b, (uint8_t)destino);
+    if (carta->sala != NULL) {
+        troca_escrever_texto(b, (const char *)carta->sala->dados, carta->sala->tamanho);
+    } else {
+        troca_escrever_texto(b, "", 0);
+    }
+    troca_escrever_u64(b, carta->token);
+    troca_escrever_u32(b, carta->quadro->tamanho);
+    troca_escrever(b, carta->quadro->dados, carta->quadro->tamanho);
+}
+
+// Função para montar o estado que vai ao processo novo: o socket local e
+// os de escuta, o que cada shard gravou das suas sessões e as cartas que
+// ainda estavam a caminho. Chamada depois que as threads dos shards
+// terminaram; os sockets seguem abertos aqui até reator_finalizar().
+// Bloco: local u8 [tipo u8 | caminho] | por shard: descritores u32 |
+// buffers u32 | (tamanho u32 | bytes)... | sessões u32 | sessões... |
+// cartas u32 | cartas...
+// Retorna quantas sessões vão, ou -1 se faltou memória
+int reator_exportar(TrocaEstado *estado) {
+    memset(estado, 0, sizeof(*estado));
+    estado->shards = (uint32_t)total_reatores;
+    estado->proximo_id = atomic_load(&proximo_id);
+    estado->parada = parada_transferencia;
+    BlocoTroca *b = &estado->bloco;
+    BlocoTroca descritores = { 0 };
+    int erro = 0;
+    int sessoes = 0;
+
+    troca_escrever_u8(b, socket_local >= 0);
+    if (socket_local >= 0) {
+        troca_escrever_u8(b, (uint8_t)endereco_local.tipo);
+        troca_escrever_texto(b, endereco_local.caminho, strlen(endereco_local.caminho));
+        troca_escrever(&descritores, &socket_local, sizeof(int));
+    }
+    for (int i = 0; i < total_reatores; i++) {
+        troca_escrever(&descritores, &reatores[i].socket_escuta, sizeof(int));
+    }
+    for (int i = 0; i < total_reatores; i++) {
+        Reator *r = &reatores[i];
+        troca_escrever_u32(b, (uint32_t)(r->descritores_exportados.tamanho / sizeof(int)));
+        troca_escrever_u32(b, r->total_buffers_exportados);
+        troca_escrever(b, r->buffers_exportados.dados, r->buffers_exportados.tamanho);
+        troca_escrever_u32(b, r->total_exportadas);
+        troca_escrever(b, r->exportadas.dados, r->exportadas.tamanho);
+        troca_escrever(&descritores, r->descritores_exportados.dados,
+                       r->descritores_exportados.tamanho);
+        erro |= r->exportadas.erro | r->buffers_exportados.erro | r->descritores_exportados.erro;
+        sessoes += (int)r->total_exportadas;
+    }
+
+    // Cartas nas caixas e nas filas de atraso: ninguém mais as consome aqui
+    BlocoTroca cartas = { 0 };
+    uint32_t total_cartas = 0;
+    for (int i = 0; i < total_reatores; i++) {
+        Reator *r = &reatores[i];
+        for (int o = 0; o < total_reatores; o++) {
+            Carta carta;
+            while (o != i && fila_spsc_remover(&r->caixas[o], &carta)) {
+                exportar_carta(&cartas, i, &carta);
+                total_cartas++;
+                buffer_soltar(carta.quadro);
+                if (carta.sala != NULL) buffer_soltar(carta.sala);
+            }
+            for (size_t k = 0; k < r->atrasadas[o].total; k++) {
+                exportar_carta(&cartas, o, &r->atrasadas[o].cartas[k]);
+                total_cartas++;
+                buffer_soltar(r->atrasadas[o].cartas[k].quadro);
+                if (r->atrasadas[o].cartas[k].sala != NULL) {
+                    buffer_soltar(r->atrasadas[o].cartas[k].sala);
+                }
+            }
+            r->atrasadas[o].total = 0;
+        }
+    }
+    troca_escrever_u32(b, total_cartas);
+    troca_escrever(b, cartas.dados, cartas.tamanho);
+    erro |= cartas.erro;
+    troca_liberar_bloco(&cartas);
+
+    estado->descritores = (int *)descritores.dados;
+    estado->total_descritores = (uint32_t)(descritores.tamanho / sizeof(int));
+    if (erro || b->erro || descritores.erro) {
+        troca_liberar(estado);
+        errno = ENOMEM;
+        return -1;
+    }
+    exportado = 1;
+    return sessoes;
+}
+
+// Função para liberar as filas e caixas de correio de um shard
+static void liberar_filas_shard(Reator *r) {
+    MensagemRecebida m;
+    while (fila_spsc_remover(&r->fila_recebidas, &m)) slab_liberar(m.dados);
+    BufferCompartilhado *buffer;
+    while (fila_spsc_remover(&r->fila_operador, &buffer)) buffer_soltar(buffer);
+    fila_spsc_liberar(&r->fila_recebidas);
+    fila_spsc_liberar(&r->fila_operador);
+
+    for (int o = 0; o < total_reatores; o++) {
+        if (r->caixas != NULL && o != r->indice) {
+            Carta carta;
+            while (fila_spsc_remover(&r->caixas[o], &carta)) {
+                buffer_soltar(carta.quadro);
+                if (carta.sala != NULL) buffer_soltar(carta.sala);
+            }
+            fila_spsc_liberar(&r->caixas[o]);
+        }
+        if (r->conexoes != NULL && o != r->indice) {
+            ConexaoRetomada c;
+            while (fila_spsc_remover(&r->conexoes[o], &c)) close(c.fd);
+            fila_spsc_liberar(&r->conexoes[o]);
+        }
+        if (r->atrasadas != NULL) {
+            for (size_t k = 0; k < r->atrasadas[o].total; k++) {
+                buffer_soltar(r->atrasadas[o].cartas[k].quadro);
+                if (r->atrasadas[o].cartas[k].sala != NULL) {
+                    buffer_soltar(r->atrasadas[o].cartas[k].sala);
+                }
+            }
+            free(r->atrasadas[o].cartas);
+        }
+    }
+    free(r->caixas);
+    free(r->conexoes);
+    free(r->atrasadas);
+    r->caixas = NULL;
+    r->conexoes = NULL;
+    r->atrasadas = NULL;
+}
+
+// Função para fechar todas as sessões e descritores dos shards. Chamada
+// depois que as threads dos shards terminaram.
+void reator_finalizar() {
+    for (int i = 0; i < total_reatores; i++) {
+        // Shards cuja thread não chegou a rodar ainda não têm sessões
+        reator = &reatores[i];
+        finalizar_sessoes();
+        // Sockets das sessões passadas ao processo novo, que já os tem
+        const int *passados = (const int *)reator->descritores_exportados.dados;
+        for (size_t k = 0; k < reator->descritores_exportados.tamanho / sizeof(int); k++) {
+            close(passados[k]);
+        }
+        troca_liberar_bloco(&reator->descritores_exportados);
+        troca_liberar_bloco(&reator->buffers_exportados);
+        troca_liberar_bloco(&reator->exportadas);
+        if (reator->socket_escuta >= 0) close(reator->socket_escuta);
+        if (reator->epoll_fd >= 0) close(reator->epoll_fd);
+        if (reator->evento_fd >= 0) close(reator->evento_fd);
+        if (reator->relogio_fd >= 0) close(reator->relogio_fd);
+        reator->socket_escuta = reator->epoll_fd = reator->evento_fd = -1;
+        reator->relogio_fd = -1;
+    }
+    // As caixas só são liberadas quando nenhum shard pode mais postar
+    for (int i = 0; i < total_reatores; i++) {
+        liberar_filas_shard(&reatores[i]);
+    }
+    reator = NULL;
+    free(reatores);
+    reatores = NULL;
+    total_reatores = 0;
+    if (evento_interface >= 0) close(evento_interface);
+    evento_interface = -1;
+    if (quadro_ping != NULL) buffer_soltar(quadro_ping);
+    if (quadro_pong != NULL) buffer_soltar(quadro_pong);
+    quadro_ping = quadro_pong = NULL;
+    if (socket_local >= 0) {
+        close(socket_local);
+        if (!exportado) unlink(endereco_local.caminho); // Segue em uso no processo novo
+    }
+    socket_local = -1;
+    abandonar_heranca();
+    registro_finalizar();
+}
+
+// Função para a interface retirar a próxima mensagem recebida, em rodízio
+// entre os shards para nenhum deles monopolizar a tela
+// Retorna 0 se não houver mensagens; quem chama libera `mensagem->dados`
+int reator_proxima_mensagem(MensagemRecebida *mensagem) {
+    for (int k = 0; k < total_reatores; k++) {
+        int i = (proxima_fila_interface + k) % total_reatores;
+        if (fila_spsc_remover(&reatores[i].fila_recebidas, mensagem)) {
+            proxima_fila_interface = (i + 1) % total_reatores;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Função para obter o eventfd que os shards sinalizam quando há mensagens
+int reator_evento_interface() {
+    return evento_interface;
+}
+
+// Função para consultar os contadores das filas de exibição (somados entre
+// os shards; o pico é o do shard mais cheio)
+void reator_estatisticas_fila(uint64_t *descartadas, size_t *pico, size_t *capacidade) {
+    *descartadas = 0;
+    *pico = 0;
+    *capacidade = 0;
+    for (int i = 0; i < total_reatores; i++) {
+        size_t pico_shard = fila_spsc_marca_maxima(&reatores[i].fila_recebidas);
+        *descartadas += fila_spsc_descartados(&reatores[i].fila_recebidas);
+        if (pico_shard > *pico) *pico = pico_shard;
+        *capacidade += fila_spsc_capacidade(&reatores[i].fila_recebidas);
+    }
+}
+
+// Função para consultar quantas sessões estão ativas em todos os shards
+int reator_total_sessoes() {
+    int total = 0;
+    for (int i = 0; i < total_reatores; i++) {
+        total += reatores[i].total_sessoes;
+    }
+    return total;
+}
+
+// Função para consultar quantas salas existem
+int reator_total_salas() {
+    return sala_total();
+}
+
+// Função para consultar em quantos shards o servidor está dividido
+int reator_total_shards() {
+    return total_reatores;
+}
+
+// Função para a thread do io_uring saber se deve parar
+int reator_encerrando() {
+    return encerrando;
+}
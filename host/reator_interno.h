@@ -0,0 +1,43 @@
+// ============================================================================
+// ARQUIVO: reator_interno.h
+//
+// DESCRIÇÃO: Ligação entre a lógica das sessões (reator.c) e os backends
+//            de E/S. O backend epoll vive em reator.c; o backend io_uring
+//            (reator_uring.c) entrega a reator.c as conexões aceitas e os
+//            bytes recebidos, e envia as filas de saída que reator.c marca
+//            a cada rodada. Tudo aqui roda só na thread de um shard, e o
+//            estado de cada backend é local à thread.
+// ============================================================================
+
+#ifndef REATOR_INTERNO_H
+#define REATOR_INTERNO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "sessao.h"
+
+// Lógica das sessões (reator.c)
+Sessao *nova_sessao(int fd, const struct sockaddr *endereco);
+int consumir_dados(Sessao *s, const uint8_t *dados, size_t tamanho);
+void fechar_sessao(Sessao *s, const char *motivo);
+void perder_conexao(Sessao *s, const char *motivo);
+void marcar_sessao(Sessao *s);
+void verificar_esperas(Sessao *s);
+void liberar_sessao_orfa(Sessao *s);
+void tratar_evento_reator(void);
+void tratar_relogio_reator(uint64_t ticks);
+void fim_da_rodada(void);
+int reator_encerrando(void);
+
+// Backend io_uring (reator_uring.c)
+int uring_iniciar(int socket_escuta, int socket_local, int evento_fd, int relogio_fd);
+void uring_executar(void);
+int uring_registrar(Sessao *s);
+void uring_cancelar_receber(Sessao *s);
+int uring_enviar(Sessao *s);
+int uring_envio_em_voo(const Sessao *s);
+void uring_finalizar(void);
+
+#endif
@@ -0,0 +1,496 @@
+// ============================================================================
+// ARQUIVO: reator_uring.c
+//
+// DESCRIÇÃO: Backend io_uring do reator (./server --io uring). Usa as
+//            chamadas de sistema do io_uring diretamente, sem liburing:
+//
+//              - um accept multishot no socket de escuta gera uma conclusão
+//                por conexão aceita (com --local unix://, outro no socket
+//                UNIX; a memória compartilhada fica só com o epoll);
+//              - cada sessão tem um recv multishot que escolhe buffers de um
+//                anel de buffers fornecidos, compartilhado por todas as
+//                conexões; o buffer volta ao anel logo depois de tratado;
+//              - a fila de saída de cada sessão vai em um único sendmsg()
+//                submetido ao anel, com no máximo um envio em voo por sessão;
+//              - uma leitura no eventfd do operador acorda o anel, e outra
+//                no timerfd dos batimentos move a roda de temporizadores;
+//              - quando uma conexão retoma uma sessão antiga, o recv dela é
+//                cancelado e o socket é registrado de novo para a sessão
+//                retomada, talvez no anel de outro shard.
+//
+//            Cada shard tem seu próprio anel, criado pela thread do shard.
+//
+//            Cada rodada é uma única chamada io_uring_enter(), que submete
+//            os envios e rearmes da rodada anterior e espera conclusões. A
+//            lógica das sessões é a mesma do epoll (reator.c).
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <arpa/inet.h>
+
+#include "servidor.h"
+#include "sessao.h"
+#include "metricas.h"
+#include "reator_interno.h"
+
+#define URING_ENTRADAS 4096
+#define URING_BUFFERS 4096          // Potência de 2
+#define URING_TAMANHO_BUFFER 4096
+#define URING_GRUPO_BUFFERS 0
+
+// Tipo da operação, guardado nos bits baixos de user_data (as sessões são
+// alinhadas a 8 bytes, então o ponteiro ocupa o resto)
+#define OP_ACEITAR 1
+#define OP_RECEBER 2
+#define OP_ENVIAR 3
+#define OP_EVENTO 4
+#define OP_RELOGIO 5
+#define OP_CANCELAR 6
+#define OP_ACEITAR_LOCAL 7
+#define OP_MASCARA 7
+
+// Estado do envio de uma sessão; os iovecs precisam viver até a conclusão
+typedef struct EnvioUring {
+    struct iovec partes[SESSAO_IOV_MAX];
+    struct msghdr msg;
+    int em_voo;
+} EnvioUring;
+
+// Estado do anel, um por shard (cada thread de shard tem o seu)
+static _Thread_local int anel_fd = -1;
+static _Thread_local int socket_escuta_uring = -1;
+static _Thread_local int socket_local_uring = -1;
+static _Thread_local int evento_fd_uring = -1;
+static _Thread_local uint64_t valor_evento;
+static _Thread_local int relogio_fd_uring = -1;
+static _Thread_local uint64_t valor_relogio;
+
+// Anel de submissão
+static _Thread_local void *sq_mapa = MAP_FAILED;
+static _Thread_local size_t sq_mapa_tamanho;
+static _Thread_local _Atomic unsigned *sq_cabeca;
+static _Thread_local _Atomic unsigned *sq_cauda;
+static _Thread_local unsigned sq_mascara;
+static _Thread_local unsigned sq_entradas;
+static _Thread_local unsigned *sq_vetor;
+static _Thread_local struct io_uring_sqe *sqes = MAP_FAILED;
+static _Thread_local size_t sqes_tamanho;
+static _Thread_local unsigned sq_cauda_local;
+
+// Anel de conclusão
+static _Thread_local void *cq_mapa = MAP_FAILED;
+static _Thread_local size_t cq_mapa_tamanho;
+static _Thread_local _Atomic unsigned *cq_cabeca;
+static _Thread_local _Atomic unsigned *cq_cauda;
+static _Thread_local unsigned cq_mascara;
+static _Thread_local struct io_uring_cqe *cqes;
+
+// Anel de buffers fornecidos para o recv multishot
+static _Thread_local struct io_uring_buf_ring *anel_buffers = MAP_FAILED;
+static _Thread_local size_t anel_buffers_tamanho;
+static _Thread_local uint8_t *buffers = NULL;
+static _Thread_local uint16_t buffers_cauda;
+
+// Função para chamar io_uring_enter; `esperar` conclusões antes de voltar
+static int entrar(unsigned submeter, unsigned esperar) {
+    int r;
+    do {
+        r = (int)syscall(__NR_io_uring_enter, anel_fd, submeter, esperar,
+                         esperar ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (r < 0 && errno == EINTR);
+    return r;
+}
+
+// Função para publicar as SQEs preenchidas ao kernel
+// Retorna quantas SQEs o kernel ainda não consumiu
+static unsigned publicar() {
+    atomic_store_explicit(sq_cauda, sq_cauda_local, memory_order_release);
+    return sq_cauda_local - atomic_load_explicit(sq_cabeca, memory_order_acquire);
+}
+
+// Função para obter uma SQE livre, zerada. Se o anel está cheio, submete
+// o que há nele antes.
+static struct io_uring_sqe *obter_sqe() {
+    while (sq_cauda_local - atomic_load_explicit(sq_cabeca, memory_order_acquire) >= sq_entradas) {
+        if (entrar(publicar(), 0) < 0 && errno != EAGAIN && errno != EBUSY) {
+            return NULL;
+        }
+    }
+    unsigned indice = sq_cauda_local & sq_mascara;
+    struct io_uring_sqe *sqe = &sqes[indice];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_vetor[indice] = indice;
+    sq_cauda_local++;
+    return sqe;
+}
+
+// Função para devolver um buffer ao anel de buffers fornecidos
+static void devolver_buffer(uint16_t id) {
+    struct io_uring_buf *b = &anel_buffers->bufs[buffers_cauda & (URING_BUFFERS - 1)];
+    b->addr = (uint64_t)(uintptr_t)(buffers + (size_t)id * URING_TAMANHO_BUFFER);
+    b->len = URING_TAMANHO_BUFFER;
+    b->bid = id;
+    buffers_cauda++;
+    atomic_store_explicit((_Atomic uint16_t *)&anel_buffers->tail, buffers_cauda,
+                          memory_order_release);
+}
+
+// Função para armar o accept multishot em um socket de escuta; `operacao`
+// é OP_ACEITAR (TCP) ou OP_ACEITAR_LOCAL
+static int armar_aceitar(int escuta, uint64_t operacao) {
+    struct io_uring_sqe *sqe = obter_sqe();
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = escuta;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = operacao;
+    return 0;
+}
+
+// Função para armar a leitura do eventfd do operador
+static int armar_evento() {
+    struct io_uring_sqe *sqe = obter_sqe();
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = evento_fd_uring;
+    sqe->addr = (uint64_t)(uintptr_t)&valor_evento;
+    sqe->len = sizeof(valor_evento);
+    sqe->user_data = OP_EVENTO;
+    return 0;
+}
+
+// Função para armar a leitura do timerfd dos batimentos; o valor lido é o
+// número de ticks passados desde a leitura anterior
+static int armar_relogio() {
+    struct io_uring_sqe *sqe = obter_sqe();
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = relogio_fd_uring;
+    sqe->addr = (uint64_t)(uintptr_t)&valor_relogio;
+    sqe->len = sizeof(valor_relogio);
+    sqe->user_data = OP_RELOGIO;
+    return 0;
+}
+
+// Função para armar o recv multishot de uma sessão
+static int armar_receber(Sessao *s) {
+    struct io_uring_sqe *sqe = obter_sqe();
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = s->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_GRUPO_BUFFERS;
+    sqe->user_data = (uint64_t)(uintptr_t)s | OP_RECEBER;
+    s->operacoes_pendentes++;
+    s->recebendo = 1;
+    return 0;
+}
+
+// Função para registrar no anel uma sessão que não veio do accept (a que
+// herda a conexão de outra na retomada)
+int uring_registrar(Sessao *s) {
+    return armar_receber(s);
+}
+
+// Função para cancelar o recv multishot de uma sessão cujo socket vai
+// passar a outra, ou cuja leitura foi pausada. O cancelamento é submetido
+// na hora, antes que esse recv consuma bytes que já são da outra sessão
+// (ou que o kernel deveria segurar).
+void uring_cancelar_receber(Sessao *s) {
+    struct io_uring_sqe *sqe = obter_sqe();
+    if (sqe == NULL) return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = (uint64_t)(uintptr_t)s | OP_RECEBER;
+    sqe->user_data = OP_CANCELAR;
+    if (entrar(publicar(), 0) < 0 && errno != EAGAIN && errno != EBUSY) {
+        perror("[ERRO] Falha ao cancelar o recv no io_uring");
+    }
+}
+
+// Função para submeter ao anel o envio da fila de saída de uma sessão.
+// Se já há um envio em voo, o restante sai quando ele concluir.
+int uring_enviar(Sessao *s) {
+    if (s->envio_uring == NULL) {
+        s->envio_uring = calloc(1, sizeof(EnvioUring));
+        if (s->envio_uring == NULL) return -1;
+    }
+    EnvioUring *e = s->envio_uring;
+    if (e->em_voo || s->saida_total == s->saida_retidos) return 0;
+
+    struct io_uring_sqe *sqe = obter_sqe();
+    if (sqe == NULL) return -1;
+    memset(&e->msg, 0, sizeof(e->msg));
+    e->msg.msg_iov = e->partes;
+    e->msg.msg_iovlen = (size_t)sessao_preparar_envio(s, e->partes);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = s->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&e->msg;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)s | OP_ENVIAR;
+    e->em_voo = 1;
+    s->operacoes_pendentes++;
+    return 0;
+}
+
+// Função para saber se a sessão tem um envio ainda no anel
+int uring_envio_em_voo(const Sessao *s) {
+    return s->envio_uring != NULL && s->envio_uring->em_voo;
+}
+
+// Função para tratar a conclusão de um accept
+static void concluir_aceitar(const struct io_uring_cqe *cqe, int escuta, uint64_t operacao) {
+    if (cqe->res >= 0) {
+        struct sockaddr_storage endereco;
+        socklen_t tamanho_endereco = sizeof(endereco);
+        memset(&endereco, 0, sizeof(endereco));
+        getpeername(cqe->res, (struct sockaddr *)&endereco, &tamanho_endereco);
+        Sessao *s = nova_sessao(cqe->res, (struct sockaddr *)&endereco);
+        if (s != NULL && armar_receber(s) < 0) {
+            fechar_sessao(s, "não pôde ser registrada no io_uring");
+        }
+    } else if (cqe->res != -EAGAIN && cqe->res != -ECONNABORTED) {
+        fprintf(stderr, "[ERRO] Accept falhou: %s\n", strerror(-cqe->res));
+    }
+    if (!(cqe->flags & IORING_CQE_F_MORE) && !reator_encerrando()) {
+        armar_aceitar(escuta, operacao);
+    }
+}
+
+// Função para tratar a conclusão de um recv multishot
+static void concluir_receber(Sessao *s, const struct io_uring_cqe *cqe) {
+    int mais = (cqe->flags & IORING_CQE_F_MORE) != 0;
+    if (!mais) {
+        s->operacoes_pendentes--;
+        s->recebendo = 0;
+    }
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        uint16_t id = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        if (cqe->res > 0 && s->fd >= 0) {
+            metricas_somar(METRICA_BYTES_RECEBIDOS, (uint64_t)cqe->res);
+            metricas_registrar(HISTOGRAMA_TAMANHO_RECV, (uint64_t)cqe->res);
+            consumir_dados(s, buffers + (size_t)id * URING_TAMANHO_BUFFER, (size_t)cqe->res);
+        }
+        devolver_buffer(id);
+    }
+    if (s->fd < 0) return; // Fechada: só aguardava as conclusões
+
+    if (cqe->res == 0) {
+        perder_conexao(s, "desconectou");
+    } else if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED) {
+        perder_conexao(s, "teve a conexão interrompida");
+    } else if (!mais && !s->pausada && armar_receber(s) < 0) {
+        // Sem buffers livres (-ENOBUFS) o recv termina e é rearmado aqui;
+        // os buffers já voltaram ao anel quando a submissão acontecer.
+        // Pausada, a sessão fica sem recv até a espera terminar; o
+        // cancelamento de uma pausa que já terminou também rearma aqui
+        fechar_sessao(s, "não pôde ser registrada no io_uring");
+    }
+}
+
+// Função para tratar a conclusão de um sendmsg
+static void concluir_enviar(Sessao *s, const struct io_uring_cqe *cqe) {
+    s->operacoes_pendentes--;
+    s->envio_uring->em_voo = 0;
+    if (s->fd < 0) return;
+
+    if (cqe->res < 0) {
+        if (cqe->res == -EAGAIN || cqe->res == -EINTR) {
+            marcar_sessao(s);
+            return;
+        }
+        metricas_somar(METRICA_ERROS_ENVIO, 1);
+        perder_conexao(s, "teve a conexão interrompida");
+        return;
+    }
+    sessao_confirmar_envio(s, (size_t)cqe->res);
+    if (s->saida_total > s->saida_retidos) {
+        marcar_sessao(s); // Envio parcial ou fila que cresceu enquanto voava
+    }
+    verificar_esperas(s);
+}
+
+// Função para tratar todas as conclusões disponíveis
+static void tratar_conclusoes() {
+    unsigned cabeca = atomic_load_explicit(cq_cabeca, memory_order_relaxed);
+    unsigned cauda = atomic_load_explicit(cq_cauda, memory_order_acquire);
+
+    while (cabeca != cauda) {
+        const struct io_uring_cqe *cqe = &cqes[cabeca & cq_mascara];
+        uint64_t dados = cqe->user_data;
+        Sessao *s = (Sessao *)(uintptr_t)(dados & ~(uint64_t)OP_MASCARA);
+
+        switch (dados & OP_MASCARA) {
+            case OP_ACEITAR:
+                concluir_aceitar(cqe, socket_escuta_uring, OP_ACEITAR);
+                break;
+            case OP_ACEITAR_LOCAL:
+                concluir_aceitar(cqe, socket_local_uring, OP_ACEITAR_LOCAL);
+                break;
+            case OP_EVENTO:
+                tratar_evento_reator();
+                if (!reator_encerrando()) armar_evento();
+                break;
+            case OP_RELOGIO:
+                if (cqe->res == sizeof(valor_relogio)) tratar_relogio_reator(valor_relogio);
+                if (!reator_encerrando()) armar_relogio();
+                break;
+            case OP_RECEBER:
+                concluir_receber(s, cqe);
+                break;
+            case OP_ENVIAR:
+                concluir_enviar(s, cqe);
+                break;
+            case OP_CANCELAR:
+                break; // O recv cancelado conclui por conta própria
+        }
+        if (s != NULL && s->orfa && s->operacoes_pendentes == 0) {
+            liberar_sessao_orfa(s);
+        }
+
+        cabeca++;
+        // Libera a entrada logo, para o kernel poder reusar o espaço
+        atomic_store_explicit(cq_cabeca, cabeca, memory_order_release);
+        if (cabeca == cauda) {
+            cauda = atomic_load_explicit(cq_cauda, memory_order_acquire);
+        }
+    }
+}
+
+// Função para registrar o anel de buffers fornecidos e preenchê-lo
+static int registrar_buffers() {
+    anel_buffers_tamanho = URING_BUFFERS * sizeof(struct io_uring_buf);
+    anel_buffers = mmap(NULL, anel_buffers_tamanho, PROT_READ | PROT_WRITE,
+                        MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    buffers = malloc((size_t)URING_BUFFERS * URING_TAMANHO_BUFFER);
+    if (anel_buffers == MAP_FAILED || buffers == NULL) return -1;
+
+    struct io_uring_buf_reg registro;
+    memset(&registro, 0, sizeof(registro));
+    registro.ring_addr = (uint64_t)(uintptr_t)anel_buffers;
+    registro.ring_entries = URING_BUFFERS;
+    registro.bgid = URING_GRUPO_BUFFERS;
+    if (syscall(__NR_io_uring_register, anel_fd, IORING_REGISTER_PBUF_RING, &registro, 1) < 0) {
+        return -1;
+    }
+
+    buffers_cauda = 0;
+    for (unsigned i = 0; i < URING_BUFFERS; i++) {
+        devolver_buffer((uint16_t)i);
+    }
+    return 0;
+}
+
+// Função para criar o anel e mapear as filas de submissão e conclusão.
+// `socket_local` é o socket UNIX de --local e `relogio_fd` o timerfd dos
+// batimentos, ou -1 se estiverem desligados.
+int uring_iniciar(int socket_escuta, int socket_local, int evento_fd, int relogio_fd) {
+    struct io_uring_params parametros;
+    memset(&parametros, 0, sizeof(parametros));
+    parametros.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    parametros.cq_entries = URING_ENTRADAS * 4;
+
+    anel_fd = (int)syscall(__NR_io_uring_setup, URING_ENTRADAS, &parametros);
+    if (anel_fd < 0 && errno == EINVAL) {
+        // Kernels antigos não conhecem COOP_TASKRUN
+        parametros.flags &= ~IORING_SETUP_COOP_TASKRUN;
+        anel_fd = (int)syscall(__NR_io_uring_setup, URING_ENTRADAS, &parametros);
+    }
+    if (anel_fd < 0) {
+        perror("[ERRO] io_uring indisponível");
+        return -1;
+    }
+    if (!(parametros.features & IORING_FEAT_SINGLE_MMAP)) {
+        fprintf(stderr, "[ERRO] Kernel sem suporte a IORING_FEAT_SINGLE_MMAP\n");
+        uring_finalizar();
+        return -1;
+    }
+
+    sq_mapa_tamanho = parametros.sq_off.array + parametros.sq_entries * sizeof(unsigned);
+    cq_mapa_tamanho = parametros.cq_off.cqes + parametros.cq_entries * sizeof(struct io_uring_cqe);
+    if (cq_mapa_tamanho > sq_mapa_tamanho) sq_mapa_tamanho = cq_mapa_tamanho;
+    sq_mapa = mmap(NULL, sq_mapa_tamanho, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   anel_fd, IORING_OFF_SQ_RING);
+    sqes_tamanho = parametros.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = mmap(NULL, sqes_tamanho, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                anel_fd, IORING_OFF_SQES);
+    if (sq_mapa == MAP_FAILED || sqes == MAP_FAILED) {
+        perror("[ERRO] Não foi possível mapear o io_uring");
+        uring_finalizar();
+        return -1;
+    }
+    cq_mapa = sq_mapa; // Um único mapeamento para os dois anéis
+
+    uint8_t *sq = sq_mapa;
+    sq_cabeca = (_Atomic unsigned *)(sq + parametros.sq_off.head);
+    sq_cauda = (_Atomic unsigned *)(sq + parametros.sq_off.tail);
+    sq_mascara = *(unsigned *)(sq + parametros.sq_off.ring_mask);
+    sq_entradas = *(unsigned *)(sq + parametros.sq_off.ring_entries);
+    sq_vetor = (unsigned *)(sq + parametros.sq_off.array);
+    sq_cauda_local = atomic_load_explicit(sq_cauda, memory_order_relaxed);
+
+    uint8_t *cq = cq_mapa;
+    cq_cabeca = (_Atomic unsigned *)(cq + parametros.cq_off.head);
+    cq_cauda = (_Atomic unsigned *)(cq + parametros.cq_off.tail);
+    cq_mascara = *(unsigned *)(cq + parametros.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *)(cq + parametros.cq_off.cqes);
+
+    if (registrar_buffers() < 0) {
+        perror("[ERRO] Não foi possível registrar os buffers do io_uring");
+        uring_finalizar();
+        return -1;
+    }
+
+    socket_escuta_uring = socket_escuta;
+    socket_local_uring = socket_local;
+    evento_fd_uring = evento_fd;
+    relogio_fd_uring = relogio_fd;
+    return 0;
+}
+
+// Laço do reator sobre o io_uring; volta quando o reator deve encerrar
+void uring_executar() {
+    if (armar_aceitar(socket_escuta_uring, OP_ACEITAR) < 0 ||
+        (socket_local_uring >= 0 && armar_aceitar(socket_local_uring, OP_ACEITAR_LOCAL) < 0) ||
+        armar_evento() < 0 ||
+        (relogio_fd_uring >= 0 && armar_relogio() < 0)) {
+        perror("[ERRO] Não foi possível armar o io_uring");
+        return;
+    }
+
+    while (!reator_encerrando()) {
+        // Submete o que a rodada anterior preparou e espera ao menos uma conclusão
+        if (entrar(publicar(), 1) < 0 && errno != EBUSY) {
+            perror("[ERRO] io_uring_enter falhou");
+            break;
+        }
+        tratar_conclusoes();
+        fim_da_rodada();
+    }
+}
+
+// Função para desfazer o anel; as operações pendentes são canceladas
+void uring_finalizar() {
+    if (anel_fd >= 0) close(anel_fd);
+    if (sqes != MAP_FAILED) munmap(sqes, sqes_tamanho);
+    if (sq_mapa != MAP_FAILED) munmap(sq_mapa, sq_mapa_tamanho);
+    if (anel_buffers != MAP_FAILED) munmap(anel_buffers, anel_buffers_tamanho);
+    free(buffers);
+    anel_fd = -1;
+    sqes = MAP_FAILED;
+    sq_mapa = cq_mapa = MAP_FAILED;
+    anel_buffers = MAP_FAILED;
+    buffers = NULL;
+}
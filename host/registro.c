@@ -0,0 +1,186 @@
+// ============================================================================
+// ARQUIVO: registro.c
+//
+// DESCRIÇÃO: Implementação do registro global de nicknames (ver
+//            registro.h).
+// ============================================================================
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "registro.h"
+#include "servidor.h"
+#include "metricas.h"
+
+typedef struct EntradaRegistro {
+    struct EntradaRegistro *proxima; // Próxima entrada no mesmo balde
+    uint64_t token;
+    uint8_t tamanho;
+    char nickname[NICKNAME_MAX];
+} EntradaRegistro;
+
+static EntradaRegistro *baldes[REGISTRO_BALDES];
+static pthread_rwlock_t faixas[REGISTRO_FAIXAS] = {
+    [0 ... REGISTRO_FAIXAS - 1] = PTHREAD_RWLOCK_INITIALIZER
+};
+// Nicknames registrados; lido também pela interface (/status)
+static _Atomic int total_nicknames = 0;
+
+// Função de hash FNV-1a para o nickname
+static uint32_t hash_nickname(const char *nickname, size_t tamanho) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < tamanho; i++) {
+        h ^= (uint8_t)nickname[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Função para obter a trava da faixa de um balde
+static pthread_rwlock_t *faixa_do_balde(uint32_t balde) {
+    return &faixas[balde % REGISTRO_FAIXAS];
+}
+
+// Função para procurar a entrada de um nickname em um balde. Com a trava
+// da faixa (leitura ou escrita).
+static EntradaRegistro **procurar(uint32_t balde, const char *nickname, size_t tamanho) {
+    EntradaRegistro **p = &baldes[balde];
+    while (*p != NULL &&
+           ((*p)->tamanho != tamanho || memcmp((*p)->nickname, nickname, tamanho) != 0)) {
+        p = &(*p)->proxima;
+    }
+    return p;
+}
+
+// Função para saber se um nickname pode ser usado: não vazio, sem espaços
+// nem caracteres de controle (o /who os separa por '\n' e o /msg por espaço)
+static int nickname_valido(const char *nickname, size_t tamanho) {
+    if (tamanho == 0) return 0;
+    for (size_t i = 0; i < tamanho; i++) {
+        if ((uint8_t)nickname[i] <= ' ' || nickname[i] == 0x7f) return 0;
+    }
+    return 1;
+}
+
+// Função para reservar um nickname (terminado em '\0' e já truncado a
+// NICKNAME_MAX) para a sessão de `token`. Reservar de novo um nickname
+// que já é da própria sessão não é erro.
+// Retorna REGISTRO_OK, REGISTRO_EM_USO (de outra sessão) ou
+// REGISTRO_INVALIDO (vazio, com espaços ou sem memória)
+int registro_reservar(const char *nickname, uint64_t token) {
+    size_t tamanho = strlen(nickname);
+    if (tamanho >= NICKNAME_MAX || !nickname_valido(nickname, tamanho)) {
+        return REGISTRO_INVALIDO;
+    }
+    uint32_t balde = hash_nickname(nickname, tamanho) & (REGISTRO_BALDES - 1);
+    pthread_rwlock_t *faixa = faixa_do_balde(balde);
+
+    pthread_rwlock_wrlock(faixa);
+    EntradaRegistro *existente = *procurar(balde, nickname, tamanho);
+    if (existente != NULL) {
+        pthread_rwlock_unlock(faixa);
+        return existente->token == token ? REGISTRO_OK : REGISTRO_EM_USO;
+    }
+    EntradaRegistro *entrada = malloc(sizeof(EntradaRegistro));
+    if (entrada == NULL) {
+        pthread_rwlock_unlock(faixa);
+        return REGISTRO_INVALIDO;
+    }
+    entrada->token = token;
+    entrada->tamanho = (uint8_t)tamanho;
+    memcpy(entrada->nickname, nickname, tamanho + 1);
+    entrada->proxima = baldes[balde];
+    baldes[balde] = entrada;
+    pthread_rwlock_unlock(faixa);
+
+    atomic_fetch_add_explicit(&total_nicknames, 1, memory_order_relaxed);
+    metricas_ajustar(MEDIDOR_NICKNAMES, 1);
+    return REGISTRO_OK;
+}
+
+// Função para liberar um nickname, se ele ainda for da sessão de `token`
+// Retorna 1 se o nickname foi liberado
+int registro_liberar(const char *nickname, uint64_t token) {
+    size_t tamanho = strlen(nickname);
+    if (tamanho >= NICKNAME_MAX) return 0;
+    uint32_t balde = hash_nickname(nickname, tamanho) & (REGISTRO_BALDES - 1);
+    pthread_rwlock_t *faixa = faixa_do_balde(balde);
+
+    pthread_rwlock_wrlock(faixa);
+    EntradaRegistro **p = procurar(balde, nickname, tamanho);
+    EntradaRegistro *entrada = *p;
+    if (entrada == NULL || entrada->token != token) {
+        pthread_rwlock_unlock(faixa);
+        return 0;
+    }
+    *p = entrada->proxima;
+    pthread_rwlock_unlock(faixa);
+
+    free(entrada);
+    atomic_fetch_sub_explicit(&total_nicknames, 1, memory_order_relaxed);
+    metricas_ajustar(MEDIDOR_NICKNAMES, -1);
+    return 1;
+}
+
+// Função para procurar o token da sessão que usa um nickname
+// Retorna 0 se ninguém usa o nickname
+uint64_t registro_buscar(const char *nickname, size_t tamanho) {
+    if (tamanho >= NICKNAME_MAX) tamanho = NICKNAME_MAX - 1;
+    uint32_t balde = hash_nickname(nickname, tamanho) & (REGISTRO_BALDES - 1);
+    pthread_rwlock_t *faixa = faixa_do_balde(balde);
+
+    pthread_rwlock_rdlock(faixa);
+    EntradaRegistro *entrada = *procurar(balde, nickname, tamanho);
+    uint64_t token = entrada != NULL ? entrada->token : 0;
+    pthread_rwlock_unlock(faixa);
+    return token;
+}
+
+// Função para listar, separados por '\n', os nicknames que começam com
+// `prefixo` (vazio = todos). Cabem em `destino` os que couberem; `total`
+// recebe quantos existem. Trava uma faixa de cada vez, então a lista é
+// uma fotografia aproximada se houver trocas durante a varredura.
+// Retorna quantos bytes foram escritos em `destino`
+size_t registro_listar(const char *prefixo, size_t tamanho_prefixo, char *destino,
+                       size_t capacidade, uint32_t *total) {
+    size_t escritos = 0;
+    *total = 0;
+    for (int f = 0; f < REGISTRO_FAIXAS; f++) {
+        pthread_rwlock_rdlock(&faixas[f]);
+        for (uint32_t b = (uint32_t)f; b < REGISTRO_BALDES; b += REGISTRO_FAIXAS) {
+            for (EntradaRegistro *e = baldes[b]; e != NULL; e = e->proxima) {
+                if (e->tamanho < tamanho_prefixo ||
+                    memcmp(e->nickname, prefixo, tamanho_prefixo) != 0) {
+                    continue;
+                }
+                (*total)++;
+                size_t separador = escritos > 0 ? 1 : 0;
+                if (escritos + separador + e->tamanho > capacidade) continue;
+                if (separador) destino[escritos++] = '\n';
+                memcpy(destino + escritos, e->nickname, e->tamanho);
+                escritos += e->tamanho;
+            }
+        }
+        pthread_rwlock_unlock(&faixas[f]);
+    }
+    return escritos;
+}
+
+// Função para consultar quantos nicknames estão registrados
+int registro_total(void) {
+    return atomic_load_explicit(&total_nicknames, memory_order_relaxed);
+}
+
+// Função para liberar todas as entradas (depois que os shards terminaram)
+void registro_finalizar(void) {
+    for (uint32_t b = 0; b < REGISTRO_BALDES; b++) {
+        while (baldes[b] != NULL) {
+            EntradaRegistro *entrada = baldes[b];
+            baldes[b] = entrada->proxima;
+            free(entrada);
+        }
+    }
+    atomic_store(&total_nicknames, 0);
+}
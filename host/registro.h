@@ -0,0 +1,40 @@
+// ============================================================================
+// ARQUIVO: registro.h
+//
+// DESCRIÇÃO: Registro global de nicknames do servidor: para cada nickname
+//            em uso, o token da sessão dona (ver protocolo.h). Garante que
+//            dois clientes não usem o mesmo nickname e permite entregar uma
+//            mensagem privada (/msg) sem percorrer as conexões: o token diz
+//            o shard dono, e lá a tabela de tokens acha a sessão.
+//
+//            A tabela é uma hash com encadeamento, compartilhada por todos
+//            os shards. Os baldes são divididos em faixas, cada uma com a
+//            sua trava de leitura e escrita: buscas (o caminho do /msg) só
+//            disputam com trocas de nickname do mesmo balde, e a listagem
+//            do /who trava uma faixa de cada vez, sem parar as demais.
+// ============================================================================
+
+#ifndef REGISTRO_H
+#define REGISTRO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define REGISTRO_BALDES 16384 // Potência de 2
+#define REGISTRO_FAIXAS 64    // Travas; o balde b fica na faixa b % REGISTRO_FAIXAS
+#define REGISTRO_LISTA_MAX (16 * 1024) // Bytes de nicknames em uma resposta a /who
+
+// Resultados de registro_reservar
+#define REGISTRO_OK 0
+#define REGISTRO_EM_USO -1
+#define REGISTRO_INVALIDO -2
+
+int registro_reservar(const char *nickname, uint64_t token);
+int registro_liberar(const char *nickname, uint64_t token);
+uint64_t registro_buscar(const char *nickname, size_t tamanho);
+size_t registro_listar(const char *prefixo, size_t tamanho_prefixo, char *destino,
+                       size_t capacidade, uint32_t *total);
+int registro_total(void);
+void registro_finalizar(void);
+
+#endif
@@ -0,0 +1,145 @@
+// ============================================================================
+// ARQUIVO: sala.c
+//
+// DESCRIÇÃO: Registro de salas e de seus membros (ver sala.h).
+// ============================================================================
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sala.h"
+
+static _Thread_local Sala *baldes[SALA_BALDES];
+static _Thread_local int shard_atual = 0;
+// Bit i de presenca[b]: o shard i tem ao menos uma sala no balde b
+static _Atomic uint64_t presenca[SALA_BALDES];
+// Soma das salas de todos os shards; lido também pela interface (/status)
+static _Atomic int total_salas = 0;
+
+// Função de hash FNV-1a para o nome da sala
+static uint32_t hash_nome(const char *nome, size_t tamanho) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < tamanho; i++) {
+        h ^= (uint8_t)nome[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Função para calcular o balde de um nome (já truncado)
+static uint32_t balde_do_nome(const char *nome, size_t tamanho) {
+    if (tamanho >= SALA_NOME_MAX) tamanho = SALA_NOME_MAX - 1;
+    return hash_nome(nome, tamanho) % SALA_BALDES;
+}
+
+// Função para informar a qual shard pertence a thread atual
+void sala_iniciar_shard(int indice) {
+    shard_atual = indice;
+}
+
+// Função para procurar uma sala do shard atual pelo nome
+Sala *sala_buscar(const char *nome, size_t tamanho) {
+    if (tamanho >= SALA_NOME_MAX) tamanho = SALA_NOME_MAX - 1;
+    for (Sala *sala = baldes[balde_do_nome(nome, tamanho)]; sala != NULL;
+         sala = sala->proxima) {
+        if (strncmp(sala->nome, nome, tamanho) == 0 && sala->nome[tamanho] == '\0') {
+            return sala;
+        }
+    }
+    return NULL;
+}
+
+// Função para consultar quais shards podem ter membros da sala (um bit por
+// shard; pode haver falsos positivos de outras salas no mesmo balde)
+uint64_t sala_shards_presentes(const char *nome, size_t tamanho) {
+    return atomic_load_explicit(&presenca[balde_do_nome(nome, tamanho)],
+                                memory_order_relaxed);
+}
+
+// Função para procurar uma sala pelo nome, criando-a se não existir
+static Sala *obter_sala(const char *nome, size_t tamanho) {
+    if (tamanho >= SALA_NOME_MAX) tamanho = SALA_NOME_MAX - 1;
+    Sala *sala = sala_buscar(nome, tamanho);
+    if (sala != NULL) return sala;
+
+    sala = calloc(1, sizeof(Sala));
+    if (sala == NULL) return NULL;
+    sala->nome_compartilhado = buffer_copiar(nome, tamanho);
+    if (sala->nome_compartilhado == NULL) {
+        free(sala);
+        return NULL;
+    }
+    memcpy(sala->nome, nome, tamanho);
+    sala->nome[tamanho] = '\0';
+
+    uint32_t b = balde_do_nome(nome, tamanho);
+    if (baldes[b] == NULL) {
+        atomic_fetch_or_explicit(&presenca[b], UINT64_C(1) << shard_atual,
+                                 memory_order_relaxed);
+    }
+    sala->proxima = baldes[b];
+    baldes[b] = sala;
+    atomic_fetch_add_explicit(&total_salas, 1, memory_order_relaxed);
+    return sala;
+}
+
+// Função para remover uma sala vazia da tabela e liberá-la
+static void destruir_sala(Sala *sala) {
+    uint32_t b = balde_do_nome(sala->nome, strlen(sala->nome));
+    Sala **p = &baldes[b];
+    while (*p != sala) p = &(*p)->proxima;
+    *p = sala->proxima;
+    if (baldes[b] == NULL) {
+        atomic_fetch_and_explicit(&presenca[b], ~(UINT64_C(1) << shard_atual),
+                                  memory_order_relaxed);
+    }
+    atomic_fetch_sub_explicit(&total_salas, 1, memory_order_relaxed);
+    buffer_soltar(sala->nome_compartilhado);
+    free(sala->membros);
+    free(sala);
+}
+
+// Função para colocar a sessão em uma sala (saindo da anterior, se houver)
+// Retorna a sala ou NULL se faltou memória
+Sala *sala_entrar(Sessao *s, const char *nome, size_t tamanho) {
+    sala_sair(s);
+
+    Sala *sala = obter_sala(nome, tamanho);
+    if (sala == NULL) return NULL;
+    if (sala->total == sala->capacidade) {
+        uint32_t nova = sala->capacidade ? sala->capacidade * 2 : 8;
+        Sessao **novo = realloc(sala->membros, nova * sizeof(Sessao *));
+        if (novo == NULL) {
+            if (sala->total == 0) destruir_sala(sala);
+            return NULL;
+        }
+        sala->membros = novo;
+        sala->capacidade = nova;
+    }
+
+    s->sala = sala;
+    s->indice_sala = sala->total;
+    sala->membros[sala->total++] = s;
+    return sala;
+}
+
+// Função para tirar a sessão da sala atual; o último membro move-se para a
+// posição liberada e a sala é destruída quando fica vazia
+void sala_sair(Sessao *s) {
+    Sala *sala = s->sala;
+    if (sala == NULL) return;
+
+    Sessao *ultimo = sala->membros[--sala->total];
+    sala->membros[s->indice_sala] = ultimo;
+    ultimo->indice_sala = s->indice_sala;
+    s->sala = NULL;
+
+    if (sala->total == 0) destruir_sala(sala);
+}
+
+// Função para consultar quantas salas existem (somando os shards; uma sala
+// com membros em vários shards conta uma vez em cada um)
+int sala_total() {
+    return atomic_load_explicit(&total_salas, memory_order_relaxed);
+}
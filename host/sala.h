@@ -0,0 +1,46 @@
+// ============================================================================
+// ARQUIVO: sala.h
+//
+// DESCRIÇÃO: Salas nomeadas do servidor. Cada sala guarda um vetor com as
+//            sessões que são membros; a sessão lembra sua posição no vetor,
+//            então entrar e sair custam O(1). As salas ficam em uma tabela
+//            hash pelo nome e são criadas na primeira entrada e destruídas
+//            quando o último membro sai.
+//
+//            Cada shard do servidor tem sua própria tabela: uma sala com
+//            membros em vários shards existe uma vez em cada um deles. Um
+//            mapa global de presença diz, para cada balde, quais shards têm
+//            alguma sala ali, e serve para filtrar o repasse entre shards.
+//            Fora esse mapa, só a thread do shard acessa suas salas.
+// ============================================================================
+
+#ifndef SALA_H
+#define SALA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sessao.h"
+#include "buffer.h"
+
+#define SALA_NOME_MAX 64
+#define SALA_BALDES 1024
+#define SALA_MAX_SHARDS 64 // Um bit por shard no mapa de presença
+
+typedef struct Sala {
+    char nome[SALA_NOME_MAX];
+    BufferCompartilhado *nome_compartilhado; // Nome para as cartas entre shards
+    Sessao **membros;
+    uint32_t total;
+    uint32_t capacidade;
+    struct Sala *proxima; // Próxima sala no mesmo balde
+} Sala;
+
+void sala_iniciar_shard(int indice);
+Sala *sala_entrar(Sessao *s, const char *nome, size_t tamanho);
+void sala_sair(Sessao *s);
+Sala *sala_buscar(const char *nome, size_t tamanho);
+uint64_t sala_shards_presentes(const char *nome, size_t tamanho);
+int sala_total(void);
+
+#endif
@@ -4,13 +4,43 @@
 // ARQUIVO: server.c
 //
 // DESCRIÇÃO: Este programa atua como o lado "servidor" do chat.
-//            Ele abre uma porta, aguarda uma única conexão de um cliente,
-//            e então inicia a troca de mensagens bidirecional usando threads.
+//            Ele abre uma porta e atende vários clientes ao mesmo tempo:
+//            o reator (reator.c) cuida das conexões em uma ou mais threads
+//            (shards, opção --shards), enquanto esta thread cuida do
+//            terminal do operador. Com --local, clientes da mesma máquina
+//            entram também por um socket UNIX (unix:///caminho) ou pela
+//            memória compartilhada (shm:///caminho, ver transporte.h).
+//            Com --rastro, todo quadro enviado e recebido vai para um
+//            arquivo de rastro (rastro.h). Com --historico, as mensagens
+//            gravadas também são indexadas para o /search dos clientes
+//            (busca.h). Com --federar e --par, vários servidores formam uma
+//            federação: salas, /msg, /who e as mensagens do operador
+//            alcançam os usuários de todos os nós (federacao.h). Com
+//            --troca, um servidor novo iniciado com o mesmo caminho assume
+//            as conexões deste sem derrubar os clientes (troca.h). A linha
+//            do operador tem edição, histórico e colagem (editor.h).
 //
-// COMO COMPILAR: gcc server.c -o server -pthread
-// COMO EXECUTAR: ./server <porta>
+// COMO COMPILAR: gcc server.c reator.c reator_uring.c sessao.c sala.c registro.c historico.c busca.c federacao.c troca.c bench_busca.c temporizador.c ../common/protocolo.c ../common/fila_spsc.c ../common/buffer.c ../common/slab.c ../common/metricas.c ../common/comandos.c ../common/transporte.c ../common/rastro.c ../common/editor.c -I../common -o server -pthread
+// COMO EXECUTAR: ./server <porta> [--backlog N] [--io epoll|uring] [--shards N]
+//                         [--historico DIR] [--fsync nunca|periodico|lote]
+//                         [--metricas SOCKET] [--ping S] [--tempo-pong S]
+//                         [--ocioso S] [--retomada S] [--saida-kb N]
+//                         [--saida-quadros N] [--lento antigos|novos|derrubar]
+//                         [--local unix:///caminho|shm:///caminho]
+//                         [--rastro ARQUIVO] [--no ID] [--federar PORTA]
+//                         [--par tcp://host:porta ...] [--troca CAMINHO]
+//                ./server --bench-busca DIR [--mensagens N] [--consultas N]
+//                         (mede o índice de busca, ver bench_busca.c)
 //
-// Exemplo: ./server 8080
+// Exemplo: ./server 8080 --backlog 4096 --io uring --shards 4 --historico historico
+//          ./server 8080 --ping 15 --tempo-pong 5 --ocioso 600
+//          ./server 8080 --saida-kb 1024 --lento derrubar
+//          ./server 8080 --local shm:///tmp/chat.sock  (cliente: ./client shm:///tmp/chat.sock)
+//          ./server 8080 --rastro servidor.rastro  (cliente: ./client --reproduzir ...)
+//          ./server 8080 --no 1 --federar 9080
+//          ./server 8081 --no 2 --federar 9081 --par tcp://127.0.0.1:9080
+//          ./server 8080 --troca /tmp/chat.troca  (de novo, com o binário novo, para trocá-lo)
+//          curl --unix-socket servidor.sock http://localhost/metrics  (com --metricas servidor.sock)
 // ============================================================================
 
 #include <stdio.h>
@@ -18,37 +48,41 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
+#include <getopt.h>
 #include <termios.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <time.h>
-
-#define BUFFER_SIZE 1024
-#define NICKNAME_MAX 50
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+
+#include "servidor.h"
+#include "historico.h"
+#include "busca.h"
+#include "federacao.h"
+#include "bench_busca.h"
+#include "protocolo.h"
+#include "metricas.h"
+#include "comandos.h"
+#include "slab.h"
+#include "registro.h"
+#include "rastro.h"
+#include "troca.h"
+#include "editor.h"
 
 // Variável global para sinalizar o fim da conexão para as threads
 volatile int FIM_CONEXAO = 0;
-volatile int MENSAGEM_RECEBIDA = 0;
-
-// Estrutura para armazenar a mensagem recebida
-typedef struct {
-    char mensagem[BUFFER_SIZE];
-    int tamanho;
-} MensagemRecebida;
 
-MensagemRecebida ultima_mensagem;
-pthread_mutex_t mutex_mensagem = PTHREAD_MUTEX_INITIALIZER;
+// Descartes da fila de exibição já avisados ao operador
+uint64_t descartes_avisados = 0;
 
-// Variáveis globais para gerenciar o input atual
-char input_atual[BUFFER_SIZE] = "";
-int posicao_atual = 0;
-int input_visivel = 0; // Flag para indicar se há input visível na tela
+// Linha de entrada sendo editada
+Editor editor;
+int entrada_encerrada = 0; // stdin chegou ao fim (ex.: redirecionado de arquivo)
 
-// Variáveis globais para nicknames
+// Variável global para o nickname do operador
 char nickname[NICKNAME_MAX] = "Servidor";
-char nickname_parceiro[NICKNAME_MAX] = "Cliente";
 
 // Função para obter timestamp atual
 char* obter_timestamp() {
@@ -70,12 +104,20 @@ void configurar_entrada_nao_bloqueante() {
     struct termios term;
     tcgetattr(STDIN_FILENO, &term);
     term.c_lflag &= ~(ICANON | ECHO);
-    term.c_cc[VMIN] = 0;
+    // Com VMIN=1 e O_NONBLOCK, read() devolve EAGAIN (e não 0) quando não
+    // há teclas; assim 0 passa a significar fim da entrada
+    term.c_cc[VMIN] = 1;
     term.c_cc[VTIME] = 0;
     tcsetattr(STDIN_FILENO, TCSANOW, &term);
     
     int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
     fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
+
+    // Colagens chegam marcadas e viram uma mensagem só (ver editor.h)
+    if (isatty(STDOUT_FILENO)) {
+        fputs(EDITOR_COLAGEM_LIGAR, stdout);
+        fflush(stdout);
+    }
 }
 
 // Função para restaurar configurações do terminal
@@ -87,32 +129,96 @@ void restaurar_terminal() {
     
     int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
     fcntl(STDIN_FILENO, F_SETFL, flags & ~O_NONBLOCK);
+
+    if (isatty(STDOUT_FILENO)) {
+        fputs(EDITOR_COLAGEM_DESLIGAR, stdout);
+        fflush(stdout);
+    }
+}
+
+// Função para listar os nicknames conectados (/who), todos ou os que
+// começam com `prefixo`, inclusive os de outros nós da federação
+void exibir_nicknames(Trecho prefixo) {
+    static char lista[REGISTRO_LISTA_MAX + 1];
+    uint32_t total;
+    size_t tamanho = registro_listar(prefixo.inicio, prefixo.tamanho, lista, REGISTRO_LISTA_MAX,
+                                     &total);
+    tamanho = federacao_listar(prefixo.inicio, prefixo.tamanho, lista, tamanho, REGISTRO_LISTA_MAX,
+                               &total);
+    lista[tamanho] = '\0';
+    limpar_linha_atual();
+    printf("\033[34m[SISTEMA] %u conectados", total);
+    if (prefixo.tamanho > 0) printf(" começando com \"%.*s\"", (int)prefixo.tamanho, prefixo.inicio);
+    printf(":\033[0m\n");
+    uint32_t listados = 0;
+    for (char *nome = strtok(lista, "\n"); nome != NULL; nome = strtok(NULL, "\n")) {
+        printf("\033[36m  • %s\033[0m\n", nome);
+        listados++;
+    }
+    if (listados < total) {
+        printf("\033[36m  ... e mais %u\033[0m\n", total - listados);
+    }
 }
 
 // Função para processar comandos do servidor
-int processar_comando_servidor(char *mensagem) {
-    // Remover quebra de linha se existir
-    mensagem[strcspn(mensagem, "\n")] = 0;
-    
-    if (strcmp(mensagem, "/quit") == 0) {
+int processar_comando_servidor(Comando comando) {
+    if (comando == COMANDO_QUIT) {
         printf("\n\033[33m[SISTEMA] Encerrando o chat...\033[0m\n");
         return 1; // Sinalizar para sair
-    } else if (strcmp(mensagem, "/help") == 0) {
+    } else if (comando == COMANDO_HELP) {
         printf("\n\033[33m══════════════════════════════════════════════════════════════\033[0m\n");
         printf("\033[33m                           COMANDOS DO CHAT                   \033[0m\n");
         printf("\033[33m══════════════════════════════════════════════════════════════\033[0m\n");
         printf("\033[36m• /quit            \033[0m- Sair do chat\n");
         printf("\033[36m• /help            \033[0m- Mostrar esta ajuda\n");
         printf("\033[36m• /status          \033[0m- Mostrar seu status\n");
+        printf("\033[36m• /stats           \033[0m- Mostrar as métricas de rede e latência\n");
         printf("\033[36m• /nick <nome>     \033[0m- Trocar seu nickname\n");
+        printf("\033[36m• /who [prefixo]   \033[0m- Listar os nicknames conectados\n");
         printf("\033[33m══════════════════════════════════════════════════════════════\033[0m\n\n");
         return 2; // Sinalizar que é comando interno (não enviar)
-    } else if (strcmp(mensagem, "/status") == 0) {
+    } else if (comando == COMANDO_STATUS) {
         printf("\n\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
         printf("\033[34m                           SEU STATUS                         \033[0m\n");
         printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
         printf("\033[32m✓ Nickname: %s\033[0m\n", nickname);
-        printf("\033[32m✓ Parceiro: %s\033[0m\n", nickname_parceiro);
+        printf("\033[32m✓ Sessões ativas: %d (em %d shards)\033[0m\n", reator_total_sessoes(),
+               reator_total_shards());
+        printf("\033[32m✓ Salas abertas: %d\033[0m\n", reator_total_salas());
+        printf("\033[32m✓ Nicknames registrados: %d\033[0m\n", registro_total());
+        uint64_t descartadas;
+        size_t pico, capacidade;
+        reator_estatisticas_fila(&descartadas, &pico, &capacidade);
+        printf("\033[32m✓ Fila de exibição: pico %zu/%zu, %llu descartadas\033[0m\n",
+               pico, capacidade, (unsigned long long)descartadas);
+        if (historico_ativo()) {
+            uint64_t gravados, perdidos;
+            size_t segmentos;
+            historico_estatisticas(&gravados, &perdidos, &segmentos);
+            printf("\033[32m✓ Histórico: %llu mensagens gravadas em %zu segmentos, %llu descartadas\033[0m\n",
+                   (unsigned long long)gravados, segmentos, (unsigned long long)perdidos);
+        }
+        if (busca_ativa()) {
+            uint64_t indexadas;
+            size_t segmentos, termos;
+            busca_estatisticas(&indexadas, &segmentos, &termos);
+            printf("\033[32m✓ Busca: %llu mensagens indexadas, %zu segmentos, %zu termos na memória\033[0m\n",
+                   (unsigned long long)indexadas, segmentos, termos);
+        }
+        if (federacao_ativa()) {
+            uint32_t no;
+            int pares, remotos;
+            federacao_estatisticas(&no, &pares, &remotos);
+            printf("\033[32m✓ Federação: nó %u, %d pares, %d nicknames remotos\033[0m\n",
+                   no, pares, remotos);
+        }
+        printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n\n");
+        return 2; // Sinalizar que é comando interno (não enviar)
+    } else if (comando == COMANDO_STATS) {
+        printf("\n\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
+        printf("\033[34m                           MÉTRICAS                           \033[0m\n");
+        printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n");
+        metricas_relatorio(stdout);
         printf("\033[34m══════════════════════════════════════════════════════════════\033[0m\n\n");
         return 2; // Sinalizar que é comando interno (não enviar)
     }
@@ -120,126 +226,85 @@ int processar_comando_servidor(char *mensagem) {
     return 0; // Mensagem normal (enviar)
 }
 
-// Função executada pela thread de recebimento de mensagens
-void *receber_mensagens(void *socket_desc) {
-    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-    int sock = *(int*)socket_desc;
-    char server_message[BUFFER_SIZE];
-    int read_size;
-
-    while ((read_size = recv(sock, server_message, BUFFER_SIZE, 0)) > 0) {
-        server_message[read_size] = '\0';
-        
-        // Verificar se é um comando /nick do cliente
-        char cmd[BUFFER_SIZE];
-        char arg1[BUFFER_SIZE];
-        if (sscanf(server_message, "%s %s", cmd, arg1) >= 1) {
-            if (strcmp(cmd, "/nick") == 0 && strlen(arg1) > 0) {
-                strncpy(nickname_parceiro, arg1, NICKNAME_MAX - 1);
-                nickname_parceiro[NICKNAME_MAX - 1] = '\0';
-                pthread_mutex_lock(&mutex_mensagem);
-                strcpy(ultima_mensagem.mensagem, server_message);
-                ultima_mensagem.tamanho = read_size;
-                MENSAGEM_RECEBIDA = 1;
-                pthread_mutex_unlock(&mutex_mensagem);
-                continue;
-            }
-        }
-        
-        pthread_mutex_lock(&mutex_mensagem);
-        strcpy(ultima_mensagem.mensagem, server_message);
-        ultima_mensagem.tamanho = read_size;
-        MENSAGEM_RECEBIDA = 1;
-        pthread_mutex_unlock(&mutex_mensagem);
-        if (strncmp(server_message, "/quit", 5) == 0) {
-            break;
-        }
-    }
-    if (read_size == 0) {
-        printf("\n\033[33m[SISTEMA] Parceiro desconectou.\033[0m\n");
-    } else if (read_size == -1) {
-        perror("[ERRO] Falha ao receber mensagem");
-    }
-    FIM_CONEXAO = 1;
-    return 0;
+// Função para exibir prompt de entrada, com a parte visível do que já foi
+// digitado
+void exibir_prompt() {
+    static char visivel[EDITOR_EXIBICAO_MAX];
+    // "[HH:MM] " + nickname + "(você): "
+    size_t prompt = 16 + editor_colunas(nickname, strlen(nickname));
+    size_t colunas = editor_largura_terminal(STDOUT_FILENO);
+    editor_exibir(&editor, colunas > prompt + 1 ? colunas - prompt - 1 : 0, visivel);
+    printf("\033[36m[%s] %s(você): \033[0m%s", obter_timestamp(), nickname, visivel);
+    fflush(stdout);
 }
 
-// Função para ler entrada do usuário de forma não-bloqueante
+// Função para ler entrada do usuário de forma não-bloqueante: cada leitura
+// traz tudo o que o terminal tiver e a linha é redesenhada uma vez por
+// leitura, não por tecla
+// Retorna -1 quando não há mais caracteres disponíveis, 1 quando uma
+// mensagem ficou pronta em `buffer` e 0 quando ela ainda não está completa
 int ler_entrada_usuario(char *buffer, int max_size) {
-    char c;
-    int bytes_read = read(STDIN_FILENO, &c, 1);
-    
-    if (bytes_read <= 0) {
-        return 0; // Nenhum caractere disponível
+    ssize_t bytes_read = editor_ler(&editor, STDIN_FILENO);
+    if (bytes_read == 0) {
+        entrada_encerrada = 1; // Fim da entrada (stdin fechado)
+        return -1;
     }
-    
-    if (c == '\n' || c == '\r') {
-        // Enter pressionado - finalizar mensagem
-        if (posicao_atual > 0) {
-            input_atual[posicao_atual] = '\0';
-            strcpy(buffer, input_atual);
-            posicao_atual = 0;
-            input_atual[0] = '\0';
-            input_visivel = 0;
-            return 1; // Mensagem completa
-        }
-    } else if (c == 127 || c == 8) {
-        // Backspace - só permite apagar se não estiver no início do prompt
-        if (posicao_atual > 0) {
-            posicao_atual--;
-            input_atual[posicao_atual] = '\0';
-            printf("\b \b"); // Apagar caractere na tela
-            fflush(stdout);
-        }
-        // Se tentar apagar além do prompt, não faz nada (protege o prompt)
-    } else if (posicao_atual < max_size - 1) {
-        // Adicionar caractere ao buffer
-        input_atual[posicao_atual] = c;
-        posicao_atual++;
-        input_atual[posicao_atual] = '\0';
-        printf("%c", c); // Mostrar caractere na tela
-        fflush(stdout);
+    if (bytes_read < 0) {
+        return -1; // Nenhum caractere disponível
     }
-    
-    return 0; // Mensagem ainda não completa
-}
 
-// Função para exibir prompt de entrada
-void exibir_prompt() {
-    printf("\033[36m[%s] %s(você): \033[0m", obter_timestamp(), nickname);
-    fflush(stdout);
+    uint64_t lida = metricas_agora();
+    if (editor_processar(&editor, buffer, (size_t)max_size)) {
+        editor.alterada = 0;
+        return 1; // Mensagem completa (quem trata redesenha o prompt)
+    }
+    if (editor.alterada) {
+        limpar_linha_atual();
+        exibir_prompt();
+        editor.alterada = 0;
+        metricas_registrar(HISTOGRAMA_TECLA_TELA, metricas_agora() - lida);
+    }
+    return 0; // Mensagem ainda não completa
 }
 
 // Função para exibir mensagem recebida
-void exibir_mensagem_recebida(const char *mensagem) {
+void exibir_mensagem_recebida(uint8_t tipo, const char *origem, const char *mensagem) {
     // Limpa a linha atual do input
     limpar_linha_atual();
 
-    // Verificar se é um comando /nick
-    char cmd[BUFFER_SIZE];
-    char arg1[BUFFER_SIZE];
-    if (sscanf(mensagem, "%s %s", cmd, arg1) >= 1) {
-        if (strcmp(cmd, "/nick") == 0 && strlen(arg1) > 0) {
-            // Mostrar mensagem de confirmação do nickname do parceiro
-            printf("\033[33m[SISTEMA] %s alterou o nickname para: %s\033[0m\n", nickname_parceiro, arg1);
-        } else {
-            // Exibe a mensagem recebida normal
-            printf("\033[32m[%s] %s: %s\033[0m", obter_timestamp(), nickname_parceiro, mensagem);
-            if (mensagem[strlen(mensagem) - 1] != '\n') {
-                printf("\n");
-            }
-        }
+    if (tipo == QUADRO_NICK) {
+        // Mostrar mensagem de confirmação do nickname do parceiro
+        printf("\033[33m[SISTEMA] %s alterou o nickname para: %s\033[0m\n", origem, mensagem);
     } else {
         // Exibe a mensagem recebida normal
-        printf("\033[32m[%s] %s: %s\033[0m", obter_timestamp(), nickname_parceiro, mensagem);
-        if (mensagem[strlen(mensagem) - 1] != '\n') {
-            printf("\n");
-        }
+        printf("\033[32m[%s] %s: %s\033[0m\n", obter_timestamp(), origem, mensagem);
     }
 
     // Sempre reimprime o prompt e o input atual (se houver)
-    printf("\033[36m[%s] %s(você): \033[0m%s", obter_timestamp(), nickname, input_atual);
-    fflush(stdout);
+    exibir_prompt();
+}
+
+// Função para exibir todas as mensagens que o reator entregou
+void exibir_mensagens_pendentes() {
+    MensagemRecebida m;
+    while (reator_proxima_mensagem(&m)) {
+        metricas_ajustar(MEDIDOR_FILA_EXIBICAO, -1);
+        exibir_mensagem_recebida(m.tipo, MENSAGEM_ORIGEM(&m), MENSAGEM_CORPO(&m));
+        metricas_registrar(HISTOGRAMA_RECEPCAO_EXIBICAO, metricas_agora() - m.recebido);
+        slab_liberar(m.dados);
+    }
+
+    // Avisa se a tela não acompanhou o ritmo e mensagens foram descartadas
+    uint64_t descartadas;
+    size_t pico, capacidade;
+    reator_estatisticas_fila(&descartadas, &pico, &capacidade);
+    if (descartadas > descartes_avisados) {
+        limpar_linha_atual();
+        printf("\033[33m[SISTEMA] %llu mensagens descartadas (fila de exibição cheia).\033[0m\n",
+               (unsigned long long)(descartadas - descartes_avisados));
+        descartes_avisados = descartadas;
+        exibir_prompt();
+    }
 }
 
 // Função para exibir mensagem enviada
@@ -249,16 +314,314 @@ void exibir_mensagem_enviada(const char *mensagem) {
     exibir_prompt();
 }
 
+// Função para tratar uma linha digitada pelo operador
+// Retorna 1 se o operador pediu para sair
+int processar_entrada(char *mensagem) {
+    uint64_t entrada = metricas_agora(); // Enter → quadro entregue aos shards
+    // Remove espaços em branco do início e fim
+    char *msg_trim = mensagem;
+    while (*msg_trim == ' ' || *msg_trim == '\t') msg_trim++;
+    size_t len = strlen(msg_trim);
+    while (len > 0 && (msg_trim[len-1] == ' ' || msg_trim[len-1] == '\t' || msg_trim[len-1] == '\n')) {
+        msg_trim[--len] = '\0';
+    }
+    
+    LinhaComando linha;
+    Comando comando = comando_analisar(msg_trim, len, &linha);
+    if (comando == COMANDO_NICK) {
+        if (linha.argumento.tamanho > 0) {
+            char novo[NICKNAME_MAX];
+            size_t tamanho = trecho_copiar(linha.argumento, novo, sizeof(novo));
+            // Enviar para os clientes (origem = nickname antigo)
+            if (reator_difundir(QUADRO_NICK, nickname, novo, tamanho) < 0) {
+                perror("[ERRO] Falha ao enviar mensagem");
+            } else {
+                // Atualizar nickname local
+                memcpy(nickname, novo, tamanho + 1);
+                limpar_linha_atual();
+                printf("\033[32m✓ Nickname alterado para: %s\033[0m\n", nickname);
+                exibir_prompt();
+            }
+        } else {
+            limpar_linha_atual();
+            printf("\033[31m✗ Uso: /nick <nome>\033[0m\n");
+            exibir_prompt();
+        }
+        return 0;
+    } else if (comando == COMANDO_WHO) {
+        exibir_nicknames(linha.argumento);
+        exibir_prompt();
+        return 0;
+    }
+
+    // Se for comando, processa normalmente
+    if (comando != COMANDO_NENHUM) {
+        int resultado_comando = processar_comando_servidor(comando);
+        if (resultado_comando == 1) {
+            // Enviar /quit para os clientes antes de sair
+            reator_difundir(QUADRO_QUIT, nickname, NULL, 0);
+            FIM_CONEXAO = 1;
+            return 1;
+        } else if (resultado_comando == 2) {
+            exibir_prompt();
+        }
+    }
+    // Só envia/exibe se não for vazio
+    else if (len > 0) {
+        if (reator_difundir(QUADRO_CHAT, nickname, msg_trim, len) < 0) {
+            perror("[ERRO] Falha ao enviar mensagem");
+        } else {
+            metricas_registrar(HISTOGRAMA_ENTRADA_ENVIO, metricas_agora() - entrada);
+            exibir_mensagem_enviada(msg_trim);
+        }
+    } else {
+        exibir_prompt();
+    }
+    return 0;
+}
+
+// Função para passar as sessões ao processo novo (--troca), depois que os
+// shards pararam e o histórico foi fechado
+void passar_conexoes(int sucessor, int escuta_troca) {
+    TrocaEstado estado;
+    int sessoes = reator_exportar(&estado);
+    if (sessoes < 0) {
+        perror("[ERRO] Não foi possível montar o estado da troca");
+        return;
+    }
+    snprintf(estado.nickname, NICKNAME_MAX, "%s", nickname);
+    if (troca_enviar(sucessor, escuta_troca, &estado) < 0) {
+        perror("[ERRO] Falha ao passar as conexões ao processo novo");
+    } else {
+        printf("\033[33m[SISTEMA] %d sessões passadas ao processo novo (%u sockets, %.1f KB de "
+               "estado) %.1f ms depois da parada dos shards.\033[0m\n",
+               sessoes, estado.total_descritores, (double)estado.bloco.tamanho / 1024,
+               (double)(metricas_agora() - estado.parada) / 1e6);
+    }
+    troca_liberar(&estado);
+}
+
+// Função para exibir o uso do programa
+void exibir_uso(const char *programa) {
+    fprintf(stderr, "Uso: %s <porta> [--backlog N] [--io epoll|uring] [--shards N]\n"
+                    "       [--historico DIR] [--fsync nunca|periodico|lote]\n"
+                    "       [--metricas SOCKET] [--ping S] [--tempo-pong S] [--ocioso S]\n"
+                    "       [--retomada S] [--saida-kb N] [--saida-quadros N]\n"
+                    "       [--lento antigos|novos|derrubar] [--local URI] [--rastro ARQUIVO]\n"
+                    "       [--no ID] [--federar PORTA] [--par tcp://host:porta ...]\n"
+                    "       [--troca CAMINHO]\n"
+                    "  --ping S        silêncio até mandar um ping (padrão %d; 0 desliga)\n"
+                    "  --tempo-pong S  prazo para a resposta ao ping (padrão %d)\n"
+                    "  --ocioso S      tempo sem mensagens até derrubar (padrão %d = nunca)\n"
+                    "  --retomada S    espera de uma sessão cuja conexão caiu (padrão %d; 0 desliga)\n"
+                    "  --saida-kb N    bytes por enviar a uma conexão, em KB (padrão %d; mínimo %d)\n"
+                    "  --saida-quadros N  quadros por enviar a uma conexão (padrão %d; mínimo %d)\n"
+                    "  --lento P       conexão que chega ao limite: descartar as mensagens\n"
+                    "                  antigas (padrão), as novas ou derrubá-la\n"
+                    "  --local URI     aceita também clientes locais por unix:///caminho ou\n"
+                    "                  shm:///caminho (memória compartilhada; só com --io epoll)\n"
+                    "  --rastro ARQUIVO  grava os quadros enviados e recebidos, para reproduzir\n"
+                    "                  com ./client --reproduzir\n"
+                    "  --no ID         identificador deste nó na federação (padrão: sorteado)\n"
+                    "  --federar PORTA aceita ligações de outros servidores nesta porta\n"
+                    "  --par URI       liga-se ao servidor em tcp://host:porta (repetível)\n"
+                    "  --troca CAMINHO assume as conexões do servidor que escuta em CAMINHO,\n"
+                    "                  se houver um, e escuta lá pela próxima troca (só com\n"
+                    "                  --io epoll)\n"
+                    "       %s --bench-busca DIR [--mensagens N] [--consultas N]\n"
+                    "                  mede o índice de busca em DIR, sem rede\n",
+            programa, PING_PADRAO, TEMPO_PONG_PADRAO, OCIOSO_PADRAO, RETOMADA_PADRAO,
+            SAIDA_KB_PADRAO, SAIDA_KB_MINIMO, SAIDA_QUADROS_PADRAO, SAIDA_QUADROS_MINIMO,
+            programa);
+}
+
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Uso: %s <porta>\n", argv[0]);
+    if (argc > 1 && strcmp(argv[1], "--bench-busca") == 0) {
+        return executar_bench_busca(argc, argv);
+    }
+    int backlog = BACKLOG_PADRAO;
+    BackendReator backend = REATOR_EPOLL;
+    int shards = 1;
+    const char *diretorio_historico = NULL;
+    PoliticaFsync politica_fsync = FSYNC_PERIODICO;
+    const char *socket_metricas = NULL;
+    int ping = PING_PADRAO;
+    int tempo_pong = TEMPO_PONG_PADRAO;
+    int ocioso = OCIOSO_PADRAO;
+    int retomada = RETOMADA_PADRAO;
+    int saida_kb = SAIDA_KB_PADRAO;
+    int saida_quadros = SAIDA_QUADROS_PADRAO;
+    PoliticaLento politica_lento = LENTO_DESCARTAR_ANTIGOS;
+    EnderecoTransporte endereco_local;
+    int local_ligado = 0;
+    const char *arquivo_rastro = NULL;
+    int federado = 0;
+    const char *caminho_troca = NULL;
+    static struct option opcoes[] = {
+        {"backlog", required_argument, 0, 'b'},
+        {"io", required_argument, 0, 'i'},
+        {"shards", required_argument, 0, 's'},
+        {"historico", required_argument, 0, 'H'},
+        {"fsync", required_argument, 0, 'f'},
+        {"metricas", required_argument, 0, 'm'},
+        {"ping", required_argument, 0, 'p'},
+        {"tempo-pong", required_argument, 0, 't'},
+        {"ocioso", required_argument, 0, 'o'},
+        {"retomada", required_argument, 0, 'r'},
+        {"saida-kb", required_argument, 0, 'k'},
+        {"saida-quadros", required_argument, 0, 'q'},
+        {"lento", required_argument, 0, 'l'},
+        {"local", required_argument, 0, 'L'},
+        {"rastro", required_argument, 0, 'R'},
+        {"no", required_argument, 0, 'N'},
+        {"federar", required_argument, 0, 'F'},
+        {"par", required_argument, 0, 'P'},
+        {"troca", required_argument, 0, 'T'},
+        {0, 0, 0, 0}
+    };
+    int opcao;
+    while ((opcao = getopt_long(argc, argv, "b:i:s:H:f:m:p:t:o:r:k:q:l:L:R:N:F:P:T:", opcoes, NULL)) != -1) {
+        switch (opcao) {
+            case 'b':
+                backlog = atoi(optarg);
+                if (backlog <= 0) {
+                    fprintf(stderr, "[ERRO] Backlog inválido: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'i':
+                if (strcmp(optarg, "epoll") == 0) {
+                    backend = REATOR_EPOLL;
+                } else if (strcmp(optarg, "uring") == 0) {
+                    backend = REATOR_URING;
+                } else {
+                    fprintf(stderr, "[ERRO] Backend de E/S inválido: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 's':
+                shards = atoi(optarg);
+                if (shards <= 0) {
+                    fprintf(stderr, "[ERRO] Número de shards inválido: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'H':
+                diretorio_historico = optarg;
+                break;
+            case 'f':
+                if (historico_politica_ler(optarg, &politica_fsync) < 0) {
+                    fprintf(stderr, "[ERRO] Política de fsync inválida: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'm':
+                socket_metricas = optarg;
+                break;
+            case 'p':
+                ping = atoi(optarg);
+                if (ping < 0) {
+                    fprintf(stderr, "[ERRO] Intervalo de ping inválido: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't':
+                tempo_pong = atoi(optarg);
+                if (tempo_pong <= 0) {
+                    fprintf(stderr, "[ERRO] Prazo do pong inválido: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'o':
+                ocioso = atoi(optarg);
+                if (ocioso < 0) {
+                    fprintf(stderr, "[ERRO] Tempo de ociosidade inválido: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'r':
+                retomada = atoi(optarg);
+                if (retomada < 0) {
+                    fprintf(stderr, "[ERRO] Tempo de retomada inválido: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'k':
+                saida_kb = atoi(optarg);
+                if (saida_kb < SAIDA_KB_MINIMO) {
+                    fprintf(stderr, "[ERRO] Limite de saída inválido: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'q':
+                saida_quadros = atoi(optarg);
+                if (saida_quadros < SAIDA_QUADROS_MINIMO) {
+                    fprintf(stderr, "[ERRO] Limite de quadros inválido: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'l':
+                if (reator_politica_ler(optarg, &politica_lento) < 0) {
+                    fprintf(stderr, "[ERRO] Política para conexões lentas inválida: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'L':
+                if (transporte_ler_uri(optarg, &endereco_local) < 0 ||
+                    endereco_local.tipo == TRANSPORTE_TCP) {
+                    fprintf(stderr, "[ERRO] Endereço local inválido: %s\n", optarg);
+                    return 1;
+                }
+                local_ligado = 1;
+                break;
+            case 'R':
+                arquivo_rastro = optarg;
+                break;
+            case 'N': {
+                long no = atol(optarg);
+                if (no <= 0 || no > UINT32_MAX) {
+                    fprintf(stderr, "[ERRO] Identificador de nó inválido: %s\n", optarg);
+                    return 1;
+                }
+                federacao_configurar_no((uint32_t)no);
+                break;
+            }
+            case 'F':
+                if (federacao_configurar_escuta(atoi(optarg)) < 0) {
+                    fprintf(stderr, "[ERRO] Porta da federação inválida: %s\n", optarg);
+                    return 1;
+                }
+                federado = 1;
+                break;
+            case 'P': {
+                EnderecoTransporte par;
+                if (transporte_ler_uri(optarg, &par) < 0 || federacao_adicionar_par(&par) < 0) {
+                    fprintf(stderr, "[ERRO] Par da federação inválido: %s\n", optarg);
+                    return 1;
+                }
+                federado = 1;
+                break;
+            }
+            case 'T':
+                caminho_troca = optarg;
+                break;
+            default:
+                exibir_uso(argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc) {
+        exibir_uso(argv[0]);
+        return 1;
+    }
+    // O io_uring deixaria recvs e envios em voo no kernel na hora da troca
+    if (caminho_troca != NULL && backend == REATOR_URING) {
+        fprintf(stderr, "[ERRO] A troca a quente (--troca) exige --io epoll\n");
         return 1;
     }
 
-    int port = atoi(argv[1]);
-    int server_socket, client_socket;
-    struct sockaddr_in server_address, client_address;
-    pthread_t receive_thread;
+    int port = atoi(argv[optind]);
+    pthread_t *reator_threads;
 
     setenv("TZ", "America/Sao_Paulo", 1);
     tzset();
@@ -267,144 +630,177 @@ int main(int argc, char *argv[]) {
     putenv("TZ=UTC-3");
     tzset();
 
-    // 1. Criar o socket do servidor
-    server_socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_socket == -1) {
-        perror("[ERRO] Não foi possível criar o socket");
+    // 1. Criar os shards: um socket de escuta (SO_REUSEPORT) e um epoll
+    //    (ou io_uring) por shard, e começar a escutar (Listen)
+    reator_configurar_batimentos(ping, tempo_pong, ocioso);
+    reator_configurar_retomada(retomada);
+    reator_configurar_saida((size_t)saida_kb * 1024, (uint32_t)saida_quadros, politica_lento);
+    if (local_ligado) reator_configurar_local(&endereco_local);
+    if (arquivo_rastro != NULL && rastro_abrir(arquivo_rastro, RASTRO_SERVIDOR) < 0) {
+        perror("[ERRO] Não foi possível criar o arquivo de rastro");
         return 1;
     }
-
-    // Preparar a estrutura sockaddr_in
-    server_address.sin_family = AF_INET;
-    server_address.sin_addr.s_addr = INADDR_ANY; // Aceita conexões de qualquer IP
-    server_address.sin_port = htons(port);       // Porta para escuta
-
-    // 2. Vincular o socket à porta (Bind)
-    if (bind(server_socket, (struct sockaddr *)&server_address, sizeof(server_address)) < 0) {
-        perror("[ERRO] Bind falhou");
-        close(server_socket);
+    // Com --troca, herda as conexões do servidor em execução, se houver
+    // um; senão passa a escutar pelo próximo
+    int escuta_troca = -1;
+    if (caminho_troca != NULL) {
+        TrocaEstado herdado;
+        int herdou = troca_pedir(caminho_troca, &herdado, &escuta_troca);
+        if (herdou < 0) return 1;
+        if (herdou) {
+            shards = (int)herdado.shards;
+            snprintf(nickname, NICKNAME_MAX, "%s", herdado.nickname);
+            if (reator_configurar_heranca(&herdado) < 0) {
+                perror("[ERRO] Estado herdado inválido");
+                return 1;
+            }
+        } else if ((escuta_troca = troca_escutar(caminho_troca)) < 0) {
+            return 1;
+        }
+    }
+    if (reator_iniciar(port, backlog, backend, shards) < 0) {
+        return 1;
+    }
+    reator_threads = calloc(shards, sizeof(pthread_t));
+    if (reator_threads == NULL) {
+        perror("[ERRO] Não foi possível criar as threads dos shards");
+        reator_finalizar();
+        return 1;
+    }
+    // Um produtor do histórico por shard e mais um para esta thread
+    if (diretorio_historico != NULL &&
+        historico_iniciar(diretorio_historico, shards + 1, politica_fsync) < 0) {
+        reator_finalizar();
+        return 1;
+    }
+    // O índice de busca fica no mesmo diretório e segue o histórico
+    if (diretorio_historico != NULL && busca_iniciar(diretorio_historico) < 0) {
+        historico_finalizar();
+        reator_finalizar();
+        return 1;
+    }
+    // Um produtor da federação por shard e mais um para esta thread
+    if (federado && federacao_iniciar(shards) < 0) {
+        busca_finalizar();
+        historico_finalizar();
+        reator_finalizar();
+        return 1;
+    }
+    if (socket_metricas != NULL && metricas_servir(socket_metricas, "chat_servidor_") < 0) {
+        federacao_finalizar();
+        busca_finalizar();
+        historico_finalizar();
+        reator_finalizar();
         return 1;
     }
 
-    // 3. Escutar por conexões (Listen)
-    listen(server_socket, 1); // Aceita apenas uma conexão pendente
+    if (editor_iniciar(&editor, BUFFER_SIZE - 1) < 0) {
+        perror("[ERRO] Não foi possível criar a linha de entrada");
+        metricas_parar();
+        federacao_finalizar();
+        busca_finalizar();
+        historico_finalizar();
+        reator_finalizar();
+        return 1;
+    }
 
     printf("\033[32m══════════════════════════════════════════════════════════════\033[0m\n");
     printf("\033[32m                    CHAT PRIVADO - SERVIDOR                    \033[0m\n");
-    printf("\033[32m              Aguardando conexão na porta %d              \033[0m\n", port);
+    printf("\033[32m              Aguardando conexões na porta %d              \033[0m\n", port);
     printf("\033[32m              Nickname: %s%-*s              \033[0m\n", nickname, (int)(strlen(nickname)), "");
     printf("\033[32m                                                              \033[0m\n");
     printf("\033[32m  Digite '/quit' para sair                                    \033[0m\n");
     printf("\033[32m══════════════════════════════════════════════════════════════\033[0m\n\n");
 
-    // 4. Aceitar a conexão (Accept)
-    socklen_t client_address_len = sizeof(struct sockaddr_in);
-    client_socket = accept(server_socket, (struct sockaddr *)&client_address, &client_address_len);
-    if (client_socket < 0) {
-        perror("[ERRO] Accept falhou");
-        close(server_socket);
-        return 1;
-    }
-
-    // Obtém e exibe o IP do cliente conectado
-    char peer_ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &client_address.sin_addr, peer_ip, INET_ADDRSTRLEN);
-    printf("\033[32m[SISTEMA] Conexão aceita de %s. Pode começar a conversar.\033[0m\n", peer_ip);
-    printf("\033[32m[SISTEMA] Digite '/quit' para encerrar a conversa.\033[0m\n\n");
-
     configurar_entrada_nao_bloqueante();
 
-    // 5. Criar a thread para receber mensagens
-    if (pthread_create(&receive_thread, NULL, receber_mensagens, (void*)&client_socket) < 0) {
-        perror("[ERRO] Não foi possível criar a thread de recebimento");
-        close(client_socket);
-        close(server_socket);
-        restaurar_terminal();
-        return 1;
+    // 2. Criar uma thread por shard; cada uma aceita e atende as suas conexões
+    for (int i = 0; i < shards; i++) {
+        if (pthread_create(&reator_threads[i], NULL, reator_executar, (void *)(intptr_t)i) != 0) {
+            perror("[ERRO] Não foi possível criar a thread do reator");
+            reator_encerrar();
+            for (int j = 0; j < i; j++) pthread_join(reator_threads[j], NULL);
+            metricas_parar();
+            federacao_finalizar();
+            busca_finalizar();
+            historico_finalizar();
+            reator_finalizar();
+            restaurar_terminal();
+            return 1;
+        }
     }
 
-    // 6. Loop principal para enviar mensagens
+    // 3. Loop principal para enviar mensagens
     char message[BUFFER_SIZE];
     exibir_prompt();
     
+    struct pollfd eventos[3] = {
+        { STDIN_FILENO, POLLIN, 0 },
+        { reator_evento_interface(), POLLIN, 0 },
+        { escuta_troca, POLLIN, 0 }
+    };
+    int sucessor = -1; // Conexão de troca com o processo novo
     while (!FIM_CONEXAO) {
-        if (MENSAGEM_RECEBIDA) {
-            pthread_mutex_lock(&mutex_mensagem);
-            exibir_mensagem_recebida(ultima_mensagem.mensagem);
-            MENSAGEM_RECEBIDA = 0;
-            pthread_mutex_unlock(&mutex_mensagem);
+        // Dorme até chegar entrada do teclado, aviso da thread de rede ou
+        // um processo novo pedindo as conexões
+        if (poll(eventos, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("[ERRO] poll falhou");
+            break;
         }
-        if (ler_entrada_usuario(message, BUFFER_SIZE)) {
-            // Remove espaços em branco do início e fim
-            char *msg_trim = message;
-            while (*msg_trim == ' ' || *msg_trim == '\t') msg_trim++;
-            size_t len = strlen(msg_trim);
-            while (len > 0 && (msg_trim[len-1] == ' ' || msg_trim[len-1] == '\t' || msg_trim[len-1] == '\n')) {
-                msg_trim[--len] = '\0';
+        if (eventos[1].revents & POLLIN) {
+            uint64_t contador;
+            while (read(eventos[1].fd, &contador, sizeof(contador)) > 0) {
             }
-            
-            // Verificar se é comando /nick
-            char cmd[BUFFER_SIZE];
-            char arg1[BUFFER_SIZE];
-            if (sscanf(msg_trim, "%s %s", cmd, arg1) >= 1) {
-                if (strcmp(cmd, "/nick") == 0) {
-                    if (strlen(arg1) > 0) {
-                        // Atualizar nickname local
-                        strncpy(nickname, arg1, NICKNAME_MAX - 1);
-                        nickname[NICKNAME_MAX - 1] = '\0';
-                        // Enviar para o cliente
-                        if (send(client_socket, msg_trim, strlen(msg_trim), 0) < 0) {
-                            perror("[ERRO] Falha ao enviar mensagem");
-                            FIM_CONEXAO = 1;
-                        } else {
-                            limpar_linha_atual();
-                            printf("\033[32m✓ Nickname alterado para: %s\033[0m\n", nickname);
-                            exibir_prompt();
-                        }
-                        continue;
-                    } else {
-                        limpar_linha_atual();
-                        printf("\033[31m✗ Uso: /nick <nome>\033[0m\n");
-                        exibir_prompt();
-                        continue;
-                    }
-                }
-            }
-            
-            // Se for comando, processa normalmente
-            if (msg_trim[0] == '/' && strlen(msg_trim) > 0) {
-                int resultado_comando = processar_comando_servidor(msg_trim);
-                if (resultado_comando == 1) {
-                    // Enviar /quit para o cliente antes de sair
-                    send(client_socket, "/quit\n", 6, 0);
-                    FIM_CONEXAO = 1;
+            exibir_mensagens_pendentes();
+        }
+        if (eventos[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            int resultado;
+            while (!FIM_CONEXAO && (resultado = ler_entrada_usuario(message, BUFFER_SIZE)) >= 0) {
+                if (resultado == 1 && processar_entrada(message)) {
                     break;
-                } else if (resultado_comando == 2) {
-                    exibir_prompt();
                 }
             }
-            // Só envia/exibe se não for vazio
-            else if (strlen(msg_trim) > 0) {
-                if (send(client_socket, msg_trim, strlen(msg_trim), 0) < 0) {
-                    perror("[ERRO] Falha ao enviar mensagem");
-                    FIM_CONEXAO = 1;
-                } else {
-                    exibir_mensagem_enviada(msg_trim);
-                }
-            } else {
-                exibir_prompt();
+            if (entrada_encerrada) {
+                eventos[0].fd = -1; // stdin fechou: continua atendendo só a rede
+            }
+        }
+        if (eventos[2].revents & POLLIN) {
+            pid_t pid;
+            sucessor = troca_aceitar(escuta_troca, &pid);
+            if (sucessor >= 0) {
+                limpar_linha_atual();
+                printf("\033[33m[SISTEMA] O processo %d vai assumir as conexões.\033[0m\n", (int)pid);
+                break;
             }
         }
-        usleep(10000);
     }
 
-    // Espera a thread de recebimento finalizar
-    pthread_cancel(receive_thread);
-    pthread_join(receive_thread, NULL);
-
-    printf("\n\033[33m[SISTEMA] Encerrando a conexão.\033[0m\n");
-    close(client_socket);
-    close(server_socket);
+    // Pede aos shards que entreguem o que falta (ou que deixem as sessões
+    // para o processo novo) e espera as threads finalizarem
+    if (sucessor >= 0) reator_transferir();
+    else reator_encerrar();
+    for (int i = 0; i < shards; i++) pthread_join(reator_threads[i], NULL);
+    free(reator_threads);
+    metricas_parar();
+    federacao_finalizar(); // Avisa os pares que este nó está saindo
+    busca_finalizar(); // Grava a parte do índice que está na memória
+    historico_finalizar(); // Grava o que falta antes de fechar
+    rastro_fechar(); // Os shards já descarregaram os seus blocos
+
+    if (sucessor >= 0) {
+        passar_conexoes(sucessor, escuta_troca);
+        close(sucessor);
+    } else {
+        printf("\n\033[33m[SISTEMA] Encerrando as conexões.\033[0m\n");
+    }
+    reator_finalizar();
+    if (escuta_troca >= 0) {
+        close(escuta_troca);
+        // Depois de uma troca o caminho é do processo novo
+        if (sucessor < 0) unlink(caminho_troca);
+    }
+    editor_liberar(&editor);
     restaurar_terminal();
     exit(0);
 }
@@ -0,0 +1,94 @@
+// ============================================================================
+// ARQUIVO: servidor.h
+//
+// DESCRIÇÃO: Declarações compartilhadas entre a interface do operador
+//            (server.c) e o reator de rede (reator.c).
+// ============================================================================
+
+#ifndef SERVIDOR_H
+#define SERVIDOR_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "transporte.h"
+
+#define BUFFER_SIZE 1024
+#define NICKNAME_MAX 50
+#define BACKLOG_PADRAO SOMAXCONN
+
+#define FILA_EXIBICAO_CAPACIDADE 4096
+#define FILA_OPERADOR_CAPACIDADE 1024
+
+// Batimentos (segundos; 0 desliga)
+#define PING_PADRAO 30       // Silêncio até o servidor mandar um ping
+#define TEMPO_PONG_PADRAO 10 // Prazo para qualquer resposta ao ping
+#define OCIOSO_PADRAO 0      // Tempo sem mensagens até derrubar a conexão
+#define RETOMADA_PADRAO 30   // Espera de uma sessão cuja conexão caiu (0 = não espera)
+
+// Limites da fila de saída de cada conexão (ver reator.c)
+#define SAIDA_KB_PADRAO 4096      // Bytes por enviar, em KB
+#define SAIDA_QUADROS_PADRAO 8192 // Quadros por enviar
+#define SAIDA_KB_MINIMO 256       // A marca alta precisa de folga para um quadro inteiro
+#define SAIDA_QUADROS_MINIMO 1024 // ... e para a resposta de um /history
+
+// O que fazer com uma conexão cuja fila de saída chega ao limite
+typedef enum {
+    LENTO_DESCARTAR_ANTIGOS = 0, // Tira as mensagens de chat mais antigas ainda não enviadas
+    LENTO_DESCARTAR_NOVOS = 1,   // Recusa as mensagens de chat novas
+    LENTO_DERRUBAR = 2           // Derruba a conexão
+} PoliticaLento;
+
+// Descritor de uma mensagem entregue pelo reator à interface.
+// `dados` contém a origem e depois o corpo, ambos terminados em '\0';
+// a interface libera `dados` depois de exibir a mensagem.
+typedef struct {
+    uint8_t tipo;           // QUADRO_CHAT, QUADRO_NICK ou QUADRO_SALA
+    uint8_t tamanho_origem;
+    uint32_t tamanho;       // Tamanho do corpo
+    uint64_t recebido;      // metricas_agora() na chegada (recepção → exibição)
+    char *dados;
+} MensagemRecebida;
+
+#define MENSAGEM_ORIGEM(m) ((m)->dados)
+#define MENSAGEM_CORPO(m) ((m)->dados + (m)->tamanho_origem + 1)
+
+// Backend de E/S do reator, escolhido na inicialização
+typedef enum {
+    REATOR_EPOLL = 0,
+    REATOR_URING = 1
+} BackendReator;
+
+struct TrocaEstado;
+
+// Estado compartilhado entre a thread do reator e a interface
+extern volatile int FIM_CONEXAO;
+
+// Reator (reator.c). Com N shards, a interface cria N threads com
+// reator_executar, passando o índice do shard como argumento.
+int reator_iniciar(int porta, int backlog, BackendReator backend, int shards);
+void reator_configurar_batimentos(int ping, int tempo_pong, int ocioso);
+void reator_configurar_retomada(int segundos);
+void reator_configurar_local(const EnderecoTransporte *endereco);
+void reator_configurar_saida(size_t bytes, uint32_t quadros, PoliticaLento politica);
+int reator_politica_ler(const char *nome, PoliticaLento *politica);
+void *reator_executar(void *arg);
+int reator_total_shards(void);
+void reator_acordar_shard(int indice);
+int reator_shard_do_token(uint64_t token);
+int reator_difundir(uint8_t tipo, const char *origem, const char *corpo, size_t tamanho);
+void reator_encerrar(void);
+// Troca a quente (--troca, troca.h)
+int reator_configurar_heranca(struct TrocaEstado *estado);
+void reator_transferir(void);
+int reator_exportar(struct TrocaEstado *estado);
+void reator_finalizar(void);
+int reator_total_sessoes(void);
+int reator_total_salas(void);
+int reator_proxima_mensagem(MensagemRecebida *mensagem);
+int reator_evento_interface(void);
+void reator_estatisticas_fila(uint64_t *descartadas, size_t *pico, size_t *capacidade);
+
+#endif
@@ -0,0 +1,285 @@
+// ============================================================================
+// ARQUIVO: sessao.c
+//
+// DESCRIÇÃO: Fila de saída das sessões e retenção do que já foi enviado
+//            (ver sessao.h).
+// ============================================================================
+
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "sessao.h"
+#include "metricas.h"
+#include "transporte.h"
+#include "rastro.h"
+
+// Função para dobrar o anel de saída quando ele está cheio
+// Retorna -1 se faltou memória
+static int garantir_espaco(Sessao *s) {
+    if (s->saida_total < s->saida_capacidade) return 0;
+    uint32_t nova = s->saida_capacidade ? s->saida_capacidade * 2 : 16;
+    ItemSaida *novo = malloc(nova * sizeof(ItemSaida));
+    if (novo == NULL) return -1;
+    // Desenrola o anel para o início do novo vetor
+    for (uint32_t i = 0; i < s->saida_total; i++) {
+        novo[i] = s->saida[(s->saida_inicio + i) % s->saida_capacidade];
+    }
+    free(s->saida);
+    s->saida = novo;
+    s->saida_capacidade = nova;
+    s->saida_inicio = 0;
+    return 0;
+}
+
+// Função para enfileirar uma referência a um buffer na saída da sessão.
+// O envio de fato acontece em sessao_descarregar().
+int sessao_enfileirar(Sessao *s, BufferCompartilhado *buffer) {
+    if (garantir_espaco(s) < 0) return -1;
+    uint32_t fim = (s->saida_inicio + s->saida_total) % s->saida_capacidade;
+    buffer_reter(buffer);
+    s->saida[fim].buffer = buffer;
+    s->saida[fim].enviado = 0;
+    s->saida[fim].fora_do_fluxo = 0;
+    s->saida_total++;
+    s->saida_bytes += buffer->tamanho;
+    metricas_ajustar(MEDIDOR_FILA_SAIDA, buffer->tamanho);
+    return 0;
+}
+
+// Função para colocar um buffer à frente de toda a fila, fora do fluxo (a
+// resposta a CONTROLE_RETOMAR). Só vale sem retidos e antes de qualquer
+// envio pela conexão atual, como logo depois de sessao_retomar().
+int sessao_enfileirar_frente(Sessao *s, BufferCompartilhado *buffer) {
+    if (garantir_espaco(s) < 0) return -1;
+    s->saida_inicio = (s->saida_inicio + s->saida_capacidade - 1) % s->saida_capacidade;
+    buffer_reter(buffer);
+    s->saida[s->saida_inicio].buffer = buffer;
+    s->saida[s->saida_inicio].enviado = 0;
+    s->saida[s->saida_inicio].fora_do_fluxo = 1;
+    s->saida_total++;
+    s->saida_bytes += buffer->tamanho;
+    metricas_ajustar(MEDIDOR_FILA_SAIDA, buffer->tamanho);
+    return 0;
+}
+
+// Função para pôr de volta no fim da fila um item que veio de outro
+// processo (troca a quente, ver troca.h), com o que dele já foi enviado;
+// `retido` diz se ele está entre os retidos, que vêm sempre primeiro
+// Retorna -1 se faltou memória
+int sessao_restaurar_item(Sessao *s, BufferCompartilhado *buffer, uint32_t enviado,
+                          int fora_do_fluxo, int retido) {
+    if (garantir_espaco(s) < 0) return -1;
+    uint32_t fim = (s->saida_inicio + s->saida_total) % s->saida_capacidade;
+    buffer_reter(buffer);
+    s->saida[fim].buffer = buffer;
+    s->saida[fim].enviado = retido ? buffer->tamanho : enviado;
+    s->saida[fim].fora_do_fluxo = fora_do_fluxo;
+    s->saida_total++;
+    if (retido) {
+        s->saida_retidos++;
+        s->retidos_bytes += buffer->tamanho;
+    } else {
+        s->saida_bytes += buffer->tamanho - s->saida[fim].enviado;
+        metricas_ajustar(MEDIDOR_FILA_SAIDA, buffer->tamanho - s->saida[fim].enviado);
+    }
+    return 0;
+}
+
+// Função para soltar o primeiro item da fila, já enviado, e avançar a
+// posição do fluxo
+static void soltar_primeiro(Sessao *s) {
+    ItemSaida *item = &s->saida[s->saida_inicio];
+    if (!item->fora_do_fluxo) s->fluxo_base += item->buffer->tamanho;
+    if (s->saida_retidos > 0) {
+        s->saida_retidos--;
+        s->retidos_bytes -= item->buffer->tamanho;
+    }
+    buffer_soltar(item->buffer);
+    s->saida_inicio = (s->saida_inicio + 1) % s->saida_capacidade;
+    s->saida_total--;
+}
+
+// Função para montar em `partes` os iovecs do que falta enviar, logo
+// depois dos retidos
+// Retorna quantos iovecs foram preenchidos (no máximo SESSAO_IOV_MAX)
+int sessao_preparar_envio(Sessao *s, struct iovec *partes) {
+    int total_partes = 0;
+    for (uint32_t i = s->saida_retidos; i < s->saida_total && total_partes < SESSAO_IOV_MAX; i++) {
+        ItemSaida *item = &s->saida[(s->saida_inicio + i) % s->saida_capacidade];
+        partes[total_partes].iov_base = item->buffer->dados + item->enviado;
+        partes[total_partes].iov_len = item->buffer->tamanho - item->enviado;
+        total_partes++;
+    }
+    return total_partes;
+}
+
+// Função para registrar que `enviados` bytes do que faltava enviar saíram:
+// os buffers enviados por completo passam a retidos (ou são soltos, se o
+// cliente não confirma nada) e o parcial avança
+void sessao_confirmar_envio(Sessao *s, size_t enviados) {
+    s->saida_bytes -= enviados;
+    metricas_somar(METRICA_BYTES_ENVIADOS, enviados);
+    metricas_ajustar(MEDIDOR_FILA_SAIDA, -(int64_t)enviados);
+    while (enviados > 0) {
+        ItemSaida *item = &s->saida[(s->saida_inicio + s->saida_retidos) % s->saida_capacidade];
+        size_t falta = item->buffer->tamanho - item->enviado;
+        if (enviados < falta) {
+            item->enviado += (uint32_t)enviados;
+            break;
+        }
+        enviados -= falta;
+        rastro_bytes(s->conexao, RASTRO_ENVIADO, item->buffer->dados, item->buffer->tamanho);
+        item->enviado = item->buffer->tamanho;
+        metricas_somar(METRICA_QUADROS_ENVIADOS, 1);
+        if (s->retendo && !item->fora_do_fluxo) {
+            s->saida_retidos++;
+            s->retidos_bytes += item->buffer->tamanho;
+        } else {
+            soltar_primeiro(s); // Sem retidos, o item é o primeiro da fila
+        }
+    }
+    while (s->retidos_bytes > SESSAO_RETIDOS_MAX) {
+        soltar_primeiro(s);
+    }
+}
+
+// Função para soltar os retidos que o cliente confirmou ter recebido, até
+// a posição `fluxo` do fluxo de saída
+void sessao_confirmar_fluxo(Sessao *s, uint64_t fluxo) {
+    while (s->saida_retidos > 0 &&
+           s->fluxo_base + s->saida[s->saida_inicio].buffer->tamanho <= fluxo) {
+        soltar_primeiro(s);
+    }
+}
+
+// Função para voltar a fila à posição `fluxo`, informada pelo cliente na
+// retomada: o que ele já recebeu é solto e todo o resto, retido ou não,
+// volta a faltar enviar a partir desse ponto
+// Retorna -1 se a posição não está na fila (o começo já foi solto)
+int sessao_retomar(Sessao *s, uint64_t fluxo) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < s->saida_total; i++) {
+        ItemSaida *item = &s->saida[(s->saida_inicio + i) % s->saida_capacidade];
+        if (!item->fora_do_fluxo) total += item->buffer->tamanho;
+    }
+    if (fluxo < s->fluxo_base || fluxo - s->fluxo_base > total) return -1;
+
+    s->saida_retidos = 0;
+    s->retidos_bytes = 0;
+    // Respostas a retomadas anteriores que não chegaram a sair não valem
+    // para esta conexão (a nova vai à frente depois) e não contam no fluxo
+    uint32_t mantidos = 0;
+    for (uint32_t i = 0; i < s->saida_total; i++) {
+        ItemSaida item = s->saida[(s->saida_inicio + i) % s->saida_capacidade];
+        if (item.fora_do_fluxo) {
+            buffer_soltar(item.buffer);
+        } else {
+            s->saida[(s->saida_inicio + mantidos++) % s->saida_capacidade] = item;
+        }
+    }
+    s->saida_total = mantidos;
+    uint64_t recebido = fluxo - s->fluxo_base;
+    while (s->saida_total > 0 && s->saida[s->saida_inicio].buffer->tamanho <= recebido) {
+        recebido -= s->saida[s->saida_inicio].buffer->tamanho;
+        soltar_primeiro(s);
+    }
+    size_t pendentes = 0;
+    for (uint32_t i = 0; i < s->saida_total; i++) {
+        ItemSaida *item = &s->saida[(s->saida_inicio + i) % s->saida_capacidade];
+        item->enviado = i == 0 ? (uint32_t)recebido : 0;
+        pendentes += item->buffer->tamanho - item->enviado;
+    }
+    metricas_ajustar(MEDIDOR_FILA_SAIDA, (int64_t)pendentes - (int64_t)s->saida_bytes);
+    s->saida_bytes = pendentes;
+    return 0;
+}
+
+// Função para consultar quantos quadros da fila ainda faltam enviar
+uint32_t sessao_quadros_pendentes(const Sessao *s) {
+    return s->saida_total - s->saida_retidos;
+}
+
+// Função para tirar da fila as mensagens de chat (de sala ou privadas) mais
+// antigas ainda não enviadas, até o que falta enviar caber em `bytes` e
+// `quadros`. Ficam os `protegidos` primeiros itens por enviar (os de um
+// envio em voo), o que saiu pela metade, a resposta fora do fluxo e os
+// quadros que não são de chat, cuja perda deixaria o cliente em um estado
+// errado.
+// Retorna quantos quadros foram descartados
+uint32_t sessao_descartar_antigos(Sessao *s, size_t bytes, uint32_t quadros,
+                                  uint32_t protegidos) {
+    uint32_t descartados = 0;
+    uint32_t destino = s->saida_retidos;
+    for (uint32_t i = s->saida_retidos; i < s->saida_total; i++) {
+        ItemSaida item = s->saida[(s->saida_inicio + i) % s->saida_capacidade];
+        int excedente = s->saida_bytes > bytes ||
+                        sessao_quadros_pendentes(s) - descartados > quadros;
+        if (excedente && i >= s->saida_retidos + protegidos && item.enviado == 0 &&
+            !item.fora_do_fluxo && (item.buffer->dados[1] == QUADRO_CHAT ||
+                                    item.buffer->dados[1] == QUADRO_PRIVADO)) {
+            s->saida_bytes -= item.buffer->tamanho;
+            metricas_ajustar(MEDIDOR_FILA_SAIDA, -(int64_t)item.buffer->tamanho);
+            buffer_soltar(item.buffer);
+            descartados++;
+            continue;
+        }
+        s->saida[(s->saida_inicio + destino) % s->saida_capacidade] = item;
+        destino++;
+    }
+    s->saida_total = destino;
+    return descartados;
+}
+
+// Função para passar a fila de saída inteira (retidos, pendentes e posição
+// no fluxo) de uma sessão para outra, cuja fila está vazia
+void sessao_mover_saida(Sessao *destino, Sessao *origem) {
+    free(destino->saida);
+    destino->saida = origem->saida;
+    destino->saida_capacidade = origem->saida_capacidade;
+    destino->saida_inicio = origem->saida_inicio;
+    destino->saida_total = origem->saida_total;
+    destino->saida_bytes = origem->saida_bytes;
+    destino->saida_retidos = origem->saida_retidos;
+    destino->retidos_bytes = origem->retidos_bytes;
+    destino->retendo = origem->retendo;
+    destino->fluxo_base = origem->fluxo_base;
+
+    origem->saida = NULL;
+    origem->saida_capacidade = origem->saida_inicio = origem->saida_total = 0;
+    origem->saida_bytes = origem->retidos_bytes = 0;
+    origem->saida_retidos = 0;
+}
+
+// Função para enviar a fila de saída sem bloquear, juntando vários buffers
+// em cada sendmsg() (ou cópia para o anel, na memória compartilhada).
+// Retorna -1 se a conexão falhou.
+int sessao_descarregar(Sessao *s) {
+    while (s->saida_total > s->saida_retidos) {
+        struct iovec partes[SESSAO_IOV_MAX];
+        int total = sessao_preparar_envio(s, partes);
+        ssize_t n = transporte_enviar_iov(s->fd, partes, total, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0; // Aguarda EPOLLOUT
+            return -1;
+        }
+        sessao_confirmar_envio(s, (size_t)n);
+    }
+    return 0;
+}
+
+// Função para soltar todos os buffers ainda na fila e liberar o anel
+void sessao_liberar_saida(Sessao *s) {
+    metricas_ajustar(MEDIDOR_FILA_SAIDA, -(int64_t)s->saida_bytes);
+    while (s->saida_total > 0) {
+        buffer_soltar(s->saida[s->saida_inicio].buffer);
+        s->saida_inicio = (s->saida_inicio + 1) % s->saida_capacidade;
+        s->saida_total--;
+    }
+    free(s->saida);
+    s->saida = NULL;
+    s->saida_capacidade = 0;
+    s->saida_bytes = 0;
+}
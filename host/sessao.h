@@ -0,0 +1,134 @@
+// ============================================================================
+// ARQUIVO: sessao.h
+//
+// DESCRIÇÃO: Estado de uma conexão de cliente no servidor e sua fila de
+//            saída. A fila guarda referências a buffers compartilhados
+//            (common/buffer.h) e é descarregada com uma única chamada
+//            sendmsg()/writev por rodada do reator.
+//
+//            Para a retomada (ver protocolo.h), os buffers já enviados a um
+//            cliente que sabe retomar continuam no início da fila, como
+//            retidos, até ele confirmar que os recebeu; se a conexão cair,
+//            a fila volta à posição que o cliente informar e sai de novo.
+//            Os retidos são limitados a SESSAO_RETIDOS_MAX bytes: além
+//            disso os mais antigos são soltos e não podem mais ser
+//            reenviados.
+//
+//            O que falta enviar é limitado pelo reator (--saida-kb,
+//            --saida-quadros); sessao_descartar_antigos() abre espaço
+//            tirando as mensagens de chat mais antigas.
+// ============================================================================
+
+#ifndef SESSAO_H
+#define SESSAO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <netinet/in.h>
+#include <sys/uio.h>
+
+#include "servidor.h"
+#include "protocolo.h"
+#include "buffer.h"
+#include "temporizador.h"
+
+#define SESSAO_IOV_MAX 64 // Buffers por chamada de sendmsg()
+#define SESSAO_RETIDOS_MAX (1024 * 1024) // Bytes enviados guardados até a confirmação
+
+struct Sala;
+struct EnvioUring;
+
+// Um buffer na fila de saída e quanto dele já foi enviado
+typedef struct {
+    BufferCompartilhado *buffer;
+    uint32_t enviado;
+    int fora_do_fluxo; // Resposta a CONTROLE_RETOMAR: não é retida nem conta no fluxo
+} ItemSaida;
+
+// Estrutura de uma sessão (um cliente conectado)
+typedef struct Sessao {
+    int fd;
+    int aviso_fd; // Conexão por memória (transporte.h): eventfd que acorda o shard; senão -1
+    unsigned long id;
+    unsigned long conexao; // Número da conexão no rastro (--rastro); não passa na retomada
+    char nickname[NICKNAME_MAX];
+    char ip[INET_ADDRSTRLEN];
+
+    // Quadros parcialmente recebidos
+    LeitorQuadros leitor;
+
+    // Fila circular de saída: os `saida_retidos` primeiros itens já foram
+    // enviados e aguardam a confirmação; `saida_bytes` conta só o que falta
+    // enviar
+    ItemSaida *saida;
+    uint32_t saida_capacidade;
+    uint32_t saida_inicio;
+    uint32_t saida_total;
+    size_t saida_bytes;
+    uint32_t saida_retidos;
+    size_t retidos_bytes;
+    int retendo;         // O cliente confirma o que recebe: guarda o enviado
+    uint64_t fluxo_base; // Posição no fluxo de saída do primeiro item da fila
+
+    // Sessões com saída pendente nesta rodada do reator
+    int marcada;
+    struct Sessao *proxima_marcada;
+
+    // Sala atual (NULL = conversa com o operador)
+    struct Sala *sala;
+    uint32_t indice_sala;
+
+    // Batimentos, em ticks da roda do shard: o temporizador vence quando é
+    // hora de mandar um ping, de cobrar o pong ou de derrubar por ociosidade
+    Temporizador temporizador;
+    uint64_t ultima_atividade; // Último byte recebido
+    uint64_t ultima_mensagem;  // Último quadro que não era PING/PONG
+    uint64_t ping_enviado;
+    int ping_pendente;
+
+    // Retomada: token da sessão, bytes do fluxo do cliente já tratados e
+    // até onde isso já foi confirmado a ele
+    uint64_t token;
+    struct Sessao *proxima_token; // Próxima sessão no mesmo balde de tokens
+    uint64_t recebidos;
+    uint64_t confirmacao_enviada;
+    int confirmacao_pedida; // Ping mandado para o cliente confirmar os retidos
+    int suspensa;           // A conexão caiu; a sessão aguarda a retomada
+    int transferida;        // O socket passou a outra sessão: não derrubá-lo
+
+    // Contenção da saída: a leitura fica parada enquanto a fila de
+    // `aguardando` (talvez a própria) está acima da marca alta; `esperando`
+    // lista as sessões paradas à espera da fila desta
+    int pausada;
+    int lenta; // Chegou ao limite sem ter o que descartar; cai ao fim da rodada
+    struct Sessao *aguardando;
+    struct Sessao *esperando;
+    struct Sessao *proxima_espera;
+
+    // Backend io_uring: operações ainda no kernel e estado do envio.
+    // A sessão só é liberada quando não resta nenhuma operação pendente.
+    int operacoes_pendentes;
+    int recebendo; // Há um recv multishot armado
+    int orfa; // Fechada, aguardando as operações pendentes para ser liberada
+    struct EnvioUring *envio_uring;
+
+    struct Sessao *anterior;
+    struct Sessao *proxima;
+} Sessao;
+
+int sessao_enfileirar(Sessao *s, BufferCompartilhado *buffer);
+int sessao_enfileirar_frente(Sessao *s, BufferCompartilhado *buffer);
+int sessao_restaurar_item(Sessao *s, BufferCompartilhado *buffer, uint32_t enviado,
+                          int fora_do_fluxo, int retido);
+int sessao_descarregar(Sessao *s);
+int sessao_preparar_envio(Sessao *s, struct iovec *partes);
+void sessao_confirmar_envio(Sessao *s, size_t enviados);
+void sessao_confirmar_fluxo(Sessao *s, uint64_t fluxo);
+int sessao_retomar(Sessao *s, uint64_t fluxo);
+uint32_t sessao_quadros_pendentes(const Sessao *s);
+uint32_t sessao_descartar_antigos(Sessao *s, size_t bytes, uint32_t quadros,
+                                  uint32_t protegidos);
+void sessao_mover_saida(Sessao *destino, Sessao *origem);
+void sessao_liberar_saida(Sessao *s);
+
+#endif
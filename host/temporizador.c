@@ -0,0 +1,119 @@
+// ============================================================================
+// ARQUIVO: temporizador.c
+//
+// DESCRIÇÃO: Implementação da roda de temporizadores hierárquica (ver
+//            temporizador.h).
+// ============================================================================
+
+#include <string.h>
+
+#include "temporizador.h"
+
+#define RODA_MASCARA (RODA_POSICOES - 1)
+// Maior distância que a roda representa; além disso o vencimento é encurtado
+#define RODA_ALCANCE ((UINT64_C(1) << (RODA_BITS * RODA_NIVEIS)) - 1)
+
+// Função para ligar um temporizador no início de uma lista
+static void ligar(Temporizador **lista, Temporizador *t) {
+    t->anterior = NULL;
+    t->proximo = *lista;
+    if (*lista) (*lista)->anterior = t;
+    *lista = t;
+    t->lista = lista;
+}
+
+// Função para desligar um temporizador da lista em que está
+static void desligar(Temporizador *t) {
+    if (t->anterior) t->anterior->proximo = t->proximo;
+    else *t->lista = t->proximo;
+    if (t->proximo) t->proximo->anterior = t->anterior;
+    t->anterior = t->proximo = NULL;
+    t->lista = NULL;
+}
+
+// Função para colocar um temporizador na posição do seu vencimento: o
+// nível é o menor cuja volta cobre a distância até lá
+static void inserir(RodaTemporizadores *roda, Temporizador *t) {
+    uint64_t distancia = t->vencimento - roda->agora;
+    int nivel = 0;
+    while (nivel < RODA_NIVEIS - 1 && distancia >= (UINT64_C(1) << (RODA_BITS * (nivel + 1)))) {
+        nivel++;
+    }
+    int posicao = (int)((t->vencimento >> (RODA_BITS * nivel)) & RODA_MASCARA);
+    ligar(&roda->posicoes[nivel][posicao], t);
+}
+
+// Função para redistribuir uma posição de um nível alto pelos níveis de
+// baixo, quando o tempo chega à faixa que ela cobre
+static void cascatear(RodaTemporizadores *roda, int nivel, int posicao) {
+    Temporizador *t = roda->posicoes[nivel][posicao];
+    roda->posicoes[nivel][posicao] = NULL;
+    while (t != NULL) {
+        Temporizador *proximo = t->proximo;
+        inserir(roda, t);
+        t = proximo;
+    }
+}
+
+// Função para iniciar uma roda vazia no tick 0
+void roda_iniciar(RodaTemporizadores *roda) {
+    memset(roda, 0, sizeof(*roda));
+}
+
+// Função para agendar (ou reagendar) um temporizador para daqui a `ticks`
+// ticks; no mínimo 1, para não disparar no meio do tick atual
+void roda_agendar(RodaTemporizadores *roda, Temporizador *t, uint64_t ticks) {
+    if (t->lista != NULL) roda_cancelar(roda, t);
+    if (ticks == 0) ticks = 1;
+    if (ticks > RODA_ALCANCE) ticks = RODA_ALCANCE;
+    t->vencimento = roda->agora + ticks;
+    inserir(roda, t);
+    roda->total++;
+}
+
+// Função para cancelar um temporizador; não faz nada se ele está parado
+void roda_cancelar(RodaTemporizadores *roda, Temporizador *t) {
+    if (t->lista == NULL) return;
+    desligar(t);
+    roda->total--;
+}
+
+// Função para avançar a roda `ticks` ticks, chamando `disparar` para cada
+// temporizador vencido. O temporizador já está parado quando `disparar` é
+// chamada, que pode reagendá-lo ou cancelar outros.
+void roda_avancar(RodaTemporizadores *roda, uint64_t ticks,
+                  void (*disparar)(Temporizador *t)) {
+    while (ticks-- > 0) {
+        if (roda->total == 0) {
+            roda->agora += ticks + 1; // Roda vazia: nada para cascatear nem disparar
+            return;
+        }
+        roda->agora++;
+        // A cada volta de um nível, a próxima posição do nível de cima desce
+        for (int nivel = 1; nivel < RODA_NIVEIS; nivel++) {
+            if (roda->agora & ((UINT64_C(1) << (RODA_BITS * nivel)) - 1)) break;
+            cascatear(roda, nivel, (int)((roda->agora >> (RODA_BITS * nivel)) & RODA_MASCARA));
+        }
+
+        Temporizador **posicao = &roda->posicoes[0][roda->agora & RODA_MASCARA];
+        if (*posicao == NULL) continue;
+        // A lista passa para `vencidos`: um cancelamento durante os disparos
+        // desliga o temporizador de lá
+        roda->vencidos = *posicao;
+        *posicao = NULL;
+        for (Temporizador *t = roda->vencidos; t != NULL; t = t->proximo) {
+            t->lista = &roda->vencidos;
+        }
+        while (roda->vencidos != NULL) {
+            Temporizador *t = roda->vencidos;
+            desligar(t);
+            roda->total--;
+            disparar(t);
+        }
+    }
+}
+
+// Função para saber se um temporizador está agendado
+int temporizador_ativo(const Temporizador *t) {
+    return t->lista != NULL;
+}
@@ -0,0 +1,55 @@
+// ============================================================================
+// ARQUIVO: temporizador.h
+//
+// DESCRIÇÃO: Roda de temporizadores hierárquica, usada pelo reator para os
+//            pings e para derrubar conexões ociosas sem uma thread nem uma
+//            varredura ordenada por conexão.
+//
+//            O tempo anda em ticks. A roda tem RODA_NIVEIS níveis de
+//            RODA_POSICOES posições: o nível 0 guarda o que vence nos
+//            próximos 64 ticks, um por posição; cada nível acima cobre 64
+//            vezes mais tempo com a mesma granularidade relativa. Quando o
+//            nível de baixo dá a volta, a posição correspondente do nível
+//            de cima é redistribuída (cascata) para os níveis de baixo.
+//
+//            O temporizador é intrusivo (vive dentro da sessão) e fica em
+//            uma lista duplamente ligada: agendar, cancelar e reagendar
+//            custam O(1), e cada tick só toca a posição que venceu, qualquer
+//            que seja o número de temporizadores na roda.
+//
+//            Cada shard tem a sua roda; nada aqui é compartilhado entre
+//            threads.
+// ============================================================================
+
+#ifndef TEMPORIZADOR_H
+#define TEMPORIZADOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RODA_BITS 6
+#define RODA_POSICOES (1 << RODA_BITS)
+#define RODA_NIVEIS 4 // 64^4 ticks: mais de um mês com ticks de 100 ms
+
+typedef struct Temporizador {
+    struct Temporizador *anterior;
+    struct Temporizador *proximo;
+    struct Temporizador **lista; // Cabeça da lista em que está (NULL = parado)
+    uint64_t vencimento;         // Tick absoluto
+} Temporizador;
+
+typedef struct {
+    uint64_t agora; // Tick atual
+    size_t total;   // Temporizadores agendados
+    Temporizador *posicoes[RODA_NIVEIS][RODA_POSICOES];
+    Temporizador *vencidos; // Retirados da posição, ainda por disparar
+} RodaTemporizadores;
+
+void roda_iniciar(RodaTemporizadores *roda);
+void roda_agendar(RodaTemporizadores *roda, Temporizador *t, uint64_t ticks);
+void roda_cancelar(RodaTemporizadores *roda, Temporizador *t);
+void roda_avancar(RodaTemporizadores *roda, uint64_t ticks,
+                  void (*disparar)(Temporizador *t));
+int temporizador_ativo(const Temporizador *t);
+
+#endif
@@ -0,0 +1,409 @@
+// ============================================================================
+// ARQUIVO: troca.c
+//
+// DESCRIÇÃO: Conexão de troca a quente entre o processo antigo e o novo do
+//            servidor e os blocos de estado (ver troca.h). O que vai no
+//            bloco é decidido pelo reator; aqui só se movem bytes e
+//            descritores.
+// ============================================================================
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include "troca.h"
+#include "protocolo.h"
+#include "metricas.h"
+#include "transporte.h"
+
+// Função para garantir espaço para mais `tamanho` bytes no bloco
+// Retorna -1 se faltou memória (e marca o erro)
+static int garantir_bloco(BlocoTroca *b, size_t tamanho) {
+    if (b->erro) return -1;
+    if (b->tamanho + tamanho <= b->capacidade) return 0;
+    size_t nova = b->capacidade ? b->capacidade : 4096;
+    while (nova < b->tamanho + tamanho) nova *= 2;
+    uint8_t *dados = realloc(b->dados, nova);
+    if (dados == NULL) {
+        b->erro = 1;
+        return -1;
+    }
+    b->dados = dados;
+    b->capacidade = nova;
+    return 0;
+}
+
+// Função para acrescentar bytes ao fim do bloco
+void troca_escrever(BlocoTroca *b, const void *dados, size_t tamanho) {
+    if (tamanho == 0 || garantir_bloco(b, tamanho) < 0) return;
+    memcpy(b->dados + b->tamanho, dados, tamanho);
+    b->tamanho += tamanho;
+}
+
+void troca_escrever_u8(BlocoTroca *b, uint8_t valor) {
+    troca_escrever(b, &valor, 1);
+}
+
+void troca_escrever_u32(BlocoTroca *b, uint32_t valor) {
+    uint32_t rede = htonl(valor);
+    troca_escrever(b, &rede, sizeof(rede));
+}
+
+void troca_escrever_u64(BlocoTroca *b, uint64_t valor) {
+    uint8_t rede[8];
+    protocolo_escrever_u64(rede, valor);
+    troca_escrever(b, rede, sizeof(rede));
+}
+
+// Função para escrever um texto curto (nickname, IP, sala): tamanho u8 e bytes
+void troca_escrever_texto(BlocoTroca *b, const char *texto, size_t tamanho) {
+    if (tamanho > UINT8_MAX) tamanho = UINT8_MAX;
+    troca_escrever_u8(b, (uint8_t)tamanho);
+    troca_escrever(b, texto, tamanho);
+}
+
+// Função para ler os próximos `tamanho` bytes do bloco
+// Retorna NULL (e marca o erro) se o bloco acabou antes
+const uint8_t *troca_ler(BlocoTroca *b, size_t tamanho) {
+    if (b->erro || b->tamanho - b->posicao < tamanho) {
+        b->erro = 1;
+        return NULL;
+    }
+    const uint8_t *dados = b->dados + b->posicao;
+    b->posicao += tamanho;
+    return dados;
+}
+
+uint8_t troca_ler_u8(BlocoTroca *b) {
+    const uint8_t *dados = troca_ler(b, 1);
+    return dados != NULL ? dados[0] : 0;
+}
+
+uint32_t troca_ler_u32(BlocoTroca *b) {
+    const uint8_t *dados = troca_ler(b, 4);
+    if (dados == NULL) return 0;
+    uint32_t rede;
+    memcpy(&rede, dados, sizeof(rede));
+    return ntohl(rede);
+}
+
+uint64_t troca_ler_u64(BlocoTroca *b) {
+    const uint8_t *dados = troca_ler(b, 8);
+    return dados != NULL ? protocolo_ler_u64(dados) : 0;
+}
+
+// Função para ler um texto escrito por troca_escrever_texto (sem '\0')
+const char *troca_ler_texto(BlocoTroca *b, size_t *tamanho) {
+    *tamanho = troca_ler_u8(b);
+    const char *texto = (const char *)troca_ler(b, *tamanho);
+    if (texto == NULL) *tamanho = 0;
+    return texto;
+}
+
+// Função para liberar a memória de um bloco
+void troca_liberar_bloco(BlocoTroca *b) {
+    free(b->dados);
+    memset(b, 0, sizeof(*b));
+}
+
+// Função para mandar `tamanho` bytes inteiros
+// Retorna -1 se a conexão falhou
+static int enviar_tudo(int fd, const void *dados, size_t tamanho) {
+    const uint8_t *p = dados;
+    while (tamanho > 0) {
+        ssize_t n = send(fd, p, tamanho, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        tamanho -= (size_t)n;
+    }
+    return 0;
+}
+
+// Função para receber `tamanho` bytes inteiros
+// Retorna -1 se a conexão caiu ou falhou antes
+static int receber_tudo(int fd, void *destino, size_t tamanho) {
+    uint8_t *p = destino;
+    while (tamanho > 0) {
+        ssize_t n = recv(fd, p, tamanho, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n == 0) errno = ECONNRESET;
+            return -1;
+        }
+        p += n;
+        tamanho -= (size_t)n;
+    }
+    return 0;
+}
+
+// Função para limitar quanto a conexão de troca espera pelo outro lado
+static void aplicar_prazo(int fd) {
+    struct timeval prazo = { TROCA_PRAZO_SEGUNDOS, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &prazo, sizeof(prazo));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &prazo, sizeof(prazo));
+}
+
+// Função para mandar um lote de descritores: um u32 com a quantidade e,
+// junto dele, os descritores
+// Retorna -1 se a conexão falhou
+static int enviar_lote(int fd, const int *descritores, uint32_t total) {
+    union {
+        char dados[CMSG_SPACE(TROCA_LOTE_DESCRITORES * sizeof(int))];
+        struct cmsghdr alinhamento;
+    } controle;
+    uint32_t quantidade = htonl(total);
+    struct iovec parte = { &quantidade, sizeof(quantidade) };
+    struct msghdr mensagem;
+    memset(&mensagem, 0, sizeof(mensagem));
+    mensagem.msg_iov = &parte;
+    mensagem.msg_iovlen = 1;
+    mensagem.msg_control = controle.dados;
+    mensagem.msg_controllen = CMSG_SPACE(total * sizeof(int));
+    struct cmsghdr *cabecalho = CMSG_FIRSTHDR(&mensagem);
+    cabecalho->cmsg_level = SOL_SOCKET;
+    cabecalho->cmsg_type = SCM_RIGHTS;
+    cabecalho->cmsg_len = CMSG_LEN(total * sizeof(int));
+    memcpy(CMSG_DATA(cabecalho), descritores, total * sizeof(int));
+
+    ssize_t n;
+    do {
+        n = sendmsg(fd, &mensagem, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return -1;
+    // Os descritores foram com o primeiro byte; o resto vai sem nada
+    return enviar_tudo(fd, (uint8_t *)&quantidade + n, sizeof(quantidade) - (size_t)n);
+}
+
+// Função para receber um lote de descritores em `destino`
+// Retorna quantos chegaram ou -1 se a conexão falhou ou o lote veio errado
+static int receber_lote(int fd, int *destino, uint32_t maximo) {
+    union {
+        char dados[CMSG_SPACE(TROCA_LOTE_DESCRITORES * sizeof(int))];
+        struct cmsghdr alinhamento;
+    } controle;
+    uint32_t quantidade;
+    struct iovec parte = { &quantidade, sizeof(quantidade) };
+    struct msghdr mensagem;
+    memset(&mensagem, 0, sizeof(mensagem));
+    mensagem.msg_iov = &parte;
+    mensagem.msg_iovlen = 1;
+    mensagem.msg_control = controle.dados;
+    mensagem.msg_controllen = sizeof(controle.dados);
+
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &mensagem, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        if (n == 0) errno = ECONNRESET;
+        return -1;
+    }
+    int recebidos = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&mensagem); c != NULL; c = CMSG_NXTHDR(&mensagem, c)) {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS) continue;
+        int total = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        for (int i = 0; i < total; i++) {
+            int descritor;
+            memcpy(&descritor, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+            if ((uint32_t)recebidos < maximo) destino[recebidos++] = descritor;
+            else close(descritor);
+        }
+    }
+    if (receber_tudo(fd, (uint8_t *)&quantidade + n, sizeof(quantidade) - (size_t)n) < 0) {
+        for (int i = 0; i < recebidos; i++) close(destino[i]);
+        return -1;
+    }
+    if ((mensagem.msg_flags & MSG_CTRUNC) || ntohl(quantidade) != (uint32_t)recebidos) {
+        for (int i = 0; i < recebidos; i++) close(destino[i]);
+        errno = EPROTO;
+        return -1;
+    }
+    return recebidos;
+}
+
+// Função para receber o estado inteiro depois do pedido
+// Retorna -1 se algo faltou (o que chegou é liberado)
+static int receber_estado(int fd, TrocaEstado *estado, int *escuta) {
+    uint8_t cabecalho[TROCA_CABECALHO];
+    if (receber_tudo(fd, cabecalho, sizeof(cabecalho)) < 0) return -1;
+    BlocoTroca b = { cabecalho, sizeof(cabecalho), sizeof(cabecalho), 0, 0 };
+    const uint8_t *magico = troca_ler(&b, 8);
+    uint32_t versao = troca_ler_u32(&b);
+    if (memcmp(magico, TROCA_MAGICO, 8) != 0 || versao != TROCA_VERSAO) {
+        errno = EPROTO;
+        return -1;
+    }
+    estado->shards = troca_ler_u32(&b);
+    uint32_t descritores = troca_ler_u32(&b);
+    troca_ler_u32(&b);
+    estado->proximo_id = troca_ler_u64(&b);
+    estado->parada = troca_ler_u64(&b);
+    uint64_t tamanho_bloco = troca_ler_u64(&b);
+    memcpy(estado->nickname, troca_ler(&b, NICKNAME_MAX), NICKNAME_MAX);
+    estado->nickname[NICKNAME_MAX - 1] = '\0';
+    if (descritores == 0 || tamanho_bloco > SIZE_MAX / 2) {
+        errno = EPROTO;
+        return -1;
+    }
+
+    // O primeiro descritor é o socket de troca; os demais são do reator
+    int *todos = malloc(descritores * sizeof(int));
+    estado->bloco.dados = malloc(tamanho_bloco > 0 ? tamanho_bloco : 1);
+    if (todos == NULL || estado->bloco.dados == NULL) {
+        free(todos);
+        troca_liberar_bloco(&estado->bloco);
+        return -1;
+    }
+    uint32_t recebidos = 0;
+    while (recebidos < descritores) {
+        int n = receber_lote(fd, todos + recebidos, descritores - recebidos);
+        if (n <= 0) {
+            if (n == 0) errno = EPROTO;
+            for (uint32_t i = 0; i < recebidos; i++) close(todos[i]);
+            free(todos);
+            troca_liberar_bloco(&estado->bloco);
+            return -1;
+        }
+        recebidos += (uint32_t)n;
+    }
+    if (receber_tudo(fd, estado->bloco.dados, (size_t)tamanho_bloco) < 0) {
+        for (uint32_t i = 0; i < recebidos; i++) close(todos[i]);
+        free(todos);
+        troca_liberar_bloco(&estado->bloco);
+        return -1;
+    }
+    estado->bloco.tamanho = estado->bloco.capacidade = (size_t)tamanho_bloco;
+    *escuta = todos[0];
+    estado->total_descritores = descritores - 1;
+    memmove(todos, todos + 1, estado->total_descritores * sizeof(int));
+    estado->descritores = todos;
+    return 0;
+}
+
+// Função para pedir as conexões ao processo que escuta em `caminho`
+// (processo novo). Recebe o estado, o socket de troca em `escuta` (que
+// passa a ser deste processo) e avisa o antigo que pode sair.
+// Retorna 1 se herdou, 0 se ninguém escutava em `caminho` e -1 se falhou
+int troca_pedir(const char *caminho, TrocaEstado *estado, int *escuta) {
+    memset(estado, 0, sizeof(*estado));
+    EnderecoTransporte endereco;
+    memset(&endereco, 0, sizeof(endereco));
+    endereco.tipo = TRANSPORTE_UNIX;
+    snprintf(endereco.caminho, sizeof(endereco.caminho), "%s", caminho);
+    int fd = transporte_conectar(&endereco, 0);
+    if (fd < 0) {
+        // Sem arquivo, ou um arquivo que sobrou de um processo que já saiu
+        if (errno == ENOENT || errno == ECONNREFUSED) return 0;
+        perror("[ERRO] Não foi possível falar com o processo em execução");
+        return -1;
+    }
+    aplicar_prazo(fd);
+
+    // Os sockets chegam todos de uma vez: o limite padrão não basta
+    struct rlimit limite;
+    if (getrlimit(RLIMIT_NOFILE, &limite) == 0 && limite.rlim_cur < limite.rlim_max) {
+        limite.rlim_cur = limite.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limite);
+    }
+
+    uint8_t pedido[TROCA_PEDIDO];
+    memcpy(pedido, TROCA_MAGICO, 8);
+    uint32_t versao = htonl(TROCA_VERSAO), pid = htonl((uint32_t)getpid());
+    memcpy(pedido + 8, &versao, 4);
+    memcpy(pedido + 12, &pid, 4);
+    uint8_t pronto = 1;
+    if (enviar_tudo(fd, pedido, sizeof(pedido)) < 0 || receber_estado(fd, estado, escuta) < 0) {
+        perror("[ERRO] Falha ao receber as conexões do processo em execução");
+        close(fd);
+        return -1;
+    }
+    estado->recebido = metricas_agora();
+    if (enviar_tudo(fd, &pronto, 1) < 0) {
+        perror("[ERRO] Falha ao confirmar a troca");
+    }
+    close(fd);
+    return 1;
+}
+
+// Função para escutar os pedidos de troca em `caminho` (um socket que sobrou
+// de um processo que já saiu é substituído)
+// Retorna o socket de escuta ou -1
+int troca_escutar(const char *caminho) {
+    EnderecoTransporte endereco;
+    memset(&endereco, 0, sizeof(endereco));
+    endereco.tipo = TRANSPORTE_UNIX;
+    snprintf(endereco.caminho, sizeof(endereco.caminho), "%s", caminho);
+    int fd = transporte_escutar(&endereco, 1);
+    if (fd < 0) perror("[ERRO] Não foi possível escutar no socket de troca");
+    return fd;
+}
+
+// Função para aceitar o pedido de um processo novo e conferir o pedido
+// Retorna a conexão de troca ou -1 (nada pedido, ou pedido inválido)
+int troca_aceitar(int escuta, pid_t *pid) {
+    int fd = accept4(escuta, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) return -1;
+    aplicar_prazo(fd);
+    uint8_t pedido[TROCA_PEDIDO];
+    uint32_t versao, numero;
+    if (receber_tudo(fd, pedido, sizeof(pedido)) < 0) {
+        close(fd);
+        return -1;
+    }
+    memcpy(&versao, pedido + 8, 4);
+    memcpy(&numero, pedido + 12, 4);
+    if (memcmp(pedido, TROCA_MAGICO, 8) != 0 || ntohl(versao) != TROCA_VERSAO) {
+        fprintf(stderr, "[ERRO] Pedido de troca de uma versão incompatível\n");
+        close(fd);
+        return -1;
+    }
+    *pid = (pid_t)ntohl(numero);
+    return fd;
+}
+
+// Função para mandar o estado ao processo novo (processo antigo): o
+// cabeçalho, o socket de troca e os descritores do reator em lotes, e o
+// bloco; depois espera o processo novo confirmar que recebeu tudo
+// Retorna -1 se a conexão falhou
+int troca_enviar(int fd, int escuta, const TrocaEstado *estado) {
+    BlocoTroca cabecalho = { 0 };
+    troca_escrever(&cabecalho, TROCA_MAGICO, 8);
+    troca_escrever_u32(&cabecalho, TROCA_VERSAO);
+    troca_escrever_u32(&cabecalho, estado->shards);
+    troca_escrever_u32(&cabecalho, estado->total_descritores + 1);
+    troca_escrever_u32(&cabecalho, 0);
+    troca_escrever_u64(&cabecalho, estado->proximo_id);
+    troca_escrever_u64(&cabecalho, estado->parada);
+    troca_escrever_u64(&cabecalho, estado->bloco.tamanho);
+    troca_escrever(&cabecalho, estado->nickname, NICKNAME_MAX);
+    int resultado = cabecalho.erro ? -1 : enviar_tudo(fd, cabecalho.dados, cabecalho.tamanho);
+    troca_liberar_bloco(&cabecalho);
+    if (resultado < 0) return -1;
+
+    if (enviar_lote(fd, &escuta, 1) < 0) return -1;
+    for (uint32_t i = 0; i < estado->total_descritores; i += TROCA_LOTE_DESCRITORES) {
+        uint32_t total = estado->total_descritores - i;
+        if (total > TROCA_LOTE_DESCRITORES) total = TROCA_LOTE_DESCRITORES;
+        if (enviar_lote(fd, estado->descritores + i, total) < 0) return -1;
+    }
+    if (enviar_tudo(fd, estado->bloco.dados, estado->bloco.tamanho) < 0) return -1;
+
+    uint8_t pronto;
+    return receber_tudo(fd, &pronto, 1);
+}
+
+// Função para liberar o estado (sem fechar os descritores)
+void troca_liberar(TrocaEstado *estado) {
+    free(estado->descritores);
+    estado->descritores = NULL;
+    estado->total_descritores = 0;
+    troca_liberar_bloco(&estado->bloco);
+}
@@ -0,0 +1,92 @@
+// ============================================================================
+// ARQUIVO: troca.h
+//
+// DESCRIÇÃO: Troca a quente do processo do servidor (./server --troca
+//            CAMINHO). O processo que está rodando escuta em um socket UNIX
+//            em CAMINHO; um processo novo iniciado com o mesmo --troca
+//            encontra alguém escutando, pede as conexões e recebe:
+//              - os sockets de escuta (TCP de cada shard, o local e o
+//                próprio socket de troca, para a próxima troca);
+//              - os sockets de todas as sessões, por SCM_RIGHTS, em lotes
+//                de até TROCA_LOTE_DESCRITORES;
+//              - um bloco com o estado das sessões (ver reator_exportar em
+//                reator.c): nicknames, salas, tokens, posição dos fluxos,
+//                quadros pela metade e a fila de saída, retidos inclusive.
+//            Os clientes não são desconectados: só deixam de ser atendidos
+//            entre a parada dos shards do processo antigo e a adoção pelos
+//            shards do novo, e o kernel segura o que chegar nesse meio
+//            tempo.
+//
+//            Na conexão de troca (ordem de rede):
+//              novo → antigo: pedido (TROCA_MAGICO, versão u32, pid u32)
+//              antigo → novo: cabeçalho (TROCA_MAGICO, versão u32, shards
+//                  u32, descritores u32, reservado u32, próximo id u64,
+//                  parada u64, tamanho do bloco u64, nickname do operador
+//                  com NICKNAME_MAX bytes), os lotes (u32 com quantos
+//                  descritores vão no SCM_RIGHTS que acompanha) e o bloco
+//              novo → antigo: um byte quando terminou de receber
+// ============================================================================
+
+#ifndef TROCA_H
+#define TROCA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "servidor.h"
+
+#define TROCA_MAGICO "CHATTROC"
+#define TROCA_VERSAO 1
+#define TROCA_PEDIDO 16
+#define TROCA_CABECALHO (48 + NICKNAME_MAX)
+#define TROCA_LOTE_DESCRITORES 250 // O kernel aceita até 253 por mensagem
+#define TROCA_PRAZO_SEGUNDOS 10
+
+// Bytes de estado, escritos em sequência e lidos na mesma ordem. Um erro
+// (falta de memória ao escrever, bloco curto ao ler) fica em `erro` e as
+// operações seguintes não fazem nada; confere-se uma vez no fim.
+typedef struct {
+    uint8_t *dados;
+    size_t tamanho;
+    size_t capacidade;
+    size_t posicao; // Leitura
+    int erro;
+} BlocoTroca;
+
+// O que passa de um processo para o outro
+typedef struct TrocaEstado {
+    uint32_t shards;
+    uint64_t proximo_id;
+    uint64_t parada;   // metricas_agora() no processo antigo ao parar os shards
+    uint64_t recebido; // metricas_agora() no processo novo ao terminar de receber
+    char nickname[NICKNAME_MAX]; // Do operador
+    int *descritores;
+    uint32_t total_descritores;
+    BlocoTroca bloco;
+} TrocaEstado;
+
+// Blocos
+void troca_escrever(BlocoTroca *b, const void *dados, size_t tamanho);
+void troca_escrever_u8(BlocoTroca *b, uint8_t valor);
+void troca_escrever_u32(BlocoTroca *b, uint32_t valor);
+void troca_escrever_u64(BlocoTroca *b, uint64_t valor);
+void troca_escrever_texto(BlocoTroca *b, const char *texto, size_t tamanho);
+const uint8_t *troca_ler(BlocoTroca *b, size_t tamanho);
+uint8_t troca_ler_u8(BlocoTroca *b);
+uint32_t troca_ler_u32(BlocoTroca *b);
+uint64_t troca_ler_u64(BlocoTroca *b);
+const char *troca_ler_texto(BlocoTroca *b, size_t *tamanho);
+void troca_liberar_bloco(BlocoTroca *b);
+
+// Processo novo
+int troca_pedir(const char *caminho, TrocaEstado *estado, int *escuta);
+
+// Processo antigo
+int troca_escutar(const char *caminho);
+int troca_aceitar(int escuta, pid_t *pid);
+int troca_enviar(int fd, int escuta, const TrocaEstado *estado);
+
+void troca_liberar(TrocaEstado *estado);
+
+#endif